@@ -151,6 +151,52 @@ cmd_heartbeat() {
     fi
 }
 
+cmd_sleep() {
+    if [[ -z "${1:-}" ]] || [[ -z "${2:-}" ]]; then
+        err "missing arguments"
+        printf '  %susage: ionode sleep <device> <interval> [report]%s\n\n' "$(c_dim)" "$(_rst)"
+        return 1
+    fi
+    local device="$1"
+    local interval="$2"
+    local report="${3:-0}"
+
+    if ! [[ "$interval" =~ ^[0-9]+$ ]] || ! [[ "$report" =~ ^[0-9]+$ ]]; then
+        err "interval and report are seconds (interval 0=always on, report 0=every wake)"
+        return 1
+    fi
+
+    local result
+    if ! result=$(nats_req "${device}.config.sleep.set" "{\"interval\":${interval},\"report\":${report}}" "3s") || [[ -z "$result" ]]; then
+        timeout_msg "$device"
+        printf '  %sa sleeping node only listens briefly after each heartbeat%s\n' "$(c_dim)" "$(_rst)"
+        return 1
+    fi
+
+    if has_jq && [[ "$result" == "{"* ]]; then
+        local ok
+        ok=$(echo "$result" | jq -r '.ok // empty' 2>/dev/null)
+        if [[ "$ok" == "true" ]]; then
+            if [[ "$interval" -eq 0 ]]; then
+                printf '  %s%s%s  %ssleep → %salways on%s\n' \
+                    "$(c_device)" "$device" "$(_rst)" \
+                    "$(c_ok)" "$(c_muted)" "$(_rst)"
+            else
+                printf '  %s%s%s  %ssleep → %swake every %ds, report every %ds%s\n' \
+                    "$(c_device)" "$device" "$(_rst)" \
+                    "$(c_ok)" "$(c_text)" "$interval" "$(( report > 0 ? report : interval ))" "$(_rst)"
+            fi
+        else
+            local error detail
+            error=$(json_str "$result" "error")
+            detail=$(json_str "$result" "detail")
+            printf '  %s%s%s %s%s%s\n' "$(c_err)" "${error:-$result}" "$(_rst)" \
+                "$(c_dim)" "$detail" "$(_rst)"
+            return 1
+        fi
+    fi
+}
+
 cmd_rename() {
     if [[ -z "${1:-}" ]] || [[ -z "${2:-}" ]]; then
         err "missing arguments"
@@ -189,9 +235,10 @@ cmd_device_add() {
     if [[ -z "${1:-}" ]] || [[ -z "${2:-}" ]] || [[ -z "${3:-}" ]]; then
         err "missing arguments"
         printf '  %susage: ionode device add <device> <name> <kind> [pin] [options]%s\n' "$(c_dim)" "$(_rst)"
-        printf '  %soptions: --unit U  --inverted  --baud N  --nats subj%s\n' "$(c_dim)" "$(_rst)"
+        printf '  %soptions: --unit U  --inverted  --baud N  --uart N  --nats subj%s\n' "$(c_dim)" "$(_rst)"
         printf '  %s         --i2c-addr A  --channel C  --template T%s\n' "$(c_dim)" "$(_rst)"
-        printf '  %s         --reg-len N  --scale F%s\n\n' "$(c_dim)" "$(_rst)"
+        printf '  %s         --reg-len N  --scale F  --expr E  --ttl MS  --bus B%s\n' "$(c_dim)" "$(_rst)"
+        printf '  %s         --debounce MS  --publish-edges%s\n\n' "$(c_dim)" "$(_rst)"
         return 1
     fi
     local device="$1"
@@ -207,8 +254,9 @@ cmd_device_add() {
     fi
 
     # Parse optional flags
-    local unit="" inverted=false baud="" nats_subj=""
-    local i2c_addr="" channel="" tmpl="" reg_len="" scale=""
+    local unit="" inverted=false baud="" uart="" nats_subj=""
+    local i2c_addr="" channel="" tmpl="" reg_len="" scale="" expr="" ttl="" bus=""
+    local debounce="" publish_edges=false
     while [[ $# -gt 0 ]]; do
         case "$1" in
             --unit)
@@ -218,6 +266,9 @@ cmd_device_add() {
             --baud)
                 if [[ $# -lt 2 ]]; then err "--baud requires a value"; return 1; fi
                 baud="$2"; shift 2 ;;
+            --uart)
+                if [[ $# -lt 2 ]]; then err "--uart requires a value"; return 1; fi
+                uart="$2"; shift 2 ;;
             --nats)
                 if [[ $# -lt 2 ]]; then err "--nats requires a value"; return 1; fi
                 nats_subj="$2"; shift 2 ;;
@@ -236,6 +287,19 @@ cmd_device_add() {
             --scale)
                 if [[ $# -lt 2 ]]; then err "--scale requires a value"; return 1; fi
                 scale="$2"; shift 2 ;;
+            --expr)
+                if [[ $# -lt 2 ]]; then err "--expr requires a value"; return 1; fi
+                expr="$2"; shift 2 ;;
+            --ttl)
+                if [[ $# -lt 2 ]]; then err "--ttl requires a value"; return 1; fi
+                ttl="$2"; shift 2 ;;
+            --bus)
+                if [[ $# -lt 2 ]]; then err "--bus requires a value"; return 1; fi
+                bus="$2"; shift 2 ;;
+            --debounce)
+                if [[ $# -lt 2 ]]; then err "--debounce requires a value"; return 1; fi
+                debounce="$2"; shift 2 ;;
+            --publish-edges) publish_edges=true; shift ;;
             -*) err "unknown option: $1"; return 1 ;;
             *)  err "unexpected argument: $1"; return 1 ;;
         esac
@@ -252,18 +316,36 @@ cmd_device_add() {
     if [[ -n "$baud" ]]; then
         payload+=",\"bd\":${baud}"
     fi
+    if [[ -n "$uart" ]]; then
+        payload+=",\"up\":${uart}"
+    fi
     if [[ -n "$i2c_addr" ]]; then
         payload+=",\"ia\":${i2c_addr}"
     fi
     if [[ -n "$tmpl" ]]; then
         payload+=",\"dt\":\"${tmpl}\""
     fi
+    if [[ -n "$expr" ]]; then
+        payload+=",\"ex\":\"${expr}\""
+    fi
     if [[ -n "$reg_len" ]]; then
         payload+=",\"rl\":${reg_len}"
     fi
     if [[ -n "$scale" ]]; then
         payload+=",\"sc\":${scale}"
     fi
+    if [[ -n "$ttl" ]]; then
+        payload+=",\"ct\":${ttl}"
+    fi
+    if [[ -n "$bus" ]]; then
+        payload+=",\"ib\":${bus}"
+    fi
+    if [[ -n "$debounce" ]]; then
+        payload+=",\"db\":${debounce}"
+    fi
+    if [[ "$publish_edges" == true ]]; then
+        payload+=",\"ep\":true"
+    fi
     payload+="}"
 
     local result
@@ -108,7 +108,7 @@ cmd_ls() {
         rssi=$(echo "$line" | jq -r '.rssi // empty' 2>/dev/null)
 
         local n_sensors n_actuators
-        n_sensors=$(echo "$line" | jq '[.devices[] | select(.kind | test("digital_in|analog_in|ntc_10k|ldr|internal_temp|clock_|nats_value|serial_text|i2c_|dht"))] | length' 2>/dev/null || echo 0)
+        n_sensors=$(echo "$line" | jq '[.devices[] | select(.kind | test("digital_in|analog_in|ntc_10k|ldr|internal_temp|clock_|nats_value|serial_text|i2c_|dht|pulse_|computed"))] | length' 2>/dev/null || echo 0)
         n_actuators=$(echo "$line" | jq '[.devices[] | select(.kind | test("digital_out|relay|pwm|rgb_led|ssd1306|sh1106"))] | length' 2>/dev/null || echo 0)
 
         # Format heap
@@ -1,5 +1,5 @@
 #!/usr/bin/env bash
-# IOnode CLI — Event commands (event set/clear/list)
+# IOnode CLI — Event and rule commands (event/rule set/clear/list)
 
 cmd_event() {
     if [[ -z "${1:-}" ]]; then
@@ -25,14 +25,14 @@ cmd_event() {
 cmd_event_set() {
     if [[ -z "${1:-}" ]] || [[ -z "${2:-}" ]]; then
         err "missing arguments"
-        printf '  %susage: ionode event set <device> <sensor> --above|--below <value> [--cooldown <s>]%s\n\n' "$(c_dim)" "$(_rst)"
+        printf '  %susage: ionode event set <device> <sensor> --above|--below <value> [--cooldown <s>] [--hysteresis <v>] [--mode value|rate|avg|min|max] [--window <n>]%s\n\n' "$(c_dim)" "$(_rst)"
         return 1
     fi
     local device="$1"
     local sensor="$2"
     shift 2
 
-    local threshold="" direction="" cooldown="10"
+    local threshold="" direction="" cooldown="10" hysteresis="" mode="" window=""
     while [[ $# -gt 0 ]]; do
         case "$1" in
             --above)
@@ -44,6 +44,15 @@ cmd_event_set() {
             --cooldown)
                 if [[ $# -lt 2 ]]; then err "--cooldown requires a value"; return 1; fi
                 cooldown="$2"; shift 2 ;;
+            --hysteresis)
+                if [[ $# -lt 2 ]]; then err "--hysteresis requires a value"; return 1; fi
+                hysteresis="$2"; shift 2 ;;
+            --mode)
+                if [[ $# -lt 2 ]]; then err "--mode requires a value"; return 1; fi
+                mode="$2"; shift 2 ;;
+            --window)
+                if [[ $# -lt 2 ]]; then err "--window requires a value"; return 1; fi
+                window="$2"; shift 2 ;;
             -*) err "unknown option: $1"; return 1 ;;
             *)  err "unexpected argument: $1"; return 1 ;;
         esac
@@ -51,13 +60,17 @@ cmd_event_set() {
 
     if [[ -z "$direction" ]] || [[ -z "$threshold" ]]; then
         err "event set requires --above <value> or --below <value>"
-        printf '  %susage: ionode event set <device> <sensor> --above|--below <value> [--cooldown <s>]%s\n\n' "$(c_dim)" "$(_rst)"
+        printf '  %susage: ionode event set <device> <sensor> --above|--below <value> [--cooldown <s>] [--hysteresis <v>] [--mode value|rate|avg|min|max] [--window <n>]%s\n\n' "$(c_dim)" "$(_rst)"
         return 1
     fi
 
     local payload
-    payload=$(printf '{"n":"%s","t":%s,"d":"%s","cd":%s}' \
+    payload=$(printf '{"n":"%s","t":%s,"d":"%s","cd":%s' \
         "$sensor" "$threshold" "$direction" "$cooldown")
+    [[ -n "$hysteresis" ]] && payload+=$(printf ',"h":%s' "$hysteresis")
+    [[ -n "$mode" ]]       && payload+=$(printf ',"m":"%s"' "$mode")
+    [[ -n "$window" ]]     && payload+=$(printf ',"w":%s' "$window")
+    payload+="}"
 
     local result
     if ! result=$(nats_req "${device}.config.event.set" "$payload" "3s") || [[ -z "$result" ]]; then
@@ -154,8 +167,10 @@ cmd_event_list() {
     fi
 
     echo "$result" | jq -c '.[]' 2>/dev/null | while IFS= read -r ev; do
-        local ename ethreshold edir ecooldown earmed
+        local ename ethreshold edir ecooldown earmed emode ewindow
         ename=$(json_str "$ev" "name")
+        emode=$(json_str "$ev" "mode")
+        ewindow=$(json_num "$ev" "window")
         ethreshold=$(echo "$ev" | jq -r '.threshold' 2>/dev/null)
         edir=$(json_str "$ev" "direction")
         ecooldown=$(json_num "$ev" "cooldown")
@@ -170,13 +185,166 @@ cmd_event_list() {
             armed_indicator="$(c_accent)● fired$(_rst)"
         fi
 
-        printf '  %s⚡%s  %s%-14s%s  %s%s %s%s  %scd=%ss%s  %s\n' \
+        local mode_str=""
+        [[ -n "$emode" && "$emode" != "value" ]] && mode_str=" ${emode}/${ewindow}"
+
+        printf '  %s⚡%s  %s%-14s%s  %s%s %s%s%s  %scd=%ss%s  %s\n' \
             "$(c_accent)" "$(_rst)" \
             "$(c_sensor)" "$ename" "$(_rst)" \
-            "$(c_text)" "$dir_symbol" "$ethreshold" "$(_rst)" \
+            "$(c_text)" "$dir_symbol" "$ethreshold" "$mode_str" "$(_rst)" \
             "$(c_dim)" "$ecooldown" "$(_rst)" \
             "$armed_indicator"
     done
 
     printf '\n  %s%d event(s)%s\n\n' "$(c_dim)" "$n_events" "$(_rst)"
 }
+
+cmd_rule() {
+    if [[ -z "${1:-}" ]]; then
+        err "missing subcommand"
+        printf '  %susage: ionode rule set|clear|list ...%s\n\n' "$(c_dim)" "$(_rst)"
+        return 1
+    fi
+    local subcmd="$1"
+    shift
+
+    case "$subcmd" in
+        set)   cmd_rule_set "$@" ;;
+        clear) cmd_rule_clear "$@" ;;
+        list)  cmd_rule_list "$@" ;;
+        *)
+            err "rule subcommand must be 'set', 'clear', or 'list'"
+            printf '  %susage: ionode rule set|clear|list ...%s\n\n' "$(c_dim)" "$(_rst)"
+            return 1
+            ;;
+    esac
+}
+
+cmd_rule_set() {
+    if [[ -z "${1:-}" ]] || [[ -z "${2:-}" ]]; then
+        err "missing arguments"
+        printf '  %susage: ionode rule set <device> '\''{"n":"cool","c":[...],"do":{"a":"fan","on":1,"off":0}}'\''%s\n\n' "$(c_dim)" "$(_rst)"
+        return 1
+    fi
+    local device="$1"
+    local payload="$2"
+
+    local result
+    if ! result=$(nats_req "${device}.config.rule.set" "$payload" "3s") || [[ -z "$result" ]]; then
+        timeout_msg "$device"
+        return 1
+    fi
+
+    if has_jq && [[ "$result" == "{"* ]]; then
+        local ok
+        ok=$(echo "$result" | jq -r '.ok // empty' 2>/dev/null)
+        if [[ "$ok" == "true" ]]; then
+            local rname
+            rname=$(json_str "$payload" "n")
+            printf '  %s⚡%s  %s%s%s  %srule set%s\n' \
+                "$(c_accent)" "$(_rst)" \
+                "$(c_sensor)" "$rname" "$(_rst)" \
+                "$(c_dim)" "$(_rst)"
+        else
+            local error detail
+            error=$(json_str "$result" "error")
+            detail=$(json_str "$result" "detail")
+            printf '  %s✗  %s%s%s\n' "$(c_err)" "${error:-failed}" \
+                "${detail:+ — $detail}" "$(_rst)"
+            return 1
+        fi
+    fi
+}
+
+cmd_rule_clear() {
+    if [[ -z "${1:-}" ]] || [[ -z "${2:-}" ]]; then
+        err "missing arguments"
+        printf '  %susage: ionode rule clear <device> <rule>%s\n\n' "$(c_dim)" "$(_rst)"
+        return 1
+    fi
+    local device="$1"
+    local rname="$2"
+
+    local payload
+    payload=$(printf '{"n":"%s"}' "$rname")
+
+    local result
+    if ! result=$(nats_req "${device}.config.rule.clear" "$payload" "3s") || [[ -z "$result" ]]; then
+        timeout_msg "$device"
+        return 1
+    fi
+
+    if has_jq && [[ "$result" == "{"* ]]; then
+        local ok
+        ok=$(echo "$result" | jq -r '.ok // empty' 2>/dev/null)
+        if [[ "$ok" == "true" ]]; then
+            printf '  %s−%s  %s%s%s  %srule cleared%s\n' \
+                "$(c_muted)" "$(_rst)" \
+                "$(c_sensor)" "$rname" "$(_rst)" \
+                "$(c_dim)" "$(_rst)"
+        else
+            local error
+            error=$(json_str "$result" "error")
+            printf '  %s✗  %s%s\n' "$(c_err)" "${error:-failed}" "$(_rst)"
+            return 1
+        fi
+    fi
+}
+
+cmd_rule_list() {
+    if [[ -z "${1:-}" ]]; then
+        err "missing argument"
+        printf '  %susage: ionode rule list <device>%s\n\n' "$(c_dim)" "$(_rst)"
+        return 1
+    fi
+    local device="$1"
+
+    if ! has_jq; then
+        err "jq is required for rule list. Install: apt install jq"
+        exit 1
+    fi
+
+    local result
+    if ! result=$(nats_req "${device}.config.rule.list" "" "3s") || [[ -z "$result" ]]; then
+        timeout_msg "$device"
+        return 1
+    fi
+
+    local n_rules
+    n_rules=$(echo "$result" | jq 'length' 2>/dev/null || echo 0)
+
+    header "Rules  ·  ${device}"
+    printf '\n'
+
+    if [[ "$n_rules" -eq 0 ]]; then
+        printf '  %sNo rules configured.%s\n\n' "$(c_dim)" "$(_rst)"
+        return
+    fi
+
+    echo "$result" | jq -c '.[]' 2>/dev/null | while IFS= read -r rule; do
+        local rname rop ractive rconds raction
+        rname=$(json_str "$rule" "n")
+        rop=$(json_str "$rule" "op")
+        ractive=$(echo "$rule" | jq -r '.active' 2>/dev/null)
+        rconds=$(echo "$rule" | jq -r --arg op " ${rop} " \
+            '[.c[] | "\(.s) \(if .d == "above" then ">" else "<" end) \(.t)"] | join($op)' 2>/dev/null)
+        raction=$(echo "$rule" | jq -r \
+            'if .do then "→ \(.do.a)=\(.do.on)" + (if .do.off != null then "/\(.do.off)" else "" end) else "" end' 2>/dev/null)
+
+        local state_indicator
+        if [[ "$ractive" == "true" ]]; then
+            state_indicator="$(c_accent)● active$(_rst)"
+        else
+            state_indicator="$(c_green)● idle$(_rst)"
+        fi
+
+        printf '  %s⚡%s  %s%-14s%s  %s%s%s  %s%s%s  %s\n' \
+            "$(c_accent)" "$(_rst)" \
+            "$(c_sensor)" "$rname" "$(_rst)" \
+            "$(c_text)" "$rconds" "$(_rst)" \
+            "$(c_actuator)" "$raction" "$(_rst)" \
+            "$state_indicator"
+    done
+
+    printf '\n  %s%d rule(s)%s\n\n' "$(c_dim)" "$n_rules" "$(_rst)"
+}
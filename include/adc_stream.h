@@ -0,0 +1,73 @@
+/**
+ * @file adc_stream.h
+ * @brief Continuous DMA ADC sampling with per-channel decimation
+ *
+ * The ADC1 pins of all analog devices are sampled round-robin by the
+ * adc_continuous driver. Each channel feeds a 2nd-order CIC decimator, so
+ * a sensor read is a lookup of the latest filtered value instead of a
+ * burst of blocking conversions. Pins the engine cannot take (ADC2, or
+ * more than ADC_STREAM_MAX) fall back to one-shot reads, which pause the
+ * engine for the duration of the burst.
+ */
+
+#ifndef ADC_STREAM_H
+#define ADC_STREAM_H
+
+#include <Arduino.h>
+
+#define ADC_STREAM_MAX        8       /* streamed pins */
+#define ADC_STREAM_SAMPLE_HZ  20000   /* total conversions/s, all channels */
+#define ADC_STREAM_DECIM      64      /* CIC decimation ratio per channel */
+#define ADC_STREAM_FRAME      256     /* DMA frame size in bytes */
+#define ADC_STREAM_POOL       4096    /* driver ring buffer in bytes */
+#define ADC_STREAM_DRAIN_MS   20      /* poll period, well inside the ~50ms the pool holds */
+
+#define ADC_CAPTURE_MAX       8192    /* samples per capture (int16 each) */
+#define ADC_CAPTURE_HZ_MIN    10
+#define ADC_CAPTURE_HZ_MAX    80000
+
+/**
+ * Set the pins to stream. Restarts the engine if the set changed; an
+ * empty set stops it. Returns the number of pins actually streamed.
+ */
+int adcStreamSetPins(const uint8_t *pins, int n);
+
+/**
+ * Drain finished DMA frames into the decimators. Call from the main loop;
+ * never waits. Schedules the next pass while the engine runs.
+ */
+void adcStreamPoll();
+
+/* Latest filtered value of a streamed pin as 12-bit raw (fractional) or
+   calibrated millivolts. Returns false if the pin is not streamed or the
+   filter has not settled yet. */
+bool adcStreamRaw(uint8_t pin, float *raw);
+bool adcStreamMilliVolts(uint8_t pin, float *mv);
+
+/* One-shot reads for pins outside the stream (pauses the engine) */
+int   adcOneshotRaw(uint8_t pin);
+float adcOneshotMilliVolts(uint8_t pin, int samples, int discard = 0);
+
+/**
+ * Start a burst capture of n samples at hz on an ADC1 pin into the
+ * preallocated capture buffer. The stream is suspended until
+ * adcCaptureEnd(). Rates below the hardware minimum are reached by
+ * oversampling and box-averaging. Returns false if the pin cannot be
+ * captured or a capture is already running.
+ */
+bool adcCaptureStart(uint8_t pin, uint32_t hz, int n);
+
+/* Capture progress: 0 = running, 1 = done, -1 = failed (timeout). The
+   last frame of a capture wakes the main loop. */
+int adcCapturePoll();
+
+/* Captured samples (12-bit raw, or millivolts if to_mv) and count */
+const int16_t *adcCaptureData(int *n, bool to_mv);
+
+/* Release the capture and resume streaming */
+void adcCaptureEnd();
+
+/* Engine statistics since boot. Returns true if the engine is running. */
+bool adcStreamStats(int *channels, uint32_t *outputs, uint32_t *overruns);
+
+#endif /* ADC_STREAM_H */
@@ -0,0 +1,32 @@
+/**
+ * @file boot_cache.h
+ * @brief Connection details kept across resets for a fast reconnect
+ *
+ * The access point (BSSID and channel) and the NATS server address from
+ * the last successful connection live in RTC memory, which survives
+ * software resets, watchdog resets and deep sleep but not power loss.
+ * With them WiFi joins without a full scan and NATS connects without a
+ * DNS lookup. Entries are bound to the SSID / host they were learned for
+ * and the block is CRC-checked, so a stale or uninitialized cache is
+ * ignored; callers fall back to the normal path and clear an entry that
+ * no longer works.
+ */
+
+#ifndef BOOT_CACHE_H
+#define BOOT_CACHE_H
+
+#include <stdint.h>
+
+/* BSSID and channel last used to join ssid. False if not known. */
+bool bootCacheWifi(const char *ssid, uint8_t bssid[6], uint8_t *channel);
+
+/* Remember the access point joined for ssid (bssid nullptr = forget) */
+void bootCacheSetWifi(const char *ssid, const uint8_t *bssid, uint8_t channel);
+
+/* Address host resolved to last time, 0 if not known */
+uint32_t bootCacheNatsIp(const char *host);
+
+/* Remember the address of host (0 = forget) */
+void bootCacheSetNatsIp(const char *host, uint32_t ip);
+
+#endif /* BOOT_CACHE_H */
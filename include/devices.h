@@ -39,6 +39,11 @@ enum DeviceKind {
     DEV_SENSOR_DHT11_HUMI,     /* DHT11 humidity (integer, 20-80% RH) */
     DEV_SENSOR_DHT22_TEMP,     /* DHT22 temperature (0.1° res, -40–80°C) */
     DEV_SENSOR_DHT22_HUMI,     /* DHT22 humidity (0.1° res, 0-100% RH) */
+    /* Pulse counters (PCNT, pulse_counter.h) */
+    DEV_SENSOR_PULSE_COUNT,    /* rising edges since boot/reset */
+    DEV_SENSOR_PULSE_RATE,     /* rising edges per second over a 2s window */
+    /* Virtual sensors */
+    DEV_SENSOR_COMPUTED,       /* expression over other sensors (expr.h), in disp_template */
     /* Actuators */
     DEV_ACTUATOR_DIGITAL,       /* digitalWrite */
     DEV_ACTUATOR_RELAY,         /* digitalWrite (inverted flag) */
@@ -55,20 +60,30 @@ struct Device {
     char        unit[DEV_UNIT_LEN];
     bool        inverted;
     bool        used;
-    /* NATS virtual sensor fields (only meaningful for DEV_SENSOR_NATS_VALUE) */
+    /* NATS virtual sensor fields (only meaningful for DEV_SENSOR_NATS_VALUE;
+       value and message also hold the last line of a serial_text device) */
     char        nats_subject[32];
     float       nats_value;
     char        nats_msg[64];
     uint16_t    nats_sid;
-    /* Serial text baud rate (only meaningful for DEV_SENSOR_SERIAL_TEXT) */
+    /* Serial text UART (only meaningful for DEV_SENSOR_SERIAL_TEXT) */
     uint32_t    baud;
+    uint8_t     uart;               /* UART number, 1..SERIAL_TEXT_UARTS */
     /* I2C fields */
     uint8_t     i2c_addr;           /* I2C slave address (0 = not I2C) */
-    char        disp_template[128]; /* display template for SSD1306 actuators */
+    uint8_t     i2c_bus;            /* I2C controller index (0 or 1) */
+    char        disp_template[128]; /* display template (SSD1306) / expression (computed) */
     uint8_t     i2c_reg_len;        /* i2c_generic: bytes to read (1 or 2) */
-    float       i2c_scale;          /* i2c_generic: scale multiplier */
+    float       i2c_scale;          /* i2c_generic, pulse_*: scale multiplier */
+    uint16_t    i2c_ttl_ms;         /* I2C sensors: read cache TTL (0 = always read) */
+    /* Digital input edge capture (DEV_SENSOR_DIGITAL) */
+    uint16_t    debounce_ms;        /* edges closer than this are bounces */
+    bool        edge_publish;       /* publish every edge on events.{name} */
     /* Last value set on actuator (for display; not persisted, resets on boot) */
     int         last_value;
+    /* Result of the last sensor read (runtime only, not persisted) */
+    float       sample;
+    bool        sampled;
     /* EMA-smoothed sensor value (runtime only, not persisted) */
     float       ema;
     bool        ema_init;
@@ -77,10 +92,13 @@ struct Device {
     float       history[DEV_HISTORY_LEN];
     uint8_t     history_idx;
     bool        history_full;
-    /* Event config (persisted as flat keys in devices.json) */
+    /* Event config (persisted) */
     float       ev_threshold;
     uint8_t     ev_direction;     /* 0=none, 1=above, 2=below */
     uint16_t    ev_cooldown;      /* seconds */
+    float       ev_hysteresis;    /* release band below/above threshold */
+    uint8_t     ev_mode;          /* EV_MODE_* (events.h) */
+    uint8_t     ev_window;        /* window length in samples (non-value modes) */
     /* Event runtime (RAM only) */
     bool        ev_armed;
     uint32_t    ev_last_fire_ms;
@@ -91,22 +109,44 @@ struct Device {
 #define EV_DIR_ABOVE  1
 #define EV_DIR_BELOW  2
 
-/* Initialize device registry - loads from /devices.json, auto-registers chip_temp */
+/* I2C read cache TTL when a device does not configure one */
+#define DEV_I2C_TTL_DEFAULT  1000
+
+/* Digital input debounce when a device does not configure one */
+#define DEV_DEBOUNCE_DEFAULT 20
+#define DEV_DEBOUNCE_MAX     1000
+
+/* Initialize device registry - loads from /devices.bin (imports /devices.json
+   once if there is no binary store), auto-registers chip_temp */
 void devicesInit();
 
-/* Background sensor poll - call from main loop to keep EMA warm */
+/* Background sensor poll - call from main loop to keep EMA warm.
+   Schedules the pass for its next sample tick or pending acquisition. */
 void sensorsPoll();
 
-/* Persist device registry to /devices.json */
+/* Run the NTC acquisitions to completion (up to 300ms). For the
+   duty-cycle wake only; elsewhere an unsettled NTC reads NAN. */
+void sensorsSettle();
+
+/* Persist device registry to /devices.bin - writes only changed records */
 void devicesSave();
 
+/* Registry as a JSON array (the devices.json format), in a static buffer.
+   Returns nullptr if it does not fit. */
+const char *devicesExportJson(int *len = nullptr);
+
+/* Replace the registry with a JSON array, re-register builtins and save.
+   Returns the number of devices imported; entries that were malformed or
+   failed to register are counted in *skipped. */
+int devicesImportJson(const char *json, int *skipped = nullptr);
+
 /* Mark device registry dirty — triggers debounced save in main loop */
 void devicesMarkDirty();
 
 /* Clear all devices (deinits serial_text if active, zeroes array) */
 void devicesClear();
 
-/* Reload devices from /devices.json, re-register builtins */
+/* Reload devices from /devices.bin, re-register builtins */
 void devicesReload();
 
 /* Register a new device. Returns true on success. */
@@ -117,7 +157,9 @@ bool deviceRegister(const char *name, DeviceKind kind, uint8_t pin,
                     uint8_t i2c_addr = 0,
                     const char *disp_template = nullptr,
                     uint8_t i2c_reg_len = 1,
-                    float i2c_scale = 1.0f);
+                    float i2c_scale = 1.0f,
+                    uint16_t i2c_ttl_ms = DEV_I2C_TTL_DEFAULT,
+                    uint8_t i2c_bus = 0, uint8_t uart = 1);
 
 /* Remove a device by name. Returns true if found and removed. */
 bool deviceRemove(const char *name);
@@ -125,9 +167,18 @@ bool deviceRemove(const char *name);
 /* Find a device by name. Returns nullptr if not found. */
 Device *deviceFind(const char *name);
 
+/* Find a device by a name that is not NUL-terminated (subject token).
+   hash is the token's routeHash(name, len). */
+Device *deviceFindN(const char *name, size_t len, uint32_t hash);
+
 /* Read a sensor device. Returns the reading as a float. */
 float deviceReadSensor(Device *dev, bool record_hist = false);
 
+/* Value of the last sensor read, without touching the hardware. The
+   sample loop refreshes it at least every 5 minutes. Returns false if
+   the sensor has not been read since it was registered. */
+bool deviceLastSample(const Device *dev, float *value);
+
 /* Set an actuator device. value: 0/1 for digital/relay, 0-255 for PWM. Returns true on success. */
 bool deviceSetActuator(Device *dev, int value);
 
@@ -149,37 +200,22 @@ Device *deviceGetAllMutable();
 /* Set the NATS value + message on a device */
 void deviceSetNatsValue(Device *dev, float value, const char *msg);
 
-/* Get the NATS message string from a device */
+/* Get the message string of a nats_value or serial_text device */
 const char *deviceGetNatsMsg(const Device *dev);
 
 /* Parse a NATS payload into value + message */
 void parseNatsPayload(const uint8_t *data, size_t len,
                       float *out_value, char *out_msg, size_t msg_len);
 
-/* --- Serial text UART (one device max, fixed pins per chip) --- */
-
-/* Fixed UART1 pins per chip variant */
-#if defined(CONFIG_IDF_TARGET_ESP32C6)
-#define SERIAL_TEXT_RX  4
-#define SERIAL_TEXT_TX  5
-#elif defined(CONFIG_IDF_TARGET_ESP32S3)
-#define SERIAL_TEXT_RX  19
-#define SERIAL_TEXT_TX  20
-#elif defined(CONFIG_IDF_TARGET_ESP32C3)
-#define SERIAL_TEXT_RX  4
-#define SERIAL_TEXT_TX  5
-#else
-#define SERIAL_TEXT_RX  16
-#define SERIAL_TEXT_TX  17
-#endif
-
-void serialTextInit(uint32_t baud);
-void serialTextDeinit();
+/* --- Serial text devices (serial_text.h, one device per UART) --- */
+
+/* Frame received lines into serial_text devices and publish each on
+   {node}.serial.{device}. Call from the main loop; the port's event
+   task wakes the loop when a line is complete. */
 void serialTextPoll();
-bool serialTextSend(const char *text);
-const char *serialTextGetMsg();
-float serialTextGetValue();
-bool serialTextActive();
+
+/* serial_text device on a UART (0 = the first one), or nullptr */
+Device *deviceSerialText(uint8_t uart);
 
 /* Returns true if the rgb_led device is set to a non-zero color (suppresses heartbeat) */
 bool rgbLedOverride();
@@ -190,10 +226,22 @@ bool deviceIsDisplay(DeviceKind kind);
 /* Check if a DeviceKind is an I2C sensor type */
 bool deviceIsI2c(DeviceKind kind);
 
-/* Check all sensor events and fire NATS notifications on threshold crossing */
-void eventsCheck();
+/* Check if a DeviceKind reads a pulse counter (pulse_count, pulse_rate) */
+bool deviceIsPulse(DeviceKind kind);
+
+/* I2C address with the device's bus index folded in (see I2C_BUS_ADDR) */
+uint8_t deviceI2cAddr(const Device *dev);
+
+/* Validate a computed-sensor expression against the current registry.
+ * Returns false with a reason in err. */
+bool deviceExprCheck(const char *expr, char *err, size_t err_len);
+
+/* Edge counters of a digital input since it was registered. Returns false
+ * for other kinds. last_us is the esp_timer time of the last edge. */
+bool deviceEdgeStats(const Device *dev, uint32_t *rising, uint32_t *falling,
+                     uint64_t *last_us);
 
-/* Count sensors with events configured */
-int eventsCount();
+/* Registry generation - bumps on every register/remove/clear */
+uint32_t deviceRegistryGen();
 
 #endif /* DEVICES_H */
@@ -0,0 +1,51 @@
+/**
+ * @file dht_decode.h
+ * @brief DHT11/DHT22 frame decoder working on captured edge timestamps
+ *
+ * The driver records the time of every level change on the data line
+ * while the sensor transmits; this module turns that trace into the five
+ * data bytes and then into temperature and humidity.
+ *
+ * A frame ends with 40 bits of (~50us LOW, 26-28us HIGH = 0 / ~70us HIGH = 1)
+ * followed by a ~50us LOW and the line returning HIGH. Decoding walks the
+ * trace backwards from that final rising edge, so a missed start/ACK edge
+ * at the beginning of the capture does not matter.
+ *
+ * No Arduino dependency; compiles on the host. Host test over reference
+ * traces (valid DHT11/DHT22, bad checksum, short and jittered frames):
+ * test/host/dht_decode_test.cpp.
+ */
+
+#ifndef DHT_DECODE_H
+#define DHT_DECODE_H
+
+#include <stdint.h>
+
+#define DHT_BIT_ONE_US    48    /* HIGH longer than this is a '1' */
+#define DHT_PULSE_MAX_US  100   /* any data-phase pulse longer is a glitch */
+
+enum DhtDecodeResult {
+    DHT_DECODE_OK = 0,
+    DHT_DECODE_SHORT,       /* fewer than 82 edges captured */
+    DHT_DECODE_TIMING,      /* pulse width out of range */
+    DHT_DECODE_CHECKSUM,    /* byte sum does not match */
+};
+
+/**
+ * Decode a DHT frame from edge timestamps (microseconds, any epoch,
+ * wrap-safe). edges[n-1] must be the final rising edge of the frame.
+ *
+ * @param edges  Edge timestamps, oldest first
+ * @param n      Number of edges
+ * @param data   Receives the 5 frame bytes (valid only on DHT_DECODE_OK)
+ * @return       DhtDecodeResult
+ */
+int dhtDecodeEdges(const uint32_t *edges, int n, uint8_t data[5]);
+
+/** Convert checked frame bytes to temperature (C) and humidity (%RH). */
+void dhtDecodeValues(const uint8_t data[5], bool is_dht22, float *temp, float *humi);
+
+/** Short text for a DhtDecodeResult, for debug output. */
+const char *dhtDecodeError(int rc);
+
+#endif /* DHT_DECODE_H */
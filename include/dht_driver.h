@@ -2,8 +2,10 @@
  * @file dht_driver.h
  * @brief DHT11/DHT22 single-wire temperature & humidity sensor driver
  *
- * Hand-rolled bit-bang driver with per-pin read cache (2s TTL).
- * Uses critical section (interrupts disabled) during the ~4ms read window.
+ * Hand-rolled driver with per-pin read cache (2s TTL). The response is
+ * captured as edge timestamps by a GPIO interrupt and decoded afterwards;
+ * interrupts are never disabled. Reads are asynchronous: a stale cache
+ * entry schedules a capture that dhtPoll() drives in the background.
  * Register two devices on the same GPIO pin to get both temp and humidity.
  */
 
@@ -16,10 +18,15 @@
 #define DHT_CHAN_HUMI     1
 #define DHT_CACHE_MAX     4
 #define DHT_CACHE_TTL_MS  2000
+#define DHT_EDGES_MAX     96    /* 82 edges per frame plus start/ACK */
 
 /**
  * Read a DHT sensor value (temperature or humidity).
  *
+ * Returns the cached reading. If it is older than DHT_CACHE_TTL_MS a new
+ * capture is scheduled and completes over the next dhtPoll() calls; only
+ * the very first read of a pin waits for its capture.
+ *
  * @param pin       GPIO pin the DHT sensor is connected to
  * @param is_dht22  true for DHT22/AM2302, false for DHT11
  * @param channel   DHT_CHAN_TEMP (0) or DHT_CHAN_HUMI (1)
@@ -27,6 +34,18 @@
  */
 float dhtRead(uint8_t pin, bool is_dht22, uint8_t channel);
 
+/**
+ * Advance the capture state machine. Call from the main loop; each call
+ * returns immediately.
+ */
+void dhtPoll();
+
+/**
+ * Register a function called from dhtPoll() each time a capture on a pin
+ * decodes successfully (the cache then holds the new reading).
+ */
+void dhtSetResultHook(void (*fn)(uint8_t pin));
+
 /**
  * Invalidate the cache entry for a given GPIO pin.
  * Call when removing a DHT device.
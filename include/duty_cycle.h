@@ -0,0 +1,117 @@
+/**
+ * @file duty_cycle.h
+ * @brief Deep-sleep duty cycle - schedule, sample ring and event outbox
+ *
+ * In duty-cycle mode the node wakes every wake_s seconds, samples its
+ * sensors, runs events and goes back to deep sleep. The radio comes up
+ * only when a report is due (every report_s) or an event is waiting, so
+ * most wakes take tens of milliseconds instead of the second or more a
+ * WiFi join and NATS connect cost. A report is one batched telemetry
+ * message with every sample since the previous report, followed by the
+ * queued events.
+ *
+ * Everything that must survive deep sleep is one DutyState the firmware
+ * keeps in RTC memory: the schedule, a short ring of samples per sensor
+ * (also replayed to re-prime event windows after a wake) and the event
+ * outbox. Times are passed in as seconds on a clock that keeps running
+ * through sleep, so the logic runs on the host against a simulated clock.
+ *
+ * No Arduino dependency; compiles on the host.
+ * Host simulation (wakes, radio use and battery estimate over N days):
+ * test/host/duty_cycle_sim.cpp.
+ */
+
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DUTY_SLOTS        16      /* one column per registry slot (MAX_DEVICES) */
+#define DUTY_RING         16      /* samples per sensor kept across sleeps */
+#define DUTY_OUTBOX       1024    /* bytes of queued events */
+#define DUTY_MIN_SLEEP_S  2       /* never schedule a wake closer than this */
+
+struct DutyConfig {
+    uint32_t wake_s;              /* sample period, 0 = duty cycle off */
+    uint32_t report_s;            /* telemetry period (0 = every wake) */
+};
+
+struct DutyState {
+    uint32_t magic;
+    DutyConfig cfg;               /* config the schedule was built for */
+    uint32_t anchor;              /* schedule origin; wakes fall on anchor + k*wake_s */
+    uint32_t next_wake;
+    uint32_t next_report;
+    uint32_t radio_hold;          /* after a failed report: events wait until here */
+    uint32_t wakes;
+    uint32_t radio_wakes;
+    uint32_t radio_fails;
+    uint32_t awake_ms;            /* total time awake, for the power estimate */
+    /* Sample ring: a row per wake, a column per registry slot */
+    uint32_t slot_key[DUTY_SLOTS];          /* name hash the column belongs to */
+    uint32_t ring_t[DUTY_RING];
+    float    ring_v[DUTY_RING][DUTY_SLOTS];
+    uint16_t ring_mask[DUTY_RING];          /* slots sampled in the row */
+    uint8_t  ring_head;                     /* next row to write */
+    uint8_t  ring_n;                        /* rows held */
+    uint8_t  ring_unsent;                   /* newest rows not reported yet */
+    uint8_t  rsv;
+    /* Edges seen on GPIO wakes, per slot */
+    uint32_t edge_count[DUTY_SLOTS];
+    uint32_t edge_t[DUTY_SLOTS];
+    /* Event outbox: "subject\0json\0" records, oldest first */
+    uint16_t outbox_len;
+    uint16_t outbox_dropped;
+    char     outbox[DUTY_OUTBOX];
+};
+
+/* True if s holds a schedule for exactly this config */
+bool dutyValid(const DutyState *s, const DutyConfig *c);
+
+/* Start a fresh schedule at now (power-on, config change) */
+void dutyReset(DutyState *s, const DutyConfig *c, uint32_t now);
+
+/* Forget ring columns whose registry slot now holds another device */
+void dutyBindSlots(DutyState *s, const uint32_t key[DUTY_SLOTS]);
+
+/* Append one row of samples (bit i of mask: v[i] is valid) */
+void dutyLogRow(DutyState *s, uint32_t t, const float v[DUTY_SLOTS], uint16_t mask);
+
+/* Row by age, 0 = oldest held. False if out of range. */
+bool dutyRow(const DutyState *s, int age, uint32_t *t, const float **v, uint16_t *mask);
+
+/* A report is due (early wakes within half a period count) */
+bool dutyReportDue(const DutyState *s, uint32_t now);
+
+/* This wake needs the radio: report due, or events waiting */
+bool dutyNeedRadio(const DutyState *s, uint32_t now);
+
+/* Radio part of the wake finished. ok: samples and outbox were published. */
+void dutyRadioDone(DutyState *s, bool ok, uint32_t now);
+
+/* Account awake time and pick the next wake. Returns seconds to sleep. */
+uint32_t dutySleepFor(DutyState *s, uint32_t now, uint32_t awake_ms);
+
+/* Queue an event. t (unix seconds, 0 = unknown) is added as "t". The
+   oldest events are dropped to make room. */
+bool dutyOutboxPush(DutyState *s, const char *subject, const char *json, uint32_t t);
+
+/* Walk the outbox: start with off 0, returns the next offset or -1 */
+int dutyOutboxNext(const DutyState *s, int off, const char **subject, const char **json);
+
+void dutyOutboxClear(DutyState *s);
+
+/* Name of a registry slot for telemetry, nullptr to leave it out */
+typedef const char *(*DutyNameFn)(int slot, void *ctx);
+
+/* Telemetry for the unreported rows:
+     {"device":..,"wake_s":..,"report_s":..,"wakes":..,"radio_wakes":..,
+      "t":[unix,..],"samples":{"name":[v,..],..}}
+   unix_now/now map ring times to unix time (0 = unknown: "age" seconds
+   before now instead of "t"). Oldest rows are left out if it does not
+   fit. Returns the length, or -1 if not even one row fits. */
+int dutyTelemetryJson(const DutyState *s, char *out, size_t len, const char *device,
+                      uint32_t unix_now, uint32_t now, DutyNameFn name, void *ctx);
+
+#endif /* DUTY_CYCLE_H */
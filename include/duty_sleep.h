@@ -0,0 +1,57 @@
+/**
+ * @file duty_sleep.h
+ * @brief Deep-sleep duty cycle on the target - wakeups, sampling, report
+ *
+ * Runs the duty_cycle.h schedule against the hardware: the DutyState lives
+ * in RTC memory, the clock is the RTC timer (keeps counting through deep
+ * sleep), and wakeups are the timer plus a GPIO wakeup on every digital
+ * input that has events, rules or edge publishing. Relay and digital_out
+ * pins are held at their level while the chip sleeps.
+ *
+ * A wake boots normally up to the device registry, then main.cpp calls
+ * sleepReleasePins() and sleepSample(), brings the radio up only if
+ * sleepRadioNeeded(), and ends with sleepEnter(). Events raised while the
+ * radio is down are queued in RTC memory (sleepQueueEvent) and published
+ * with the next report.
+ */
+
+#ifndef DUTY_SLEEP_H
+#define DUTY_SLEEP_H
+
+#include <stdint.h>
+
+/* This boot is a wake from duty-cycle deep sleep */
+bool sleepWoke();
+
+/* Release the outputs held through sleep. Call after devicesInit() has
+   driven them again. */
+void sleepReleasePins();
+
+/* Continue the schedule for this config, or start a new one */
+void sleepBegin(uint32_t wake_s, uint32_t report_s);
+
+/* Duty cycle running: sleepBegin() was called this boot */
+bool sleepActive();
+
+/* Read the sensors into the ring and feed events; digital inputs that
+   changed while asleep are replayed as edges */
+void sleepSample();
+
+/* This wake needs WiFi and NATS: report due or events queued */
+bool sleepRadioNeeded();
+
+/* Queue an event for the next report. False if it was dropped. */
+bool sleepQueueEvent(const char *subject, const char *json);
+
+/* Publish telemetry ({device}.telemetry) and the queued events. Returns
+   the number of messages, -1 on a publish error. */
+int sleepPublish();
+
+/* The radio part of this wake is over (ok: sleepPublish() reached the
+   broker) */
+void sleepRadioDone(bool ok);
+
+/* Flush pending saves, arm the wakeups and deep-sleep. Does not return. */
+void sleepEnter();
+
+#endif /* DUTY_SLEEP_H */
@@ -0,0 +1,52 @@
+/**
+ * @file ev_window.h
+ * @brief Running sample windows for event conditions
+ *
+ * A window holds the last N samples of one condition and answers its
+ * measure as each sample is pushed: average from a running sum (O(1)),
+ * minimum/maximum from a monotonic deque (amortized O(1)), and rate of
+ * change against the oldest sample held. Non-finite samples (a failed
+ * read) are not pushed, so they cannot poison the sum or the deque.
+ *
+ * No Arduino dependency; compiles on the host.
+ * Host test (NaN between finite samples in every mode):
+ * test/host/ev_window_test.cpp.
+ */
+
+#ifndef EV_WINDOW_H
+#define EV_WINDOW_H
+
+#include <stdint.h>
+
+#define EV_WIN_MAX         32    /* max window length in samples */
+
+/* What a condition compares against its threshold */
+#define EV_MODE_VALUE  0    /* the sample itself */
+#define EV_MODE_RATE   1    /* change per second across the window */
+#define EV_MODE_AVG    2    /* moving average over the window */
+#define EV_MODE_MIN    3    /* minimum over the window */
+#define EV_MODE_MAX    4    /* maximum over the window */
+#define EV_MODE_BAD    0xFF
+
+struct EvWindow {
+    bool     used;
+    uint8_t  len;                /* window length in samples */
+    uint8_t  count;              /* samples held, <= len */
+    uint8_t  dq_head;            /* monotonic deque of sample sequence numbers */
+    uint8_t  dq_n;
+    uint32_t seq;                /* samples pushed so far */
+    float    sum;
+    float    v[EV_WIN_MAX];
+    uint32_t t[EV_WIN_MAX];      /* millis() per sample, for rate */
+    uint32_t dq[EV_WIN_MAX];
+};
+
+/* Empty the window and set its length (clamped to 2..EV_WIN_MAX) */
+void evWinReset(EvWindow *w, uint8_t len);
+
+/* Push a sample taken at now (ms) and return the measure for mode
+ * (EV_MODE_*). Returns NaN while not ready, and for a non-finite sample,
+ * which is dropped and leaves the window unchanged. */
+float evWinPush(EvWindow *w, uint8_t mode, float x, uint32_t now);
+
+#endif /* EV_WINDOW_H */
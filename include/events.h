@@ -0,0 +1,76 @@
+/**
+ * @file events.h
+ * @brief Incremental event engine - per-sensor events and compound rules
+ *
+ * Conditions are evaluated as samples arrive (sensorsPoll, NATS values,
+ * serial lines) and never read sensors themselves. A condition looks at
+ * the sample, its rate of change, or the average/min/max over the last N
+ * samples (O(1) running windows), compares it above/below a threshold and
+ * releases only after leaving a hysteresis band.
+ *
+ * Per-sensor events live in the Device (devices.bin); compound AND/OR
+ * rules across sensors live in /rules.json. A rule may drive a local
+ * actuator via deviceSetActuator() on each state change, so control keeps
+ * working without the broker.
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <Arduino.h>
+#include "devices.h"
+#include "ev_window.h"
+
+#define EV_WIN_POOL        16    /* running windows shared by all conditions */
+#define EV_MAX_RULES       8
+#define EV_RULE_CONDS      4
+#define EV_RULE_NAME_LEN   24
+
+/* Compound rule logic */
+#define EV_LOGIC_AND   0
+#define EV_LOGIC_OR    1
+
+/* Mode <-> string ("value", "rate", "avg", "min", "max") */
+const char *eventsModeName(uint8_t mode);
+uint8_t eventsModeFromString(const char *s);
+
+/* Feed a fresh sample of a sensor into its event and all rules using it */
+void eventsOnSample(Device *dev, float value);
+
+/* Replay an older sample (age_ms before now) into windows and condition
+ * state without firing or acting - restores state after a deep sleep */
+void eventsPrime(Device *dev, float value, uint32_t age_ms);
+
+/* A debounced edge on a digital input: publishes it on events.{name} if
+ * the device has edge_publish set, then feeds it as a sample */
+void eventsOnEdge(Device *dev, uint8_t level, uint32_t count, uint64_t t_us,
+                  uint64_t dt_us);
+
+/* True if the sensor has an event or is used by a rule (needs samples) */
+bool eventsWatching(const Device *dev);
+
+/* Event config of a device changed or device removed: drop runtime state */
+void eventsDeviceChanged(Device *dev);
+
+/* Count sensors with events configured */
+int eventsCount();
+
+/* --- Compound rules --- */
+
+/* Create or replace a rule from JSON. On failure writes a reason to err. */
+bool eventsRuleSet(const char *json, char *err, size_t err_len);
+
+/* Remove a rule by name. Returns true if found. */
+bool eventsRuleClear(const char *name);
+
+/* JSON array of all rules with runtime state. Returns bytes written. */
+int eventsRuleList(char *out, size_t out_len);
+
+/* Number of configured rules */
+int eventsRuleCount();
+
+/* Persist / load /rules.json (called from devicesSave / devicesLoad) */
+void eventsRulesSave();
+void eventsRulesLoad();
+
+#endif /* EVENTS_H */
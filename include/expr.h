@@ -0,0 +1,54 @@
+/**
+ * @file expr.h
+ * @brief Arithmetic expressions over devices, compiled to stack bytecode
+ *
+ * Used by computed sensors (DEV_SENSOR_COMPUTED). The expression is parsed
+ * once into a postfix program with device names resolved to registry
+ * slots; reading the sensor only runs the program.
+ *
+ *   numbers     1.5  -3  2e3
+ *   devices     bme_temp  ntc_1        (any registered sensor name)
+ *   operators   + - * / % ^  ( )       (^ is power, right-associative)
+ *   functions   min(a,..) max(a,..) avg(a,..)   up to 8 arguments
+ *               abs(x) sqrt(x) log(x) exp(x) round(x) pow(x,y)
+ *               dew(t,rh)  dew point in C (Magnus formula)
+ *
+ * Example: avg(ntc_1, ntc_2, ntc_3)   dew(bme_temp, bme_humi)
+ *
+ * No Arduino dependency; compiles on the host.
+ */
+
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EXPR_CODE_MAX    64    /* bytecode bytes */
+#define EXPR_CONST_MAX   12    /* numeric literals */
+#define EXPR_STACK_MAX   12    /* evaluation stack depth */
+#define EXPR_NEST_MAX    16    /* parser recursion: ( ), calls, signs, ^ */
+
+struct ExprProg {
+    uint8_t  code[EXPR_CODE_MAX];
+    float    k[EXPR_CONST_MAX];
+    uint8_t  len;
+    uint8_t  nk;
+    bool     ok;       /* compiled successfully */
+    uint32_t gen;      /* owner's registry generation at compile time */
+};
+
+/* Map a device name to a slot index, or -1 if unknown / not usable */
+typedef int (*ExprResolveFn)(const char *name, void *ctx);
+
+/* Fetch the current value of a slot */
+typedef float (*ExprLoadFn)(uint8_t slot, void *ctx);
+
+/* Compile src into prog. On failure prog->ok is false and err holds a reason. */
+bool exprCompile(const char *src, ExprResolveFn resolve, void *ctx,
+                 ExprProg *prog, char *err, size_t err_len);
+
+/* Run a compiled program. NaN inputs propagate; returns NaN if !prog->ok. */
+float exprEval(const ExprProg *prog, ExprLoadFn load, void *ctx);
+
+#endif /* EXPR_H */
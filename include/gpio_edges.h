@@ -0,0 +1,37 @@
+/**
+ * @file gpio_edges.h
+ * @brief Interrupt-captured GPIO edges for digital inputs
+ *
+ * A GPIO interrupt timestamps every level change on an attached pin and
+ * pushes it into a single-producer/single-consumer ring; the ISR takes no
+ * locks and never blocks, and wakes the main loop, which pops edges and
+ * applies debounce (devices.cpp) right away instead of on the next 1s
+ * poll. Slots are device registry indices.
+ */
+
+#ifndef GPIO_EDGES_H
+#define GPIO_EDGES_H
+
+#include <Arduino.h>
+
+#define EDGE_QUEUE_LEN  128     /* power of two */
+
+struct EdgeEvent {
+    uint8_t  slot;
+    uint8_t  level;     /* pin level after the edge */
+    uint64_t t_us;      /* esp_timer time of the edge */
+};
+
+/* Start capturing edges on a pin for a slot (pin set to INPUT) */
+void edgeAttach(uint8_t slot, uint8_t pin);
+
+/* Stop capturing for a slot */
+void edgeDetach(uint8_t slot);
+
+/* Pop the oldest captured edge. Returns false if the queue is empty. */
+bool edgePop(EdgeEvent *out);
+
+/* Edges dropped because the queue was full (since boot) */
+uint32_t edgeDropped();
+
+#endif /* GPIO_EDGES_H */
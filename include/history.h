@@ -0,0 +1,71 @@
+/**
+ * @file history.h
+ * @brief Multi-resolution on-device time-series store for sensor readings
+ *
+ * Each recorded sensor gets a series with three downsampling tiers:
+ *   raw   1 s samples                       (~10 minutes)
+ *   min   1 minute avg/min/max aggregates   (~6 hours)
+ *   hour  1 hour avg/min/max aggregates     (~5 days)
+ *
+ * Values are delta-encoded as int16 in fixed-size blocks, so a series
+ * holds thousands of points in ~4.3 KB. Series are allocated from the heap
+ * when a sensor first records and only while HIST_HEAP_RESERVE stays free.
+ * Range queries are answered over NATS via {name}.hal.{sensor}.history.
+ *
+ * Once the clock is synced, finished minutes are also appended to the
+ * segment log (seglog.h), which refills the minute/hour tiers after a
+ * reboot and answers minute queries older than the RAM tier. The last
+ * 24 hours at minute resolution therefore come from flash, not RAM; the
+ * log keeps at least ~5400 minutes shared by all sensors (24 h for 3).
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <Arduino.h>
+
+#define HIST_MAX_SERIES   8      /* sensors with a history series */
+#define HIST_HEAP_RESERVE 49152  /* free heap a new series must leave */
+#define HIST_BLOCK_LEN    60     /* points per block */
+#define HIST_RAW_BLOCKS   10     /* 10 x 60 x 1s   = 10 min */
+#define HIST_MIN_BLOCKS   6      /* 6 x 60 x 1min  = 6 h    */
+#define HIST_HOUR_BLOCKS  2      /* 2 x 60 x 1h    = 5 days */
+#define HIST_GAP_FILL     10     /* gaps up to this many steps hold the last value */
+
+/* Current history timestamp: unix seconds once the clock is synced,
+ * seconds since boot before that. */
+uint32_t historyNow();
+
+/* True once historyNow() returns unix time */
+bool historyClockSynced();
+
+/* Record one sample for a device slot. NaN values are skipped. */
+void historyRecord(int dev_idx, const char *name, float value);
+
+/* Latest recorded value of a device slot (raw tier, quantized).
+ * Returns false if the slot has no series or no samples yet. */
+bool historyLast(int dev_idx, float *out);
+
+/* Refill the minute/hour tiers of a device slot from the segment log.
+ * Returns the number of minutes restored. */
+int historyRestore(int dev_idx, const char *name);
+
+/* Drop the series of a device slot (device removed) */
+void historyRelease(int dev_idx);
+
+/* Drop all series (registry cleared/reloaded) */
+void historyReset();
+
+/* Number of allocated series */
+int historySeriesCount();
+
+/**
+ * Answer a range query as JSON into out.
+ * query is "from=-3600&to=0&res=60" or {"from":-3600,"to":0,"res":60};
+ * from/to <= 0 are relative to now, res is 1, 60 or 3600 (auto if omitted).
+ * Returns false (with an error JSON in out) if the query is invalid.
+ */
+bool historyQuery(int dev_idx, const char *name, const char *unit,
+                  const char *query, char *out, size_t out_len);
+
+#endif /* HISTORY_H */
@@ -5,6 +5,11 @@
  * Provides I2C bus init/deinit with reference counting, bus scan,
  * and raw Wire.h drivers for common I2C sensors and OLED displays.
  * No external libraries — all register-level communication.
+ *
+ * ESP32 and ESP32-S3 have two I2C controllers (Wire, Wire1); the other
+ * targets have one. Device addresses passed to this module carry the bus
+ * index in bit 7 (I2C_BUS_ADDR), so the same 7-bit address can be used on
+ * both buses and caches/queues keep them apart.
  */
 
 #ifndef I2C_DEVICES_H
@@ -12,7 +17,9 @@
 
 #include <Arduino.h>
 
-/* Fixed I2C pins per chip variant (single bus) */
+class TwoWire;
+
+/* Default pins for bus 0 per chip variant */
 #if defined(CONFIG_IDF_TARGET_ESP32C6)
 #define I2C_SDA  6
 #define I2C_SCL  7
@@ -27,33 +34,76 @@
 #define I2C_SCL  22
 #endif
 
-/* Per-address reading cache (avoids redundant I2C reads for multi-channel sensors) */
-#define I2C_CACHE_MAX     8
-#define I2C_CACHE_TTL_MS  1000
+/* Second controller (ESP32, ESP32-S3): default pins, overridable in config */
+#if defined(CONFIG_IDF_TARGET_ESP32S3)
+#define I2C_BUS_MAX  2
+#define I2C1_SDA     17
+#define I2C1_SCL     18
+#elif defined(CONFIG_IDF_TARGET_ESP32)
+#define I2C_BUS_MAX  2
+#define I2C1_SDA     33
+#define I2C1_SCL     32
+#else
+#define I2C_BUS_MAX  1
+#endif
+
+#define I2C_DEFAULT_HZ  100000
+
+/* Bus-qualified address: bus index in bit 7, 7-bit address below */
+#define I2C_BUS_ADDR(bus, addr)  ((uint8_t)(((bus) << 7) | ((addr) & 0x7F)))
+#define I2C_ADDR_BUS(a)          ((uint8_t)((a) >> 7))
+#define I2C_ADDR_7BIT(a)         ((uint8_t)((a) & 0x7F))
+
+/*
+ * Reading cache keyed by (addr, reg, len). Holds raw register bytes for
+ * generic/HAL reads and decoded results for the multi-channel drivers.
+ * TTL is per address (from the device config, see i2cCacheSetTtl);
+ * addresses without a registered device are not cached. LRU eviction.
+ */
+#define I2C_CACHE_MAX     16
+#define I2C_CACHE_RAW_MAX 16    /* longest cached raw read */
+#define I2C_TTL_MAX       16    /* addresses with a TTL */
 
 struct I2cCache {
     uint8_t  addr;
-    uint32_t last_read_ms;
-    float    values[4];     /* up to 4 channels per sensor */
-    uint8_t  num_values;
+    uint8_t  reg;           /* register; decoded: 0, or channel for ADS1115 */
+    uint8_t  len;           /* raw bytes, or number of decoded values */
+    bool     decoded;       /* values[] holds driver results */
     bool     valid;
+    uint32_t last_read_ms;
+    uint32_t lru;           /* access tick, lowest is evicted first */
+    union {
+        uint8_t raw[I2C_CACHE_RAW_MAX];
+        float   values[4];  /* up to 4 channels per sensor */
+    };
 };
 
 /*============================================================================
  * I2C Bus Management
  *============================================================================*/
 
-/* Initialize I2C bus (reference counted — safe to call multiple times) */
-void i2cInit();
+/* Set pins (-1 = keep) and clock (0 = keep) for a bus. Pins apply at the
+   next init; the clock is applied immediately if the bus is running. */
+void i2cBusConfig(uint8_t bus, int sda, int scl, uint32_t hz);
+
+/* Current pins/clock for a bus. Returns true if the bus is running. */
+bool i2cBusInfo(uint8_t bus, int *sda, int *scl, uint32_t *hz);
+
+/* Wire instance for a bus-qualified address, or nullptr if its bus is down */
+TwoWire *i2cBusWire(uint8_t addr);
+
+/* Initialize I2C bus (reference counted — safe to call multiple times).
+   Returns false if the chip has no such bus. */
+bool i2cInit(uint8_t bus = 0);
 
 /* Deinitialize I2C bus (decrements refcount, shuts down on last) */
-void i2cDeinit();
+void i2cDeinit(uint8_t bus = 0);
 
 /* Returns true if I2C bus is currently initialized */
-bool i2cActive();
+bool i2cActive(uint8_t bus = 0);
 
-/* Scan I2C bus, fill addrs[] with found addresses. Returns count. */
-int i2cScan(uint8_t *addrs, int max_addrs);
+/* Scan I2C bus, fill addrs[] with found 7-bit addresses. Returns count. */
+int i2cScan(uint8_t *addrs, int max_addrs, uint8_t bus = 0);
 
 /* Check if a specific address responds */
 bool i2cDetect(uint8_t addr);
@@ -64,19 +114,45 @@ bool i2cReadReg(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len);
 /* Raw I2C write: write register address + data bytes */
 bool i2cWriteReg(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len);
 
+/* Burst transfer of any length in one transaction: write wlen bytes, then
+   after a repeated start read rlen bytes. Either part may be empty. Not
+   limited by the Wire buffer; the timeout scales with the length. */
+bool i2cTransfer(uint8_t addr, const uint8_t *wbuf, size_t wlen,
+                 uint8_t *rbuf, size_t rlen);
+
 /* Attempt I2C bus recovery by toggling SCL 9 times */
-void i2cRecover();
+void i2cRecover(uint8_t bus = 0);
+
+/**
+ * Advance the conversion queue: collect finished conversions and trigger
+ * requested ones. Call from the main loop; never waits on the bus.
+ */
+void i2cPoll();
+
+/* Register a function called each time a queued conversion completes and
+   its result is in the cache: chan is the ADS1115 channel converted, 0xFF
+   for sensors that convert all channels at once. */
+void i2cSetResultHook(void (*fn)(uint8_t addr, uint8_t chan));
 
 /*============================================================================
  * Sensor Drivers — return float via channel index
  *============================================================================*/
 
-/* Get cached reading for an address/channel, or NAN if stale/missing */
-float i2cCacheGet(uint8_t addr, uint8_t channel);
-
-/* Invalidate cache for an address */
+/* Drop cached readings and pending conversions for an address.
+   Call when removing a device or after writing to it. */
 void i2cCacheInvalidate(uint8_t addr);
 
+/* Set the cache TTL for an address (0 = always read). When several devices
+   share an address the shortest TTL wins; i2cCacheTtlReset() forgets all. */
+void i2cCacheSetTtl(uint8_t addr, uint16_t ttl_ms);
+void i2cCacheTtlReset();
+
+/* i2cReadReg() through the cache (len <= I2C_CACHE_RAW_MAX, TTL set) */
+bool i2cReadRegCached(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len);
+
+/* Cache statistics since boot */
+void i2cCacheStats(uint32_t *hits, uint32_t *misses, int *entries);
+
 /**
  * Read I2C generic sensor: read register, combine bytes, apply scale.
  * @param addr    I2C slave address
@@ -88,7 +164,8 @@ float i2cGenericRead(uint8_t addr, uint8_t reg, uint8_t reg_len, float scale);
 
 /**
  * Read BME280 sensor (temperature/humidity/pressure).
- * Initializes calibration on first call per address.
+ * Initializes calibration on first call per address, then runs a
+ * forced-mode conversion through the queue whenever the cache is stale.
  * Results cached — multiple channel reads within TTL don't re-read.
  * @param addr    I2C address (typically 0x76 or 0x77)
  * @param channel 0=temperature(C), 1=humidity(%), 2=pressure(hPa)
@@ -104,14 +181,15 @@ float i2cBh1750Read(uint8_t addr);
 
 /**
  * Read SHT31 temperature/humidity sensor.
- * Results cached per address.
+ * Results cached per address; stale entries are refreshed via the queue.
  * @param addr    I2C address (typically 0x44 or 0x45)
  * @param channel 0=temperature(C), 1=humidity(%)
  */
 float i2cSht31Read(uint8_t addr, uint8_t channel);
 
 /**
- * Read ADS1115 16-bit ADC.
+ * Read ADS1115 16-bit ADC. Channels convert one after another via the
+ * queue; each channel's last result is cached for the address TTL.
  * @param addr    I2C address (typically 0x48-0x4B)
  * @param channel ADC channel 0-3
  * @return Voltage in millivolts (default +/-4.096V range)
@@ -155,8 +233,19 @@ void ssd1306Clear(uint8_t addr, uint8_t col_offset = 0);
 void ssd1306WriteText(uint8_t addr, uint8_t line, const char *text, uint8_t col_offset = 0);
 
 /**
- * Render a full template string to the display.
- * Template may contain {device_name} tokens and \n for line breaks.
+ * Write multi-line text to the display (\n separates lines, lines past
+ * the end of the text are blanked). Only changed pixels are sent.
+ * @param addr       I2C address
+ * @param text       Text with real newlines (max 21 chars per line)
+ * @param height     Display height (64 or 32)
+ * @param col_offset Column offset (0 for SSD1306, 2 for SH1106)
+ */
+void ssd1306WriteLines(uint8_t addr, const char *text, uint8_t height, uint8_t col_offset = 0);
+
+/**
+ * Render a full template string to the display now.
+ * Template may contain {device_name} tokens and \n for line breaks; it is
+ * compiled on first use and recompiled when it or the registry changes.
  * @param addr       I2C address
  * @param tmpl       Template string
  * @param height     Display height (64 or 32)
@@ -164,15 +253,25 @@ void ssd1306WriteText(uint8_t addr, uint8_t line, const char *text, uint8_t col_
  */
 void ssd1306RenderTemplate(uint8_t addr, const char *tmpl, uint8_t height, uint8_t col_offset = 0);
 
+/* GDDRAM bytes sent and skipped as unchanged, all displays, since boot */
+void ssd1306Stats(uint32_t *sent, uint32_t *skipped);
+
 /**
- * Poll all SSD1306 displays — refresh templates with live sensor values.
- * Call from main loop every ~2 seconds.
+ * Poll all displays — re-render templates whose shown values changed.
+ * Call from main loop every pass; schedules the pass a pending render
+ * or {ip}/{heap}/{uptime} refresh needs.
  */
 void displayPoll();
 
 /**
- * Reset display poll timer (call after explicit render to avoid double-render).
+ * Hold templates off for 2s after an explicit write, then re-apply them.
  */
 void displayPollReset();
 
+/* A device (registry slot) has a new value: marks displays showing it */
+void displayOnValue(int slot, float value);
+
+/* True if a display template shows this sensor (it needs sampling) */
+bool displayShows(int slot);
+
 #endif /* I2C_DEVICES_H */
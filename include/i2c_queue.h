@@ -0,0 +1,84 @@
+/**
+ * @file i2c_queue.h
+ * @brief I2C conversion queue - trigger/collect scheduling
+ *
+ * Sensors with a conversion time are split into trigger and collect steps.
+ * A poll triggers every requested conversion in one pass and collects each
+ * one when its deadline passes, so a cycle over several sensors costs the
+ * longest conversion time instead of the sum, and the caller never sleeps
+ * on the bus. One job per chip; a chip with several channels (ADS1115)
+ * converts the requested ones one after another.
+ *
+ * The bus work is done by an I2cQueueDriver (the Wire drivers on target),
+ * and times are passed in as milliseconds, so the scheduling runs on the
+ * host against a mock bus.
+ *
+ * No Arduino dependency; compiles on the host.
+ * Host test (mock bus: ordering, deadlines, contention):
+ * test/host/i2c_queue_test.cpp.
+ */
+
+#ifndef I2C_QUEUE_H
+#define I2C_QUEUE_H
+
+#include <stdint.h>
+
+#define I2C_JOB_MAX       8     /* pending conversions, one job per chip */
+#define I2C_JOB_VALUES    4     /* values one collect can return */
+
+/* Conversion waits used by the drivers (datasheet maximum plus margin) */
+#define SHT31_CONV_MS     16    /* high repeatability: 15ms max */
+#define ADS1115_CONV_MS   10    /* 128 SPS = ~8ms, plus margin */
+#define BME280_CONV_MS    10    /* forced mode 1x/1x/1x: 9.3ms max */
+#define BME280_RESET_MS   10
+
+enum I2cJobStage : uint8_t { I2C_STAGE_IDLE, I2C_STAGE_SETUP, I2C_STAGE_CONVERT };
+
+/* I2cQueueDriver::trigger results */
+enum I2cTrigger { I2C_TRIG_FAIL, I2C_TRIG_CONVERT, I2C_TRIG_SETUP };
+
+struct I2cJob {
+    bool     used;
+    uint8_t  type;          /* driver's sensor type */
+    uint8_t  addr;          /* bus-qualified address */
+    uint8_t  stage;         /* I2cJobStage */
+    uint8_t  want;          /* requested conversions, one bit per channel */
+    uint8_t  chan;          /* channel in flight */
+    uint32_t due_ms;        /* current stage deadline */
+};
+
+struct I2cQueueDriver {
+    /* Bus of addr is up; jobs on a bus that is down wait */
+    bool (*ready)(uint8_t addr);
+    /* Start a conversion on chan. I2C_TRIG_CONVERT: collect after *wait_ms.
+       I2C_TRIG_SETUP: the chip needs setup() after *wait_ms first; the
+       request stays pending and is triggered again after it. */
+    int  (*trigger)(uint8_t type, uint8_t addr, uint8_t chan, uint32_t *wait_ms);
+    bool (*setup)(uint8_t type, uint8_t addr);
+    /* Read a finished conversion into values[] */
+    bool (*collect)(uint8_t type, uint8_t addr, uint8_t chan, float *values);
+    /* Outcome of a request: values, or nullptr if any step failed */
+    void (*result)(uint8_t type, uint8_t addr, uint8_t chan, const float *values);
+};
+
+struct I2cQueue {
+    const I2cQueueDriver *drv;
+    I2cJob jobs[I2C_JOB_MAX];
+};
+
+/* Job of a chip, allocated on first use. nullptr if the table is full. */
+I2cJob *i2cQueueGet(I2cQueue *q, uint8_t type, uint8_t addr);
+
+/* Advance one job: collect if due, then trigger the next request.
+   Returns true while the job has work in flight or pending. */
+bool i2cQueueStep(I2cQueue *q, I2cJob *j, uint32_t now);
+
+/* Advance every job whose bus is ready. Returns true and the earliest
+   deadline in due_ms if a conversion or setup is in flight. */
+bool i2cQueuePoll(I2cQueue *q, uint32_t now, uint32_t *due_ms);
+
+/* Drop jobs whose address matches addr in the bits of mask
+   (0xFF: one chip, 0x80: a whole bus) */
+void i2cQueueClear(I2cQueue *q, uint8_t addr, uint8_t mask);
+
+#endif /* I2C_QUEUE_H */
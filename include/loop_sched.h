@@ -0,0 +1,58 @@
+/**
+ * @file loop_sched.h
+ * @brief Tickless main loop - deadlines, wake notifications, socket watch
+ *
+ * loop() runs one pass and then sleeps in loopWait() until the earliest
+ * deadline any component asked for during the pass, or until something
+ * wakes it: a readable watched socket (NATS, web server), console input, a GPIO edge,
+ * a finished ADC capture or a complete serial_text line. Deadlines are one-shot and re-registered by
+ * each component every pass it still has work pending, so a component
+ * with nothing to do costs no wakeups.
+ *
+ * Wakeups are a task notification to the loop task. Sockets are watched
+ * by a small task blocked in select(); it notifies the loop and then waits
+ * for the next pass before selecting again, so unread data wakes the loop
+ * once per pass instead of spinning.
+ */
+
+#ifndef LOOP_SCHED_H
+#define LOOP_SCHED_H
+
+#include <Arduino.h>
+
+#define LOOP_MAX_WAIT_MS    1000    /* upper bound on one wait (WiFi check, pings) */
+#define LOOP_WATCH_MAX      3       /* watched sockets */
+#define LOOP_WATCH_NATS     0       /* watch slot of the NATS connection */
+#define LOOP_WATCH_WEB      1       /* web server listener */
+#define LOOP_WATCH_WEB_CONN 2       /* web connection being served */
+
+/* Bind to the calling task (call from setup()) and start the socket watcher */
+void loopSchedInit();
+
+/* Run the next pass no later than due (millis). The earliest request of a
+   pass wins; a due time in the past runs the next pass at once. */
+void loopAt(uint32_t due_ms);
+
+/* Run the next pass within ms */
+void loopIn(uint32_t ms);
+
+/* Run the next pass now (task context, also from other tasks) */
+void loopWake();
+
+/* Same from an ISR (IRAM) */
+void loopWakeFromIsr();
+
+/* Wake the loop when fd becomes readable; -1 stops watching the slot.
+   Bytes a client has already read ahead into its own buffer do not make
+   the fd readable; the caller checks for them after each pass.
+   Cheap when unchanged, so it can be called every pass. */
+void loopWatch(int slot, int fd);
+
+/* End of pass: sleep until the earliest deadline or a wake */
+void loopWait();
+
+/* Over the last complete window: share of time spent waiting (percent)
+   and loop passes per second */
+void loopSchedStats(uint32_t *idle_pct, uint32_t *passes_s);
+
+#endif /* LOOP_SCHED_H */
@@ -18,6 +18,12 @@
  */
 void onNatsHal(nats_client_t *client, const nats_msg_t *msg, void *userdata);
 
+/**
+ * Finish pending HAL work (ADC burst captures). Call from the main loop;
+ * never waits.
+ */
+void halPoll();
+
 /**
  * Check if a name is reserved by the HAL (gpio, adc, pwm, etc.).
  * Used to prevent device registration with HAL-reserved names.
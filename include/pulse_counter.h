@@ -0,0 +1,43 @@
+/**
+ * @file pulse_counter.h
+ * @brief Hardware pulse counting for flow meters, anemometers, S0 meters
+ *
+ * Rising edges are counted by the PCNT peripheral, so pulses cost no CPU;
+ * the ISR only runs when the 16-bit hardware counter reaches its limit
+ * and folds it into a 64-bit total. The rate is derived from the total
+ * over a sliding window sampled by pulsePoll(). Chips without PCNT
+ * (ESP32-C3) count in a GPIO interrupt instead.
+ *
+ * Counters are per pin and reference counted, so a pulse_count and a
+ * pulse_rate device can share one input.
+ */
+
+#ifndef PULSE_COUNTER_H
+#define PULSE_COUNTER_H
+
+#include <Arduino.h>
+
+#define PULSE_MAX          4       /* counted pins (PCNT units on S3/C6) */
+#define PULSE_HIGH_LIMIT   30000   /* hardware counter wraps here */
+#define PULSE_GLITCH_NS    1000    /* ignore pulses shorter than this */
+#define PULSE_SAMPLE_MS    250     /* window sample spacing */
+#define PULSE_WINDOW       8       /* samples: rate over ~2 s */
+
+/* Start counting on a pin (shared: counts attaches). Returns false if no
+   counter is free or the peripheral could not be set up. */
+bool pulseAttach(uint8_t pin);
+
+/* Release a pin; the counter stops on the last detach */
+void pulseDetach(uint8_t pin);
+
+/* Sample totals into the rate windows. Call from the main loop. */
+void pulsePoll();
+
+/* Total pulses since attach/reset and rate in Hz over the window.
+   Returns false if the pin is not counted. */
+bool pulseRead(uint8_t pin, uint64_t *count, float *rate_hz);
+
+/* Zero the total of a pin */
+void pulseReset(uint8_t pin);
+
+#endif /* PULSE_COUNTER_H */
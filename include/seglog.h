@@ -0,0 +1,84 @@
+/**
+ * @file seglog.h
+ * @brief Append-only segmented sample log on LittleFS
+ *
+ * Fixed-size 20-byte records are packed into 512-byte blocks. Every block
+ * carries a global sequence number, the newest timestamp it holds and a
+ * CRC32, so torn or corrupted blocks are skipped on read. Blocks fill
+ * segment files {dir}/seg0.bin .. seg7.bin used as a ring: when the newest
+ * segment is full the oldest one is truncated and reused.
+ *
+ * Sizing: 8 segments x 32 blocks x 512 B = 128 KB of the 256 KB LittleFS
+ * partition. The history store logs one record per sensor per minute, so
+ * with 8 sensors a block is written every 3 minutes plus at most one
+ * partial flush every SEGLOG_FLUSH_MS. That is roughly 800 block writes a
+ * day spread by LittleFS over 64 erase blocks, ~13 erase cycles per block
+ * per day - decades against the 100k-cycle flash endurance.
+ *
+ * Loss window: records sit in a RAM block until it fills or is
+ * SEGLOG_FLUSH_MS (5 min) old, so a power cut or hard reset loses at most
+ * the last 5 minutes. Software restarts (esp_restart shutdown handler) and
+ * deep sleep flush first and lose nothing.
+ *
+ * The reader streams one block at a time; range queries never load a whole
+ * segment into RAM. Only one reader can be open at a time.
+ *
+ * On the host the log runs on a file-backed stand-in; the benchmark is
+ * test/host/seglog_bench.cpp.
+ */
+
+#ifndef SEGLOG_H
+#define SEGLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SEGLOG_BLOCK_SIZE   512
+#define SEGLOG_SEG_BLOCKS   32        /* 16 KB per segment */
+#define SEGLOG_MAX_SEGS     8
+#define SEGLOG_FLUSH_MS     300000    /* max age of records buffered in RAM */
+
+struct SeglogRecord {
+    uint32_t t;         /* unix seconds */
+    uint32_t key;       /* seglogKey(sensor name) */
+    float    v;         /* value (average for aggregates) */
+    float    lo;        /* minimum over the interval */
+    float    hi;        /* maximum over the interval */
+};
+
+/* Streaming range reader (state only; the block buffer lives in seglog.cpp) */
+struct SeglogReader {
+    uint32_t key;
+    uint32_t from;
+    uint32_t to;
+    uint8_t  order[SEGLOG_MAX_SEGS];   /* segment slots, oldest first */
+    uint8_t  nseg;
+    uint8_t  seg;                       /* index into order */
+    uint16_t blk;                       /* block within segment */
+    uint16_t rec;                       /* record within loaded block */
+    bool     loaded;
+    bool     done;
+};
+
+/* Mount the log in dir (created if missing). Resumes the newest segment. */
+bool seglogInit(const char *dir = "/hist");
+
+/* Append a record. Buffered in RAM until the block is full or stale. */
+bool seglogAppend(const SeglogRecord &rec);
+
+/* Write the partially filled block (before reboot / sleep) */
+void seglogFlush();
+
+/* Stable 32-bit key for a sensor name (FNV-1a) */
+uint32_t seglogKey(const char *name);
+
+/* Range query: records with rec.key == key (0 = any) and from <= t <= to */
+void seglogReaderOpen(SeglogReader *r, uint32_t key, uint32_t from, uint32_t to);
+bool seglogReaderNext(SeglogReader *r, SeglogRecord *out);
+void seglogReaderClose(SeglogReader *r);
+
+/* Counters since boot */
+uint32_t seglogBlocksWritten();
+uint32_t seglogBadBlocks();
+
+#endif /* SEGLOG_H */
@@ -0,0 +1,75 @@
+/**
+ * @file serial_text.h
+ * @brief Line-framed UART input for serial_text devices
+ *
+ * Each spare UART (UART0 is the console) runs the IDF driver with a 2 KB
+ * RX ring and '\n' pattern detection. The driver's ISR moves bytes out of
+ * the hardware FIFO and records where each line ends, so lines that
+ * arrive during a long loop pass wait in RAM instead of overflowing the
+ * FIFO, and reading a line is one bulk copy rather than a byte loop.
+ * A task per open port waits on the driver events and wakes the main
+ * loop when a line is complete.
+ * Pins are fixed per UART and chip.
+ */
+
+#ifndef SERIAL_TEXT_H
+#define SERIAL_TEXT_H
+
+#include <Arduino.h>
+#include "soc/soc_caps.h"
+
+#ifdef SOC_UART_HP_NUM
+#define SERIAL_TEXT_UARTS     (SOC_UART_HP_NUM - 1)   /* UART1..n */
+#else
+#define SERIAL_TEXT_UARTS     (SOC_UART_NUM - 1)
+#endif
+#define SERIAL_TEXT_LINE_MAX  128     /* longer lines are truncated */
+#define SERIAL_TEXT_RX_BUF    2048    /* driver RX ring per UART */
+#define SERIAL_TEXT_EVENTS    16      /* driver event queue depth */
+#define SERIAL_TEXT_PATTERNS  32      /* line ends remembered per UART */
+
+/* Fixed pins per chip variant (UART1) */
+#if defined(CONFIG_IDF_TARGET_ESP32C6)
+#define SERIAL_TEXT_RX  4
+#define SERIAL_TEXT_TX  5
+#elif defined(CONFIG_IDF_TARGET_ESP32S3)
+#define SERIAL_TEXT_RX  19
+#define SERIAL_TEXT_TX  20
+#elif defined(CONFIG_IDF_TARGET_ESP32C3)
+#define SERIAL_TEXT_RX  4
+#define SERIAL_TEXT_TX  5
+#else
+#define SERIAL_TEXT_RX  16
+#define SERIAL_TEXT_TX  17
+#endif
+
+/* UART2 (ESP32, ESP32-S3) */
+#if defined(CONFIG_IDF_TARGET_ESP32S3)
+#define SERIAL_TEXT2_RX 15
+#define SERIAL_TEXT2_TX 16
+#else
+#define SERIAL_TEXT2_RX 25
+#define SERIAL_TEXT2_TX 26
+#endif
+
+/* Start line framing on a UART (1..SERIAL_TEXT_UARTS). baud 0 = 9600.
+   Returns false if the UART does not exist, is open, or failed to start. */
+bool serialTextOpen(uint8_t uart, uint32_t baud);
+
+/* Stop a UART and release its driver */
+void serialTextClose(uint8_t uart);
+
+/* True if the UART is open */
+bool serialTextIsOpen(uint8_t uart);
+
+/* Pop the next complete line (no '\r'/'\n', empty lines skipped).
+   Never waits. Returns false if no line is ready. */
+bool serialTextReadLine(uint8_t uart, char *out, size_t out_len);
+
+/* Write text, appending '\n' if missing */
+bool serialTextWrite(uint8_t uart, const char *text);
+
+/* Lines received and input overflows (data dropped) since open */
+void serialTextStats(uint8_t uart, uint32_t *lines, uint32_t *overflows);
+
+#endif /* SERIAL_TEXT_H */
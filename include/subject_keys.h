@@ -0,0 +1,43 @@
+/**
+ * @file subject_keys.h
+ * @brief Keys of the hal.* and config.* subjects
+ *
+ * The hashed switches that turn routed tokens into handler selectors for
+ * onNatsHal() and onNatsConfig(). They hold no handler code and no Arduino
+ * dependency, so the host router bench (test/host/subject_router_bench.cpp)
+ * dispatches through the same switches as the node.
+ */
+
+#ifndef SUBJECT_KEYS_H
+#define SUBJECT_KEYS_H
+
+#include "subject_router.h"
+
+/* First hal token: a HAL keyword, or a device name */
+enum HalSegment { HSEG_NONE, HSEG_GPIO, HSEG_ADC, HSEG_PWM, HSEG_DAC, HSEG_UART,
+                  HSEG_I2C, HSEG_I2C1, HSEG_SYSTEM, HSEG_DEVICE, HSEG_BATCH };
+
+HalSegment halSegment(const RouteToken &t);
+
+/* hal.system.{key} */
+enum SysKey { SYS_NONE, SYS_TEMPERATURE, SYS_HEAP, SYS_UPTIME, SYS_RSSI,
+              SYS_RESET_REASON, SYS_NATS_RECONNECTS, SYS_LOOP, SYS_I2C_CACHE,
+              SYS_ADC, SYS_DISPLAY };
+
+SysKey halSysKey(const RouteToken &t);
+
+/* hal.{device}.{action}; a bare name and unknown actions read the device */
+enum DevAction { DACT_READ, DACT_INFO, DACT_RESET, DACT_HISTORY, DACT_SET, DACT_GET };
+
+DevAction halDevAction(const Route *r);
+
+/* Config commands: a group token, then a verb token (config.get has none) */
+enum CfgCommand { CCMD_NONE, CCMD_DEVICE_ADD, CCMD_DEVICE_REMOVE, CCMD_DEVICE_LIST,
+                  CCMD_TAG_SET, CCMD_TAG_GET, CCMD_HEARTBEAT_SET, CCMD_I2C_SET,
+                  CCMD_I2C_GET, CCMD_EVENT_SET, CCMD_EVENT_CLEAR, CCMD_EVENT_LIST,
+                  CCMD_RULE_SET, CCMD_RULE_CLEAR, CCMD_RULE_LIST, CCMD_NAME_SET,
+                  CCMD_SLEEP_SET, CCMD_SLEEP_GET, CCMD_GET };
+
+CfgCommand cfgCommand(const Route *r);
+
+#endif /* SUBJECT_KEYS_H */
@@ -0,0 +1,108 @@
+/**
+ * @file subject_router.h
+ * @brief Subject tokens and compile-time hashed dispatch
+ *
+ * routeParse() splits the subject after the node prefix into pointer and
+ * length views of its dot-separated tokens, hashing each token in the same
+ * pass. Routers then switch on a token's hash against case labels hashed by
+ * the compiler, level by level (hal.gpio.{pin}.set: "gpio", then "set"), so
+ * each level is one jump instead of a strcmp chain. Two keys with the same
+ * hash are duplicate case labels and fail to compile; a matching case still
+ * checks routeIs() because tokens that are not keys (device names) may
+ * share a key's hash.
+ *
+ * Buffer ownership: tokens point into msg->subject and the payload into
+ * the client's receive buffer, both valid for the duration of the callback;
+ * nothing is copied. The payload is NUL-terminated in place over the CR
+ * that follows it, so handlers get a C string; routeRelease() restores the
+ * byte before the callback returns. Binary payloads use msg->data and
+ * msg->data_len, which the terminator does not touch.
+ *
+ * Host benchmark: test/host/subject_router_bench.cpp replays hal.* /
+ * config.* traffic through the old strcmp dispatch and through this router
+ * with the subject_keys.h switches, checks both reach the same handler and
+ * prints ns per message (see test/host/README.md).
+ */
+
+#ifndef SUBJECT_ROUTER_H
+#define SUBJECT_ROUTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "nats_core.h"
+
+#define ROUTE_MAX_TOKENS  6       /* further tokens stay in the last one */
+
+struct RouteToken {
+    const char *p;                /* into the subject, not terminated */
+    size_t      len;
+    uint32_t    hash;             /* routeHash(p, len) */
+};
+
+struct Route {
+    const char *suffix;           /* subject after the prefix (terminated) */
+    size_t      suffix_len;
+    RouteToken  tok[ROUTE_MAX_TOKENS];
+    uint8_t     n;
+    const char *payload;          /* terminated in place, "" if none */
+    size_t      payload_len;
+    char       *term;             /* byte replaced by the terminator */
+    char        saved;
+};
+
+/* FNV-1a step and hash. Evaluated by the compiler for case labels. */
+#define ROUTE_HASH_INIT  2166136261u
+constexpr uint32_t routeHashStep(uint32_t h, char c) {
+    return (h ^ (uint8_t)c) * 16777619u;
+}
+
+constexpr uint32_t routeHash(const char *s, size_t n) {
+    uint32_t h = ROUTE_HASH_INIT;
+    for (size_t i = 0; i < n; i++) h = routeHashStep(h, s[i]);
+    return h;
+}
+
+/* Hash of a string literal, for case labels */
+constexpr uint32_t routeKey(const char *s) {
+    size_t n = 0;
+    while (s[n]) n++;
+    return routeHash(s, n);
+}
+
+/* Token view of a C string (e.g. a JSON field), hashed */
+inline RouteToken routeToken(const char *s) {
+    size_t n = strlen(s);
+    return { s, n, routeHash(s, n) };
+}
+
+/* Exact token match against a literal */
+inline bool routeIs(const RouteToken &t, const char *s) {
+    return strlen(s) == t.len && memcmp(t.p, s, t.len) == 0;
+}
+
+template <uint32_t K> struct RouteKeyConst { static constexpr uint32_t value = K; };
+
+/* Token equals a literal key: compile-time hash compare, then confirm */
+#define ROUTE_MATCH(t, key) \
+    ((t).hash == RouteKeyConst<routeKey(key)>::value && routeIs((t), (key)))
+
+/* Token i, or an empty token past the end */
+inline const RouteToken &routeTok(const Route *r, int i) {
+    static const RouteToken none = { "", 0, ROUTE_HASH_INIT };
+    return i < r->n ? r->tok[i] : none;
+}
+
+/* Unsigned decimal token (pin, address, length). False if empty, not all
+   digits or above max. */
+bool routeUint(const RouteToken &t, uint32_t max, int *out);
+
+/* Tokenize msg->subject after prefix_len bytes and terminate the payload.
+   Returns false if nothing follows the prefix. Call routeRelease() before
+   the handler returns to the client. */
+bool routeParse(const nats_msg_t *msg, size_t prefix_len, Route *r);
+
+/* Restore the byte under the payload terminator */
+void routeRelease(Route *r);
+
+#endif /* SUBJECT_ROUTER_H */
@@ -10,6 +10,9 @@
 #ifndef WEB_CONFIG_H
 #define WEB_CONFIG_H
 
+#define WEB_PORT     80
+#define WEB_POLL_MS  50     /* poll interval if the listener cannot be watched */
+
 /**
  * Initialize the web config server and mDNS responder.
  * Call from setup() after WiFi is connected.
@@ -18,8 +21,17 @@ void webConfigSetup();
 
 /**
  * Process pending HTTP requests.
- * Call from loop() on every iteration.
+ * Call from loop() on every iteration. The listening socket, or the
+ * connection being served, wakes the loop through the socket watcher;
+ * only if the listener was not found does it poll every WEB_POLL_MS.
  */
 void webConfigLoop();
 
+/**
+ * WiFi link went down (false) or came back (true).
+ * Down drops both socket watches so no stale descriptor is waited on;
+ * up looks the listening socket up again.
+ */
+void webConfigLink(bool up);
+
 #endif /* WEB_CONFIG_H */
@@ -116,6 +116,19 @@ public:
    */
   bool connected() const { return m_connected && nats_is_connected(&m_client); }
 
+  /**
+   * @brief Socket descriptor of the connection (-1 if none), for select()
+   */
+  int socketFd() const { return m_tcp.fd(); }
+
+  /**
+   * @brief Bytes received but not yet processed
+   *
+   * WiFiClient reads ahead into its own buffer, so data can be waiting
+   * here while the socket is no longer readable.
+   */
+  int pending() { return m_tcp.available(); }
+
   /**
    * @brief Process incoming messages (call in loop())
    *
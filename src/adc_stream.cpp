@@ -0,0 +1,425 @@
+/**
+ * @file adc_stream.cpp
+ * @brief Continuous DMA ADC sampling with per-channel decimation
+ *
+ * ADC1 runs in continuous mode at ADC_STREAM_SAMPLE_HZ, cycling through
+ * one pattern entry per streamed pin. adcStreamPoll() pulls the DMA frames
+ * and runs each sample through its channel's CIC decimator (2 integrators,
+ * 2 combs, ratio ADC_STREAM_DECIM): a sinc^2 low-pass that needs only adds
+ * per sample. Integrators wrap modulo 2^32, which the combs cancel out.
+ * Outputs are converted to millivolts on lookup with the chip's eFuse
+ * calibration.
+ *
+ * Burst captures take the unit over temporarily: the stream is torn down,
+ * a single-pin configuration runs at the requested rate and the DMA
+ * callback writes samples straight into the capture buffer.
+ */
+
+#include "adc_stream.h"
+#include "loop_sched.h"
+#include <esp_adc/adc_continuous.h>
+#include <esp_adc/adc_cali_scheme.h>
+#include "soc/soc_caps.h"
+
+#if CONFIG_IDF_TARGET_ESP32
+#define ADC_STREAM_FORMAT        ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define ADC_STREAM_CHAN(p)       ((p)->type1.channel)
+#define ADC_STREAM_DATA(p)       ((p)->type1.data)
+#else
+#define ADC_STREAM_FORMAT        ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define ADC_STREAM_CHAN(p)       ((p)->type2.channel)
+#define ADC_STREAM_DATA(p)       ((p)->type2.data)
+#endif
+
+#define ADC_STREAM_CHAN_MAX  16     /* ADC1 channel numbers */
+#define ADC_STREAM_GAIN      ((float)ADC_STREAM_DECIM * ADC_STREAM_DECIM)
+
+/*============================================================================
+ * Per-channel decimator
+ *============================================================================*/
+
+struct AdcChan {
+    uint8_t  pin;
+    uint8_t  channel;
+    uint8_t  outputs;       /* saturates at 2: comb delay lines filled */
+    uint16_t count;         /* samples in the current decimation period */
+    uint32_t integ1, integ2;
+    uint32_t comb1, comb2;  /* comb delay elements */
+    float    value;         /* latest output, 12-bit raw */
+};
+
+static adc_continuous_handle_t g_adc_handle = nullptr;
+static bool     g_adc_running = false;
+static int      g_adc_paused  = 0;
+static bool     g_cap_active  = false;  /* a burst capture owns the unit */
+static AdcChan  g_adc_chan[ADC_STREAM_MAX];
+static int      g_adc_count = 0;
+static int8_t   g_adc_slot[ADC_STREAM_CHAN_MAX];    /* channel -> slot */
+static uint32_t g_adc_outputs = 0;
+static volatile uint32_t g_adc_overruns = 0;
+
+static adc_cali_handle_t g_adc_cali[ADC_STREAM_CHAN_MAX];
+static bool     g_adc_cali_tried[ADC_STREAM_CHAN_MAX];
+
+static inline void adcChanFeed(AdcChan *c, uint32_t x) {
+    c->integ1 += x;
+    c->integ2 += c->integ1;
+    if (++c->count < ADC_STREAM_DECIM) return;
+    c->count = 0;
+    uint32_t d1 = c->integ2 - c->comb1;
+    c->comb1 = c->integ2;
+    uint32_t d2 = d1 - c->comb2;
+    c->comb2 = d1;
+    c->value = (float)d2 / ADC_STREAM_GAIN;
+    if (c->outputs < 2) c->outputs++;
+    g_adc_outputs++;
+}
+
+static AdcChan *adcChanFind(uint8_t pin) {
+    for (int i = 0; i < g_adc_count; i++) {
+        if (g_adc_chan[i].pin == pin) return &g_adc_chan[i];
+    }
+    return nullptr;
+}
+
+/*============================================================================
+ * Calibration
+ *============================================================================*/
+
+static adc_cali_handle_t adcCali(uint8_t channel) {
+    if (channel >= ADC_STREAM_CHAN_MAX) return nullptr;
+    if (g_adc_cali_tried[channel]) return g_adc_cali[channel];
+    g_adc_cali_tried[channel] = true;
+
+    esp_err_t err = ESP_FAIL;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t cfg = {};
+    cfg.unit_id  = ADC_UNIT_1;
+    cfg.chan     = (adc_channel_t)channel;
+    cfg.atten    = ADC_ATTEN_DB_12;
+    cfg.bitwidth = ADC_BITWIDTH_12;
+    err = adc_cali_create_scheme_curve_fitting(&cfg, &g_adc_cali[channel]);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_line_fitting_config_t cfg = {};
+    cfg.unit_id  = ADC_UNIT_1;
+    cfg.atten    = ADC_ATTEN_DB_12;
+    cfg.bitwidth = ADC_BITWIDTH_12;
+    err = adc_cali_create_scheme_line_fitting(&cfg, &g_adc_cali[channel]);
+#endif
+    if (err != ESP_OK) g_adc_cali[channel] = nullptr;
+    return g_adc_cali[channel];
+}
+
+/* Calibrated millivolts, interpolated between integer raw codes */
+static float adcToMilliVolts(uint8_t channel, float raw) {
+    adc_cali_handle_t cali = adcCali(channel);
+    if (!cali) return raw * 3300.0f / 4095.0f;
+    int r0 = (int)raw;
+    int mv0 = 0, mv1 = 0;
+    adc_cali_raw_to_voltage(cali, r0, &mv0);
+    if (r0 >= 4095) return (float)mv0;
+    adc_cali_raw_to_voltage(cali, r0 + 1, &mv1);
+    return mv0 + (raw - r0) * (mv1 - mv0);
+}
+
+/*============================================================================
+ * Engine
+ *============================================================================*/
+
+static bool IRAM_ATTR adcOnPoolOverflow(adc_continuous_handle_t handle,
+                                        const adc_continuous_evt_data_t *edata,
+                                        void *user) {
+    (void)handle; (void)edata; (void)user;
+    g_adc_overruns++;
+    return false;
+}
+
+static void adcEngineStop() {
+    if (!g_adc_handle) return;
+    if (g_adc_running) adc_continuous_stop(g_adc_handle);
+    adc_continuous_deinit(g_adc_handle);
+    g_adc_handle = nullptr;
+    g_adc_running = false;
+}
+
+static bool adcEngineStart() {
+    adc_continuous_handle_cfg_t hcfg = {};
+    hcfg.max_store_buf_size = ADC_STREAM_POOL;
+    hcfg.conv_frame_size    = ADC_STREAM_FRAME;
+    if (adc_continuous_new_handle(&hcfg, &g_adc_handle) != ESP_OK) {
+        g_adc_handle = nullptr;
+        return false;
+    }
+
+    static adc_digi_pattern_config_t pattern[ADC_STREAM_MAX];
+    for (int i = 0; i < g_adc_count; i++) {
+        pattern[i].atten     = ADC_ATTEN_DB_12;
+        pattern[i].channel   = g_adc_chan[i].channel;
+        pattern[i].unit      = ADC_UNIT_1;
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+
+    adc_continuous_config_t cfg = {};
+    cfg.pattern_num    = g_adc_count;
+    cfg.adc_pattern    = pattern;
+    cfg.sample_freq_hz = ADC_STREAM_SAMPLE_HZ;
+    cfg.conv_mode      = ADC_CONV_SINGLE_UNIT_1;
+    cfg.format         = ADC_STREAM_FORMAT;
+
+    adc_continuous_evt_cbs_t cbs = {};
+    cbs.on_pool_ovf = adcOnPoolOverflow;
+
+    if (adc_continuous_config(g_adc_handle, &cfg) != ESP_OK ||
+        adc_continuous_register_event_callbacks(g_adc_handle, &cbs, nullptr) != ESP_OK ||
+        adc_continuous_start(g_adc_handle) != ESP_OK) {
+        adcEngineStop();
+        return false;
+    }
+    g_adc_running = true;
+    return true;
+}
+
+int adcStreamSetPins(const uint8_t *pins, int n) {
+    /* Collect ADC1 pins, keep the current set if nothing changed */
+    uint8_t want[ADC_STREAM_MAX];
+    uint8_t chans[ADC_STREAM_MAX];
+    int count = 0;
+    for (int i = 0; i < n && count < ADC_STREAM_MAX; i++) {
+        adc_unit_t unit;
+        adc_channel_t chan;
+        if (adc_continuous_io_to_channel(pins[i], &unit, &chan) != ESP_OK ||
+            unit != ADC_UNIT_1 || chan >= ADC_STREAM_CHAN_MAX)
+            continue;
+        bool dup = false;
+        for (int j = 0; j < count; j++) dup |= (want[j] == pins[i]);
+        if (dup) continue;
+        want[count] = pins[i];
+        chans[count] = (uint8_t)chan;
+        count++;
+    }
+
+    bool same = (count == g_adc_count) && (count == 0 || g_adc_running);
+    for (int i = 0; same && i < count; i++) same = (adcChanFind(want[i]) != nullptr);
+    if (same) return g_adc_running ? count : 0;
+
+    if (!g_cap_active) adcEngineStop();
+    memset(g_adc_chan, 0, sizeof(g_adc_chan));
+    memset(g_adc_slot, -1, sizeof(g_adc_slot));
+    g_adc_count = count;
+    for (int i = 0; i < count; i++) {
+        g_adc_chan[i].pin = want[i];
+        g_adc_chan[i].channel = chans[i];
+        g_adc_slot[chans[i]] = (int8_t)i;
+        adcCali(chans[i]);
+    }
+    if (count == 0 || g_cap_active) return count;   /* capture end restarts */
+
+    if (!adcEngineStart()) {
+        Serial.printf("ADC: continuous mode failed, using one-shot reads\n");
+        g_adc_count = 0;
+        return 0;
+    }
+    Serial.printf("ADC: streaming %d pin(s) at %d Hz, decimation %d\n",
+                  count, ADC_STREAM_SAMPLE_HZ, ADC_STREAM_DECIM);
+    return count;
+}
+
+void adcStreamPoll() {
+    if (!g_adc_running || g_adc_paused || g_cap_active) return;
+    loopIn(ADC_STREAM_DRAIN_MS);
+
+    static uint8_t frame[ADC_STREAM_FRAME];
+    /* Bounded: at most one pool's worth per call */
+    for (int f = 0; f < ADC_STREAM_POOL / ADC_STREAM_FRAME; f++) {
+        uint32_t got = 0;
+        if (adc_continuous_read(g_adc_handle, frame, sizeof(frame), &got, 0) != ESP_OK)
+            break;
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= got;
+             i += SOC_ADC_DIGI_RESULT_BYTES) {
+            adc_digi_output_data_t *p = (adc_digi_output_data_t *)&frame[i];
+            uint32_t chan = ADC_STREAM_CHAN(p);
+            if (chan >= ADC_STREAM_CHAN_MAX || g_adc_slot[chan] < 0) continue;
+            adcChanFeed(&g_adc_chan[g_adc_slot[chan]], ADC_STREAM_DATA(p));
+        }
+        if (got < sizeof(frame)) break;
+    }
+}
+
+/* During a capture the stream holds its last values */
+static bool adcStreamLive() {
+    return g_adc_running || g_adc_count > 0;
+}
+
+bool adcStreamRaw(uint8_t pin, float *raw) {
+    if (!adcStreamLive()) return false;
+    AdcChan *c = adcChanFind(pin);
+    if (!c || c->outputs < 2) return false;
+    *raw = c->value;
+    return true;
+}
+
+bool adcStreamMilliVolts(uint8_t pin, float *mv) {
+    if (!adcStreamLive()) return false;
+    AdcChan *c = adcChanFind(pin);
+    if (!c || c->outputs < 2) return false;
+    *mv = adcToMilliVolts(c->channel, c->value);
+    return true;
+}
+
+bool adcStreamStats(int *channels, uint32_t *outputs, uint32_t *overruns) {
+    bool running = g_adc_running && !g_cap_active;
+    *channels = running ? g_adc_count : 0;
+    *outputs  = g_adc_outputs;
+    *overruns = g_adc_overruns;
+    return running;
+}
+
+/*============================================================================
+ * Burst capture
+ *============================================================================*/
+
+static int16_t  g_cap_buf[ADC_CAPTURE_MAX];
+static uint8_t  g_cap_channel;
+static uint16_t g_cap_oversample;       /* hw samples averaged per output */
+static uint32_t g_cap_deadline_ms;
+static volatile int      g_cap_count;
+static volatile int      g_cap_want;
+static volatile uint32_t g_cap_acc;
+static volatile uint16_t g_cap_acc_n;
+
+static bool IRAM_ATTR adcOnCaptureFrame(adc_continuous_handle_t handle,
+                                        const adc_continuous_evt_data_t *edata,
+                                        void *user) {
+    (void)handle; (void)user;
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= edata->size &&
+                         g_cap_count < g_cap_want;
+         i += SOC_ADC_DIGI_RESULT_BYTES) {
+        adc_digi_output_data_t *p = (adc_digi_output_data_t *)&edata->conv_frame_buffer[i];
+        if (ADC_STREAM_CHAN(p) != g_cap_channel) continue;
+        g_cap_acc += ADC_STREAM_DATA(p);
+        if (++g_cap_acc_n < g_cap_oversample) continue;
+        g_cap_buf[g_cap_count++] = (int16_t)(g_cap_acc / g_cap_oversample);
+        g_cap_acc = 0;
+        g_cap_acc_n = 0;
+    }
+    if (g_cap_count >= g_cap_want) loopWakeFromIsr();
+    return false;
+}
+
+bool adcCaptureStart(uint8_t pin, uint32_t hz, int n) {
+    if (g_cap_active || n < 1 || n > ADC_CAPTURE_MAX ||
+        hz < ADC_CAPTURE_HZ_MIN || hz > ADC_CAPTURE_HZ_MAX)
+        return false;
+    adc_unit_t unit;
+    adc_channel_t chan;
+    if (adc_continuous_io_to_channel(pin, &unit, &chan) != ESP_OK || unit != ADC_UNIT_1)
+        return false;
+
+    /* Oversample up to the hardware minimum rate */
+    uint32_t k = (SOC_ADC_SAMPLE_FREQ_THRES_LOW + hz - 1) / hz;
+    if (k < 1) k = 1;
+
+    adcEngineStop();        /* stream resumes in adcCaptureEnd() */
+    g_cap_channel = (uint8_t)chan;
+    g_cap_oversample = (uint16_t)k;
+    g_cap_count = 0;
+    g_cap_want = n;
+    g_cap_acc = 0;
+    g_cap_acc_n = 0;
+    g_cap_deadline_ms = millis() + (uint32_t)((uint64_t)n * 1000 / hz) + 1000;
+    g_cap_active = true;
+
+    adc_continuous_handle_cfg_t hcfg = {};
+    hcfg.max_store_buf_size = ADC_STREAM_POOL;
+    hcfg.conv_frame_size    = ADC_STREAM_FRAME;
+    static adc_digi_pattern_config_t pattern;
+    pattern.atten     = ADC_ATTEN_DB_12;
+    pattern.channel   = (uint8_t)chan;
+    pattern.unit      = ADC_UNIT_1;
+    pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    adc_continuous_config_t cfg = {};
+    cfg.pattern_num    = 1;
+    cfg.adc_pattern    = &pattern;
+    cfg.sample_freq_hz = hz * k;
+    cfg.conv_mode      = ADC_CONV_SINGLE_UNIT_1;
+    cfg.format         = ADC_STREAM_FORMAT;
+    adc_continuous_evt_cbs_t cbs = {};
+    cbs.on_conv_done = adcOnCaptureFrame;
+
+    if (adc_continuous_new_handle(&hcfg, &g_adc_handle) != ESP_OK) {
+        g_adc_handle = nullptr;
+        adcCaptureEnd();
+        return false;
+    }
+    if (adc_continuous_config(g_adc_handle, &cfg) != ESP_OK ||
+        adc_continuous_register_event_callbacks(g_adc_handle, &cbs, nullptr) != ESP_OK ||
+        adc_continuous_start(g_adc_handle) != ESP_OK) {
+        adcCaptureEnd();
+        return false;
+    }
+    g_adc_running = true;   /* the capture owns the handle now */
+    return true;
+}
+
+int adcCapturePoll() {
+    if (!g_cap_active) return -1;
+    if (g_cap_count >= g_cap_want) return 1;
+    if ((int32_t)(millis() - g_cap_deadline_ms) >= 0) return -1;
+    loopAt(g_cap_deadline_ms);
+    return 0;
+}
+
+const int16_t *adcCaptureData(int *n, bool to_mv) {
+    *n = g_cap_count;
+    if (to_mv) {
+        for (int i = 0; i < g_cap_count; i++)
+            g_cap_buf[i] = (int16_t)(adcToMilliVolts(g_cap_channel, g_cap_buf[i]) + 0.5f);
+    }
+    return g_cap_buf;
+}
+
+void adcCaptureEnd() {
+    if (!g_cap_active) return;
+    adcEngineStop();
+    g_cap_active = false;
+    if (g_adc_count > 0 && !adcEngineStart()) {
+        Serial.printf("ADC: stream restart failed, using one-shot reads\n");
+        g_adc_count = 0;
+    }
+}
+
+/*============================================================================
+ * One-shot fallback — the unit is owned by the stream while it runs
+ *============================================================================*/
+
+/* A running capture is not interrupted; one-shot reads fail until it ends */
+static void adcPause() {
+    if (g_adc_paused++ == 0 && g_adc_running && !g_cap_active)
+        adc_continuous_stop(g_adc_handle);
+}
+
+static void adcResume() {
+    if (--g_adc_paused == 0 && g_adc_running && !g_cap_active &&
+        adc_continuous_start(g_adc_handle) != ESP_OK) {
+        Serial.printf("ADC: restart failed, using one-shot reads\n");
+        adcEngineStop();
+        g_adc_count = 0;
+    }
+}
+
+int adcOneshotRaw(uint8_t pin) {
+    adcPause();
+    int val = analogRead(pin);
+    adcResume();
+    return val;
+}
+
+float adcOneshotMilliVolts(uint8_t pin, int samples, int discard) {
+    if (samples <= 0) return 0.0f;
+    adcPause();
+    for (int s = 0; s < discard; s++) analogReadMilliVolts(pin);
+    int32_t sum = 0;
+    for (int s = 0; s < samples; s++) sum += analogReadMilliVolts(pin);
+    adcResume();
+    return sum / (float)samples;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file boot_cache.cpp
+ * @brief Connection details kept across resets for a fast reconnect
+ */
+
+#include "boot_cache.h"
+#include <stddef.h>
+#include <string.h>
+#include <esp_attr.h>
+#include <esp_rom_crc.h>
+
+#define BOOT_CACHE_MAGIC  0x43544F42u   /* "BOTC" */
+
+struct BootCache {
+    uint32_t magic;
+    uint32_t ssid_crc;          /* SSID the AP entry belongs to, 0 = none */
+    uint8_t  bssid[6];
+    uint8_t  channel;
+    uint8_t  rsv;
+    uint32_t host_crc;          /* NATS host the address belongs to, 0 = none */
+    uint32_t nats_ip;
+    uint32_t crc;               /* CRC32 over magic..nats_ip */
+};
+
+static RTC_NOINIT_ATTR BootCache g_boot_cache;
+
+static uint32_t bootCacheCrc(const void *p, size_t len) {
+    return esp_rom_crc32_le(0, (const uint8_t *)p, len);
+}
+
+/* Cache contents, or nullptr after power-on / corruption */
+static BootCache *bootCacheValid() {
+    BootCache *c = &g_boot_cache;
+    if (c->magic != BOOT_CACHE_MAGIC ||
+        c->crc != bootCacheCrc(c, offsetof(BootCache, crc)))
+        return nullptr;
+    return c;
+}
+
+static BootCache *bootCacheEdit() {
+    BootCache *c = bootCacheValid();
+    if (!c) {
+        c = &g_boot_cache;
+        memset(c, 0, sizeof(*c));
+        c->magic = BOOT_CACHE_MAGIC;
+    }
+    return c;
+}
+
+static void bootCacheSeal(BootCache *c) {
+    c->crc = bootCacheCrc(c, offsetof(BootCache, crc));
+}
+
+bool bootCacheWifi(const char *ssid, uint8_t bssid[6], uint8_t *channel) {
+    const BootCache *c = bootCacheValid();
+    if (!c || c->ssid_crc == 0 || c->ssid_crc != bootCacheCrc(ssid, strlen(ssid)))
+        return false;
+    memcpy(bssid, c->bssid, 6);
+    *channel = c->channel;
+    return true;
+}
+
+void bootCacheSetWifi(const char *ssid, const uint8_t *bssid, uint8_t channel) {
+    BootCache *c = bootCacheEdit();
+    if (bssid && channel > 0) {
+        c->ssid_crc = bootCacheCrc(ssid, strlen(ssid));
+        memcpy(c->bssid, bssid, 6);
+        c->channel = channel;
+    } else {
+        c->ssid_crc = 0;
+    }
+    bootCacheSeal(c);
+}
+
+uint32_t bootCacheNatsIp(const char *host) {
+    const BootCache *c = bootCacheValid();
+    if (!c || c->host_crc == 0 || c->host_crc != bootCacheCrc(host, strlen(host)))
+        return 0;
+    return c->nats_ip;
+}
+
+void bootCacheSetNatsIp(const char *host, uint32_t ip) {
+    BootCache *c = bootCacheEdit();
+    c->host_crc = ip ? bootCacheCrc(host, strlen(host)) : 0;
+    c->nats_ip = ip;
+    bootCacheSeal(c);
+}
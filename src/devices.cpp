@@ -7,18 +7,39 @@
 #include "nats_hal.h"
 #include "i2c_devices.h"
 #include "dht_driver.h"
+#include "adc_stream.h"
+#include "gpio_edges.h"
+#include "pulse_counter.h"
+#include "serial_text.h"
+#include "history.h"
+#include "events.h"
+#include "expr.h"
+#include "loop_sched.h"
+#include "subject_router.h"
 #include <nats_atoms.h>
 #include <LittleFS.h>
+#include <esp_timer.h>
+#include <esp_rom_crc.h>
 #if !defined(CONFIG_IDF_TARGET_ESP32)
 #include "driver/temperature_sensor.h"
 extern temperature_sensor_handle_t g_temp_sensor;
 #endif
 #include <math.h>
 extern bool g_debug;
+extern NatsClient natsClient;
+extern bool g_nats_connected;
+extern char cfg_device_name[32];
 extern bool g_devices_dirty;
 extern unsigned long g_devices_dirty_ms;
 
 static Device g_devices[MAX_DEVICES];
+static bool   g_history_restored = false;   /* segment log replayed into history */
+static uint32_t g_registry_gen = 0;         /* bumped on register/remove/clear */
+static uint32_t g_fresh_mask = 0;           /* slots with a conversion just completed */
+
+uint32_t deviceRegistryGen() {
+    return g_registry_gen;
+}
 
 void devicesMarkDirty() {
     g_devices_dirty = true;
@@ -30,7 +51,7 @@ void devicesMarkDirty() {
  *============================================================================*/
 
 bool deviceIsSensor(DeviceKind kind) {
-    return kind <= DEV_SENSOR_DHT22_HUMI;
+    return kind <= DEV_SENSOR_COMPUTED;
 }
 
 bool deviceIsActuator(DeviceKind kind) {
@@ -46,6 +67,10 @@ bool deviceIsI2c(DeviceKind kind) {
            kind == DEV_ACTUATOR_SSD1306 || kind == DEV_ACTUATOR_SH1106;
 }
 
+bool deviceIsPulse(DeviceKind kind) {
+    return kind == DEV_SENSOR_PULSE_COUNT || kind == DEV_SENSOR_PULSE_RATE;
+}
+
 const char *deviceKindName(DeviceKind kind) {
     switch (kind) {
         case DEV_SENSOR_DIGITAL:       return "digital_in";
@@ -67,6 +92,9 @@ const char *deviceKindName(DeviceKind kind) {
         case DEV_SENSOR_DHT11_HUMI:    return "dht11_humi";
         case DEV_SENSOR_DHT22_TEMP:    return "dht22_temp";
         case DEV_SENSOR_DHT22_HUMI:    return "dht22_humi";
+        case DEV_SENSOR_PULSE_COUNT:   return "pulse_count";
+        case DEV_SENSOR_PULSE_RATE:    return "pulse_rate";
+        case DEV_SENSOR_COMPUTED:      return "computed";
         case DEV_ACTUATOR_DIGITAL:     return "digital_out";
         case DEV_ACTUATOR_RELAY:       return "relay";
         case DEV_ACTUATOR_PWM:         return "pwm";
@@ -97,6 +125,9 @@ static DeviceKind kindFromString(const char *s) {
     if (strcmp(s, "dht11_humi") == 0)    return DEV_SENSOR_DHT11_HUMI;
     if (strcmp(s, "dht22_temp") == 0)    return DEV_SENSOR_DHT22_TEMP;
     if (strcmp(s, "dht22_humi") == 0)    return DEV_SENSOR_DHT22_HUMI;
+    if (strcmp(s, "pulse_count") == 0)   return DEV_SENSOR_PULSE_COUNT;
+    if (strcmp(s, "pulse_rate") == 0)    return DEV_SENSOR_PULSE_RATE;
+    if (strcmp(s, "computed") == 0)      return DEV_SENSOR_COMPUTED;
     if (strcmp(s, "digital_out") == 0)   return DEV_ACTUATOR_DIGITAL;
     if (strcmp(s, "relay") == 0)         return DEV_ACTUATOR_RELAY;
     if (strcmp(s, "pwm") == 0)           return DEV_ACTUATOR_PWM;
@@ -126,110 +157,287 @@ Device *deviceFind(const char *name) {
     return nullptr;
 }
 
-bool deviceRegister(const char *name, DeviceKind kind, uint8_t pin,
-                    const char *unit, bool inverted,
-                    const char *nats_subject, uint32_t baud,
-                    uint8_t i2c_addr, const char *disp_template,
-                    uint8_t i2c_reg_len, float i2c_scale) {
+/* Name hashes per slot for subject lookups, rebuilt when the registry
+   changes; a slot's name is only compared when its hash matches */
+static uint32_t g_name_hash[MAX_DEVICES];
+static uint32_t g_name_hash_gen;
+static bool     g_name_hash_valid = false;
+
+Device *deviceFindN(const char *name, size_t len, uint32_t hash) {
+    if (len >= DEV_NAME_LEN) return nullptr;
+    if (!g_name_hash_valid || g_name_hash_gen != g_registry_gen) {
+        for (int i = 0; i < MAX_DEVICES; i++)
+            g_name_hash[i] = g_devices[i].used ? routeKey(g_devices[i].name) : 0;
+        g_name_hash_gen = g_registry_gen;
+        g_name_hash_valid = true;
+    }
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (g_name_hash[i] == hash && g_devices[i].used &&
+            memcmp(g_devices[i].name, name, len) == 0 && g_devices[i].name[len] == '\0')
+            return &g_devices[i];
+    }
+    return nullptr;
+}
+
+uint8_t deviceI2cAddr(const Device *dev) {
+    return I2C_BUS_ADDR(dev->i2c_bus, dev->i2c_addr);
+}
+
+/* Rebuild the per-address I2C cache TTLs from the registered sensors */
+static void deviceI2cTtlSync() {
+    i2cCacheTtlReset();
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        const Device *d = &g_devices[i];
+        if (d->used && deviceIsI2c(d->kind) && !deviceIsDisplay(d->kind) && d->i2c_addr > 0)
+            i2cCacheSetTtl(deviceI2cAddr(d), d->i2c_ttl_ms);
+    }
+}
+
+/*============================================================================
+ * Digital input edges - debounced on the consumer side of the ISR queue
+ *============================================================================*/
+
+/* Leading-edge debounce: the first edge after a quiet period is accepted
+ * at once, later ones inside debounce_ms only mark the input for a re-check
+ * when the window closes. A pulse shorter than the window still produces
+ * both edges, and the level can never stick on a bounce. */
+
+struct EdgeState {
+    uint8_t  level;         /* debounced level */
+    bool     pending;       /* edges seen inside the window */
+    uint64_t last_us;       /* last accepted edge */
+    uint32_t rising;
+    uint32_t falling;
+};
+
+static EdgeState g_edge[MAX_DEVICES];
+
+static void edgeStateReset(int slot) {
+    memset(&g_edge[slot], 0, sizeof(g_edge[slot]));
+    g_edge[slot].level = (uint8_t)digitalRead(g_devices[slot].pin);
+}
+
+static void edgeAccept(int slot, uint8_t level, uint64_t t_us) {
+    EdgeState *s = &g_edge[slot];
+    uint64_t dt_us = s->last_us ? t_us - s->last_us : 0;
+    s->level = level;
+    s->last_us = t_us;
+    s->pending = false;
+    if (level) s->rising++; else s->falling++;
+    eventsOnEdge(&g_devices[slot], level, s->rising + s->falling, t_us, dt_us);
+    displayOnValue(slot, (float)level);
+}
+
+static void edgesPoll() {
+    EdgeEvent e;
+    while (edgePop(&e)) {
+        Device *d = &g_devices[e.slot];
+        if (!d->used || d->kind != DEV_SENSOR_DIGITAL) continue;
+        EdgeState *s = &g_edge[e.slot];
+        if (s->last_us && e.t_us - s->last_us < (uint64_t)d->debounce_ms * 1000) {
+            s->pending = true;
+            continue;
+        }
+        if (e.level != s->level) edgeAccept(e.slot, e.level, e.t_us);
+    }
+
+    /* Window closed: settle on the actual level (millis() runs on the same
+       timer, so the pass for an open window is scheduled in ms) */
+    uint64_t now = (uint64_t)esp_timer_get_time();
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        EdgeState *s = &g_edge[i];
+        if (!s->pending) continue;
+        uint64_t window = (uint64_t)g_devices[i].debounce_ms * 1000;
+        if (now - s->last_us < window) {
+            loopAt((uint32_t)((s->last_us + window) / 1000) + 1);
+            continue;
+        }
+        s->pending = false;
+        uint8_t level = (uint8_t)digitalRead(g_devices[i].pin);
+        if (level != s->level) edgeAccept(i, level, now);
+    }
+}
+
+bool deviceEdgeStats(const Device *dev, uint32_t *rising, uint32_t *falling,
+                     uint64_t *last_us) {
+    if (!dev || !dev->used || dev->kind != DEV_SENSOR_DIGITAL || dev->pin == PIN_NONE)
+        return false;
+    const EdgeState *s = &g_edge[dev - g_devices];
+    *rising = s->rising;
+    *falling = s->falling;
+    *last_us = s->last_us;
+    return true;
+}
+
+/* First free registry slot, -1 if full */
+static int deviceFreeSlot() {
+    for (int i = 0; i < MAX_DEVICES; i++)
+        if (!g_devices[i].used) return i;
+    return -1;
+}
+
+/* Register into slot i. The stored registry restores each device into the
+   slot it was saved from, so slot-indexed state (history series, duty
+   columns, edge capture) lines up with the same device across boots. */
+static bool deviceRegisterAt(int i, const char *name, DeviceKind kind, uint8_t pin,
+                             const char *unit, bool inverted,
+                             const char *nats_subject, uint32_t baud,
+                             uint8_t i2c_addr, const char *disp_template,
+                             uint8_t i2c_reg_len, float i2c_scale,
+                             uint16_t i2c_ttl_ms, uint8_t i2c_bus, uint8_t uart) {
+    if (i < 0 || i >= MAX_DEVICES || g_devices[i].used) return false;
+
     /* Reject HAL reserved names */
     if (halIsReservedName(name)) return false;
 
+    /* One serial_text device per UART */
+    if (kind == DEV_SENSOR_SERIAL_TEXT &&
+        (uart < 1 || uart > SERIAL_TEXT_UARTS || deviceSerialText(uart)))
+        return false;
+
+    /* Bus index must exist on this chip */
+    if (deviceIsI2c(kind) && i2c_bus >= I2C_BUS_MAX) return false;
+
     /* Check for duplicate */
     if (deviceFind(name)) return false;
 
-    /* Find free slot */
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        if (!g_devices[i].used) {
-            strncpy(g_devices[i].name, name, DEV_NAME_LEN - 1);
-            g_devices[i].name[DEV_NAME_LEN - 1] = '\0';
-            g_devices[i].kind = kind;
-            g_devices[i].pin = pin;
-            if (unit) {
-                strncpy(g_devices[i].unit, unit, DEV_UNIT_LEN - 1);
-                g_devices[i].unit[DEV_UNIT_LEN - 1] = '\0';
-            } else {
-                g_devices[i].unit[0] = '\0';
-            }
-            g_devices[i].inverted = inverted;
-            g_devices[i].used = true;
-
-            /* NATS virtual sensor fields */
-            if (nats_subject && nats_subject[0]) {
-                strncpy(g_devices[i].nats_subject, nats_subject, sizeof(g_devices[i].nats_subject) - 1);
-                g_devices[i].nats_subject[sizeof(g_devices[i].nats_subject) - 1] = '\0';
-            } else {
-                g_devices[i].nats_subject[0] = '\0';
-            }
-            g_devices[i].nats_value = 0.0f;
-            g_devices[i].nats_msg[0] = '\0';
-            g_devices[i].nats_sid = 0;
-            g_devices[i].baud = baud;
-
-            /* I2C fields */
-            g_devices[i].i2c_addr = i2c_addr;
-            g_devices[i].i2c_reg_len = i2c_reg_len > 0 ? i2c_reg_len : 1;
-            g_devices[i].i2c_scale = (i2c_scale != 0.0f) ? i2c_scale : 1.0f;
-            if (disp_template && disp_template[0]) {
-                strncpy(g_devices[i].disp_template, disp_template, sizeof(g_devices[i].disp_template) - 1);
-                g_devices[i].disp_template[sizeof(g_devices[i].disp_template) - 1] = '\0';
-            } else {
-                g_devices[i].disp_template[0] = '\0';
-            }
+    strncpy(g_devices[i].name, name, DEV_NAME_LEN - 1);
+    g_devices[i].name[DEV_NAME_LEN - 1] = '\0';
+    g_devices[i].kind = kind;
+    g_devices[i].pin = pin;
+    if (unit) {
+        strncpy(g_devices[i].unit, unit, DEV_UNIT_LEN - 1);
+        g_devices[i].unit[DEV_UNIT_LEN - 1] = '\0';
+    } else {
+        g_devices[i].unit[0] = '\0';
+    }
+    g_devices[i].inverted = inverted;
+    g_devices[i].used = true;
+    g_devices[i].sampled = false;
+
+    /* NATS virtual sensor fields */
+    if (nats_subject && nats_subject[0]) {
+        strncpy(g_devices[i].nats_subject, nats_subject, sizeof(g_devices[i].nats_subject) - 1);
+        g_devices[i].nats_subject[sizeof(g_devices[i].nats_subject) - 1] = '\0';
+    } else {
+        g_devices[i].nats_subject[0] = '\0';
+    }
+    g_devices[i].nats_value = 0.0f;
+    g_devices[i].nats_msg[0] = '\0';
+    g_devices[i].nats_sid = 0;
+    g_devices[i].baud = baud;
+    g_devices[i].uart = 0;
+
+    /* I2C fields */
+    g_devices[i].i2c_addr = i2c_addr;
+    g_devices[i].i2c_bus = deviceIsI2c(kind) ? i2c_bus : 0;
+    g_devices[i].i2c_reg_len = i2c_reg_len > 0 ? i2c_reg_len : 1;
+    g_devices[i].i2c_scale = (i2c_scale != 0.0f) ? i2c_scale : 1.0f;
+    g_devices[i].i2c_ttl_ms = i2c_ttl_ms;
+    if (disp_template && disp_template[0]) {
+        strncpy(g_devices[i].disp_template, disp_template, sizeof(g_devices[i].disp_template) - 1);
+        g_devices[i].disp_template[sizeof(g_devices[i].disp_template) - 1] = '\0';
+    } else {
+        g_devices[i].disp_template[0] = '\0';
+    }
 
-            /* Initialize serial_text UART */
-            if (kind == DEV_SENSOR_SERIAL_TEXT) {
-                serialTextInit(baud);
-            }
+    /* No event until configured (slot may have been reused) */
+    g_devices[i].ev_direction = EV_DIR_NONE;
+    g_devices[i].ev_threshold = 0.0f;
+    g_devices[i].ev_cooldown = 0;
+    g_devices[i].ev_hysteresis = 0.0f;
+    g_devices[i].ev_mode = EV_MODE_VALUE;
+    g_devices[i].ev_window = 10;
+    g_devices[i].ev_armed = false;
+    g_devices[i].ev_last_fire_ms = 0;
+    g_devices[i].debounce_ms = DEV_DEBOUNCE_DEFAULT;
+    g_devices[i].edge_publish = false;
+    g_registry_gen++;
+
+    /* Start line framing on the device's UART */
+    if (kind == DEV_SENSOR_SERIAL_TEXT) {
+        g_devices[i].uart = uart;
+        if (!serialTextOpen(uart, baud)) {
+            g_devices[i].used = false;
+            return false;
+        }
+    }
 
-            /* Initialize I2C bus for I2C devices */
-            if (deviceIsI2c(kind) && i2c_addr > 0) {
-                i2cInit();
-                /* Initialize OLED display (SSD1306 or SH1106) */
-                if (deviceIsDisplay(kind)) {
-                    uint8_t height = (pin == 1) ? 32 : 64;
-                    uint8_t col_offset = (kind == DEV_ACTUATOR_SH1106) ? 2 : 0;
-                    ssd1306Init(i2c_addr, height, col_offset);
-                }
-            }
+    /* Initialize I2C bus for I2C devices */
+    if (deviceIsI2c(kind) && i2c_addr > 0) {
+        i2cInit(i2c_bus);
+        deviceI2cTtlSync();
+        /* Initialize OLED display (SSD1306 or SH1106) */
+        if (deviceIsDisplay(kind)) {
+            uint8_t height = (pin == 1) ? 32 : 64;
+            uint8_t col_offset = (kind == DEV_ACTUATOR_SH1106) ? 2 : 0;
+            ssd1306Init(I2C_BUS_ADDR(i2c_bus, i2c_addr), height, col_offset);
+        }
+    }
 
-            /* Configure GPIO for DHT sensors */
-            if ((kind == DEV_SENSOR_DHT11_TEMP || kind == DEV_SENSOR_DHT11_HUMI ||
-                 kind == DEV_SENSOR_DHT22_TEMP || kind == DEV_SENSOR_DHT22_HUMI) &&
-                pin != PIN_NONE) {
-                pinMode(pin, INPUT_PULLUP);
-            }
+    /* Configure GPIO for DHT sensors */
+    if ((kind == DEV_SENSOR_DHT11_TEMP || kind == DEV_SENSOR_DHT11_HUMI ||
+         kind == DEV_SENSOR_DHT22_TEMP || kind == DEV_SENSOR_DHT22_HUMI) &&
+        pin != PIN_NONE) {
+        pinMode(pin, INPUT_PULLUP);
+    }
 
-            /* Configure GPIO for non-I2C actuators */
-            if (deviceIsActuator(kind) && !deviceIsI2c(kind) && pin != PIN_NONE) {
-                pinMode(pin, OUTPUT);
-            }
+    /* Digital inputs: interrupt edge capture */
+    if (kind == DEV_SENSOR_DIGITAL && pin != PIN_NONE) {
+        edgeAttach(i, pin);
+        edgeStateReset(i);
+    }
 
-            return true;
-        }
+    /* Pulse counters: count and rate devices share the pin's counter */
+    if (deviceIsPulse(kind) && pin != PIN_NONE && !pulseAttach(pin)) {
+        g_devices[i].used = false;
+        return false;
+    }
+
+    /* Configure GPIO for non-I2C actuators */
+    if (deviceIsActuator(kind) && !deviceIsI2c(kind) && pin != PIN_NONE) {
+        pinMode(pin, OUTPUT);
     }
-    return false; /* No free slot */
+
+    return true;
+}
+
+bool deviceRegister(const char *name, DeviceKind kind, uint8_t pin,
+                    const char *unit, bool inverted,
+                    const char *nats_subject, uint32_t baud,
+                    uint8_t i2c_addr, const char *disp_template,
+                    uint8_t i2c_reg_len, float i2c_scale,
+                    uint16_t i2c_ttl_ms, uint8_t i2c_bus, uint8_t uart) {
+    return deviceRegisterAt(deviceFreeSlot(), name, kind, pin, unit, inverted,
+                            nats_subject, baud, i2c_addr, disp_template,
+                            i2c_reg_len, i2c_scale, i2c_ttl_ms, i2c_bus, uart);
 }
 
 bool deviceRemove(const char *name) {
     Device *dev = deviceFind(name);
     if (!dev) return false;
-    if (dev->kind == DEV_SENSOR_SERIAL_TEXT) {
-        serialTextDeinit();
-    }
+    if (dev->kind == DEV_SENSOR_SERIAL_TEXT) serialTextClose(dev->uart);
+    if (dev->kind == DEV_SENSOR_DIGITAL) edgeDetach(dev - g_devices);
+    if (deviceIsPulse(dev->kind) && dev->pin != PIN_NONE) pulseDetach(dev->pin);
     if (deviceIsI2c(dev->kind) && dev->i2c_addr > 0) {
         if (deviceIsDisplay(dev->kind)) {
             uint8_t col_offset = (dev->kind == DEV_ACTUATOR_SH1106) ? 2 : 0;
-            ssd1306Deinit(dev->i2c_addr, col_offset);
+            ssd1306Deinit(deviceI2cAddr(dev), col_offset);
         }
-        i2cCacheInvalidate(dev->i2c_addr);
-        i2cDeinit();
+        i2cCacheInvalidate(deviceI2cAddr(dev));
+        i2cDeinit(dev->i2c_bus);
     }
+    bool was_i2c = deviceIsI2c(dev->kind);
     if (dev->kind == DEV_SENSOR_DHT11_TEMP || dev->kind == DEV_SENSOR_DHT11_HUMI ||
         dev->kind == DEV_SENSOR_DHT22_TEMP || dev->kind == DEV_SENSOR_DHT22_HUMI) {
         dhtCacheInvalidate(dev->pin);
     }
+    historyRelease(dev - g_devices);
+    eventsDeviceChanged(dev);
     dev->used = false;
     dev->name[0] = '\0';
+    g_registry_gen++;
+    if (was_i2c) deviceI2cTtlSync();
     return true;
 }
 
@@ -237,25 +445,154 @@ bool deviceRemove(const char *name) {
  * Sensor Reading
  *============================================================================*/
 
-/* NTC ADC warmup+read: settles ADC with warmup read, 300ms delay, then real read.
- * Stores result directly in dev->ema (used as cache, no smoothing).
- * ESP32 SAR ADC reads ~60mV high after >1s idle; needs ~287ms to settle. */
-static void ntcReadWithWarmup(Device *dev) {
-    /* Warmup burst — rapid 16-sample read to wake ADC */
-    for (int s = 0; s < 16; s++) analogReadMilliVolts(dev->pin);
-    delay(300);
-    /* Real read — ADC is settled after burst + 300ms pause */
-    int32_t sum = 0;
-    for (int s = 0; s < 16; s++) sum += analogReadMilliVolts(dev->pin);
-    float mV = sum / 16.0f;
-    if (mV <= 0 || mV >= 3300) { dev->ema = -999.0f; dev->ema_init = true; return; }
+/* Analog pins (raw, NTC, LDR) are streamed by the continuous ADC engine
+ * (adc_stream.cpp) and read as a filter lookup. Pins it cannot take fall
+ * back to the one-shot paths below. */
+
+static uint32_t g_adc_gen = (uint32_t)-1;
+
+static bool deviceIsAnalog(DeviceKind kind) {
+    return kind == DEV_SENSOR_ANALOG_RAW || kind == DEV_SENSOR_NTC_10K ||
+           kind == DEV_SENSOR_LDR;
+}
+
+/* Re-plan the stream when the registry changed */
+static void deviceAdcSync() {
+    if (g_adc_gen == g_registry_gen) return;
+    g_adc_gen = g_registry_gen;
+    uint8_t pins[MAX_DEVICES];
+    int n = 0;
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (g_devices[i].used && deviceIsAnalog(g_devices[i].kind))
+            pins[n++] = g_devices[i].pin;
+    }
+    adcStreamSetPins(pins, n);
+}
+
+static float deviceAnalogMilliVolts(Device *dev) {
+    float mV;
+    if (adcStreamMilliVolts(dev->pin, &mV)) return mV;
+    return adcOneshotMilliVolts(dev->pin, 16);
+}
+
+/* NTC fallback acquisition: warmup burst, 300ms settle, then 16-sample read.
+ * ESP32 SAR ADC reads ~60mV high after >1s idle; needs ~287ms to settle.
+ * Runs as a per-device state machine advanced by sensorsPoll(), so several
+ * NTCs settle in parallel and the loop never waits. The result is stored
+ * directly in dev->ema (used as cache, no smoothing). Streamed NTCs skip
+ * this: a continuously sampled ADC never goes idle. */
+
+#define NTC_SETTLE_MS  300
+
+enum NtcPhase : uint8_t { NTC_IDLE = 0, NTC_SETTLING };
+
+struct NtcAcq {
+    NtcPhase phase;
+    uint32_t due_ms;        /* settle deadline */
+};
+
+static NtcAcq g_ntc[MAX_DEVICES];
+
+static void ntcFromMilliVolts(Device *dev, float mV) {
+    dev->ema_init = true;
+    if (mV <= 0 || mV >= 3300) { dev->ema = -999.0f; return; }
     float ratio = mV / 3300.0f;
     float resistance = dev->inverted
         ? 10000.0f * (1.0f - ratio) / ratio
         : 10000.0f * ratio / (1.0f - ratio);
     float tempK = 1.0f / (1.0f / 298.15f + (1.0f / 3950.0f) * logf(resistance / 10000.0f));
     dev->ema = tempK - 273.15f;
-    dev->ema_init = true;
+}
+
+static void ntcConvert(Device *dev) {
+    /* Short discard burst: another NTC may have been sampled since warmup */
+    ntcFromMilliVolts(dev, adcOneshotMilliVolts(dev->pin, 16, 4));
+}
+
+/* Warmup burst (rapid 16-sample read to wake the ADC), then settle */
+static void ntcStart(Device *dev) {
+    NtcAcq *a = &g_ntc[dev - g_devices];
+    if (a->phase != NTC_IDLE) return;
+    float mV;
+    if (adcStreamMilliVolts(dev->pin, &mV)) return;
+    adcOneshotMilliVolts(dev->pin, 16);
+    a->phase = NTC_SETTLING;
+    a->due_ms = millis() + NTC_SETTLE_MS;
+    loopAt(a->due_ms);
+}
+
+/* Finish every acquisition whose settle deadline has passed */
+static void ntcAdvance(uint32_t now) {
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        NtcAcq *a = &g_ntc[i];
+        if (a->phase != NTC_SETTLING) continue;
+        if ((int32_t)(now - a->due_ms) < 0) {
+            loopAt(a->due_ms);
+            continue;
+        }
+        a->phase = NTC_IDLE;
+        if (g_devices[i].used && g_devices[i].kind == DEV_SENSOR_NTC_10K) {
+            ntcConvert(&g_devices[i]);
+            g_fresh_mask |= 1u << i;
+        }
+    }
+}
+
+/* Start every NTC acquisition and wait out the settle time. Only for a
+ * duty-cycle wake, which reads each sensor once and sleeps again; the
+ * loop itself never waits. */
+void sensorsSettle() {
+    uint32_t due = millis();
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (!g_devices[i].used || g_devices[i].kind != DEV_SENSOR_NTC_10K) continue;
+        ntcStart(&g_devices[i]);
+        if (g_ntc[i].phase == NTC_SETTLING && (int32_t)(g_ntc[i].due_ms - due) > 0)
+            due = g_ntc[i].due_ms;
+    }
+    int32_t left = (int32_t)(due - millis());
+    if (left > 0) delay(left);
+    ntcAdvance(millis());
+}
+
+/*============================================================================
+ * Computed sensors - expression compiled once per registry generation
+ *============================================================================*/
+
+static ExprProg g_expr[MAX_DEVICES];
+static uint8_t  g_expr_depth = 0;    /* computed-of-computed nesting guard */
+
+static int exprResolveSensor(const char *name, void *ctx) {
+    (void)ctx;
+    Device *d = deviceFind(name);
+    if (!d || !deviceIsSensor(d->kind)) return -1;
+    return d - g_devices;
+}
+
+static float exprLoadSensor(uint8_t slot, void *ctx) {
+    (void)ctx;
+    if (slot >= MAX_DEVICES || !g_devices[slot].used) return NAN;
+    return deviceReadSensor(&g_devices[slot]);
+}
+
+bool deviceExprCheck(const char *expr, char *err, size_t err_len) {
+    static ExprProg tmp;
+    return exprCompile(expr, exprResolveSensor, nullptr, &tmp, err, err_len);
+}
+
+static float computedRead(Device *dev) {
+    ExprProg *prog = &g_expr[dev - g_devices];
+    /* Slots baked into the bytecode are only valid for one registry layout */
+    if (prog->gen != g_registry_gen) {
+        char err[48];
+        if (!exprCompile(dev->disp_template, exprResolveSensor, nullptr, prog, err, sizeof(err)))
+            Serial.printf("Devices: %s: %s\n", dev->name, err);
+        prog->gen = g_registry_gen;
+    }
+    if (g_expr_depth >= 4) return NAN;   /* reference cycle */
+    g_expr_depth++;
+    float v = exprEval(prog, exprLoadSensor, nullptr);
+    g_expr_depth--;
+    return v;
 }
 
 float deviceReadSensor(Device *dev, bool record_hist) {
@@ -266,25 +603,30 @@ float deviceReadSensor(Device *dev, bool record_hist) {
 
     switch (dev->kind) {
         case DEV_SENSOR_DIGITAL:
-            pinMode(dev->pin, INPUT);
-            result = (float)digitalRead(dev->pin);
+            /* Debounced level tracked from the edge queue */
+            result = dev->pin != PIN_NONE ? (float)g_edge[dev - g_devices].level : 0.0f;
             break;
 
-        case DEV_SENSOR_ANALOG_RAW:
-            result = (float)analogRead(dev->pin);
+        case DEV_SENSOR_ANALOG_RAW: {
+            float raw;
+            result = adcStreamRaw(dev->pin, &raw) ? raw : (float)adcOneshotRaw(dev->pin);
             record_history = true;
             break;
+        }
 
-        case DEV_SENSOR_NTC_10K:
-            if (!dev->ema_init) ntcReadWithWarmup(dev);  /* first read before sensorsPoll */
-            result = dev->ema;
+        case DEV_SENSOR_NTC_10K: {
+            float mV;
+            if (adcStreamMilliVolts(dev->pin, &mV))
+                ntcFromMilliVolts(dev, mV);
+            else if (!dev->ema_init)
+                ntcStart(dev);          /* not ready until ntcAdvance() converts */
+            result = dev->ema_init ? dev->ema : NAN;
             record_history = true;
             break;
+        }
 
         case DEV_SENSOR_LDR: {
-            int32_t sum = 0;
-            for (int s = 0; s < 16; s++) sum += analogReadMilliVolts(dev->pin);
-            float mV = sum / 16.0f;
+            float mV = deviceAnalogMilliVolts(dev);
             float pct = mV * 100.0f / 3300.0f;
             result = dev->inverted ? (100.0f - pct) : pct;
             record_history = true;
@@ -326,33 +668,33 @@ float deviceReadSensor(Device *dev, bool record_hist) {
             break;
 
         case DEV_SENSOR_SERIAL_TEXT:
-            result = serialTextGetValue();
+            result = dev->nats_value;
             record_history = true;
             break;
 
         case DEV_SENSOR_I2C_GENERIC:
-            result = i2cGenericRead(dev->i2c_addr, dev->pin,
+            result = i2cGenericRead(deviceI2cAddr(dev), dev->pin,
                                     dev->i2c_reg_len, dev->i2c_scale);
             record_history = true;
             break;
 
         case DEV_SENSOR_I2C_BME280:
-            result = i2cBme280Read(dev->i2c_addr, dev->pin);
+            result = i2cBme280Read(deviceI2cAddr(dev), dev->pin);
             record_history = true;
             break;
 
         case DEV_SENSOR_I2C_BH1750:
-            result = i2cBh1750Read(dev->i2c_addr);
+            result = i2cBh1750Read(deviceI2cAddr(dev));
             record_history = true;
             break;
 
         case DEV_SENSOR_I2C_SHT31:
-            result = i2cSht31Read(dev->i2c_addr, dev->pin);
+            result = i2cSht31Read(deviceI2cAddr(dev), dev->pin);
             record_history = true;
             break;
 
         case DEV_SENSOR_I2C_ADS1115:
-            result = i2cAds1115Read(dev->i2c_addr, dev->pin);
+            result = i2cAds1115Read(deviceI2cAddr(dev), dev->pin);
             record_history = true;
             break;
 
@@ -376,10 +718,29 @@ float deviceReadSensor(Device *dev, bool record_hist) {
             record_history = true;
             break;
 
+        case DEV_SENSOR_PULSE_COUNT:
+        case DEV_SENSOR_PULSE_RATE: {
+            /* Scale converts pulses to units (e.g. 1/450 L per pulse) */
+            uint64_t count;
+            float hz;
+            if (dev->pin != PIN_NONE && pulseRead(dev->pin, &count, &hz))
+                result = (dev->kind == DEV_SENSOR_PULSE_COUNT ? (float)count : hz) * dev->i2c_scale;
+            record_history = true;
+            break;
+        }
+
+        case DEV_SENSOR_COMPUTED:
+            result = computedRead(dev);
+            record_history = true;
+            break;
+
         default:
             break;
     }
 
+    dev->sample = result;
+    dev->sampled = true;
+
     if (record_history && record_hist) {
         dev->history[dev->history_idx] = result;
         dev->history_idx = (dev->history_idx + 1) % DEV_HISTORY_LEN;
@@ -389,6 +750,12 @@ float deviceReadSensor(Device *dev, bool record_hist) {
     return result;
 }
 
+bool deviceLastSample(const Device *dev, float *value) {
+    if (!dev || !dev->used || !dev->sampled) return false;
+    *value = dev->sample;
+    return true;
+}
+
 /*============================================================================
  * Actuator Control
  *============================================================================*/
@@ -400,6 +767,7 @@ bool deviceSetActuator(Device *dev, int value) {
 
     int prev = dev->last_value;
     dev->last_value = value;
+    if (!deviceIsDisplay(dev->kind)) displayOnValue(dev - g_devices, (float)value);
 
     /* Debounced persist for relay/digital_out only */
     if ((dev->kind == DEV_ACTUATOR_RELAY || dev->kind == DEV_ACTUATOR_DIGITAL)
@@ -436,20 +804,20 @@ bool deviceSetActuator(Device *dev, int value) {
         case DEV_ACTUATOR_SSD1306:
             /* value=0 clears display, value=1 refreshes template */
             if (value == 0) {
-                ssd1306Clear(dev->i2c_addr);
+                ssd1306Clear(deviceI2cAddr(dev));
             } else if (dev->disp_template[0]) {
                 uint8_t height = (dev->pin == 1) ? 32 : 64;
-                ssd1306RenderTemplate(dev->i2c_addr, dev->disp_template, height);
+                ssd1306RenderTemplate(deviceI2cAddr(dev), dev->disp_template, height);
             }
             return true;
 
         case DEV_ACTUATOR_SH1106:
             /* value=0 clears display, value=1 refreshes template */
             if (value == 0) {
-                ssd1306Clear(dev->i2c_addr, 2);
+                ssd1306Clear(deviceI2cAddr(dev), 2);
             } else if (dev->disp_template[0]) {
                 uint8_t height = (dev->pin == 1) ? 32 : 64;
-                ssd1306RenderTemplate(dev->i2c_addr, dev->disp_template, height, 2);
+                ssd1306RenderTemplate(deviceI2cAddr(dev), dev->disp_template, height, 2);
             }
             return true;
 
@@ -471,10 +839,13 @@ void deviceSetNatsValue(Device *dev, float value, const char *msg) {
     } else {
         dev->nats_msg[0] = '\0';
     }
+    eventsOnSample(dev, value);
+    displayOnValue(dev - g_devices, value);
 }
 
 const char *deviceGetNatsMsg(const Device *dev) {
-    if (!dev || dev->kind != DEV_SENSOR_NATS_VALUE) return "";
+    if (!dev || (dev->kind != DEV_SENSOR_NATS_VALUE && dev->kind != DEV_SENSOR_SERIAL_TEXT))
+        return "";
     return dev->nats_msg;
 }
 
@@ -546,7 +917,192 @@ void parseNatsPayload(const uint8_t *data, size_t len,
 }
 
 /*============================================================================
- * JSON Persistence - /devices.json
+ * Binary Persistence - /devices.bin
+ *
+ * A header and one fixed-size record per registry slot. Each record has
+ * its own CRC32, so a torn write costs one device rather than the file,
+ * and a save writes only the records whose CRC differs from flash. Kinds
+ * are stored by name because enum values shift when kinds are added.
+ *============================================================================*/
+
+#define DEV_STORE_PATH     "/devices.bin"
+#define DEV_STORE_MAGIC    0x56444F49u   /* "IODV" */
+#define DEV_STORE_VERSION  1
+#define DEV_JSON_PATH      "/devices.json"
+#define DEV_JSON_MAX       4096
+#define DEV_JSON_ROOM      640           /* worst case for one exported device */
+
+struct DevStoreHdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t rec_size;
+    uint16_t slots;
+    uint16_t rsv;
+    uint32_t crc;               /* CRC32 over magic..rsv */
+};
+
+struct DevRecord {
+    uint32_t crc;               /* CRC32 over the rest; 0 and no name = free */
+    char     name[DEV_NAME_LEN];
+    char     kind[16];
+    char     unit[DEV_UNIT_LEN];
+    char     nats_subject[32];
+    char     disp_template[128];
+    uint32_t baud;
+    float    i2c_scale;
+    float    ev_threshold;
+    float    ev_hysteresis;
+    int32_t  value;             /* relay / digital_out state */
+    uint16_t i2c_ttl_ms;
+    uint16_t debounce_ms;
+    uint16_t ev_cooldown;
+    uint8_t  pin;
+    uint8_t  inverted;
+    uint8_t  uart;
+    uint8_t  i2c_addr;
+    uint8_t  i2c_bus;
+    uint8_t  i2c_reg_len;
+    uint8_t  edge_publish;
+    uint8_t  ev_direction;
+    uint8_t  ev_mode;
+    uint8_t  ev_window;
+};
+
+static_assert(sizeof(DevStoreHdr) == 16, "header layout is part of the file format");
+static_assert(sizeof(DevRecord) == 248, "record layout is part of the file format");
+
+static uint32_t g_rec_crc[MAX_DEVICES];     /* CRC of each slot on flash, 0 = free */
+static bool     g_store_ok = false;         /* file present with the current layout */
+static char     g_dev_json[DEV_JSON_MAX];   /* JSON import / export */
+
+static uint32_t devRecordCrc(const DevRecord *r) {
+    return esp_rom_crc32_le(0, (const uint8_t *)r + sizeof(r->crc),
+                            sizeof(*r) - sizeof(r->crc));
+}
+
+static uint32_t devStoreHdrCrc(const DevStoreHdr *h) {
+    return esp_rom_crc32_le(0, (const uint8_t *)h, offsetof(DevStoreHdr, crc));
+}
+
+/* Record for a registry slot (all zero if the slot is free) */
+static void devRecordFrom(const Device *d, DevRecord *r) {
+    memset(r, 0, sizeof(*r));
+    if (!d->used) return;
+    strncpy(r->name, d->name, sizeof(r->name) - 1);
+    strncpy(r->kind, deviceKindName(d->kind), sizeof(r->kind) - 1);
+    strncpy(r->unit, d->unit, sizeof(r->unit) - 1);
+    strncpy(r->nats_subject, d->nats_subject, sizeof(r->nats_subject) - 1);
+    strncpy(r->disp_template, d->disp_template, sizeof(r->disp_template) - 1);
+    r->baud          = d->baud;
+    r->i2c_scale     = d->i2c_scale;
+    r->ev_threshold  = d->ev_threshold;
+    r->ev_hysteresis = d->ev_hysteresis;
+    /* Persist last value for relay/digital_out (safe to restore on boot) */
+    if (d->kind == DEV_ACTUATOR_RELAY || d->kind == DEV_ACTUATOR_DIGITAL)
+        r->value = d->last_value;
+    r->i2c_ttl_ms    = d->i2c_ttl_ms;
+    r->debounce_ms   = d->debounce_ms;
+    r->ev_cooldown   = d->ev_cooldown;
+    r->pin           = d->pin;
+    r->inverted      = d->inverted;
+    r->uart          = d->uart;
+    r->i2c_addr      = d->i2c_addr;
+    r->i2c_bus       = d->i2c_bus;
+    r->i2c_reg_len   = d->i2c_reg_len;
+    r->edge_publish  = d->edge_publish;
+    r->ev_direction  = d->ev_direction;
+    r->ev_mode       = d->ev_mode;
+    r->ev_window     = d->ev_window;
+    r->crc = devRecordCrc(r);
+}
+
+/* Register the device a record describes into slot i and apply its
+   settings */
+static bool devRestore(int i, const DevRecord *r) {
+    DeviceKind kind = kindFromString(r->kind);
+    if (!deviceRegisterAt(i, r->name, kind, r->pin, r->unit, r->inverted,
+                          r->nats_subject[0] ? r->nats_subject : nullptr, r->baud,
+                          r->i2c_addr, r->disp_template[0] ? r->disp_template : nullptr,
+                          r->i2c_reg_len, r->i2c_scale, r->i2c_ttl_ms, r->i2c_bus, r->uart))
+        return false;
+    Device *d = &g_devices[i];
+
+    /* Digital input debounce / edge publishing */
+    if (kind == DEV_SENSOR_DIGITAL) {
+        d->debounce_ms = r->debounce_ms > DEV_DEBOUNCE_MAX ? DEV_DEBOUNCE_MAX : r->debounce_ms;
+        d->edge_publish = r->edge_publish != 0;
+    }
+
+    /* Restore persisted actuator value for relay/digital_out */
+    if ((kind == DEV_ACTUATOR_RELAY || kind == DEV_ACTUATOR_DIGITAL) && r->value != 0)
+        deviceSetActuator(d, r->value);
+
+    /* Event config */
+    if (r->ev_direction == EV_DIR_ABOVE || r->ev_direction == EV_DIR_BELOW) {
+        d->ev_direction = r->ev_direction;
+        d->ev_threshold = r->ev_threshold;
+        d->ev_cooldown = r->ev_cooldown;
+        d->ev_hysteresis = r->ev_hysteresis;
+        d->ev_mode = r->ev_mode <= EV_MODE_MAX ? r->ev_mode : EV_MODE_VALUE;
+        d->ev_window = (uint8_t)constrain(r->ev_window, 2, EV_WIN_MAX);
+        d->ev_armed = true;
+        d->ev_last_fire_ms = 0;
+    }
+    return true;
+}
+
+/* Write header and all slots (new file, other layout, or a failed update) */
+static bool devStoreRewrite() {
+    File f = LittleFS.open(DEV_STORE_PATH, "w");
+    if (!f) return false;
+    DevStoreHdr h = { DEV_STORE_MAGIC, DEV_STORE_VERSION, sizeof(DevRecord),
+                      MAX_DEVICES, 0, 0 };
+    h.crc = devStoreHdrCrc(&h);
+    bool ok = f.write((const uint8_t *)&h, sizeof(h)) == sizeof(h);
+    DevRecord r;
+    for (int i = 0; i < MAX_DEVICES && ok; i++) {
+        devRecordFrom(&g_devices[i], &r);
+        ok = f.write((const uint8_t *)&r, sizeof(r)) == sizeof(r);
+        g_rec_crc[i] = r.crc;
+    }
+    f.close();
+    return ok;
+}
+
+void devicesSave() {
+    int written = 0;
+    if (!g_store_ok) {
+        g_store_ok = devStoreRewrite();
+        written = MAX_DEVICES;
+        /* Migrated: the binary store is now the only copy */
+        if (g_store_ok && LittleFS.exists(DEV_JSON_PATH)) LittleFS.remove(DEV_JSON_PATH);
+    } else {
+        File f;
+        DevRecord r;
+        for (int i = 0; i < MAX_DEVICES; i++) {
+            devRecordFrom(&g_devices[i], &r);
+            if (r.crc == g_rec_crc[i]) continue;
+            if (!f) f = LittleFS.open(DEV_STORE_PATH, "r+");
+            if (!f || !f.seek(sizeof(DevStoreHdr) + i * sizeof(DevRecord)) ||
+                f.write((const uint8_t *)&r, sizeof(r)) != sizeof(r)) {
+                g_store_ok = false;     /* rewrite everything next time */
+                break;
+            }
+            g_rec_crc[i] = r.crc;
+            written++;
+        }
+        if (f) f.close();
+    }
+
+    if (g_debug) Serial.printf("Devices: %d of %d records written to %s%s\n",
+                               written, MAX_DEVICES, DEV_STORE_PATH,
+                               g_store_ok ? "" : " (failed)");
+
+    eventsRulesSave();
+}
+
+/*============================================================================
+ * JSON Import / Export - /api/devices/json, migration from /devices.json
  *============================================================================*/
 
 /* Simple JSON string extractor (matches pattern from main.cpp) */
@@ -603,35 +1159,139 @@ static bool devJsonGetBool(const char *json, const char *key, bool default_val)
     return default_val;
 }
 
-void devicesSave() {
-    static char buf[2048];
+/* Register every device in a JSON array. Returns the number registered;
+   objects that are malformed or do not register (pin or UART taken, name
+   in use, registry full) are counted in *skipped. */
+static int devicesParseJson(const char *json, int *skipped) {
+    const char *p = json;
+    int count = 0;
+    *skipped = 0;
+
+    while (*p && count < MAX_DEVICES) {
+        /* Find next object */
+        const char *obj = strchr(p, '{');
+        if (!obj) break;
+
+        /* Find closing '}', skipping over quoted strings so that
+           template tokens like {name} don't confuse the parser */
+        const char *obj_end = nullptr;
+        {
+            const char *q = obj + 1;
+            bool in_str = false;
+            while (*q) {
+                if (in_str) {
+                    if (*q == '\\' && q[1]) { q += 2; continue; }
+                    if (*q == '"') in_str = false;
+                } else {
+                    if (*q == '"') in_str = true;
+                    else if (*q == '}') { obj_end = q; break; }
+                }
+                q++;
+            }
+        }
+        if (!obj_end) break;
+
+        /* Extract into a temporary null-terminated substring */
+        int obj_len = obj_end - obj + 1;
+        static char objBuf[512];
+        p = obj_end + 1;
+        if (obj_len >= (int)sizeof(objBuf)) { (*skipped)++; continue; }
+        memcpy(objBuf, obj, obj_len);
+        objBuf[obj_len] = '\0';
+
+        DevRecord r;
+        memset(&r, 0, sizeof(r));
+        if (!devJsonGetString(objBuf, "n", r.name, sizeof(r.name)) ||
+            !devJsonGetString(objBuf, "k", r.kind, sizeof(r.kind))) {
+            (*skipped)++;
+            continue;
+        }
+
+        r.pin = (uint8_t)devJsonGetInt(objBuf, "p", PIN_NONE);
+        devJsonGetString(objBuf, "u", r.unit, sizeof(r.unit));
+        r.inverted = devJsonGetBool(objBuf, "i", false);
+        devJsonGetString(objBuf, "ns", r.nats_subject, sizeof(r.nats_subject));
+        r.baud = (uint32_t)devJsonGetInt(objBuf, "bd", 0);
+        r.uart = (uint8_t)devJsonGetInt(objBuf, "up", 1);
+
+        /* I2C fields */
+        r.i2c_addr = (uint8_t)devJsonGetInt(objBuf, "ia", 0);
+        r.i2c_bus = (uint8_t)devJsonGetInt(objBuf, "ib", 0);
+        devJsonGetString(objBuf, "dt", r.disp_template, sizeof(r.disp_template));
+        r.i2c_reg_len = (uint8_t)devJsonGetInt(objBuf, "rl", 1);
+        r.i2c_scale = devJsonGetFloat(objBuf, "sc", 1.0f);
+        r.i2c_ttl_ms = (uint16_t)devJsonGetInt(objBuf, "ct", DEV_I2C_TTL_DEFAULT);
+
+        /* Digital input debounce / edge publishing */
+        r.debounce_ms = (uint16_t)constrain(
+            devJsonGetInt(objBuf, "db", DEV_DEBOUNCE_DEFAULT), 0, DEV_DEBOUNCE_MAX);
+        r.edge_publish = devJsonGetBool(objBuf, "ep", false);
+
+        r.value = devJsonGetInt(objBuf, "v", 0);
+
+        /* Event config (flat keys: "et" float, "ed" string, "ec" int,
+           optional "eh" hysteresis, "em" mode, "ew" window) */
+        char ed_str[8] = "";
+        devJsonGetString(objBuf, "ed", ed_str, sizeof(ed_str));
+        if (strcmp(ed_str, "above") == 0) r.ev_direction = EV_DIR_ABOVE;
+        else if (strcmp(ed_str, "below") == 0) r.ev_direction = EV_DIR_BELOW;
+        if (r.ev_direction != EV_DIR_NONE) {
+            r.ev_threshold = devJsonGetFloat(objBuf, "et", 0.0f);
+            r.ev_cooldown = (uint16_t)devJsonGetInt(objBuf, "ec", 10);
+            r.ev_hysteresis = devJsonGetFloat(objBuf, "eh", 0.0f);
+            char em_str[8] = "";
+            devJsonGetString(objBuf, "em", em_str, sizeof(em_str));
+            r.ev_mode = eventsModeFromString(em_str);
+            r.ev_window = (uint8_t)constrain(devJsonGetInt(objBuf, "ew", 10), 2, EV_WIN_MAX);
+        }
+
+        if (devRestore(deviceFreeSlot(), &r)) {
+            count++;
+        } else {
+            Serial.printf("Devices: '%s' not imported\n", r.name);
+            (*skipped)++;
+        }
+    }
+    return count;
+}
+
+const char *devicesExportJson(int *len) {
+    char *buf = g_dev_json;
+    const int size = sizeof(g_dev_json);
     int w = 0;
 
-    w += snprintf(buf + w, sizeof(buf) - w, "[");
+    w += snprintf(buf + w, size - w, "[");
 
     bool first = true;
     for (int i = 0; i < MAX_DEVICES; i++) {
         if (!g_devices[i].used) continue;
         const Device *d = &g_devices[i];
 
-        if (!first) w += snprintf(buf + w, sizeof(buf) - w, ",");
+        /* Refuse rather than truncate */
+        if (size - w < DEV_JSON_ROOM) return nullptr;
+
+        if (!first) w += snprintf(buf + w, size - w, ",");
         first = false;
 
-        w += snprintf(buf + w, sizeof(buf) - w,
+        w += snprintf(buf + w, size - w,
             "{\"n\":\"%s\",\"k\":\"%s\",\"p\":%d,\"u\":\"%s\",\"i\":%s",
             d->name, deviceKindName(d->kind), d->pin,
             d->unit, d->inverted ? "true" : "false");
         if (d->nats_subject[0]) {
-            w += snprintf(buf + w, sizeof(buf) - w,
+            w += snprintf(buf + w, size - w,
                 ",\"ns\":\"%s\"", d->nats_subject);
         }
         if (d->baud > 0) {
-            w += snprintf(buf + w, sizeof(buf) - w,
+            w += snprintf(buf + w, size - w,
                 ",\"bd\":%u", (unsigned)d->baud);
         }
+        if (d->kind == DEV_SENSOR_SERIAL_TEXT && d->uart != 1)
+            w += snprintf(buf + w, size - w, ",\"up\":%d", d->uart);
         if (d->i2c_addr > 0) {
-            w += snprintf(buf + w, sizeof(buf) - w,
+            w += snprintf(buf + w, size - w,
                 ",\"ia\":%d", d->i2c_addr);
+            if (d->i2c_bus > 0)
+                w += snprintf(buf + w, size - w, ",\"ib\":%d", d->i2c_bus);
         }
         if (d->disp_template[0]) {
             /* JSON-escape the template (may contain quotes, backslashes) */
@@ -648,177 +1308,155 @@ void devicesSave() {
                 }
             }
             esc_tmpl[ew] = '\0';
-            w += snprintf(buf + w, sizeof(buf) - w,
+            w += snprintf(buf + w, size - w,
                 ",\"dt\":\"%s\"", esc_tmpl);
         }
         if (d->kind == DEV_SENSOR_I2C_GENERIC) {
-            w += snprintf(buf + w, sizeof(buf) - w,
+            w += snprintf(buf + w, size - w,
                 ",\"rl\":%d", d->i2c_reg_len);
-            if (d->i2c_scale != 1.0f) {
-                w += snprintf(buf + w, sizeof(buf) - w,
-                    ",\"sc\":%.6g", d->i2c_scale);
-            }
         }
-        /* Persist last value for relay/digital_out (safe to restore on boot) */
+        if ((d->kind == DEV_SENSOR_I2C_GENERIC || deviceIsPulse(d->kind)) &&
+            d->i2c_scale != 1.0f) {
+            w += snprintf(buf + w, size - w,
+                ",\"sc\":%.6g", d->i2c_scale);
+        }
+        if (deviceIsI2c(d->kind) && !deviceIsDisplay(d->kind) &&
+            d->i2c_ttl_ms != DEV_I2C_TTL_DEFAULT) {
+            w += snprintf(buf + w, size - w,
+                ",\"ct\":%u", d->i2c_ttl_ms);
+        }
+        if (d->kind == DEV_SENSOR_DIGITAL) {
+            if (d->debounce_ms != DEV_DEBOUNCE_DEFAULT)
+                w += snprintf(buf + w, size - w, ",\"db\":%u", d->debounce_ms);
+            if (d->edge_publish)
+                w += snprintf(buf + w, size - w, ",\"ep\":true");
+        }
         if ((d->kind == DEV_ACTUATOR_RELAY || d->kind == DEV_ACTUATOR_DIGITAL)
             && d->last_value != 0) {
-            w += snprintf(buf + w, sizeof(buf) - w,
+            w += snprintf(buf + w, size - w,
                 ",\"v\":%d", d->last_value);
         }
-        /* Persist event config as flat keys (no nesting to avoid parser issues) */
+        /* Event config as flat keys (no nesting to avoid parser issues) */
         if (d->ev_direction != EV_DIR_NONE) {
             const char *dir = d->ev_direction == EV_DIR_ABOVE ? "above" : "below";
-            w += snprintf(buf + w, sizeof(buf) - w,
-                ",\"et\":%.1f,\"ed\":\"%s\",\"ec\":%d",
+            w += snprintf(buf + w, size - w,
+                ",\"et\":%.6g,\"ed\":\"%s\",\"ec\":%d",
                 d->ev_threshold, dir, d->ev_cooldown);
+            if (d->ev_hysteresis != 0.0f)
+                w += snprintf(buf + w, size - w,
+                    ",\"eh\":%.6g", d->ev_hysteresis);
+            if (d->ev_mode != EV_MODE_VALUE)
+                w += snprintf(buf + w, size - w,
+                    ",\"em\":\"%s\",\"ew\":%d",
+                    eventsModeName(d->ev_mode), d->ev_window);
         }
-        w += snprintf(buf + w, sizeof(buf) - w, "}");
-
-        if (w >= (int)sizeof(buf) - 1) break;
+        w += snprintf(buf + w, size - w, "}");
     }
 
-    w += snprintf(buf + w, sizeof(buf) - w, "]");
+    w += snprintf(buf + w, size - w, "]");
+    if (len) *len = w;
+    return buf;
+}
 
-    File f = LittleFS.open("/devices.json", "w");
-    if (f) {
-        f.print(buf);
+/* First boot with an older build's /devices.json (or a fresh LittleFS
+   image): register its devices; the next save writes the binary store */
+static void devicesImportFile() {
+    File f = LittleFS.open(DEV_JSON_PATH, "r");
+    if (!f) return;
+    if (f.size() >= sizeof(g_dev_json)) {
         f.close();
+        Serial.printf("Devices: %s too large to import\n", DEV_JSON_PATH);
+        return;
     }
+    int len = f.readBytes(g_dev_json, sizeof(g_dev_json) - 1);
+    g_dev_json[len] = '\0';
+    f.close();
 
-    if (g_debug) Serial.printf("Devices: saved to /devices.json (%d bytes)\n", w);
+    int skipped;
+    int count = devicesParseJson(g_dev_json, &skipped);
+    if (skipped)
+        Serial.printf("Devices: imported %d from %s, %d skipped\n", count, DEV_JSON_PATH, skipped);
+    else
+        Serial.printf("Devices: imported %d from %s\n", count, DEV_JSON_PATH);
+    devicesMarkDirty();
 }
 
 static void devicesLoad() {
-    static char buf[2048];
-    File f = LittleFS.open("/devices.json", "r");
-    if (!f) return;
-
-    int len = f.readBytes(buf, sizeof(buf) - 1);
-    buf[len] = '\0';
-    f.close();
-
-    if (len <= 2) return;
+    memset(g_rec_crc, 0, sizeof(g_rec_crc));
+    g_store_ok = false;
 
-    /* Parse array of device objects */
-    const char *p = buf;
-    int count = 0;
-
-    while (*p && count < MAX_DEVICES) {
-        /* Find next object */
-        const char *obj = strchr(p, '{');
-        if (!obj) break;
-
-        /* Find closing '}', skipping over quoted strings so that
-           template tokens like {name} don't confuse the parser */
-        const char *obj_end = nullptr;
-        {
-            const char *q = obj + 1;
-            bool in_str = false;
-            while (*q) {
-                if (in_str) {
-                    if (*q == '\\' && q[1]) { q += 2; continue; }
-                    if (*q == '"') in_str = false;
-                } else {
-                    if (*q == '"') in_str = true;
-                    else if (*q == '}') { obj_end = q; break; }
-                }
-                q++;
-            }
-        }
-        if (!obj_end) break;
-
-        /* Extract into a temporary null-terminated substring */
-        int obj_len = obj_end - obj + 1;
-        static char objBuf[256];
-        if (obj_len >= (int)sizeof(objBuf)) { p = obj_end + 1; continue; }
-        memcpy(objBuf, obj, obj_len);
-        objBuf[obj_len] = '\0';
-
-        char name[DEV_NAME_LEN];
-        char kind_str[24];
-        char unit[DEV_UNIT_LEN];
-
-        if (!devJsonGetString(objBuf, "n", name, sizeof(name))) { p = obj_end + 1; continue; }
-        if (!devJsonGetString(objBuf, "k", kind_str, sizeof(kind_str))) { p = obj_end + 1; continue; }
-
-        int pin = devJsonGetInt(objBuf, "p", PIN_NONE);
-        devJsonGetString(objBuf, "u", unit, sizeof(unit));
-        bool inverted = devJsonGetBool(objBuf, "i", false);
-
-        char nats_subj[32] = "";
-        devJsonGetString(objBuf, "ns", nats_subj, sizeof(nats_subj));
-        uint32_t baud = (uint32_t)devJsonGetInt(objBuf, "bd", 0);
-
-        /* I2C fields */
-        uint8_t i2c_addr = (uint8_t)devJsonGetInt(objBuf, "ia", 0);
-        char disp_tmpl[128] = "";
-        devJsonGetString(objBuf, "dt", disp_tmpl, sizeof(disp_tmpl));
-        uint8_t i2c_reg_len = (uint8_t)devJsonGetInt(objBuf, "rl", 1);
-        float i2c_scale = devJsonGetFloat(objBuf, "sc", 1.0f);
-
-        DeviceKind kind = kindFromString(kind_str);
-        deviceRegister(name, kind, (uint8_t)pin, unit, inverted,
-                       nats_subj[0] ? nats_subj : nullptr, baud,
-                       i2c_addr, disp_tmpl[0] ? disp_tmpl : nullptr,
-                       i2c_reg_len, i2c_scale);
-
-        /* Restore persisted actuator value for relay/digital_out */
-        if (kind == DEV_ACTUATOR_RELAY || kind == DEV_ACTUATOR_DIGITAL) {
-            int saved_val = devJsonGetInt(objBuf, "v", 0);
-            if (saved_val != 0) {
-                Device *d = deviceFind(name);
-                if (d) deviceSetActuator(d, saved_val);
-            }
-        }
+    File f = LittleFS.open(DEV_STORE_PATH, "r");
+    if (!f) {
+        devicesImportFile();
+        return;
+    }
 
-        /* Load event config (flat keys: "et" float, "ed" string, "ec" int) */
-        {
-            char ed_str[8] = "";
-            devJsonGetString(objBuf, "ed", ed_str, sizeof(ed_str));
-            if (ed_str[0]) {
-                Device *d = deviceFind(name);
-                if (d) {
-                    if (strcmp(ed_str, "above") == 0) d->ev_direction = EV_DIR_ABOVE;
-                    else if (strcmp(ed_str, "below") == 0) d->ev_direction = EV_DIR_BELOW;
-                    if (d->ev_direction != EV_DIR_NONE) {
-                        d->ev_threshold = devJsonGetFloat(objBuf, "et", 0.0f);
-                        d->ev_cooldown = (uint16_t)devJsonGetInt(objBuf, "ec", 10);
-                        d->ev_armed = true;
-                        d->ev_last_fire_ms = 0;
-                    }
-                }
-            }
-        }
+    DevStoreHdr h;
+    if (f.read((uint8_t *)&h, sizeof(h)) != sizeof(h) ||
+        h.magic != DEV_STORE_MAGIC || h.crc != devStoreHdrCrc(&h) ||
+        h.version != DEV_STORE_VERSION || h.rec_size != sizeof(DevRecord) ||
+        h.slots != MAX_DEVICES) {
+        f.close();
+        Serial.printf("Devices: %s has an unknown layout, ignored\n", DEV_STORE_PATH);
+        devicesImportFile();
+        return;
+    }
 
+    /* Each record goes back into its own slot. A record that does not
+       restore (pin or UART taken) leaves the slot free and stays on flash
+       until the slot is reused, so it is retried at the next boot. */
+    int count = 0, bad = 0, failed = 0;
+    bool complete = true;
+    DevRecord r;
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (f.read((uint8_t *)&r, sizeof(r)) != sizeof(r)) { complete = false; break; }
+        if (r.crc == 0 && r.name[0] == '\0') continue;
+        if (r.crc != devRecordCrc(&r)) { bad++; continue; }
+        if (!devRestore(i, &r)) { failed++; continue; }
+        g_rec_crc[i] = r.crc;
         count++;
-
-        p = obj_end + 1;
     }
+    f.close();
+
+    /* Damaged file: rewrite it whole on the next save */
+    g_store_ok = complete && bad == 0;
+    if (!g_store_ok) devicesMarkDirty();
 
-    Serial.printf("Devices: loaded %d from /devices.json\n", count);
+    Serial.printf("Devices: loaded %d from %s", count, DEV_STORE_PATH);
+    if (bad) Serial.printf(" (%d bad records skipped)", bad);
+    if (failed) Serial.printf(" (%d not restored)", failed);
+    Serial.printf("\n");
 }
 
 void devicesClear() {
-    /* Deinit serial_text if active */
-    if (serialTextActive()) serialTextDeinit();
-    /* Deinit OLED displays and I2C bus */
+    /* Stop serial_text UARTs, deinit OLED displays and I2C bus, release
+       edge interrupts and pulse counters */
     for (int i = 0; i < MAX_DEVICES; i++) {
+        if (g_devices[i].used && g_devices[i].kind == DEV_SENSOR_SERIAL_TEXT)
+            serialTextClose(g_devices[i].uart);
+        if (g_devices[i].used && g_devices[i].kind == DEV_SENSOR_DIGITAL)
+            edgeDetach(i);
+        if (g_devices[i].used && deviceIsPulse(g_devices[i].kind) && g_devices[i].pin != PIN_NONE)
+            pulseDetach(g_devices[i].pin);
         if (g_devices[i].used && deviceIsI2c(g_devices[i].kind) && g_devices[i].i2c_addr > 0) {
             if (deviceIsDisplay(g_devices[i].kind)) {
                 uint8_t col_offset = (g_devices[i].kind == DEV_ACTUATOR_SH1106) ? 2 : 0;
-                ssd1306Deinit(g_devices[i].i2c_addr, col_offset);
+                ssd1306Deinit(deviceI2cAddr(&g_devices[i]), col_offset);
             }
-            i2cDeinit();
+            i2cDeinit(g_devices[i].i2c_bus);
         }
     }
+    for (int i = 0; i < MAX_DEVICES; i++)
+        if (g_devices[i].used) eventsDeviceChanged(&g_devices[i]);
     memset(g_devices, 0, sizeof(g_devices));
+    i2cCacheTtlReset();
+    historyReset();
+    g_history_restored = false;
+    g_registry_gen++;
 }
 
-void devicesReload() {
-    devicesClear();
-    devicesLoad();
-
-    /* Re-register builtins if missing */
+/* Auto-register built-in virtual sensors if not already present */
+static bool devicesAddBuiltins() {
     bool changed = false;
     if (!deviceFind("chip_temp")) {
         deviceRegister("chip_temp", DEV_SENSOR_INTERNAL_TEMP, PIN_NONE, "C", false);
@@ -842,7 +1480,15 @@ void devicesReload() {
         changed = true;
     }
 #endif
-    if (changed) devicesSave();
+    return changed;
+}
+
+void devicesReload() {
+    devicesClear();
+    devicesLoad();
+    eventsRulesLoad();
+
+    if (devicesAddBuiltins()) devicesSave();
 
     int count = 0;
     for (int i = 0; i < MAX_DEVICES; i++)
@@ -850,253 +1496,236 @@ void devicesReload() {
     Serial.printf("Devices: reloaded (%d registered)\n", count);
 }
 
+int devicesImportJson(const char *json, int *skipped) {
+    int dummy;
+    devicesClear();
+    int count = devicesParseJson(json, skipped ? skipped : &dummy);
+    eventsRulesLoad();
+    devicesAddBuiltins();
+    devicesSave();
+    return count;
+}
+
 /*============================================================================
- * Serial Text UART (one device max, UART1 on fixed pins)
+ * Serial Text Devices (one per UART, framing in serial_text.cpp)
  *============================================================================*/
 
-static HardwareSerial SerialText(1);
-static bool  g_serial_text_active = false;
-static float g_serial_text_value  = 0.0f;
-static char  g_serial_text_msg[64];
-static char  g_serial_text_buf[128];
-static int   g_serial_text_pos = 0;
-
-void serialTextInit(uint32_t baud) {
-    if (g_serial_text_active) return;
-    if (baud == 0) baud = 9600;
-    SerialText.begin(baud, SERIAL_8N1, SERIAL_TEXT_RX, SERIAL_TEXT_TX);
-    g_serial_text_active = true;
-    g_serial_text_pos = 0;
-    g_serial_text_msg[0] = '\0';
-    g_serial_text_value = 0.0f;
-    Serial.printf("SerialText: UART1 at %u baud (RX=%d TX=%d)\n",
-                  baud, SERIAL_TEXT_RX, SERIAL_TEXT_TX);
-}
-
-void serialTextDeinit() {
-    if (!g_serial_text_active) return;
-    SerialText.end();
-    g_serial_text_active = false;
-    g_serial_text_pos = 0;
-    g_serial_text_msg[0] = '\0';
-    g_serial_text_value = 0.0f;
-    Serial.println("SerialText: stopped");
+Device *deviceSerialText(uint8_t uart) {
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (g_devices[i].used && g_devices[i].kind == DEV_SENSOR_SERIAL_TEXT &&
+            (uart == 0 || g_devices[i].uart == uart))
+            return &g_devices[i];
+    }
+    return nullptr;
 }
 
 void serialTextPoll() {
-    if (!g_serial_text_active) return;
+    static char line[SERIAL_TEXT_LINE_MAX];
+    static char subject[96];
 
-    while (SerialText.available()) {
-        char c = SerialText.read();
-
-        if (c == '\n') {
-            if (g_serial_text_pos == 0) continue;
-            g_serial_text_buf[g_serial_text_pos] = '\0';
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        Device *d = &g_devices[i];
+        if (!d->used || d->kind != DEV_SENSOR_SERIAL_TEXT) continue;
 
+        while (serialTextReadLine(d->uart, line, sizeof(line))) {
             /* Parse value + message using same logic as NATS */
-            parseNatsPayload((const uint8_t *)g_serial_text_buf,
-                             g_serial_text_pos,
-                             &g_serial_text_value,
-                             g_serial_text_msg, sizeof(g_serial_text_msg));
+            int len = strlen(line);
+            parseNatsPayload((const uint8_t *)line, len, &d->nats_value,
+                             d->nats_msg, sizeof(d->nats_msg));
 
             /* If msg empty, store raw line as msg */
-            if (g_serial_text_msg[0] == '\0') {
-                strncpy(g_serial_text_msg, g_serial_text_buf,
-                        sizeof(g_serial_text_msg) - 1);
-                g_serial_text_msg[sizeof(g_serial_text_msg) - 1] = '\0';
+            if (d->nats_msg[0] == '\0') {
+                strncpy(d->nats_msg, line, sizeof(d->nats_msg) - 1);
+                d->nats_msg[sizeof(d->nats_msg) - 1] = '\0';
             }
 
             if (g_debug) {
-                Serial.printf("[SerialText] '%s' -> val=%.1f msg='%s'\n",
-                              g_serial_text_buf, g_serial_text_value,
-                              g_serial_text_msg);
+                Serial.printf("[SerialText] %s: '%s' -> val=%.1f msg='%s'\n",
+                              d->name, line, d->nats_value, d->nats_msg);
             }
-            g_serial_text_pos = 0;
-            continue;
-        }
-
-        if (c == '\r') continue;
 
-        if (g_serial_text_pos < (int)sizeof(g_serial_text_buf) - 1) {
-            g_serial_text_buf[g_serial_text_pos++] = c;
+            /* Every line goes out as it arrives */
+            if (g_nats_connected) {
+                snprintf(subject, sizeof(subject), "%s.serial.%s", cfg_device_name, d->name);
+                natsClient.publish(subject, line);
+            }
+            eventsOnSample(d, d->nats_value);
+            displayOnValue(i, d->nats_value);
         }
     }
 }
 
-bool serialTextSend(const char *text) {
-    if (!g_serial_text_active || !text) return false;
-    SerialText.print(text);
-    /* Append newline if not already present */
-    size_t len = strlen(text);
-    if (len == 0 || text[len - 1] != '\n') {
-        SerialText.print('\n');
+bool rgbLedOverride() {
+    Device *dev = deviceFind("rgb_led");
+    return dev && dev->last_value != 0;
+}
+
+/*============================================================================
+ * Background sensor polling - EMA warmup (10s) + history store and event
+ * samples (1s) + sparkline (5min)
+ *============================================================================*/
+
+/* Sensors whose readings go into the history store */
+static bool deviceHasHistory(DeviceKind kind) {
+    switch (kind) {
+        case DEV_SENSOR_DIGITAL:
+        case DEV_SENSOR_CLOCK_HOUR:
+        case DEV_SENSOR_CLOCK_MINUTE:
+        case DEV_SENSOR_CLOCK_HHMM:
+            return false;
+        default:
+            return deviceIsSensor(kind);
     }
-    return true;
 }
 
-const char *serialTextGetMsg() {
-    return g_serial_text_msg;
+/* Sensors that are expensive or slow to read (ADC settle, DHT capture, I2C
+ * conversion wait, computed sensors reading those) are sampled on the 5s cadence; the
+ * raw tier holds their last value in between. */
+static bool deviceIsSlowSensor(DeviceKind kind) {
+    return kind == DEV_SENSOR_NTC_10K || kind == DEV_SENSOR_COMPUTED ||
+           kind == DEV_SENSOR_DHT11_TEMP || kind == DEV_SENSOR_DHT11_HUMI ||
+           kind == DEV_SENSOR_DHT22_TEMP || kind == DEV_SENSOR_DHT22_HUMI ||
+           deviceIsI2c(kind);
 }
 
-float serialTextGetValue() {
-    return g_serial_text_value;
+/* Sensors whose value comes from a background conversion (NTC settle, DHT
+ * capture, queued I2C): events see each result when the conversion
+ * completes, not on the sample cadence. */
+static bool deviceIsConverted(DeviceKind kind) {
+    return kind == DEV_SENSOR_NTC_10K ||
+           kind == DEV_SENSOR_DHT11_TEMP || kind == DEV_SENSOR_DHT11_HUMI ||
+           kind == DEV_SENSOR_DHT22_TEMP || kind == DEV_SENSOR_DHT22_HUMI ||
+           kind == DEV_SENSOR_I2C_BME280 || kind == DEV_SENSOR_I2C_SHT31 ||
+           kind == DEV_SENSOR_I2C_ADS1115;
 }
 
-bool serialTextActive() {
-    return g_serial_text_active;
+static bool deviceIsDht(DeviceKind kind) {
+    return kind == DEV_SENSOR_DHT11_TEMP || kind == DEV_SENSOR_DHT11_HUMI ||
+           kind == DEV_SENSOR_DHT22_TEMP || kind == DEV_SENSOR_DHT22_HUMI;
 }
 
-bool rgbLedOverride() {
-    Device *dev = deviceFind("rgb_led");
-    return dev && dev->last_value != 0;
+static void onDhtResult(uint8_t pin) {
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (g_devices[i].used && deviceIsDht(g_devices[i].kind) &&
+            g_devices[i].pin == pin)
+            g_fresh_mask |= 1u << i;
+    }
 }
 
-/*============================================================================
- * Background sensor polling - EMA warmup (10s) + history recording (5min)
- *============================================================================*/
+static void onI2cResult(uint8_t addr, uint8_t chan) {
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        Device *d = &g_devices[i];
+        if (!d->used || !deviceIsConverted(d->kind) || !deviceIsI2c(d->kind)) continue;
+        if (deviceI2cAddr(d) != addr) continue;
+        if (chan != 0xFF && d->pin != chan) continue;
+        g_fresh_mask |= 1u << i;
+    }
+}
+
+/* Feed completed conversions to events in the pass they finish in; the
+ * read is a cache hit */
+static void sensorsFeedFresh() {
+    uint32_t fresh = g_fresh_mask;
+    g_fresh_mask = 0;
+    for (int i = 0; fresh && i < MAX_DEVICES; i++, fresh >>= 1) {
+        if (!(fresh & 1)) continue;
+        Device *d = &g_devices[i];
+        if (d->used && eventsWatching(d)) eventsOnSample(d, deviceReadSensor(d));
+    }
+}
 
 void sensorsPoll() {
-    static uint32_t last_ntc  = 0;
-    static uint32_t last_hist = 0;
+    static bool     started     = false;
+    static uint32_t last_ntc    = 0;
+    static uint32_t last_sample = 0;
+    static uint32_t last_hist   = 0;
     uint32_t now = millis();
 
-    bool do_ntc  = (now - last_ntc  >= 5000);    /* every 5 seconds */
-    bool do_hist = (now - last_hist >= 300000);   /* every 5 minutes */
-
-    if (!do_ntc && !do_hist) return;
-    if (do_ntc)  last_ntc  = now;
-    if (do_hist) last_hist = now;
+    /* First pass starts the slow acquisitions right away, not after 5s */
+    bool do_ntc    = !started || (now - last_ntc >= 5000);    /* every 5 seconds */
+    bool do_sample = (now - last_sample >= 1000);    /* every second */
+    bool do_hist   = (now - last_hist   >= 300000);  /* every 5 minutes */
+
+    edgesPoll();
+    pulsePoll();
+    deviceAdcSync();
+    adcStreamPoll();
+    ntcAdvance(now);
+    dhtPoll();
+    i2cPoll();
+    sensorsFeedFresh();
+
+    started = true;
+    if (do_ntc)    last_ntc    = now;
+    if (do_sample) last_sample = now;
+    if (do_hist)   last_hist   = now;
+    loopAt(last_sample + 1000);
+    loopAt(last_ntc + 5000);
+    loopAt(last_hist + 300000);
+    if (!do_ntc && !do_sample && !do_hist) return;
+
+    /* Log timestamps are unix time: replay once the clock is synced */
+    if (!g_history_restored && historyClockSynced()) {
+        g_history_restored = true;
+        int restored = 0;
+        for (int i = 0; i < MAX_DEVICES; i++) {
+            if (g_devices[i].used && deviceHasHistory(g_devices[i].kind))
+                restored += historyRestore(i, g_devices[i].name);
+        }
+        if (g_debug && restored > 0)
+            Serial.printf("[History] restored %d minutes from flash\n", restored);
+    }
 
     for (int i = 0; i < MAX_DEVICES; i++) {
         Device *d = &g_devices[i];
         if (!d->used || !deviceIsSensor(d->kind)) continue;
 
+        /* NTC: kick off warmup; ntcAdvance() reads it 300ms later. The
+           samples below use the previous acquisition (<= 5.3s old). */
         if (d->kind == DEV_SENSOR_NTC_10K && do_ntc)
-            ntcReadWithWarmup(d);           /* warmup + delay + read → cached */
+            ntcStart(d);
 
         /* Refresh DHT cache every 5s (only on _temp variants to avoid double-reads) */
         if (do_ntc && (d->kind == DEV_SENSOR_DHT11_TEMP || d->kind == DEV_SENSOR_DHT22_TEMP))
             deviceReadSensor(d);
 
-        if (do_hist)
-            deviceReadSensor(d, true);      /* all sensors: record history every 5min */
+        /* One read feeds history and events; push sensors (NATS value,
+           serial text) feed events themselves when a value arrives, and
+           converted sensors from sensorsFeedFresh(). A watched DHT/I2C
+           sensor is read every second anyway: the read requests the next
+           conversion once the cache TTL has passed. */
+        bool sample   = do_sample && (do_ntc || !deviceIsSlowSensor(d->kind));
+        bool watching = d->kind != DEV_SENSOR_NATS_VALUE &&
+                        d->kind != DEV_SENSOR_SERIAL_TEXT && eventsWatching(d);
+        bool converted = deviceIsConverted(d->kind);
+        bool record   = sample && deviceHasHistory(d->kind);
+        bool watch    = sample && watching && !converted;
+        bool request  = do_sample && watching && converted &&
+                        d->kind != DEV_SENSOR_NTC_10K;
+        bool shown    = sample && displayShows(i);
+        if (!record && !watch && !request && !shown && !do_hist) continue;
+
+        /* all sensors: sparkline every 5min */
+        float val = deviceReadSensor(d, do_hist);
+        if (record) historyRecord(i, d->name, val);
+        if (watch)  eventsOnSample(d, val);
+        if (shown)  displayOnValue(i, val);
     }
 }
 
-/*============================================================================
- * Events — threshold crossing detection + NATS publish
- *============================================================================*/
-
-extern NatsClient natsClient;
-extern char cfg_device_name[32];
-extern uint32_t g_events_fired;
-extern bool g_nats_connected;
-
-static char g_ev_json[256];
-static char g_ev_subject[64];
-
-void eventsCheck() {
-    uint32_t now = millis();
-
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        Device *d = &g_devices[i];
-        if (!d->used || d->ev_direction == EV_DIR_NONE) continue;
-        if (!deviceIsSensor(d->kind)) continue;
-
-        /* Cooldown check */
-        if (d->ev_last_fire_ms != 0 &&
-            (now - d->ev_last_fire_ms) < (uint32_t)d->ev_cooldown * 1000) {
-            continue;
-        }
-
-        float val = deviceReadSensor(d);
-        bool threshold_crossed = false;
-
-        if (d->ev_direction == EV_DIR_ABOVE) {
-            if (val > d->ev_threshold) {
-                if (d->ev_armed) threshold_crossed = true;
-            } else {
-                /* Re-arm when value returns below threshold */
-                d->ev_armed = true;
-            }
-        } else if (d->ev_direction == EV_DIR_BELOW) {
-            if (val < d->ev_threshold) {
-                if (d->ev_armed) threshold_crossed = true;
-            } else {
-                /* Re-arm when value returns above threshold */
-                d->ev_armed = true;
-            }
-        }
-
-        if (threshold_crossed) {
-            d->ev_armed = false;
-            d->ev_last_fire_ms = now;
-            g_events_fired++;
-
-            /* Publish event */
-            if (g_nats_connected) {
-                const char *dir = d->ev_direction == EV_DIR_ABOVE ? "above" : "below";
-                snprintf(g_ev_json, sizeof(g_ev_json),
-                    "{\"event\":\"threshold\",\"device\":\"%s\",\"sensor\":\"%s\","
-                    "\"value\":%.1f,\"threshold\":%.1f,\"direction\":\"%s\","
-                    "\"unit\":\"%s\"}",
-                    cfg_device_name, d->name, val, d->ev_threshold, dir, d->unit);
-
-                snprintf(g_ev_subject, sizeof(g_ev_subject),
-                    "%s.events.%s", cfg_device_name, d->name);
-                natsClient.publish(g_ev_subject, g_ev_json);
-
-                if (g_debug)
-                    Serial.printf("[Event] %s: %.1f %s %s %.1f\n",
-                                  d->name, val, dir, dir, d->ev_threshold);
-            }
-        }
-    }
-}
-
-int eventsCount() {
-    int count = 0;
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        if (g_devices[i].used && g_devices[i].ev_direction != EV_DIR_NONE)
-            count++;
-    }
-    return count;
-}
-
 /*============================================================================
  * Init
  *============================================================================*/
 
 void devicesInit() {
     memset(g_devices, 0, sizeof(g_devices));
+    dhtSetResultHook(onDhtResult);
+    i2cSetResultHook(onI2cResult);
 
     devicesLoad();
+    eventsRulesLoad();
 
-    /* Auto-register built-in virtual sensors if not already present */
-    bool changed = false;
-    if (!deviceFind("chip_temp")) {
-        deviceRegister("chip_temp", DEV_SENSOR_INTERNAL_TEMP, PIN_NONE, "C", false);
-        changed = true;
-    }
-    if (!deviceFind("clock_hour")) {
-        deviceRegister("clock_hour", DEV_SENSOR_CLOCK_HOUR, PIN_NONE, "h", false);
-        changed = true;
-    }
-    if (!deviceFind("clock_minute")) {
-        deviceRegister("clock_minute", DEV_SENSOR_CLOCK_MINUTE, PIN_NONE, "m", false);
-        changed = true;
-    }
-    if (!deviceFind("clock_hhmm")) {
-        deviceRegister("clock_hhmm", DEV_SENSOR_CLOCK_HHMM, PIN_NONE, "", false);
-        changed = true;
-    }
-#ifdef RGB_BUILTIN
-    if (!deviceFind("rgb_led")) {
-        deviceRegister("rgb_led", DEV_ACTUATOR_RGB_LED, RGB_BUILTIN, "", false);
-        changed = true;
-    }
-#endif
-    if (changed) devicesSave();
+    if (devicesAddBuiltins()) devicesSave();
 
     int count = 0;
     for (int i = 0; i < MAX_DEVICES; i++)
@@ -0,0 +1,67 @@
+/**
+ * @file dht_decode.cpp
+ * @brief DHT11/DHT22 frame decoder working on captured edge timestamps
+ */
+
+#include "dht_decode.h"
+
+/* 40 bits x (fall, rise) plus the trailing fall and rise */
+#define DHT_FRAME_EDGES  82
+
+int dhtDecodeEdges(const uint32_t *edges, int n, uint8_t data[5]) {
+    if (!edges || n < DHT_FRAME_EDGES) return DHT_DECODE_SHORT;
+
+    for (int i = 0; i < 5; i++) data[i] = 0;
+
+    /* edges[n-1] rise (end), edges[n-2] fall ending bit 39's HIGH,
+       edges[n-3] rise starting it, edges[n-4] fall starting its LOW, ... */
+    const uint32_t *e = edges + n - DHT_FRAME_EDGES;
+    for (int bit = 0; bit < 40; bit++) {
+        uint32_t t_fall = e[2 * bit];
+        uint32_t t_rise = e[2 * bit + 1];
+        uint32_t t_end  = e[2 * bit + 2];
+        uint32_t low  = t_rise - t_fall;
+        uint32_t high = t_end - t_rise;
+        if (low > DHT_PULSE_MAX_US || high > DHT_PULSE_MAX_US)
+            return DHT_DECODE_TIMING;
+
+        data[bit / 8] <<= 1;
+        if (high > DHT_BIT_ONE_US) data[bit / 8] |= 1;
+    }
+
+    /* Trailing LOW before the line is released */
+    if (e[DHT_FRAME_EDGES - 1] - e[DHT_FRAME_EDGES - 2] > DHT_PULSE_MAX_US)
+        return DHT_DECODE_TIMING;
+
+    uint8_t sum = data[0] + data[1] + data[2] + data[3];
+    if (sum != data[4]) return DHT_DECODE_CHECKSUM;
+    return DHT_DECODE_OK;
+}
+
+void dhtDecodeValues(const uint8_t data[5], bool is_dht22, float *temp, float *humi) {
+    if (is_dht22) {
+        /* DHT22: 16-bit values × 0.1, humidity first, temp second */
+        int16_t raw_humi = ((uint16_t)data[0] << 8) | data[1];
+        int16_t raw_temp = ((uint16_t)data[2] << 8) | data[3];
+        /* Sign bit for temperature */
+        if (raw_temp & 0x8000) {
+            raw_temp = -(raw_temp & 0x7FFF);
+        }
+        *humi = raw_humi * 0.1f;
+        *temp = raw_temp * 0.1f;
+    } else {
+        /* DHT11: integer bytes (data[0]=humi integer, data[2]=temp integer) */
+        *humi = (float)data[0];
+        *temp = (float)data[2];
+    }
+}
+
+const char *dhtDecodeError(int rc) {
+    switch (rc) {
+        case DHT_DECODE_OK:       return "ok";
+        case DHT_DECODE_SHORT:    return "no response";
+        case DHT_DECODE_TIMING:   return "bad timing";
+        case DHT_DECODE_CHECKSUM: return "checksum";
+        default:                  return "unknown";
+    }
+}
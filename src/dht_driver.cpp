@@ -2,12 +2,17 @@
  * @file dht_driver.cpp
  * @brief DHT11/DHT22 single-wire temperature & humidity sensor driver
  *
- * Bit-bang protocol with critical section (interrupts disabled) during
- * the ~4ms read window. Per-pin cache with 2s TTL avoids redundant reads
- * when two devices (temp + humi) share the same GPIO pin.
+ * Edge capture via GPIO interrupt: after the start pulse the line is
+ * released and an ISR timestamps every level change; the trace is decoded
+ * afterwards (dht_decode.cpp) with interrupts enabled throughout.
+ * Acquisition is a small state machine advanced by dhtPoll(), one sensor
+ * at a time. Per-pin cache with 2s TTL avoids redundant reads when two
+ * devices (temp + humi) share the same GPIO pin.
  */
 
 #include "dht_driver.h"
+#include "dht_decode.h"
+#include "loop_sched.h"
 #include <math.h>
 
 extern bool g_debug;
@@ -18,17 +23,20 @@ extern bool g_debug;
 
 struct DhtCache {
     uint8_t  pin;
-    uint32_t last_read_ms;
+    bool     used;
+    bool     valid;         /* temp/humi hold a good reading */
+    bool     want;          /* refresh requested */
+    bool     is_dht22;
+    uint32_t last_read_ms;  /* last acquisition, good or not */
     float    temp;
     float    humi;
-    bool     valid;
 };
 
 static DhtCache g_dht_cache[DHT_CACHE_MAX];
 
 static DhtCache *dhtCacheFind(uint8_t pin) {
     for (int i = 0; i < DHT_CACHE_MAX; i++) {
-        if (g_dht_cache[i].pin == pin && g_dht_cache[i].valid)
+        if (g_dht_cache[i].used && g_dht_cache[i].pin == pin)
             return &g_dht_cache[i];
     }
     return nullptr;
@@ -36,131 +44,137 @@ static DhtCache *dhtCacheFind(uint8_t pin) {
 
 static DhtCache *dhtCacheAlloc(uint8_t pin) {
     /* Find existing or free slot */
+    DhtCache *c = dhtCacheFind(pin);
+    if (c) return c;
     for (int i = 0; i < DHT_CACHE_MAX; i++) {
-        if (g_dht_cache[i].pin == pin) return &g_dht_cache[i];
+        if (!g_dht_cache[i].used) { c = &g_dht_cache[i]; break; }
     }
-    for (int i = 0; i < DHT_CACHE_MAX; i++) {
-        if (!g_dht_cache[i].valid) {
-            g_dht_cache[i].pin = pin;
-            return &g_dht_cache[i];
-        }
-    }
-    /* Evict oldest */
-    int oldest = 0;
-    for (int i = 1; i < DHT_CACHE_MAX; i++) {
-        if (g_dht_cache[i].last_read_ms < g_dht_cache[oldest].last_read_ms)
-            oldest = i;
-    }
-    g_dht_cache[oldest].pin = pin;
-    g_dht_cache[oldest].valid = false;
-    return &g_dht_cache[oldest];
-}
-
-void dhtCacheInvalidate(uint8_t pin) {
-    for (int i = 0; i < DHT_CACHE_MAX; i++) {
-        if (g_dht_cache[i].pin == pin) {
-            g_dht_cache[i].valid = false;
-            g_dht_cache[i].last_read_ms = 0;
+    if (!c) {
+        /* Evict oldest */
+        c = &g_dht_cache[0];
+        for (int i = 1; i < DHT_CACHE_MAX; i++) {
+            if (g_dht_cache[i].last_read_ms < c->last_read_ms)
+                c = &g_dht_cache[i];
         }
     }
+    memset(c, 0, sizeof(*c));
+    c->pin  = pin;
+    c->used = true;
+    c->temp = c->humi = NAN;
+    return c;
 }
 
 /*============================================================================
- * Bit-bang driver
+ * Edge capture
  *============================================================================*/
 
-static portMUX_TYPE g_dht_mux = portMUX_INITIALIZER_UNLOCKED;
+enum DhtPhase : uint8_t { DHT_IDLE, DHT_START, DHT_CAPTURE };
 
-/**
- * Perform a physical DHT read. Returns true on success.
- * Disables interrupts for ~4ms during the 40-bit transfer.
- */
-static bool dhtDoRead(uint8_t pin, float *temp, float *humi, bool is_dht22) {
-    uint8_t data[5] = {0};
-
-    /* --- Start signal --- */
-    pinMode(pin, OUTPUT);
-    digitalWrite(pin, LOW);
-    delayMicroseconds(1200);   /* >1ms for DHT22, >18ms for DHT11 — 1.2ms works for both */
-    digitalWrite(pin, HIGH);
-    delayMicroseconds(30);
-    pinMode(pin, INPUT_PULLUP);
-
-    /* --- Critical section: read 40 bits --- */
-    portENTER_CRITICAL(&g_dht_mux);
-
-    /* Wait for sensor ACK: LOW ~80µs, then HIGH ~80µs */
-    uint32_t timeout;
-
-    timeout = 100;
-    while (digitalRead(pin) == HIGH) {
-        if (--timeout == 0) { portEXIT_CRITICAL(&g_dht_mux); return false; }
-        delayMicroseconds(1);
-    }
+#define DHT_START_US_DHT22  1200    /* host LOW: >1ms for DHT22 */
+#define DHT_START_US_DHT11  20000   /* >18ms for DHT11 */
+#define DHT_CAPTURE_US      8000    /* full frame is ~5ms */
 
-    timeout = 100;
-    while (digitalRead(pin) == LOW) {
-        if (--timeout == 0) { portEXIT_CRITICAL(&g_dht_mux); return false; }
-        delayMicroseconds(1);
-    }
+static volatile uint32_t g_dht_edges[DHT_EDGES_MAX];
+static volatile uint8_t  g_dht_nedges;
 
-    timeout = 100;
-    while (digitalRead(pin) == HIGH) {
-        if (--timeout == 0) { portEXIT_CRITICAL(&g_dht_mux); return false; }
-        delayMicroseconds(1);
+static DhtPhase  g_dht_phase = DHT_IDLE;
+static void    (*g_dht_result_hook)(uint8_t pin) = nullptr;
+static DhtCache *g_dht_cur;
+static uint32_t  g_dht_t0_us;
+
+static void IRAM_ATTR dhtEdgeIsr(void *) {
+    uint8_t n = g_dht_nedges;
+    if (n < DHT_EDGES_MAX) {
+        g_dht_edges[n] = micros();
+        g_dht_nedges = n + 1;
     }
+}
 
-    /* Read 40 bits (5 bytes) */
-    for (int i = 0; i < 40; i++) {
-        /* Wait for LOW→HIGH transition (bit start) */
-        timeout = 100;
-        while (digitalRead(pin) == LOW) {
-            if (--timeout == 0) { portEXIT_CRITICAL(&g_dht_mux); return false; }
-            delayMicroseconds(1);
-        }
+static void dhtFinish(DhtCache *c) {
+    detachInterrupt(c->pin);
 
-        /* Measure HIGH duration: >40µs = '1', else '0' */
-        uint32_t t0 = micros();
-        timeout = 100;
-        while (digitalRead(pin) == HIGH) {
-            if (--timeout == 0) { portEXIT_CRITICAL(&g_dht_mux); return false; }
-            delayMicroseconds(1);
-        }
-        uint32_t dur = micros() - t0;
+    uint32_t edges[DHT_EDGES_MAX];
+    int n = g_dht_nedges;
+    for (int i = 0; i < n; i++) edges[i] = g_dht_edges[i];
 
-        data[i / 8] <<= 1;
-        if (dur > 40) data[i / 8] |= 1;
+    uint8_t data[5];
+    int rc = dhtDecodeEdges(edges, n, data);
+    c->last_read_ms = millis();
+    if (rc != DHT_DECODE_OK) {
+        c->valid = false;
+        c->temp = c->humi = NAN;
+        if (g_debug)
+            Serial.printf("[DHT] read failed on pin %d: %s (%d edges)\n",
+                          c->pin, dhtDecodeError(rc), n);
+        return;
     }
 
-    portEXIT_CRITICAL(&g_dht_mux);
+    dhtDecodeValues(data, c->is_dht22, &c->temp, &c->humi);
+    c->valid = true;
+    if (g_dht_result_hook) g_dht_result_hook(c->pin);
 
-    /* --- Checksum --- */
-    uint8_t sum = data[0] + data[1] + data[2] + data[3];
-    if (sum != data[4]) {
-        if (g_debug)
-            Serial.printf("[DHT] checksum fail on pin %d: got 0x%02X expect 0x%02X\n",
-                          pin, data[4], sum);
-        return false;
-    }
+    if (g_debug)
+        Serial.printf("[DHT] pin %d: temp=%.1f humi=%.1f (%s)\n",
+                      c->pin, c->temp, c->humi, c->is_dht22 ? "DHT22" : "DHT11");
+}
 
-    /* --- Decode --- */
-    if (is_dht22) {
-        /* DHT22: 16-bit values × 0.1, humidity first, temp second */
-        int16_t raw_humi = ((uint16_t)data[0] << 8) | data[1];
-        int16_t raw_temp = ((uint16_t)data[2] << 8) | data[3];
-        /* Sign bit for temperature */
-        if (raw_temp & 0x8000) {
-            raw_temp = -(raw_temp & 0x7FFF);
+void dhtPoll() {
+    uint32_t now = micros();
+
+    switch (g_dht_phase) {
+        case DHT_IDLE:
+            for (int i = 0; i < DHT_CACHE_MAX; i++) {
+                DhtCache *c = &g_dht_cache[i];
+                if (!c->used || !c->want) continue;
+                /* Start signal; held LOW until the next poll step */
+                c->want = false;
+                pinMode(c->pin, OUTPUT);
+                digitalWrite(c->pin, LOW);
+                g_dht_cur   = c;
+                g_dht_t0_us = now;
+                g_dht_phase = DHT_START;
+                break;
+            }
+            break;
+
+        case DHT_START: {
+            uint32_t hold = g_dht_cur->is_dht22 ? DHT_START_US_DHT22 : DHT_START_US_DHT11;
+            if (now - g_dht_t0_us < hold) break;
+            /* Release the line and timestamp every edge of the response */
+            g_dht_nedges = 0;
+            pinMode(g_dht_cur->pin, INPUT_PULLUP);
+            attachInterruptArg(g_dht_cur->pin, dhtEdgeIsr, nullptr, CHANGE);
+            g_dht_t0_us = now;
+            g_dht_phase = DHT_CAPTURE;
+            break;
         }
-        *humi = raw_humi * 0.1f;
-        *temp = raw_temp * 0.1f;
-    } else {
-        /* DHT11: integer bytes (data[0]=humi integer, data[2]=temp integer) */
-        *humi = (float)data[0];
-        *temp = (float)data[2];
+
+        case DHT_CAPTURE:
+            if (now - g_dht_t0_us < DHT_CAPTURE_US) break;
+            dhtFinish(g_dht_cur);
+            g_dht_cur   = nullptr;
+            g_dht_phase = DHT_IDLE;
+            break;
     }
 
-    return true;
+    /* Next step: end of the start pulse or of the capture window */
+    if (g_dht_phase != DHT_IDLE) {
+        uint32_t span = g_dht_phase == DHT_CAPTURE ? DHT_CAPTURE_US :
+                        g_dht_cur->is_dht22 ? DHT_START_US_DHT22 : DHT_START_US_DHT11;
+        uint32_t spent = micros() - g_dht_t0_us;
+        loopIn(spent < span ? (span - spent + 999) / 1000 : 0);
+    }
+}
+
+/* First read of a pin: nothing cached yet, run the same sequence to
+   completion (~10-30ms, interrupts stay enabled). */
+static void dhtReadNow(DhtCache *c) {
+    uint32_t t0 = millis();
+    c->want = true;
+    while ((c->want || g_dht_phase != DHT_IDLE) && millis() - t0 < 100) {
+        dhtPoll();
+        delayMicroseconds(200);
+    }
 }
 
 /*============================================================================
@@ -170,32 +184,37 @@ static bool dhtDoRead(uint8_t pin, float *temp, float *humi, bool is_dht22) {
 float dhtRead(uint8_t pin, bool is_dht22, uint8_t channel) {
     uint32_t now = millis();
 
-    /* Check cache */
     DhtCache *c = dhtCacheFind(pin);
-    if (c && (now - c->last_read_ms) < DHT_CACHE_TTL_MS) {
-        return (channel == DHT_CHAN_TEMP) ? c->temp : c->humi;
+    if (!c) {
+        c = dhtCacheAlloc(pin);
+        c->is_dht22 = is_dht22;
+        dhtReadNow(c);
+    } else if ((now - c->last_read_ms) >= DHT_CACHE_TTL_MS && g_dht_cur != c) {
+        /* Stale: schedule a capture, answer from the cache meanwhile */
+        c->is_dht22 = is_dht22;
+        c->want = true;
+        dhtPoll();
     }
 
-    /* Cache miss — perform physical read */
-    float temp = NAN, humi = NAN;
-    bool ok = dhtDoRead(pin, &temp, &humi, is_dht22);
-
-    if (!ok) {
-        if (g_debug)
-            Serial.printf("[DHT] read failed on pin %d\n", pin);
-        return NAN;
-    }
-
-    /* Store in cache */
-    c = dhtCacheAlloc(pin);
-    c->temp = temp;
-    c->humi = humi;
-    c->valid = true;
-    c->last_read_ms = now;
+    if (!c->valid) return NAN;
+    return (channel == DHT_CHAN_TEMP) ? c->temp : c->humi;
+}
 
-    if (g_debug)
-        Serial.printf("[DHT] pin %d: temp=%.1f humi=%.1f (%s)\n",
-                      pin, temp, humi, is_dht22 ? "DHT22" : "DHT11");
+void dhtSetResultHook(void (*fn)(uint8_t pin)) {
+    g_dht_result_hook = fn;
+}
 
-    return (channel == DHT_CHAN_TEMP) ? temp : humi;
+void dhtCacheInvalidate(uint8_t pin) {
+    for (int i = 0; i < DHT_CACHE_MAX; i++) {
+        DhtCache *c = &g_dht_cache[i];
+        if (!c->used || c->pin != pin) continue;
+        if (g_dht_cur == c) {
+            detachInterrupt(pin);
+            g_dht_cur   = nullptr;
+            g_dht_phase = DHT_IDLE;
+        }
+        c->used = false;
+        c->valid = false;
+        c->want = false;
+    }
 }
@@ -0,0 +1,224 @@
+/**
+ * @file duty_cycle.cpp
+ * @brief Deep-sleep duty cycle - schedule, sample ring and event outbox
+ */
+
+#include "duty_cycle.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define DUTY_MAGIC  0x31595444u   /* "DTY1" */
+
+/*============================================================================
+ * Schedule
+ *============================================================================*/
+
+/* Report period: at least one wake, at most what the ring can hold */
+static uint32_t reportPeriod(const DutyConfig *c) {
+    uint32_t r = c->report_s > c->wake_s ? c->report_s : c->wake_s;
+    uint32_t max = c->wake_s * DUTY_RING;
+    return r > max ? max : r;
+}
+
+bool dutyValid(const DutyState *s, const DutyConfig *c) {
+    return s->magic == DUTY_MAGIC && c->wake_s > 0 &&
+           s->cfg.wake_s == c->wake_s && s->cfg.report_s == c->report_s;
+}
+
+void dutyReset(DutyState *s, const DutyConfig *c, uint32_t now) {
+    memset(s, 0, sizeof(*s));
+    s->magic = DUTY_MAGIC;
+    s->cfg = *c;
+    s->anchor = now;
+    s->next_wake = now + c->wake_s;
+    s->next_report = now + reportPeriod(c);
+}
+
+bool dutyReportDue(const DutyState *s, uint32_t now) {
+    return (int32_t)(now + s->cfg.wake_s / 2 - s->next_report) >= 0;
+}
+
+bool dutyNeedRadio(const DutyState *s, uint32_t now) {
+    if (dutyReportDue(s, now)) return true;
+    return s->outbox_len > 0 && (int32_t)(now - s->radio_hold) >= 0;
+}
+
+void dutyRadioDone(DutyState *s, bool ok, uint32_t now) {
+    s->radio_wakes++;
+    if (ok) {
+        s->ring_unsent = 0;
+        dutyOutboxClear(s);
+    } else {
+        s->radio_fails++;
+    }
+    uint32_t period = reportPeriod(&s->cfg);
+    while (dutyReportDue(s, now)) s->next_report += period;
+    if (!ok && s->ring_unsent < DUTY_RING) {
+        /* Retry before the ring overwrites unsent rows */
+        uint32_t retry = now + s->cfg.wake_s * (DUTY_RING - s->ring_unsent);
+        if ((int32_t)(retry - s->next_report) < 0) s->next_report = retry;
+    }
+    /* Queued events wait for the retry rather than trying on every wake */
+    s->radio_hold = ok ? 0 : s->next_report;
+}
+
+uint32_t dutySleepFor(DutyState *s, uint32_t now, uint32_t awake_ms) {
+    s->wakes++;
+    s->awake_ms += awake_ms;
+    uint32_t earliest = now + DUTY_MIN_SLEEP_S;
+    uint32_t k = (earliest - s->anchor + s->cfg.wake_s - 1) / s->cfg.wake_s;
+    s->next_wake = s->anchor + k * s->cfg.wake_s;
+    return s->next_wake - now;
+}
+
+/*============================================================================
+ * Sample ring
+ *============================================================================*/
+
+void dutyBindSlots(DutyState *s, const uint32_t key[DUTY_SLOTS]) {
+    for (int i = 0; i < DUTY_SLOTS; i++) {
+        if (s->slot_key[i] == key[i]) continue;
+        s->slot_key[i] = key[i];
+        for (int r = 0; r < DUTY_RING; r++) s->ring_mask[r] &= ~(1u << i);
+        s->edge_count[i] = 0;
+        s->edge_t[i] = 0;
+    }
+}
+
+void dutyLogRow(DutyState *s, uint32_t t, const float v[DUTY_SLOTS], uint16_t mask) {
+    s->ring_t[s->ring_head] = t;
+    memcpy(s->ring_v[s->ring_head], v, sizeof(s->ring_v[0]));
+    s->ring_mask[s->ring_head] = mask;
+    s->ring_head = (s->ring_head + 1) % DUTY_RING;
+    if (s->ring_n < DUTY_RING) s->ring_n++;
+    if (s->ring_unsent < DUTY_RING) s->ring_unsent++;
+}
+
+bool dutyRow(const DutyState *s, int age, uint32_t *t, const float **v, uint16_t *mask) {
+    if (age < 0 || age >= s->ring_n) return false;
+    int idx = (s->ring_head + DUTY_RING - s->ring_n + age) % DUTY_RING;
+    *t = s->ring_t[idx];
+    *v = s->ring_v[idx];
+    *mask = s->ring_mask[idx];
+    return true;
+}
+
+/*============================================================================
+ * Event outbox
+ *============================================================================*/
+
+/* Drop the oldest record */
+static void outboxDropOldest(DutyState *s) {
+    const char *subject, *json;
+    int next = dutyOutboxNext(s, 0, &subject, &json);
+    if (next < 0) { s->outbox_len = 0; return; }
+    memmove(s->outbox, s->outbox + next, s->outbox_len - next);
+    s->outbox_len -= next;
+    s->outbox_dropped++;
+}
+
+bool dutyOutboxPush(DutyState *s, const char *subject, const char *json, uint32_t t) {
+    size_t sl = strlen(subject) + 1;
+    size_t jl = strlen(json);
+    bool stamp = t && jl > 2 && json[jl - 1] == '}';
+    size_t need = sl + jl + 1 + (stamp ? 16 : 0);    /* ,"t":4294967295 */
+    if (need > DUTY_OUTBOX) { s->outbox_dropped++; return false; }
+    while (s->outbox_len + need > DUTY_OUTBOX) outboxDropOldest(s);
+
+    char *p = s->outbox + s->outbox_len;
+    memcpy(p, subject, sl);
+    p += sl;
+    if (stamp) {
+        memcpy(p, json, jl - 1);
+        p += jl - 1;
+        p += snprintf(p, 18, ",\"t\":%lu}", (unsigned long)t) + 1;
+    } else {
+        memcpy(p, json, jl + 1);
+        p += jl + 1;
+    }
+    s->outbox_len = (uint16_t)(p - s->outbox);
+    return true;
+}
+
+int dutyOutboxNext(const DutyState *s, int off, const char **subject, const char **json) {
+    if (off < 0 || off >= s->outbox_len) return -1;
+    *subject = s->outbox + off;
+    *json = *subject + strlen(*subject) + 1;
+    return (int)(*json - s->outbox) + (int)strlen(*json) + 1;
+}
+
+void dutyOutboxClear(DutyState *s) {
+    s->outbox_len = 0;
+}
+
+/*============================================================================
+ * Telemetry
+ *============================================================================*/
+
+/* Append to out; false once it no longer fits */
+static bool put(char *out, size_t len, int *w, const char *fmt, ...) {
+    if (*w >= (int)len) return false;
+    va_list ap;
+    va_start(ap, fmt);
+    *w += vsnprintf(out + *w, len - *w, fmt, ap);
+    va_end(ap);
+    return *w < (int)len;
+}
+
+static int telemetryRows(const DutyState *s, char *out, size_t len, const char *device,
+                         uint32_t unix_now, uint32_t now, DutyNameFn name, void *ctx,
+                         int rows) {
+    int first = s->ring_n - rows;
+    int w = 0;
+    bool ok = put(out, len, &w,
+        "{\"device\":\"%s\",\"wake_s\":%lu,\"report_s\":%lu,\"wakes\":%lu,"
+        "\"radio_wakes\":%lu,\"radio_fails\":%lu,\"events_dropped\":%u,\"%s\":[",
+        device, (unsigned long)s->cfg.wake_s, (unsigned long)s->cfg.report_s,
+        (unsigned long)s->wakes, (unsigned long)s->radio_wakes,
+        (unsigned long)s->radio_fails, s->outbox_dropped, unix_now ? "t" : "age");
+
+    uint16_t any = 0;
+    for (int a = first; a < s->ring_n && ok; a++) {
+        uint32_t t = 0;
+        const float *v;
+        uint16_t mask = 0;
+        dutyRow(s, a, &t, &v, &mask);
+        any |= mask;
+        ok = put(out, len, &w, "%s%lu", a > first ? "," : "",
+                 (unsigned long)(unix_now ? unix_now - (now - t) : now - t));
+    }
+    ok = ok && put(out, len, &w, "],\"samples\":{");
+
+    bool first_col = true;
+    for (int i = 0; i < DUTY_SLOTS && ok; i++) {
+        const char *n = (any & (1u << i)) ? name(i, ctx) : nullptr;
+        if (!n) continue;
+        ok = put(out, len, &w, "%s\"%s\":[", first_col ? "" : ",", n);
+        first_col = false;
+        for (int a = first; a < s->ring_n && ok; a++) {
+            uint32_t t;
+            const float *v = nullptr;
+            uint16_t mask = 0;
+            dutyRow(s, a, &t, &v, &mask);
+            const char *sep = a > first ? "," : "";
+            if ((mask & (1u << i)) && !isnan(v[i]))
+                ok = put(out, len, &w, "%s%.6g", sep, v[i]);
+            else
+                ok = put(out, len, &w, "%snull", sep);
+        }
+        ok = ok && put(out, len, &w, "]");
+    }
+    ok = ok && put(out, len, &w, "}}");
+    return ok ? w : -1;
+}
+
+int dutyTelemetryJson(const DutyState *s, char *out, size_t len, const char *device,
+                      uint32_t unix_now, uint32_t now, DutyNameFn name, void *ctx) {
+    for (int rows = s->ring_unsent; rows > 0; rows--) {
+        int w = telemetryRows(s, out, len, device, unix_now, now, name, ctx, rows);
+        if (w >= 0) return w;
+    }
+    return -1;
+}
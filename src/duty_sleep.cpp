@@ -0,0 +1,301 @@
+/**
+ * @file duty_sleep.cpp
+ * @brief Deep-sleep duty cycle on the target - wakeups, sampling, report
+ *
+ * Chip differences: the C3 and C6 wake on any deep-sleep capable GPIO at
+ * either level. The ESP32 and S3 wake on RTC GPIOs through EXT1 (any of a
+ * set going high) and EXT0 (one pin, here going low); further inputs that
+ * sit high are only checked on the timer wake.
+ */
+
+#include "duty_sleep.h"
+#include "duty_cycle.h"
+#include "devices.h"
+#include "events.h"
+#include "history.h"
+#include "seglog.h"
+#include <nats_atoms.h>
+#include <esp_attr.h>
+#include <esp_sleep.h>
+#include <esp_rtc_time.h>
+#include <esp_system.h>
+#include <driver/gpio.h>
+#include <math.h>
+#include <time.h>
+
+extern NatsClient natsClient;
+extern char cfg_device_name[32];
+extern bool g_devices_dirty;
+extern bool g_config_dirty;
+void configSave();
+
+struct SleepRtc {
+    DutyState duty;
+    uint64_t  held;             /* output pins held through sleep */
+    uint8_t   ext0_pin;         /* pin armed for EXT0, PIN_NONE if none */
+};
+
+static RTC_DATA_ATTR SleepRtc g_sleep;
+static bool     g_sleep_active = false;
+static uint64_t g_wake_pins = 0;        /* pins that caused this wake */
+
+static char g_tm_json[2048];
+static char g_tm_subject[64];
+
+/* Seconds on the RTC timer, which keeps counting through deep sleep */
+static uint32_t sleepClock() {
+    return (uint32_t)(esp_rtc_get_time_us() / 1000000ULL);
+}
+
+static uint32_t sleepUnixTime() {
+    return historyClockSynced() ? (uint32_t)time(nullptr) : 0;
+}
+
+static uint64_t sleepWakePins() {
+    switch (esp_sleep_get_wakeup_cause()) {
+#if SOC_GPIO_SUPPORT_DEEPSLEEP_WAKEUP
+        case ESP_SLEEP_WAKEUP_GPIO: return esp_sleep_get_gpio_wakeup_status();
+#endif
+#if SOC_PM_SUPPORT_EXT1_WAKEUP
+        case ESP_SLEEP_WAKEUP_EXT1: return esp_sleep_get_ext1_wakeup_status();
+#endif
+#if SOC_PM_SUPPORT_EXT0_WAKEUP
+        case ESP_SLEEP_WAKEUP_EXT0:
+            return g_sleep.ext0_pin != PIN_NONE ? 1ULL << g_sleep.ext0_pin : 0;
+#endif
+        default: return 0;
+    }
+}
+
+/*============================================================================
+ * Wake
+ *============================================================================*/
+
+bool sleepWoke() {
+    return esp_reset_reason() == ESP_RST_DEEPSLEEP;
+}
+
+void sleepReleasePins() {
+    for (int pin = 0; pin < 64; pin++)
+        if (g_sleep.held & (1ULL << pin)) gpio_hold_dis((gpio_num_t)pin);
+    g_sleep.held = 0;
+}
+
+void sleepBegin(uint32_t wake_s, uint32_t report_s) {
+    DutyConfig c = { wake_s, report_s };
+    uint32_t now = sleepClock();
+    if (!sleepWoke() || !dutyValid(&g_sleep.duty, &c)) {
+        dutyReset(&g_sleep.duty, &c, now);
+        Serial.printf("Sleep: duty cycle every %us, report every %us\n",
+                      wake_s, report_s ? report_s : wake_s);
+    }
+    g_wake_pins = sleepWoke() ? sleepWakePins() : 0;
+    g_sleep_active = true;
+}
+
+bool sleepActive() {
+    return g_sleep_active;
+}
+
+/*============================================================================
+ * Sampling
+ *============================================================================*/
+
+/* Sensors read on a wake: push sensors need the radio, pulse counters
+   stop in deep sleep */
+static bool sleepReads(const Device *d) {
+    return d->used && deviceIsSensor(d->kind) &&
+           d->kind != DEV_SENSOR_NATS_VALUE && d->kind != DEV_SENSOR_SERIAL_TEXT &&
+           !deviceIsPulse(d->kind);
+}
+
+/* Values worth reporting; clock sensors only drive rules */
+static bool sleepLogs(DeviceKind kind) {
+    return kind != DEV_SENSOR_CLOCK_HOUR && kind != DEV_SENSOR_CLOCK_MINUTE &&
+           kind != DEV_SENSOR_CLOCK_HHMM;
+}
+
+static const char *sleepSlotName(int slot, void *ctx) {
+    (void)ctx;
+    const Device *d = &deviceGetAll()[slot];
+    return d->used ? d->name : nullptr;
+}
+
+static void sleepEdge(Device *d, int slot, uint8_t level, uint32_t now) {
+    DutyState *s = &g_sleep.duty;
+    uint32_t dt = s->edge_t[slot] ? now - s->edge_t[slot] : 0;
+    s->edge_count[slot]++;
+    s->edge_t[slot] = now;
+    eventsOnEdge(d, level, s->edge_count[slot], (uint64_t)now * 1000000ULL,
+                 (uint64_t)dt * 1000000ULL);
+}
+
+void sleepSample() {
+    DutyState *s = &g_sleep.duty;
+    Device *devs = deviceGetAll();
+    uint32_t now = sleepClock();
+
+    uint32_t key[DUTY_SLOTS] = { 0 };
+    for (int i = 0; i < DUTY_SLOTS; i++)
+        if (devs[i].used) key[i] = seglogKey(devs[i].name);
+    dutyBindSlots(s, key);
+
+    /* Event windows are RAM: re-prime them from the ring, oldest first */
+    float last[DUTY_SLOTS] = { 0 };
+    uint16_t known = 0;
+    for (int a = 0; a < s->ring_n; a++) {
+        uint32_t t;
+        const float *v;
+        uint16_t mask;
+        dutyRow(s, a, &t, &v, &mask);
+        for (int i = 0; i < DUTY_SLOTS; i++) {
+            if (!(mask & (1u << i))) continue;
+            last[i] = v[i];
+            known |= 1u << i;
+            if (eventsWatching(&devs[i])) eventsPrime(&devs[i], v[i], (now - t) * 1000);
+        }
+    }
+
+    sensorsSettle();
+
+    float v[DUTY_SLOTS];
+    uint16_t mask = 0;
+    for (int i = 0; i < DUTY_SLOTS; i++) {
+        v[i] = NAN;
+        Device *d = &devs[i];
+        if (!sleepReads(d)) continue;
+        float val = deviceReadSensor(d);
+
+        /* Digital inputs: a level change since the last wake is an edge; a
+           pin that woke us but reads unchanged pulsed and is back */
+        bool edged = false;
+        if (d->kind == DEV_SENSOR_DIGITAL && d->pin != PIN_NONE && (known & (1u << i))) {
+            uint8_t level = val != 0.0f;
+            uint8_t was = last[i] != 0.0f;
+            if (level != was) {
+                sleepEdge(d, i, level, now);
+                edged = true;
+            } else if (g_wake_pins & (1ULL << d->pin)) {
+                sleepEdge(d, i, !was, now);
+                sleepEdge(d, i, was, now);
+                edged = true;
+            }
+        }
+        if (!edged && eventsWatching(d)) eventsOnSample(d, val);
+
+        if (!isnan(val) && sleepLogs(d->kind)) {
+            v[i] = val;
+            mask |= 1u << i;
+        }
+    }
+    dutyLogRow(s, now, v, mask);
+}
+
+/*============================================================================
+ * Report
+ *============================================================================*/
+
+bool sleepRadioNeeded() {
+    return dutyNeedRadio(&g_sleep.duty, sleepClock());
+}
+
+bool sleepQueueEvent(const char *subject, const char *json) {
+    if (!g_sleep_active) return false;
+    return dutyOutboxPush(&g_sleep.duty, subject, json, sleepUnixTime());
+}
+
+int sleepPublish() {
+    DutyState *s = &g_sleep.duty;
+    int sent = 0;
+    if (s->ring_unsent) {
+        int n = dutyTelemetryJson(s, g_tm_json, sizeof(g_tm_json), cfg_device_name,
+                                  sleepUnixTime(), sleepClock(), sleepSlotName, nullptr);
+        if (n > 0) {
+            snprintf(g_tm_subject, sizeof(g_tm_subject), "%s.telemetry", cfg_device_name);
+            if (natsClient.publish(g_tm_subject, g_tm_json) != NATS_OK) return -1;
+            sent++;
+        }
+    }
+    const char *subject, *json;
+    for (int off = 0; (off = dutyOutboxNext(s, off, &subject, &json)) >= 0; ) {
+        if (natsClient.publish(subject, json) != NATS_OK) return -1;
+        sent++;
+    }
+    return sent;
+}
+
+void sleepRadioDone(bool ok) {
+    dutyRadioDone(&g_sleep.duty, ok, sleepClock());
+}
+
+/*============================================================================
+ * Sleep
+ *============================================================================*/
+
+/* Keep relay / digital_out levels while the chip sleeps */
+static void sleepHoldOutputs() {
+    const Device *devs = deviceGetAll();
+    g_sleep.held = 0;
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        const Device *d = &devs[i];
+        if (!d->used || d->pin == PIN_NONE) continue;
+        if (d->kind != DEV_ACTUATOR_RELAY && d->kind != DEV_ACTUATOR_DIGITAL) continue;
+        if (gpio_hold_en((gpio_num_t)d->pin) == ESP_OK) g_sleep.held |= 1ULL << d->pin;
+    }
+#if !SOC_GPIO_SUPPORT_HOLD_SINGLE_IO_IN_DSLP
+    if (g_sleep.held) gpio_deep_sleep_hold_en();
+#endif
+}
+
+/* Wake on a level change of inputs that publish edges or drive events */
+static void sleepArmInputs() {
+    const Device *devs = deviceGetAll();
+    uint64_t to_high = 0, to_low = 0;
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        const Device *d = &devs[i];
+        if (!d->used || d->kind != DEV_SENSOR_DIGITAL || d->pin == PIN_NONE) continue;
+        if (!d->edge_publish && !eventsWatching(d)) continue;
+        if (!esp_sleep_is_valid_wakeup_gpio((gpio_num_t)d->pin)) {
+            Serial.printf("Sleep: %s (pin %d) cannot wake the chip, timer only\n",
+                          d->name, d->pin);
+            continue;
+        }
+        if (digitalRead(d->pin)) to_low |= 1ULL << d->pin;
+        else                     to_high |= 1ULL << d->pin;
+    }
+
+    g_sleep.ext0_pin = PIN_NONE;
+#if SOC_GPIO_SUPPORT_DEEPSLEEP_WAKEUP
+    if (to_high) esp_deep_sleep_enable_gpio_wakeup(to_high, ESP_GPIO_WAKEUP_GPIO_HIGH);
+    if (to_low)  esp_deep_sleep_enable_gpio_wakeup(to_low, ESP_GPIO_WAKEUP_GPIO_LOW);
+#else
+#if SOC_PM_SUPPORT_EXT1_WAKEUP
+    if (to_high) esp_sleep_enable_ext1_wakeup(to_high, ESP_EXT1_WAKEUP_ANY_HIGH);
+#endif
+#if SOC_PM_SUPPORT_EXT0_WAKEUP
+    for (int pin = 0; pin < 64 && to_low; pin++) {
+        if (!(to_low & (1ULL << pin))) continue;
+        esp_sleep_enable_ext0_wakeup((gpio_num_t)pin, 0);
+        g_sleep.ext0_pin = (uint8_t)pin;
+        break;
+    }
+#endif
+#endif
+}
+
+void sleepEnter() {
+    if (g_devices_dirty) { devicesSave(); g_devices_dirty = false; }
+    if (g_config_dirty)  { configSave();  g_config_dirty = false; }
+    seglogFlush();
+
+    DutyState *s = &g_sleep.duty;
+    uint32_t sleep_s = dutySleepFor(s, sleepClock(), millis());
+    sleepHoldOutputs();
+    sleepArmInputs();
+    esp_sleep_enable_timer_wakeup((uint64_t)sleep_s * 1000000ULL);
+
+    Serial.printf("Sleep: %us (wakes %u, radio %u, queued %u bytes)\n",
+                  sleep_s, s->wakes, s->radio_wakes, s->outbox_len);
+    Serial.flush();
+    esp_deep_sleep_start();
+}
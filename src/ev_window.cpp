@@ -0,0 +1,67 @@
+/**
+ * @file ev_window.cpp
+ * @brief Running sample windows for event conditions
+ */
+
+#include "ev_window.h"
+#include <math.h>
+#include <string.h>
+
+void evWinReset(EvWindow *w, uint8_t len) {
+    if (len < 2) len = 2;
+    if (len > EV_WIN_MAX) len = EV_WIN_MAX;
+    memset(w, 0, sizeof(EvWindow));
+    w->len = len;
+}
+
+float evWinPush(EvWindow *w, uint8_t mode, float x, uint32_t now) {
+    if (!isfinite(x)) return NAN;
+
+    uint32_t s = w->seq++;
+    uint8_t pos = s % w->len;
+    if (w->count == w->len) w->sum -= w->v[pos];    /* evict oldest */
+    else w->count++;
+    w->v[pos] = x;
+    w->t[pos] = now;
+    w->sum += x;
+    /* Re-sum once per lap so float error cannot accumulate */
+    if (pos == w->len - 1 && w->count == w->len) {
+        float sum = 0.0f;
+        for (int i = 0; i < w->len; i++) sum += w->v[i];
+        w->sum = sum;
+    }
+
+    switch (mode) {
+        case EV_MODE_AVG:
+            return w->sum / w->count;
+
+        case EV_MODE_MIN:
+        case EV_MODE_MAX: {
+            /* Expire the front, drop dominated entries from the back */
+            while (w->dq_n && s - w->dq[w->dq_head] >= w->len) {
+                w->dq_head = (w->dq_head + 1) % EV_WIN_MAX;
+                w->dq_n--;
+            }
+            while (w->dq_n) {
+                uint32_t back = w->dq[(w->dq_head + w->dq_n - 1) % EV_WIN_MAX];
+                float bv = w->v[back % w->len];
+                if (mode == EV_MODE_MIN ? bv >= x : bv <= x) w->dq_n--;
+                else break;
+            }
+            w->dq[(w->dq_head + w->dq_n) % EV_WIN_MAX] = s;
+            w->dq_n++;
+            return w->v[w->dq[w->dq_head] % w->len];
+        }
+
+        case EV_MODE_RATE: {
+            if (w->count < 2) return NAN;
+            uint8_t oldest = (uint8_t)((s + 1 - w->count) % w->len);
+            uint32_t dt = now - w->t[oldest];
+            if (dt == 0) return NAN;
+            return (x - w->v[oldest]) * 1000.0f / (float)dt;
+        }
+
+        default:
+            return x;
+    }
+}
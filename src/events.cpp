@@ -0,0 +1,728 @@
+/**
+ * @file events.cpp
+ * @brief Incremental event engine - conditions, running windows, rules,
+ *        local actuator actions
+ */
+
+#include "events.h"
+#include "duty_sleep.h"
+#include <nats_atoms.h>
+#include <LittleFS.h>
+#include <math.h>
+
+extern bool g_debug;
+extern NatsClient natsClient;
+extern char cfg_device_name[32];
+extern uint32_t g_events_fired;
+extern bool g_nats_connected;
+
+/*============================================================================
+ * Running windows (ev_window.cpp), pooled across conditions
+ *============================================================================*/
+
+static EvWindow g_win[EV_WIN_POOL];
+
+static int8_t winAlloc(uint8_t len) {
+    for (int i = 0; i < EV_WIN_POOL; i++) {
+        if (!g_win[i].used) {
+            evWinReset(&g_win[i], len);
+            g_win[i].used = true;
+            return (int8_t)i;
+        }
+    }
+    return -1;
+}
+
+static void winFree(int8_t w) {
+    if (w >= 0 && w < EV_WIN_POOL) g_win[w].used = false;
+}
+
+/* Measure for one condition; allocates its window on first use */
+static float condMeasure(int8_t *win, uint8_t mode, uint8_t len, float x, uint32_t now) {
+    if (mode == EV_MODE_VALUE) return x;
+    if (*win < 0) *win = winAlloc(len);
+    if (*win < 0) return NAN;           /* pool exhausted: condition never fires */
+    return evWinPush(&g_win[*win], mode, x, now);
+}
+
+/* Threshold with hysteresis: enter past the threshold, leave past the band */
+static bool condStep(uint8_t dir, float thr, float hyst, bool active, float m) {
+    if (isnan(m)) return active;
+    if (dir == EV_DIR_ABOVE) return active ? (m > thr - hyst) : (m > thr);
+    if (dir == EV_DIR_BELOW) return active ? (m < thr + hyst) : (m < thr);
+    return false;
+}
+
+static bool cooldownOver(uint32_t last_fire_ms, uint16_t cooldown_s, uint32_t now) {
+    return last_fire_ms == 0 || (now - last_fire_ms) >= (uint32_t)cooldown_s * 1000;
+}
+
+const char *eventsModeName(uint8_t mode) {
+    switch (mode) {
+        case EV_MODE_VALUE: return "value";
+        case EV_MODE_RATE:  return "rate";
+        case EV_MODE_AVG:   return "avg";
+        case EV_MODE_MIN:   return "min";
+        case EV_MODE_MAX:   return "max";
+        default:            return "unknown";
+    }
+}
+
+uint8_t eventsModeFromString(const char *s) {
+    if (!s || !*s || strcmp(s, "value") == 0) return EV_MODE_VALUE;
+    if (strcmp(s, "rate") == 0) return EV_MODE_RATE;
+    if (strcmp(s, "avg") == 0)  return EV_MODE_AVG;
+    if (strcmp(s, "min") == 0)  return EV_MODE_MIN;
+    if (strcmp(s, "max") == 0)  return EV_MODE_MAX;
+    return EV_MODE_BAD;
+}
+
+/*============================================================================
+ * State - per-sensor event runtime and compound rules
+ *============================================================================*/
+
+struct EvDevRuntime {
+    int8_t win;          /* window index, -1 = none */
+    bool   active;       /* condition currently true */
+};
+
+struct EvCond {
+    char    sensor[DEV_NAME_LEN];
+    int8_t  dev;         /* resolved device slot, -1 = missing */
+    uint8_t mode;
+    uint8_t dir;
+    uint8_t window;
+    float   threshold;
+    float   hyst;
+    int8_t  win;
+    bool    active;
+    float   m;           /* last measure */
+};
+
+struct EvRule {
+    bool     used;
+    char     name[EV_RULE_NAME_LEN];
+    uint8_t  logic;
+    uint8_t  ncond;
+    uint16_t cooldown;   /* seconds */
+    EvCond   cond[EV_RULE_CONDS];
+    bool     active;
+    bool     primed;     /* first evaluation done (action state applied) */
+    uint32_t last_fire_ms;
+    /* Local action: set an actuator when the rule turns on/off */
+    char     act[DEV_NAME_LEN];     /* actuator name, "" = notify only */
+    int8_t   act_dev;               /* resolved device slot, -1 = missing */
+    bool     act_has_off;
+    int      act_on;
+    int      act_off;
+};
+
+static EvDevRuntime g_dev_rt[MAX_DEVICES];
+static bool         g_dev_rt_init = false;
+static EvRule       g_rules[EV_MAX_RULES];
+static uint32_t     g_rules_gen = 0;   /* registry generation conds were resolved at */
+
+static char g_ev_json[384];
+static char g_ev_subject[64];
+
+static void devRtInit() {
+    if (g_dev_rt_init) return;
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        g_dev_rt[i].win = -1;
+        g_dev_rt[i].active = false;
+    }
+    g_dev_rt_init = true;
+}
+
+/* Re-resolve rule sensor names after the registry changed */
+static void rulesResolve() {
+    uint32_t gen = deviceRegistryGen();
+    if (gen == g_rules_gen) return;
+    g_rules_gen = gen;
+    Device *devs = deviceGetAll();
+    for (int r = 0; r < EV_MAX_RULES; r++) {
+        if (!g_rules[r].used) continue;
+        for (int c = 0; c < g_rules[r].ncond; c++) {
+            EvCond *cd = &g_rules[r].cond[c];
+            Device *d = deviceFind(cd->sensor);
+            int8_t idx = d ? (int8_t)(d - devs) : -1;
+            if (idx != cd->dev) {
+                cd->dev = idx;
+                cd->active = false;
+                winFree(cd->win);
+                cd->win = -1;
+            }
+        }
+        if (g_rules[r].act[0]) {
+            Device *a = deviceFind(g_rules[r].act);
+            g_rules[r].act_dev = (a && deviceIsActuator(a->kind)) ? (int8_t)(a - devs) : -1;
+        }
+    }
+}
+
+/*============================================================================
+ * Publishing
+ *============================================================================*/
+
+/* Publish g_ev_json on g_ev_subject. With the radio down in duty-cycle
+   mode it is queued for the next report instead. */
+static void evEmit() {
+    if (g_nats_connected) natsClient.publish(g_ev_subject, g_ev_json);
+    else sleepQueueEvent(g_ev_subject, g_ev_json);
+}
+
+static void evPublishThreshold(const Device *d, float m) {
+    if (!g_nats_connected && !sleepActive()) return;
+    const char *dir = d->ev_direction == EV_DIR_ABOVE ? "above" : "below";
+    int w = snprintf(g_ev_json, sizeof(g_ev_json),
+        "{\"event\":\"threshold\",\"device\":\"%s\",\"sensor\":\"%s\","
+        "\"value\":%.1f,\"threshold\":%.1f,\"direction\":\"%s\","
+        "\"unit\":\"%s\"",
+        cfg_device_name, d->name, m, d->ev_threshold, dir, d->unit);
+    if (d->ev_mode != EV_MODE_VALUE)
+        w += snprintf(g_ev_json + w, sizeof(g_ev_json) - w,
+            ",\"mode\":\"%s\",\"window\":%d", eventsModeName(d->ev_mode), d->ev_window);
+    snprintf(g_ev_json + w, sizeof(g_ev_json) - w, "}");
+
+    snprintf(g_ev_subject, sizeof(g_ev_subject),
+        "%s.events.%s", cfg_device_name, d->name);
+    evEmit();
+
+    if (g_debug)
+        Serial.printf("[Event] %s: %.1f %s %.1f\n", d->name, m, dir, d->ev_threshold);
+}
+
+static void evPublishEdge(const Device *d, uint8_t level, uint32_t count,
+                          uint64_t t_us, uint64_t dt_us) {
+    if (!g_nats_connected && !sleepActive()) return;
+    snprintf(g_ev_json, sizeof(g_ev_json),
+        "{\"event\":\"edge\",\"device\":\"%s\",\"sensor\":\"%s\","
+        "\"value\":%d,\"edge\":\"%s\",\"count\":%lu,"
+        "\"t_us\":%llu,\"dt_us\":%llu}",
+        cfg_device_name, d->name, level, level ? "rising" : "falling",
+        (unsigned long)count, (unsigned long long)t_us,
+        (unsigned long long)dt_us);
+
+    snprintf(g_ev_subject, sizeof(g_ev_subject),
+        "%s.events.%s", cfg_device_name, d->name);
+    evEmit();
+}
+
+static void evPublishRule(const EvRule *r, bool acted) {
+    if (!g_nats_connected && !sleepActive()) return;
+    int w = snprintf(g_ev_json, sizeof(g_ev_json),
+        "{\"event\":\"rule\",\"device\":\"%s\",\"rule\":\"%s\",\"op\":\"%s\",\"sensors\":{",
+        cfg_device_name, r->name, r->logic == EV_LOGIC_OR ? "or" : "and");
+    for (int c = 0; c < r->ncond && w < (int)sizeof(g_ev_json) - 48; c++) {
+        w += snprintf(g_ev_json + w, sizeof(g_ev_json) - w, "%s\"%s\":%.2f",
+                      c ? "," : "", r->cond[c].sensor, r->cond[c].m);
+    }
+    w += snprintf(g_ev_json + w, sizeof(g_ev_json) - w, "}");
+    if (acted && w < (int)sizeof(g_ev_json))
+        w += snprintf(g_ev_json + w, sizeof(g_ev_json) - w,
+                      ",\"set\":{\"%s\":%d}", r->act, r->act_on);
+    if (w < (int)sizeof(g_ev_json))
+        snprintf(g_ev_json + w, sizeof(g_ev_json) - w, "}");
+
+    snprintf(g_ev_subject, sizeof(g_ev_subject),
+        "%s.events.%s", cfg_device_name, r->name);
+    evEmit();
+
+    if (g_debug) Serial.printf("[Event] rule %s fired\n", r->name);
+}
+
+/*============================================================================
+ * Sample path
+ *============================================================================*/
+
+/* Drive the rule's actuator to match the rule state. Runs on every edge
+ * (cooldown only limits notifications) and needs no NATS connection. */
+static bool ruleAct(EvRule *r, bool on) {
+    if (r->act_dev < 0) return false;
+    if (!on && !r->act_has_off) return false;
+    Device *a = &deviceGetAll()[r->act_dev];
+    int v = on ? r->act_on : r->act_off;
+    if (!deviceSetActuator(a, v)) return false;
+    if (g_debug) Serial.printf("[Event] rule %s: %s = %d\n", r->name, a->name, v);
+    return true;
+}
+
+static void ruleEvaluate(EvRule *r, uint32_t now, bool quiet) {
+    bool val = (r->logic == EV_LOGIC_AND);
+    for (int c = 0; c < r->ncond; c++) {
+        if (r->logic == EV_LOGIC_AND) val = val && r->cond[c].active;
+        else                          val = val || r->cond[c].active;
+    }
+    if (quiet) {
+        /* Replay: the actuator already holds the state it was left in */
+        r->active = val;
+        r->primed = true;
+        return;
+    }
+    bool acted = false;
+    if (val != r->active || !r->primed) acted = ruleAct(r, val);
+    r->primed = true;
+    if (val && !r->active && cooldownOver(r->last_fire_ms, r->cooldown, now)) {
+        r->last_fire_ms = now;
+        g_events_fired++;
+        evPublishRule(r, acted);
+    }
+    r->active = val;
+}
+
+/* quiet: replayed sample, updates windows and state but fires nothing */
+static void eventsSample(Device *dev, float value, uint32_t now, bool quiet) {
+    if (!dev || !dev->used || !deviceIsSensor(dev->kind)) return;
+    /* A failed read (NaN) is not a sample: windows and state stay as they are */
+    if (!isfinite(value)) return;
+    devRtInit();
+    rulesResolve();
+
+    int idx = dev - deviceGetAll();
+
+    /* Per-sensor event */
+    if (dev->ev_direction != EV_DIR_NONE) {
+        EvDevRuntime *rt = &g_dev_rt[idx];
+        float m = condMeasure(&rt->win, dev->ev_mode, dev->ev_window, value, now);
+        bool was = rt->active;
+        rt->active = condStep(dev->ev_direction, dev->ev_threshold,
+                              dev->ev_hysteresis, was, m);
+        dev->ev_armed = !rt->active;
+        /* Rising edge inside the cooldown is swallowed, not deferred */
+        if (rt->active && !was && !quiet &&
+            cooldownOver(dev->ev_last_fire_ms, dev->ev_cooldown, now)) {
+            dev->ev_last_fire_ms = now;
+            g_events_fired++;
+            evPublishThreshold(dev, m);
+        }
+    }
+
+    /* Rules that reference this sensor */
+    for (int r = 0; r < EV_MAX_RULES; r++) {
+        EvRule *rule = &g_rules[r];
+        if (!rule->used) continue;
+        bool touched = false;
+        for (int c = 0; c < rule->ncond; c++) {
+            EvCond *cd = &rule->cond[c];
+            if (cd->dev != idx) continue;
+            cd->m = condMeasure(&cd->win, cd->mode, cd->window, value, now);
+            cd->active = condStep(cd->dir, cd->threshold, cd->hyst, cd->active, cd->m);
+            touched = true;
+        }
+        if (touched) ruleEvaluate(rule, now, quiet);
+    }
+}
+
+void eventsOnSample(Device *dev, float value) {
+    eventsSample(dev, value, millis(), false);
+}
+
+void eventsPrime(Device *dev, float value, uint32_t age_ms) {
+    eventsSample(dev, value, millis() - age_ms, true);
+}
+
+void eventsOnEdge(Device *dev, uint8_t level, uint32_t count, uint64_t t_us,
+                  uint64_t dt_us) {
+    if (dev->edge_publish) evPublishEdge(dev, level, count, t_us, dt_us);
+    if (eventsWatching(dev)) eventsOnSample(dev, (float)level);
+}
+
+bool eventsWatching(const Device *dev) {
+    if (!dev || !dev->used) return false;
+    if (dev->ev_direction != EV_DIR_NONE) return true;
+    rulesResolve();
+    int idx = dev - deviceGetAll();
+    for (int r = 0; r < EV_MAX_RULES; r++) {
+        if (!g_rules[r].used) continue;
+        for (int c = 0; c < g_rules[r].ncond; c++)
+            if (g_rules[r].cond[c].dev == idx) return true;
+    }
+    return false;
+}
+
+void eventsDeviceChanged(Device *dev) {
+    if (!dev) return;
+    devRtInit();
+    int idx = dev - deviceGetAll();
+    if (idx < 0 || idx >= MAX_DEVICES) return;
+    winFree(g_dev_rt[idx].win);
+    g_dev_rt[idx].win = -1;
+    g_dev_rt[idx].active = false;
+    dev->ev_armed = (dev->ev_direction != EV_DIR_NONE);
+    dev->ev_last_fire_ms = 0;
+}
+
+int eventsCount() {
+    Device *devs = deviceGetAll();
+    int count = 0;
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (devs[i].used && devs[i].ev_direction != EV_DIR_NONE)
+            count++;
+    }
+    return count;
+}
+
+/*============================================================================
+ * Rules - JSON format shared by config.rule.set and /rules.json:
+ * {"n":"hot","op":"and","cd":30,
+ *  "c":[{"s":"temp","d":"above","t":30,"h":1},
+ *       {"s":"humi","m":"avg","w":10,"d":"above","t":70}]}
+ *============================================================================*/
+
+/* Simple JSON extractors (matches project pattern) */
+static bool evJsonGetString(const char *json, const char *key,
+                             char *dst, int dst_len) {
+    char pattern[48];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char *p = strstr(json, pattern);
+    if (!p) return false;
+    p += strlen(pattern);
+    while (*p == ' ' || *p == ':') p++;
+    if (*p != '"') return false;
+    p++;
+    int w = 0;
+    while (*p && *p != '"' && w < dst_len - 1) {
+        if (*p == '\\' && *(p + 1)) p++;
+        dst[w++] = *p++;
+    }
+    dst[w] = '\0';
+    return w > 0;
+}
+
+static int evJsonGetInt(const char *json, const char *key, int default_val) {
+    char pattern[48];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char *p = strstr(json, pattern);
+    if (!p) return default_val;
+    p += strlen(pattern);
+    while (*p == ' ' || *p == ':') p++;
+    return atoi(p);
+}
+
+static bool evJsonGetFloat(const char *json, const char *key, float *out) {
+    char pattern[48];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char *p = strstr(json, pattern);
+    if (!p) return false;
+    p += strlen(pattern);
+    while (*p == ' ' || *p == ':') p++;
+    char *end = nullptr;
+    float v = strtof(p, &end);
+    if (end == p) return false;
+    *out = v;
+    return true;
+}
+
+static bool ruleNameValid(const char *n) {
+    size_t len = strlen(n);
+    if (len < 1 || len >= EV_RULE_NAME_LEN) return false;
+    for (size_t i = 0; i < len; i++) {
+        char c = n[i];
+        if (c == '.' || c == '*' || c == '>' || c == ' ' || c == '"') return false;
+    }
+    return true;
+}
+
+/* Parse one condition object. Returns false with a reason in err. */
+static bool condParse(const char *obj, EvCond *cd, char *err, size_t err_len) {
+    memset(cd, 0, sizeof(*cd));
+    cd->dev = -1;
+    cd->win = -1;
+    if (!evJsonGetString(obj, "s", cd->sensor, sizeof(cd->sensor))) {
+        snprintf(err, err_len, "condition needs s (sensor)");
+        return false;
+    }
+    char dir[8] = "";
+    evJsonGetString(obj, "d", dir, sizeof(dir));
+    if (strcmp(dir, "above") == 0)      cd->dir = EV_DIR_ABOVE;
+    else if (strcmp(dir, "below") == 0) cd->dir = EV_DIR_BELOW;
+    else {
+        snprintf(err, err_len, "d must be above or below");
+        return false;
+    }
+    if (!evJsonGetFloat(obj, "t", &cd->threshold)) {
+        snprintf(err, err_len, "condition needs t (threshold)");
+        return false;
+    }
+    cd->hyst = 0.0f;
+    evJsonGetFloat(obj, "h", &cd->hyst);
+    if (cd->hyst < 0) cd->hyst = -cd->hyst;
+    char mode[8] = "";
+    evJsonGetString(obj, "m", mode, sizeof(mode));
+    cd->mode = eventsModeFromString(mode);
+    if (cd->mode == EV_MODE_BAD) {
+        snprintf(err, err_len, "m must be value, rate, avg, min or max");
+        return false;
+    }
+    cd->window = (uint8_t)constrain(evJsonGetInt(obj, "w", 10), 2, EV_WIN_MAX);
+    return true;
+}
+
+static void ruleFree(EvRule *r) {
+    for (int c = 0; c < r->ncond; c++) winFree(r->cond[c].win);
+    r->used = false;
+}
+
+static EvRule *ruleFind(const char *name) {
+    for (int r = 0; r < EV_MAX_RULES; r++)
+        if (g_rules[r].used && strcmp(g_rules[r].name, name) == 0) return &g_rules[r];
+    return nullptr;
+}
+
+bool eventsRuleSet(const char *json, char *err, size_t err_len) {
+    EvRule nr;
+    memset(&nr, 0, sizeof(nr));
+
+    if (!evJsonGetString(json, "n", nr.name, sizeof(nr.name)) || !ruleNameValid(nr.name)) {
+        snprintf(err, err_len, "n (rule name) missing or invalid");
+        return false;
+    }
+    char op[8] = "and";
+    evJsonGetString(json, "op", op, sizeof(op));
+    if (strcmp(op, "and") == 0)     nr.logic = EV_LOGIC_AND;
+    else if (strcmp(op, "or") == 0) nr.logic = EV_LOGIC_OR;
+    else {
+        snprintf(err, err_len, "op must be and or or");
+        return false;
+    }
+    nr.cooldown = (uint16_t)constrain(evJsonGetInt(json, "cd", 10), 0, 65535);
+    nr.act_dev = -1;
+
+    /* Optional action: "do":{"a":"fan","on":1,"off":0} */
+    const char *act = strstr(json, "\"do\"");
+    if (act) {
+        act += 4;
+        while (*act == ' ') act++;
+        act = (*act == ':') ? strchr(act, '{') : nullptr;
+    }
+    if (act) {
+        const char *ae = strchr(act, '}');
+        char obj[96];
+        size_t alen = ae ? (size_t)(ae - act + 1) : 0;
+        if (!ae || alen >= sizeof(obj)) {
+            snprintf(err, err_len, "do (action) malformed");
+            return false;
+        }
+        memcpy(obj, act, alen);
+        obj[alen] = '\0';
+        if (!evJsonGetString(obj, "a", nr.act, sizeof(nr.act))) {
+            snprintf(err, err_len, "do needs a (actuator)");
+            return false;
+        }
+        Device *a = deviceFind(nr.act);
+        if (a && !deviceIsActuator(a->kind)) {
+            snprintf(err, err_len, "%s is not an actuator", nr.act);
+            return false;
+        }
+        nr.act_on = evJsonGetInt(obj, "on", 1);
+        nr.act_has_off = strstr(obj, "\"off\"") != nullptr;
+        nr.act_off = evJsonGetInt(obj, "off", 0);
+    }
+
+    /* Conditions: flat objects inside "c":[ ... ] */
+    const char *p = strstr(json, "\"c\"");
+    if (p) p = strchr(p, '[');
+    if (!p) {
+        snprintf(err, err_len, "c (conditions) missing");
+        return false;
+    }
+    p++;
+    while (*p && *p != ']') {
+        const char *ob = strchr(p, '{');
+        const char *end = strchr(p, ']');
+        if (!ob || (end && end < ob)) break;
+        const char *oe = strchr(ob, '}');
+        if (!oe) break;
+        if (nr.ncond >= EV_RULE_CONDS) {
+            snprintf(err, err_len, "at most %d conditions", EV_RULE_CONDS);
+            return false;
+        }
+        char obj[160];
+        size_t olen = oe - ob + 1;
+        if (olen >= sizeof(obj)) {
+            snprintf(err, err_len, "condition too long");
+            return false;
+        }
+        memcpy(obj, ob, olen);
+        obj[olen] = '\0';
+        if (!condParse(obj, &nr.cond[nr.ncond], err, err_len)) return false;
+        nr.ncond++;
+        p = oe + 1;
+    }
+    if (nr.ncond == 0) {
+        snprintf(err, err_len, "c (conditions) empty");
+        return false;
+    }
+
+    EvRule *slot = ruleFind(nr.name);
+    if (slot) {
+        ruleFree(slot);
+    } else {
+        for (int r = 0; r < EV_MAX_RULES && !slot; r++)
+            if (!g_rules[r].used) slot = &g_rules[r];
+    }
+    if (!slot) {
+        snprintf(err, err_len, "rule table full (%d)", EV_MAX_RULES);
+        return false;
+    }
+
+    nr.used = true;
+    *slot = nr;
+    g_rules_gen = deviceRegistryGen() - 1;   /* force resolve on next sample */
+    return true;
+}
+
+bool eventsRuleClear(const char *name) {
+    EvRule *r = ruleFind(name);
+    if (!r) return false;
+    ruleFree(r);
+    return true;
+}
+
+int eventsRuleCount() {
+    int n = 0;
+    for (int r = 0; r < EV_MAX_RULES; r++)
+        if (g_rules[r].used) n++;
+    return n;
+}
+
+/* Serialize one rule; with_state adds runtime fields for listing */
+static int ruleToJson(const EvRule *r, char *out, size_t out_len, bool with_state) {
+    int w = snprintf(out, out_len, "{\"n\":\"%s\",\"op\":\"%s\",\"cd\":%u,\"c\":[",
+                     r->name, r->logic == EV_LOGIC_OR ? "or" : "and", r->cooldown);
+    for (int c = 0; c < r->ncond && w < (int)out_len; c++) {
+        const EvCond *cd = &r->cond[c];
+        w += snprintf(out + w, out_len - w,
+            "%s{\"s\":\"%s\",\"d\":\"%s\",\"t\":%.6g",
+            c ? "," : "", cd->sensor, cd->dir == EV_DIR_ABOVE ? "above" : "below",
+            cd->threshold);
+        if (w >= (int)out_len) break;
+        if (cd->hyst != 0.0f)
+            w += snprintf(out + w, out_len - w, ",\"h\":%.6g", cd->hyst);
+        if (w >= (int)out_len) break;
+        if (cd->mode != EV_MODE_VALUE)
+            w += snprintf(out + w, out_len - w, ",\"m\":\"%s\",\"w\":%d",
+                          eventsModeName(cd->mode), cd->window);
+        if (w >= (int)out_len) break;
+        if (with_state)
+            w += snprintf(out + w, out_len - w, ",\"active\":%s%s",
+                          cd->active ? "true" : "false",
+                          cd->dev < 0 ? ",\"missing\":true" : "");
+        if (w >= (int)out_len) break;
+        w += snprintf(out + w, out_len - w, "}");
+    }
+    if (r->act[0] && w < (int)out_len) {
+        w += snprintf(out + w, out_len - w, "],\"do\":{\"a\":\"%s\",\"on\":%d",
+                      r->act, r->act_on);
+        if (r->act_has_off && w < (int)out_len)
+            w += snprintf(out + w, out_len - w, ",\"off\":%d", r->act_off);
+        if (with_state && r->act_dev < 0 && w < (int)out_len)
+            w += snprintf(out + w, out_len - w, ",\"missing\":true");
+        if (w < (int)out_len)
+            w += snprintf(out + w, out_len - w, "}");
+    } else if (w < (int)out_len) {
+        w += snprintf(out + w, out_len - w, "]");
+    }
+    if (w < (int)out_len) {
+        if (with_state)
+            w += snprintf(out + w, out_len - w, ",\"active\":%s}",
+                          r->active ? "true" : "false");
+        else
+            w += snprintf(out + w, out_len - w, "}");
+    }
+    return w < (int)out_len ? w : (int)out_len - 1;
+}
+
+/* JSON array of all rules; a rule that doesn't fit whole is left out */
+static int rulesToJson(char *out, size_t out_len, bool with_state) {
+    static char one[640];
+    int w = snprintf(out, out_len, "[");
+    bool first = true;
+    for (int r = 0; r < EV_MAX_RULES; r++) {
+        if (!g_rules[r].used) continue;
+        int n = ruleToJson(&g_rules[r], one, sizeof(one), with_state);
+        if (w + n + 3 > (int)out_len) break;
+        if (!first) out[w++] = ',';
+        first = false;
+        memcpy(out + w, one, n);
+        w += n;
+    }
+    w += snprintf(out + w, out_len - w, "]");
+    return w;
+}
+
+int eventsRuleList(char *out, size_t out_len) {
+    rulesResolve();
+    return rulesToJson(out, out_len, true);
+}
+
+/*============================================================================
+ * Persistence - /rules.json next to /devices.bin
+ *============================================================================*/
+
+void eventsRulesSave() {
+    static char buf[4096];
+    if (eventsRuleCount() == 0) {
+        /* No rules: don't leave a stale file behind */
+        if (LittleFS.exists("/rules.json")) LittleFS.remove("/rules.json");
+        return;
+    }
+
+    int w = rulesToJson(buf, sizeof(buf), false);
+    File f = LittleFS.open("/rules.json", "w");
+    if (f) {
+        f.print(buf);
+        f.close();
+    }
+    if (g_debug) Serial.printf("Rules: saved to /rules.json (%d bytes)\n", w);
+}
+
+void eventsRulesLoad() {
+    for (int r = 0; r < EV_MAX_RULES; r++)
+        if (g_rules[r].used) ruleFree(&g_rules[r]);
+
+    static char buf[4096];
+    File f = LittleFS.open("/rules.json", "r");
+    if (!f) return;
+    int len = f.readBytes(buf, sizeof(buf) - 1);
+    buf[len] = '\0';
+    f.close();
+
+    /* Split top-level objects (rules contain a nested condition array) */
+    int count = 0;
+    const char *p = strchr(buf, '[');
+    if (!p) return;
+    p++;
+    while (*p) {
+        const char *ob = strchr(p, '{');
+        if (!ob) break;
+        int depth = 0;
+        bool in_str = false;
+        const char *q = ob;
+        for (; *q; q++) {
+            if (in_str) {
+                if (*q == '\\' && q[1]) { q++; continue; }
+                if (*q == '"') in_str = false;
+            } else if (*q == '"') {
+                in_str = true;
+            } else if (*q == '{') {
+                depth++;
+            } else if (*q == '}') {
+                if (--depth == 0) break;
+            }
+        }
+        if (!*q) break;
+
+        static char obj[640];
+        size_t olen = q - ob + 1;
+        if (olen < sizeof(obj)) {
+            memcpy(obj, ob, olen);
+            obj[olen] = '\0';
+            char err[64];
+            if (eventsRuleSet(obj, err, sizeof(err))) count++;
+            else Serial.printf("Rules: skipped invalid rule (%s)\n", err);
+        }
+        p = q + 1;
+    }
+    Serial.printf("Rules: loaded %d from /rules.json\n", count);
+}
@@ -0,0 +1,309 @@
+/**
+ * @file expr.cpp
+ * @brief Expression compiler (recursive descent -> postfix) and evaluator
+ */
+
+#include "expr.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+
+/* Opcodes. OP_K/OP_DEV take one operand byte, OP_FN takes two. */
+enum {
+    OP_K = 1,       /* push k[i] */
+    OP_DEV,         /* push value of device slot i */
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW, OP_NEG,
+    OP_FN,          /* fn id, argc */
+};
+
+enum {
+    FN_MIN, FN_MAX, FN_AVG, FN_ABS, FN_SQRT, FN_LOG, FN_EXP,
+    FN_ROUND, FN_POW, FN_DEW,
+};
+
+struct FnDef {
+    const char *name;
+    uint8_t     id;
+    uint8_t     min_args;
+    uint8_t     max_args;
+};
+
+static const FnDef FNS[] = {
+    {"min",   FN_MIN,   1, 8},
+    {"max",   FN_MAX,   1, 8},
+    {"avg",   FN_AVG,   1, 8},
+    {"abs",   FN_ABS,   1, 1},
+    {"sqrt",  FN_SQRT,  1, 1},
+    {"log",   FN_LOG,   1, 1},
+    {"exp",   FN_EXP,   1, 1},
+    {"round", FN_ROUND, 1, 1},
+    {"pow",   FN_POW,   2, 2},
+    {"dew",   FN_DEW,   2, 2},
+};
+
+/*============================================================================
+ * Compiler
+ *============================================================================*/
+
+struct Parser {
+    const char    *p;
+    ExprProg      *prog;
+    ExprResolveFn  resolve;
+    void          *ctx;
+    int            sp;          /* stack depth after the emitted code */
+    int            depth;       /* parser recursion, bounded by EXPR_NEST_MAX */
+    char          *err;
+    size_t         err_len;
+    bool           failed;
+};
+
+static void fail(Parser *ps, const char *fmt, const char *arg = "") {
+    if (ps->failed) return;
+    ps->failed = true;
+    snprintf(ps->err, ps->err_len, fmt, arg);
+}
+
+static void skipWs(Parser *ps) {
+    while (*ps->p == ' ' || *ps->p == '\t') ps->p++;
+}
+
+/* Emit one op; delta is its effect on the stack depth */
+static void emit(Parser *ps, int delta, uint8_t op, int a = -1, int b = -1) {
+    ExprProg *pr = ps->prog;
+    int need = 1 + (a >= 0) + (b >= 0);
+    if (pr->len + need > EXPR_CODE_MAX) { fail(ps, "expression too long"); return; }
+    pr->code[pr->len++] = op;
+    if (a >= 0) pr->code[pr->len++] = (uint8_t)a;
+    if (b >= 0) pr->code[pr->len++] = (uint8_t)b;
+    ps->sp += delta;
+    if (ps->sp > EXPR_STACK_MAX) fail(ps, "expression nested too deeply");
+}
+
+static void parseExpr(Parser *ps);
+
+static void parsePrimary(Parser *ps) {
+    skipWs(ps);
+    char c = *ps->p;
+
+    if (c == '(') {
+        ps->p++;
+        parseExpr(ps);
+        skipWs(ps);
+        if (*ps->p != ')') { fail(ps, "missing ')'"); return; }
+        ps->p++;
+        return;
+    }
+
+    if (isdigit((unsigned char)c) || c == '.') {
+        char *end;
+        float v = strtof(ps->p, &end);
+        if (end == ps->p) { fail(ps, "bad number"); return; }
+        ps->p = end;
+        ExprProg *pr = ps->prog;
+        int i = 0;
+        while (i < pr->nk && pr->k[i] != v) i++;     /* reuse equal literals */
+        if (i == pr->nk) {
+            if (pr->nk >= EXPR_CONST_MAX) { fail(ps, "too many constants"); return; }
+            pr->k[pr->nk++] = v;
+        }
+        emit(ps, 1, OP_K, i);
+        return;
+    }
+
+    if (isalpha((unsigned char)c) || c == '_') {
+        char name[32];
+        int n = 0;
+        while ((isalnum((unsigned char)*ps->p) || *ps->p == '_') && n < (int)sizeof(name) - 1)
+            name[n++] = *ps->p++;
+        name[n] = '\0';
+        skipWs(ps);
+
+        if (*ps->p == '(') {
+            const FnDef *fn = nullptr;
+            for (size_t i = 0; i < sizeof(FNS) / sizeof(FNS[0]); i++)
+                if (strcmp(FNS[i].name, name) == 0) fn = &FNS[i];
+            if (!fn) { fail(ps, "unknown function '%s'", name); return; }
+            ps->p++;
+            int argc = 0;
+            skipWs(ps);
+            if (*ps->p != ')') {
+                for (;;) {
+                    parseExpr(ps);
+                    if (ps->failed) return;
+                    argc++;
+                    skipWs(ps);
+                    if (*ps->p == ',') { ps->p++; continue; }
+                    break;
+                }
+            }
+            if (*ps->p != ')') { fail(ps, "missing ')' after arguments"); return; }
+            ps->p++;
+            if (argc < fn->min_args || argc > fn->max_args) {
+                fail(ps, "wrong number of arguments to '%s'", fn->name);
+                return;
+            }
+            emit(ps, 1 - argc, OP_FN, fn->id, argc);
+            return;
+        }
+
+        int slot = ps->resolve(name, ps->ctx);
+        if (slot < 0) { fail(ps, "unknown sensor '%s'", name); return; }
+        emit(ps, 1, OP_DEV, slot);
+        return;
+    }
+
+    char tok[2] = {c, '\0'};
+    if (c == '\0') fail(ps, "unexpected end");
+    else           fail(ps, "unexpected '%s'", tok);
+}
+
+static void parseUnary(Parser *ps);
+
+/* power := primary ('^' unary)?  - right-associative, binds tighter than unary minus */
+static void parsePower(Parser *ps) {
+    parsePrimary(ps);
+    skipWs(ps);
+    if (!ps->failed && *ps->p == '^') {
+        ps->p++;
+        parseUnary(ps);
+        emit(ps, -1, OP_POW);
+    }
+}
+
+/* Every recursive path - parentheses, function arguments, signs and the
+   right side of '^' - passes through here, so one counter bounds the
+   C stack the parser uses on the 8 KB loop task. */
+static void parseUnary(Parser *ps) {
+    if (++ps->depth > EXPR_NEST_MAX) {
+        fail(ps, "expression nested too deeply");
+        ps->depth--;
+        return;
+    }
+    skipWs(ps);
+    if (*ps->p == '-') {
+        ps->p++;
+        parseUnary(ps);
+        emit(ps, 0, OP_NEG);
+    } else {
+        if (*ps->p == '+') ps->p++;
+        parsePower(ps);
+    }
+    ps->depth--;
+}
+
+static void parseTerm(Parser *ps) {
+    parseUnary(ps);
+    for (;;) {
+        skipWs(ps);
+        char c = *ps->p;
+        if (ps->failed || (c != '*' && c != '/' && c != '%')) return;
+        ps->p++;
+        parseUnary(ps);
+        emit(ps, -1, c == '*' ? OP_MUL : c == '/' ? OP_DIV : OP_MOD);
+    }
+}
+
+static void parseExpr(Parser *ps) {
+    parseTerm(ps);
+    for (;;) {
+        skipWs(ps);
+        char c = *ps->p;
+        if (ps->failed || (c != '+' && c != '-')) return;
+        ps->p++;
+        parseTerm(ps);
+        emit(ps, -1, c == '+' ? OP_ADD : OP_SUB);
+    }
+}
+
+bool exprCompile(const char *src, ExprResolveFn resolve, void *ctx,
+                 ExprProg *prog, char *err, size_t err_len) {
+    memset(prog, 0, sizeof(*prog));
+    char dummy[4];
+    if (!err || err_len == 0) { err = dummy; err_len = sizeof(dummy); }
+    err[0] = '\0';
+
+    Parser ps = {src ? src : "", prog, resolve, ctx, 0, 0, err, err_len, false};
+    parseExpr(&ps);
+    skipWs(&ps);
+    if (!ps.failed && *ps.p != '\0') {
+        char tok[2] = {*ps.p, '\0'};
+        fail(&ps, "unexpected '%s'", tok);
+    }
+    if (!ps.failed && ps.sp != 1) fail(&ps, "empty expression");
+
+    prog->ok = !ps.failed;
+    if (!prog->ok) prog->len = 0;
+    return prog->ok;
+}
+
+/*============================================================================
+ * Evaluator
+ *============================================================================*/
+
+/* Dew point (Magnus, valid -45..60 C) */
+static float dewPoint(float t, float rh) {
+    const float b = 17.62f, c = 243.12f;
+    if (rh <= 0.0f) return NAN;
+    float g = logf(rh / 100.0f) + b * t / (c + t);
+    return c * g / (b - g);
+}
+
+static float callFn(uint8_t id, const float *a, int n) {
+    switch (id) {
+        /* Not fminf/fmaxf: they drop a NaN operand and would hide a failed input */
+        case FN_MIN: {
+            float m = a[0];
+            for (int i = 1; i < n; i++) m = isnan(m) || isnan(a[i]) ? NAN : (a[i] < m ? a[i] : m);
+            return m;
+        }
+        case FN_MAX: {
+            float m = a[0];
+            for (int i = 1; i < n; i++) m = isnan(m) || isnan(a[i]) ? NAN : (a[i] > m ? a[i] : m);
+            return m;
+        }
+        case FN_AVG: { float s = 0;    for (int i = 0; i < n; i++) s += a[i];          return s / n; }
+        case FN_ABS:   return fabsf(a[0]);
+        case FN_SQRT:  return sqrtf(a[0]);
+        case FN_LOG:   return logf(a[0]);
+        case FN_EXP:   return expf(a[0]);
+        case FN_ROUND: return roundf(a[0]);
+        case FN_POW:   return powf(a[0], a[1]);
+        case FN_DEW:   return dewPoint(a[0], a[1]);
+        default:       return NAN;
+    }
+}
+
+float exprEval(const ExprProg *prog, ExprLoadFn load, void *ctx) {
+    if (!prog || !prog->ok) return NAN;
+    float st[EXPR_STACK_MAX];
+    int sp = 0;
+    const uint8_t *c = prog->code;
+    const uint8_t *end = c + prog->len;
+
+    /* Stack bounds were proven at compile time */
+    while (c < end) {
+        uint8_t op = *c++;
+        switch (op) {
+            case OP_K:   st[sp++] = prog->k[*c++]; break;
+            case OP_DEV: st[sp++] = load(*c++, ctx); break;
+            case OP_ADD: sp--; st[sp - 1] += st[sp]; break;
+            case OP_SUB: sp--; st[sp - 1] -= st[sp]; break;
+            case OP_MUL: sp--; st[sp - 1] *= st[sp]; break;
+            case OP_DIV: sp--; st[sp - 1] /= st[sp]; break;
+            case OP_MOD: sp--; st[sp - 1] = fmodf(st[sp - 1], st[sp]); break;
+            case OP_POW: sp--; st[sp - 1] = powf(st[sp - 1], st[sp]); break;
+            case OP_NEG: st[sp - 1] = -st[sp - 1]; break;
+            case OP_FN: {
+                uint8_t id = *c++, n = *c++;
+                sp -= n;
+                st[sp] = callFn(id, &st[sp], n);
+                sp++;
+                break;
+            }
+            default: return NAN;
+        }
+    }
+    return sp == 1 ? st[0] : NAN;
+}
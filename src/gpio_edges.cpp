@@ -0,0 +1,74 @@
+/**
+ * @file gpio_edges.cpp
+ * @brief Interrupt-captured GPIO edges for digital inputs
+ *
+ * The ISR reads the timer and the pin level straight from the GPIO
+ * registers (both IRAM-safe) and publishes the slot into the ring with a
+ * release store of the head index; the loop consumes with an acquire load.
+ * Bounces are queued like any other edge - filtering happens on the
+ * consumer side, where it costs no interrupt time.
+ */
+
+#include "gpio_edges.h"
+#include "devices.h"
+#include "loop_sched.h"
+#include <esp_timer.h>
+#include <hal/gpio_ll.h>
+
+struct EdgePin {
+    uint8_t slot;
+    uint8_t pin;
+    bool    attached;
+};
+
+static EdgePin   g_edge_pin[MAX_DEVICES];
+static EdgeEvent g_edge_q[EDGE_QUEUE_LEN];
+static uint32_t  g_edge_head = 0;       /* written by the ISR only */
+static uint32_t  g_edge_tail = 0;       /* written by the loop only */
+static volatile uint32_t g_edge_dropped = 0;
+
+static void IRAM_ATTR edgeIsr(void *arg) {
+    const EdgePin *p = (const EdgePin *)arg;
+    uint32_t head = g_edge_head;
+    uint32_t tail = __atomic_load_n(&g_edge_tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= EDGE_QUEUE_LEN) {
+        g_edge_dropped++;
+        return;
+    }
+    EdgeEvent *e = &g_edge_q[head & (EDGE_QUEUE_LEN - 1)];
+    e->slot  = p->slot;
+    e->level = (uint8_t)gpio_ll_get_level(&GPIO, p->pin);
+    e->t_us  = (uint64_t)esp_timer_get_time();
+    __atomic_store_n(&g_edge_head, head + 1, __ATOMIC_RELEASE);
+    loopWakeFromIsr();
+}
+
+void edgeAttach(uint8_t slot, uint8_t pin) {
+    if (slot >= MAX_DEVICES || pin == PIN_NONE) return;
+    EdgePin *p = &g_edge_pin[slot];
+    if (p->attached) edgeDetach(slot);
+    p->slot = slot;
+    p->pin = pin;
+    p->attached = true;
+    pinMode(pin, INPUT);
+    attachInterruptArg(digitalPinToInterrupt(pin), edgeIsr, p, CHANGE);
+}
+
+void edgeDetach(uint8_t slot) {
+    if (slot >= MAX_DEVICES || !g_edge_pin[slot].attached) return;
+    detachInterrupt(digitalPinToInterrupt(g_edge_pin[slot].pin));
+    g_edge_pin[slot].attached = false;
+}
+
+bool edgePop(EdgeEvent *out) {
+    uint32_t tail = g_edge_tail;
+    uint32_t head = __atomic_load_n(&g_edge_head, __ATOMIC_ACQUIRE);
+    if (tail == head) return false;
+    *out = g_edge_q[tail & (EDGE_QUEUE_LEN - 1)];
+    __atomic_store_n(&g_edge_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t edgeDropped() {
+    return g_edge_dropped;
+}
@@ -0,0 +1,479 @@
+/**
+ * @file history.cpp
+ * @brief Multi-resolution sensor history - delta-encoded int16 blocks
+ *
+ * Every tier is a ring of fixed-size blocks. A block stores its first
+ * timestamp, the first value as float and then one int16 delta per point,
+ * taken against the reconstructed previous value so quantization error
+ * never accumulates. Aggregate tiers additionally store min/max as uint16
+ * offsets below/above the average. A block is closed when it is full,
+ * when a delta does not fit in int16, or when the series has a gap longer
+ * than HIST_GAP_FILL steps; shorter gaps hold the last value.
+ */
+
+#include "history.h"
+#include "seglog.h"
+#include <math.h>
+#include <time.h>
+
+/*============================================================================
+ * Storage
+ *============================================================================*/
+
+/* Quantum per block, picked from the magnitude of its first value */
+static const float HIST_QUANTUM[] = { 0.01f, 0.1f, 1.0f, 10.0f };
+
+#define HIST_DELTAS   (HIST_BLOCK_LEN - 1)
+
+static_assert(HIST_RAW_BLOCKS >= HIST_MIN_BLOCKS && HIST_RAW_BLOCKS >= HIST_HOUR_BLOCKS,
+              "query block ordering is sized by the raw tier");
+
+struct HistBlock {
+    uint32_t t0;        /* timestamp of the first point */
+    float    base;      /* first value (average for aggregate tiers) */
+    float    last;      /* reconstructed last value (encoder state) */
+    uint8_t  count;     /* points in block, 0 = empty */
+    uint8_t  q;         /* index into HIST_QUANTUM */
+};
+
+/* Running aggregate for the minute/hour tiers */
+struct HistAcc {
+    uint32_t slot;      /* start of the interval being accumulated */
+    uint32_t n;         /* raw samples in the interval */
+    float    sum;
+    float    lo;
+    float    hi;
+};
+
+struct HistSeries {
+    int8_t    dev;      /* device slot, -1 = free */
+    uint8_t   head[3];  /* newest block per tier */
+    uint32_t  key;      /* seglogKey(name) */
+
+    HistBlock raw_blk[HIST_RAW_BLOCKS];
+    int16_t   raw_d[HIST_RAW_BLOCKS * HIST_DELTAS];
+
+    HistBlock min_blk[HIST_MIN_BLOCKS];
+    int16_t   min_d[HIST_MIN_BLOCKS * HIST_DELTAS];
+    uint16_t  min_lo[HIST_MIN_BLOCKS * HIST_BLOCK_LEN];
+    uint16_t  min_hi[HIST_MIN_BLOCKS * HIST_BLOCK_LEN];
+
+    HistBlock hour_blk[HIST_HOUR_BLOCKS];
+    int16_t   hour_d[HIST_HOUR_BLOCKS * HIST_DELTAS];
+    uint16_t  hour_lo[HIST_HOUR_BLOCKS * HIST_BLOCK_LEN];
+    uint16_t  hour_hi[HIST_HOUR_BLOCKS * HIST_BLOCK_LEN];
+
+    HistAcc   acc_min;
+    HistAcc   acc_hour;
+};
+
+/* Uniform view of one tier of a series */
+struct HistTier {
+    HistBlock *blk;
+    int16_t   *d;
+    uint16_t  *lo;      /* nullptr for the raw tier */
+    uint16_t  *hi;
+    uint8_t   *head;
+    uint8_t    nblk;
+    uint16_t   step;    /* seconds per point */
+};
+
+enum { TIER_RAW = 0, TIER_MIN, TIER_HOUR };
+
+/* Series are heap-allocated when a sensor first records, so a node
+   without sensors pays only for this table */
+static HistSeries *g_series[HIST_MAX_SERIES];
+
+static HistSeries *seriesFind(int dev_idx, const char *name) {
+    for (int i = 0; i < HIST_MAX_SERIES; i++)
+        if (g_series[i] && g_series[i]->dev == dev_idx) return g_series[i];
+    if (!name) return nullptr;
+    for (int i = 0; i < HIST_MAX_SERIES; i++) {
+        if (g_series[i]) continue;
+        if (ESP.getFreeHeap() < sizeof(HistSeries) + HIST_HEAP_RESERVE) return nullptr;
+        HistSeries *s = (HistSeries *)calloc(1, sizeof(HistSeries));
+        if (!s) return nullptr;
+        s->dev = (int8_t)dev_idx;
+        s->key = seglogKey(name);
+        g_series[i] = s;
+        return s;
+    }
+    return nullptr;  /* all series in use */
+}
+
+static void seriesFree(int i) {
+    free(g_series[i]);
+    g_series[i] = nullptr;
+}
+
+static HistTier tierOf(HistSeries *s, int tier) {
+    HistTier t;
+    switch (tier) {
+        case TIER_RAW:
+            t = { s->raw_blk, s->raw_d, nullptr, nullptr,
+                  &s->head[TIER_RAW], HIST_RAW_BLOCKS, 1 };
+            break;
+        case TIER_MIN:
+            t = { s->min_blk, s->min_d, s->min_lo, s->min_hi,
+                  &s->head[TIER_MIN], HIST_MIN_BLOCKS, 60 };
+            break;
+        default:
+            t = { s->hour_blk, s->hour_d, s->hour_lo, s->hour_hi,
+                  &s->head[TIER_HOUR], HIST_HOUR_BLOCKS, 3600 };
+            break;
+    }
+    return t;
+}
+
+/*============================================================================
+ * Encoding
+ *============================================================================*/
+
+static uint8_t quantumFor(float v) {
+    float a = fabsf(v);
+    if (a < 300.0f)   return 0;
+    if (a < 3000.0f)  return 1;
+    if (a < 30000.0f) return 2;
+    return 3;
+}
+
+/* Store min/max offsets of point i. Returns false if they do not fit. */
+static bool blockPutRange(const HistTier &t, int b, int i,
+                          float avg, float lo, float hi) {
+    if (!t.lo) return true;
+    float q = HIST_QUANTUM[t.blk[b].q];
+    long dl = lroundf((avg - lo) / q);
+    long dh = lroundf((hi - avg) / q);
+    if (dl < 0) dl = 0;
+    if (dh < 0) dh = 0;
+    if (dl > 0xFFFF || dh > 0xFFFF) return false;
+    t.lo[b * HIST_BLOCK_LEN + i] = (uint16_t)dl;
+    t.hi[b * HIST_BLOCK_LEN + i] = (uint16_t)dh;
+    return true;
+}
+
+/* Start a new block at ts in the next ring slot */
+static void blockStart(const HistTier &t, uint32_t ts,
+                       float avg, float lo, float hi) {
+    *t.head = (uint8_t)((*t.head + 1) % t.nblk);
+    int b = *t.head;
+    HistBlock *blk = &t.blk[b];
+    blk->t0    = ts;
+    blk->base  = avg;
+    blk->last  = avg;
+    blk->count = 1;
+    blk->q     = quantumFor(avg);
+    if (!blockPutRange(t, b, 0, avg, lo, hi)) {
+        /* Range too wide even for the first point: clamp */
+        t.lo[b * HIST_BLOCK_LEN] = 0xFFFF;
+        t.hi[b * HIST_BLOCK_LEN] = 0xFFFF;
+    }
+}
+
+/* Append one point to the newest block. Returns false if it does not fit. */
+static bool blockPush(const HistTier &t, float avg, float lo, float hi) {
+    int b = *t.head;
+    HistBlock *blk = &t.blk[b];
+    if (blk->count == 0 || blk->count >= HIST_BLOCK_LEN) return false;
+
+    float q = HIST_QUANTUM[blk->q];
+    long d = lroundf((avg - blk->last) / q);
+    if (d < INT16_MIN || d > INT16_MAX) return false;
+    float recon = blk->last + (float)d * q;
+    if (!blockPutRange(t, b, blk->count, recon, lo, hi)) return false;
+
+    t.d[b * HIST_DELTAS + blk->count - 1] = (int16_t)d;
+    blk->last = recon;
+    blk->count++;
+    return true;
+}
+
+static void tierAppend(const HistTier &t, uint32_t ts,
+                       float avg, float lo, float hi) {
+    HistBlock *blk = &t.blk[*t.head];
+
+    if (blk->count > 0) {
+        uint32_t next = blk->t0 + (uint32_t)blk->count * t.step;
+        if (ts >= blk->t0 && ts < next) return;        /* slot already filled */
+        if (ts >= next) {
+            uint32_t missing = (ts - next) / t.step;
+            if (missing <= HIST_GAP_FILL) {
+                /* Short gap: hold the last value */
+                bool ok = true;
+                for (uint32_t m = 0; m < missing && ok; m++)
+                    ok = blockPush(t, blk->last, blk->last, blk->last);
+                if (ok && blockPush(t, avg, lo, hi)) return;
+                if (ok) { blockStart(t, ts, avg, lo, hi); return; }
+            }
+        }
+    }
+    /* Empty tier, long gap, clock moved back, or block full */
+    blockStart(t, ts, avg, lo, hi);
+}
+
+/*============================================================================
+ * Recording
+ *============================================================================*/
+
+#define HIST_EPOCH_MIN  1600000000u   /* earlier time() values mean "not synced" */
+
+uint32_t historyNow() {
+    time_t t = time(nullptr);
+    if (t > (time_t)HIST_EPOCH_MIN) return (uint32_t)t;
+    return millis() / 1000;
+}
+
+bool historyClockSynced() {
+    return time(nullptr) > (time_t)HIST_EPOCH_MIN;
+}
+
+static void accFlush(HistSeries *s, HistAcc &acc, int tier) {
+    if (acc.n == 0) return;
+    float avg = acc.sum / acc.n;
+    tierAppend(tierOf(s, tier), acc.slot, avg, acc.lo, acc.hi);
+    /* Persist finished minutes; uptime timestamps are meaningless after reboot */
+    if (tier == TIER_MIN && acc.slot > HIST_EPOCH_MIN) {
+        SeglogRecord rec = { acc.slot, s->key, avg, acc.lo, acc.hi };
+        seglogAppend(rec);
+    }
+}
+
+static void accAdd(HistAcc &acc, uint32_t slot, float sum, uint32_t n,
+                   float lo, float hi) {
+    if (acc.n == 0 || acc.slot != slot) {
+        acc.slot = slot;
+        acc.n    = 0;
+        acc.sum  = 0.0f;
+        acc.lo   = lo;
+        acc.hi   = hi;
+    }
+    acc.sum += sum;
+    acc.n   += n;
+    if (lo < acc.lo) acc.lo = lo;
+    if (hi > acc.hi) acc.hi = hi;
+}
+
+/* Close the minute in acc_min and roll it into the hour (minute-weighted) */
+static void minuteDone(HistSeries *s) {
+    HistAcc &m = s->acc_min;
+    accFlush(s, m, TIER_MIN);
+    uint32_t hslot = m.slot - m.slot % 3600;
+    if (s->acc_hour.n > 0 && s->acc_hour.slot != hslot) {
+        accFlush(s, s->acc_hour, TIER_HOUR);
+        s->acc_hour.n = 0;
+    }
+    accAdd(s->acc_hour, hslot, m.sum / m.n, 1, m.lo, m.hi);
+    m.n = 0;
+}
+
+void historyRecord(int dev_idx, const char *name, float value) {
+    if (isnan(value) || isinf(value)) return;
+    HistSeries *s = seriesFind(dev_idx, name);
+    if (!s) return;
+
+    uint32_t now = historyNow();
+    tierAppend(tierOf(s, TIER_RAW), now, value, value, value);
+
+    /* Minute boundary: push the finished minute, roll it into the hour */
+    uint32_t mslot = now - now % 60;
+    if (s->acc_min.n > 0 && s->acc_min.slot != mslot)
+        minuteDone(s);
+    accAdd(s->acc_min, mslot, value, 1, value, value);
+}
+
+bool historyLast(int dev_idx, float *out) {
+    HistSeries *s = seriesFind(dev_idx, nullptr);
+    if (!s) return false;
+    const HistBlock *blk = &s->raw_blk[s->head[TIER_RAW]];
+    if (blk->count == 0) return false;
+    *out = blk->last;
+    return true;
+}
+
+int historyRestore(int dev_idx, const char *name) {
+    HistSeries *s = seriesFind(dev_idx, name);
+    if (!s) return 0;
+
+    HistTier mt = tierOf(s, TIER_MIN);
+    SeglogReader r;
+    SeglogRecord rec;
+    int n = 0;
+    seglogReaderOpen(&r, s->key, HIST_EPOCH_MIN, historyNow());
+    while (seglogReaderNext(&r, &rec)) {
+        tierAppend(mt, rec.t, rec.v, rec.lo, rec.hi);
+        uint32_t hslot = rec.t - rec.t % 3600;
+        if (s->acc_hour.n > 0 && s->acc_hour.slot != hslot) {
+            accFlush(s, s->acc_hour, TIER_HOUR);
+            s->acc_hour.n = 0;
+        }
+        accAdd(s->acc_hour, hslot, rec.v, 1, rec.lo, rec.hi);
+        n++;
+    }
+    seglogReaderClose(&r);
+    return n;
+}
+
+void historyRelease(int dev_idx) {
+    for (int i = 0; i < HIST_MAX_SERIES; i++)
+        if (g_series[i] && g_series[i]->dev == dev_idx) seriesFree(i);
+}
+
+void historyReset() {
+    for (int i = 0; i < HIST_MAX_SERIES; i++) seriesFree(i);
+}
+
+int historySeriesCount() {
+    int n = 0;
+    for (int i = 0; i < HIST_MAX_SERIES; i++)
+        if (g_series[i]) n++;
+    return n;
+}
+
+/*============================================================================
+ * Query
+ *============================================================================*/
+
+/* Read a numeric parameter from "k=v&..." or {"k":v,...} */
+static bool histParam(const char *q, const char *key, long *out) {
+    size_t klen = strlen(key);
+    for (const char *p = q; (p = strstr(p, key)) != nullptr; p += klen) {
+        if (p > q && isalnum((unsigned char)p[-1])) continue;
+        const char *v = p + klen;
+        if (*v == '"') v++;
+        while (*v == ' ') v++;
+        if (*v != '=' && *v != ':') continue;
+        v++;
+        while (*v == ' ') v++;
+        char *end = nullptr;
+        long n = strtol(v, &end, 10);
+        if (end == v) return false;
+        *out = n;
+        return true;
+    }
+    return false;
+}
+
+static uint32_t histResolveTime(long t, uint32_t now) {
+    if (t > 0) return (uint32_t)t;
+    if ((uint32_t)(-t) > now) return 0;
+    return now - (uint32_t)(-t);
+}
+
+bool historyQuery(int dev_idx, const char *name, const char *unit,
+                  const char *query, char *out, size_t out_len) {
+    uint32_t now = historyNow();
+    long from_arg = -3600, to_arg = 0, res = 0;
+    if (query) {
+        histParam(query, "from", &from_arg);
+        histParam(query, "to", &to_arg);
+        histParam(query, "res", &res);
+    }
+    uint32_t from = histResolveTime(from_arg, now);
+    uint32_t to   = histResolveTime(to_arg, now);
+    if (from > to) {
+        snprintf(out, out_len, "{\"error\":\"bad_range\",\"detail\":\"from > to\"}");
+        return false;
+    }
+    if (res == 0) {
+        uint32_t span = to - from;
+        res = span <= 600 ? 1 : (span <= 6 * 3600 ? 60 : 3600);
+    }
+    int tier;
+    if (res == 1)         tier = TIER_RAW;
+    else if (res == 60)   tier = TIER_MIN;
+    else if (res == 3600) tier = TIER_HOUR;
+    else {
+        snprintf(out, out_len, "{\"error\":\"bad_res\",\"detail\":\"res is 1, 60 or 3600\"}");
+        return false;
+    }
+
+    int w = snprintf(out, out_len,
+        "{\"sensor\":\"%s\",\"unit\":\"%s\",\"res\":%ld,\"now\":%u,"
+        "\"from\":%u,\"points\":[",
+        name, unit, res, (unsigned)now, (unsigned)from);
+
+    HistSeries *s = seriesFind(dev_idx, nullptr);
+    bool more = false;
+    uint32_t next = 0;
+    bool first = true;
+
+    /* Minutes older than the RAM tier come from the segment log */
+    if (tier == TIER_MIN && from > HIST_EPOCH_MIN) {
+        uint32_t oldest = UINT32_MAX;
+        if (s) {
+            HistTier t = tierOf(s, TIER_MIN);
+            for (int b = 0; b < t.nblk; b++)
+                if (t.blk[b].count > 0 && t.blk[b].t0 < oldest) oldest = t.blk[b].t0;
+        }
+        if (from < oldest) {
+            SeglogReader r;
+            SeglogRecord rec;
+            seglogReaderOpen(&r, seglogKey(name), from, oldest - 1 < to ? oldest - 1 : to);
+            while (seglogReaderNext(&r, &rec)) {
+                if (w >= (int)out_len - 96) {
+                    more = true;
+                    next = rec.t;
+                    break;
+                }
+                if (!first) out[w++] = ',';
+                first = false;
+                w += snprintf(out + w, out_len - w, "[%u,%.6g,%.6g,%.6g]",
+                              (unsigned)(rec.t - from), rec.v, rec.lo, rec.hi);
+            }
+            seglogReaderClose(&r);
+        }
+    }
+
+    if (s && !more) {
+        HistTier t = tierOf(s, tier);
+
+        /* Visit blocks oldest-first */
+        int order[HIST_RAW_BLOCKS];
+        int nb = 0;
+        for (int b = 0; b < t.nblk; b++) {
+            if (t.blk[b].count == 0) continue;
+            int j = nb++;
+            while (j > 0 && t.blk[order[j - 1]].t0 > t.blk[b].t0) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = b;
+        }
+
+        for (int k = 0; k < nb && !more; k++) {
+            int b = order[k];
+            const HistBlock *blk = &t.blk[b];
+            float q = HIST_QUANTUM[blk->q];
+            float v = blk->base;
+            for (int i = 0; i < blk->count; i++) {
+                if (i > 0) v += (float)t.d[b * HIST_DELTAS + i - 1] * q;
+                uint32_t ts = blk->t0 + (uint32_t)i * t.step;
+                if (ts < from) continue;
+                if (ts > to) break;
+                /* Leave room for the trailer */
+                if (w >= (int)out_len - 96) {
+                    more = true;
+                    next = ts;
+                    break;
+                }
+                if (!first) out[w++] = ',';
+                first = false;
+                if (t.lo) {
+                    float lo = v - (float)t.lo[b * HIST_BLOCK_LEN + i] * q;
+                    float hi = v + (float)t.hi[b * HIST_BLOCK_LEN + i] * q;
+                    w += snprintf(out + w, out_len - w, "[%u,%.6g,%.6g,%.6g]",
+                                  (unsigned)(ts - from), v, lo, hi);
+                } else {
+                    w += snprintf(out + w, out_len - w, "[%u,%.6g]",
+                                  (unsigned)(ts - from), v);
+                }
+            }
+        }
+    }
+
+    if (more)
+        snprintf(out + w, out_len - w, "],\"more\":true,\"next\":%u}", (unsigned)next);
+    else
+        snprintf(out + w, out_len - w, "],\"more\":false}");
+    return true;
+}
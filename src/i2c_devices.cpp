@@ -4,53 +4,120 @@
  *
  * No external libraries — all register-level I2C communication.
  * Includes drivers for BME280, BH1750, SHT31, ADS1115, and generic register reads.
+ * Sensors with a conversion time run through a trigger/collect queue.
  */
 
 #include "i2c_devices.h"
+#include "i2c_queue.h"
 #include <Wire.h>
+#include "esp32-hal-i2c.h"
+#include "loop_sched.h"
 
 extern bool g_debug;
 
 /*============================================================================
- * I2C Bus Management (reference counted)
+ * I2C Bus Management (reference counted per bus)
  *============================================================================*/
 
-static int  g_i2c_ref_count = 0;
-static bool g_i2c_initialized = false;
+struct I2cBus {
+    TwoWire *wire;
+    int8_t   sda;
+    int8_t   scl;
+    uint32_t hz;
+    int      ref_count;
+    bool     initialized;
+};
 
-void i2cInit() {
-    if (g_i2c_initialized) {
-        g_i2c_ref_count++;
-        return;
+#if I2C_BUS_MAX > 1
+static I2cBus g_i2c_bus[I2C_BUS_MAX] = {
+    { &Wire,  I2C_SDA,  I2C_SCL,  I2C_DEFAULT_HZ, 0, false },
+    { &Wire1, I2C1_SDA, I2C1_SCL, I2C_DEFAULT_HZ, 0, false },
+};
+#else
+static I2cBus g_i2c_bus[I2C_BUS_MAX] = {
+    { &Wire,  I2C_SDA,  I2C_SCL,  I2C_DEFAULT_HZ, 0, false },
+};
+#endif
+
+static void i2cJobsClear(uint8_t addr);
+static void i2cJobsClearBus(uint8_t bus);
+
+/* Bus for a (possibly bus-qualified) address, or nullptr if not running */
+static I2cBus *i2cBusOf(uint8_t addr) {
+    uint8_t bus = I2C_ADDR_BUS(addr);
+    if (bus >= I2C_BUS_MAX || !g_i2c_bus[bus].initialized) return nullptr;
+    return &g_i2c_bus[bus];
+}
+
+static void i2cBusBegin(I2cBus *b) {
+    b->wire->begin(b->sda, b->scl, b->hz);
+    b->wire->setTimeOut(50);
+}
+
+void i2cBusConfig(uint8_t bus, int sda, int scl, uint32_t hz) {
+    if (bus >= I2C_BUS_MAX) return;
+    I2cBus *b = &g_i2c_bus[bus];
+    if (sda >= 0) b->sda = (int8_t)sda;
+    if (scl >= 0) b->scl = (int8_t)scl;
+    if (hz > 0) {
+        b->hz = hz;
+        if (b->initialized) b->wire->setClock(hz);
     }
-    Wire.begin(I2C_SDA, I2C_SCL);
-    Wire.setTimeOut(50);
-    g_i2c_initialized = true;
-    g_i2c_ref_count = 1;
-    Serial.printf("I2C: initialized (SDA=%d SCL=%d)\n", I2C_SDA, I2C_SCL);
-}
-
-void i2cDeinit() {
-    if (!g_i2c_initialized) return;
-    g_i2c_ref_count--;
-    if (g_i2c_ref_count <= 0) {
-        Wire.end();
-        g_i2c_initialized = false;
-        g_i2c_ref_count = 0;
-        Serial.println("I2C: deinitialized");
+}
+
+bool i2cBusInfo(uint8_t bus, int *sda, int *scl, uint32_t *hz) {
+    if (bus >= I2C_BUS_MAX) return false;
+    *sda = g_i2c_bus[bus].sda;
+    *scl = g_i2c_bus[bus].scl;
+    *hz  = g_i2c_bus[bus].hz;
+    return g_i2c_bus[bus].initialized;
+}
+
+TwoWire *i2cBusWire(uint8_t addr) {
+    I2cBus *b = i2cBusOf(addr);
+    return b ? b->wire : nullptr;
+}
+
+bool i2cInit(uint8_t bus) {
+    if (bus >= I2C_BUS_MAX) return false;
+    I2cBus *b = &g_i2c_bus[bus];
+    if (b->initialized) {
+        b->ref_count++;
+        return true;
     }
+    i2cBusBegin(b);
+    b->initialized = true;
+    b->ref_count = 1;
+    Serial.printf("I2C: bus %d initialized (SDA=%d SCL=%d, %lu Hz)\n",
+                  bus, b->sda, b->scl, (unsigned long)b->hz);
+    return true;
 }
 
-bool i2cActive() {
-    return g_i2c_initialized;
+void i2cDeinit(uint8_t bus) {
+    if (bus >= I2C_BUS_MAX) return;
+    I2cBus *b = &g_i2c_bus[bus];
+    if (!b->initialized) return;
+    b->ref_count--;
+    if (b->ref_count <= 0) {
+        b->wire->end();
+        i2cJobsClearBus(bus);
+        b->initialized = false;
+        b->ref_count = 0;
+        Serial.printf("I2C: bus %d deinitialized\n", bus);
+    }
 }
 
-int i2cScan(uint8_t *addrs, int max_addrs) {
-    if (!g_i2c_initialized) return 0;
+bool i2cActive(uint8_t bus) {
+    return bus < I2C_BUS_MAX && g_i2c_bus[bus].initialized;
+}
+
+int i2cScan(uint8_t *addrs, int max_addrs, uint8_t bus) {
+    if (!i2cActive(bus)) return 0;
+    TwoWire *w = g_i2c_bus[bus].wire;
     int count = 0;
     for (uint8_t a = 1; a < 127 && count < max_addrs; a++) {
-        Wire.beginTransmission(a);
-        if (Wire.endTransmission() == 0) {
+        w->beginTransmission(a);
+        if (w->endTransmission() == 0) {
             addrs[count++] = a;
         }
     }
@@ -58,95 +125,211 @@ int i2cScan(uint8_t *addrs, int max_addrs) {
 }
 
 bool i2cDetect(uint8_t addr) {
-    if (!g_i2c_initialized) return false;
-    Wire.beginTransmission(addr);
-    return Wire.endTransmission() == 0;
+    I2cBus *b = i2cBusOf(addr);
+    if (!b) return false;
+    b->wire->beginTransmission(I2C_ADDR_7BIT(addr));
+    return b->wire->endTransmission() == 0;
 }
 
 bool i2cReadReg(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len) {
-    if (!g_i2c_initialized) return false;
-    Wire.beginTransmission(addr);
-    Wire.write(reg);
-    if (Wire.endTransmission(false) != 0) return false;
-    if (Wire.requestFrom(addr, len) != len) return false;
+    I2cBus *b = i2cBusOf(addr);
+    if (!b) return false;
+    TwoWire *w = b->wire;
+    w->beginTransmission(I2C_ADDR_7BIT(addr));
+    w->write(reg);
+    if (w->endTransmission(false) != 0) return false;
+    if (w->requestFrom(I2C_ADDR_7BIT(addr), len) != len) return false;
     for (uint8_t i = 0; i < len; i++) {
-        buf[i] = Wire.read();
+        buf[i] = w->read();
     }
     return true;
 }
 
 bool i2cWriteReg(uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t len) {
-    if (!g_i2c_initialized) return false;
-    Wire.beginTransmission(addr);
-    Wire.write(reg);
+    I2cBus *b = i2cBusOf(addr);
+    if (!b) return false;
+    TwoWire *w = b->wire;
+    w->beginTransmission(I2C_ADDR_7BIT(addr));
+    w->write(reg);
     for (uint8_t i = 0; i < len; i++) {
-        Wire.write(data[i]);
+        w->write(data[i]);
     }
-    return Wire.endTransmission() == 0;
+    return w->endTransmission() == 0;
+}
+
+bool i2cTransfer(uint8_t addr, const uint8_t *wbuf, size_t wlen,
+                 uint8_t *rbuf, size_t rlen) {
+    I2cBus *b = i2cBusOf(addr);
+    if (!b || (wlen == 0 && rlen == 0)) return false;
+    /* Goes to the bus driver underneath Wire, which takes any length;
+       allow 9 clocks per byte plus the usual margin */
+    uint8_t num = I2C_ADDR_BUS(addr);
+    uint16_t a7 = I2C_ADDR_7BIT(addr);
+    uint32_t timeout = 50 + (uint32_t)((wlen + rlen + 2) * 9 * 1000ULL / b->hz);
+    size_t got = 0;
+    esp_err_t err;
+    if (rlen == 0)      err = i2cWrite(num, a7, wbuf, wlen, timeout);
+    else if (wlen == 0) err = i2cRead(num, a7, rbuf, rlen, timeout, &got);
+    else                err = i2cWriteReadNonStop(num, a7, wbuf, wlen, rbuf, rlen, timeout, &got);
+    return err == ESP_OK && got == rlen;
+}
+
+/* Bare command write (no register byte) */
+static bool i2cCommand(uint8_t addr, const uint8_t *cmd, uint8_t len) {
+    I2cBus *b = i2cBusOf(addr);
+    if (!b) return false;
+    b->wire->beginTransmission(I2C_ADDR_7BIT(addr));
+    for (uint8_t i = 0; i < len; i++) b->wire->write(cmd[i]);
+    return b->wire->endTransmission() == 0;
 }
 
-void i2cRecover() {
+/* Bare read (no register pointer write) */
+static bool i2cRead(uint8_t addr, uint8_t *buf, uint8_t len) {
+    I2cBus *b = i2cBusOf(addr);
+    if (!b) return false;
+    if (b->wire->requestFrom(I2C_ADDR_7BIT(addr), len) != len) return false;
+    for (uint8_t i = 0; i < len; i++) buf[i] = b->wire->read();
+    return true;
+}
+
+void i2cRecover(uint8_t bus) {
+    if (bus >= I2C_BUS_MAX) return;
+    I2cBus *b = &g_i2c_bus[bus];
     /* Toggle SCL 9 times to unstick any slave holding SDA low */
-    Wire.end();
-    pinMode(I2C_SCL, OUTPUT);
+    b->wire->end();
+    pinMode(b->scl, OUTPUT);
     for (int i = 0; i < 9; i++) {
-        digitalWrite(I2C_SCL, LOW);
+        digitalWrite(b->scl, LOW);
         delayMicroseconds(5);
-        digitalWrite(I2C_SCL, HIGH);
+        digitalWrite(b->scl, HIGH);
         delayMicroseconds(5);
     }
     /* Re-initialize */
-    if (g_i2c_initialized) {
-        Wire.begin(I2C_SDA, I2C_SCL);
-        Wire.setTimeOut(50);
-    }
-    Serial.println("I2C: bus recovery attempted");
+    if (b->initialized) i2cBusBegin(b);
+    Serial.printf("I2C: bus %d recovery attempted\n", bus);
 }
 
 /*============================================================================
- * Per-Address Reading Cache
+ * Reading Cache — keyed by (addr, reg, len), per-address TTL, LRU
  *============================================================================*/
 
-static I2cCache g_i2c_cache[I2C_CACHE_MAX];
+struct I2cTtl {
+    uint8_t  addr;
+    uint16_t ttl_ms;
+};
 
-float i2cCacheGet(uint8_t addr, uint8_t channel) {
-    uint32_t now = millis();
-    for (int i = 0; i < I2C_CACHE_MAX; i++) {
-        if (g_i2c_cache[i].valid && g_i2c_cache[i].addr == addr &&
-            (now - g_i2c_cache[i].last_read_ms) < I2C_CACHE_TTL_MS &&
-            channel < g_i2c_cache[i].num_values) {
-            return g_i2c_cache[i].values[channel];
+static I2cCache g_i2c_cache[I2C_CACHE_MAX];
+static I2cTtl   g_i2c_ttl[I2C_TTL_MAX];
+static int      g_i2c_ttl_count = 0;
+static uint32_t g_i2c_cache_tick = 0;
+static uint32_t g_i2c_cache_hits = 0;
+static uint32_t g_i2c_cache_misses = 0;
+
+void i2cCacheSetTtl(uint8_t addr, uint16_t ttl_ms) {
+    for (int i = 0; i < g_i2c_ttl_count; i++) {
+        if (g_i2c_ttl[i].addr == addr) {
+            if (ttl_ms < g_i2c_ttl[i].ttl_ms) g_i2c_ttl[i].ttl_ms = ttl_ms;
+            return;
         }
     }
-    return NAN;
+    if (g_i2c_ttl_count >= I2C_TTL_MAX) return;
+    g_i2c_ttl[g_i2c_ttl_count].addr = addr;
+    g_i2c_ttl[g_i2c_ttl_count].ttl_ms = ttl_ms;
+    g_i2c_ttl_count++;
 }
 
-static void i2cCacheSet(uint8_t addr, const float *values, uint8_t num) {
-    /* Find existing entry or free slot */
-    int slot = -1;
+void i2cCacheTtlReset() {
+    g_i2c_ttl_count = 0;
+}
+
+/* Addresses without a registered device are not cached */
+static uint16_t i2cCacheTtl(uint8_t addr) {
+    for (int i = 0; i < g_i2c_ttl_count; i++) {
+        if (g_i2c_ttl[i].addr == addr) return g_i2c_ttl[i].ttl_ms;
+    }
+    return 0;
+}
+
+static I2cCache *i2cCacheFind(uint8_t addr, uint8_t reg, uint8_t len, bool decoded) {
     for (int i = 0; i < I2C_CACHE_MAX; i++) {
-        if (g_i2c_cache[i].addr == addr) { slot = i; break; }
-        if (!g_i2c_cache[i].valid && slot < 0) slot = i;
+        I2cCache *c = &g_i2c_cache[i];
+        if (c->valid && c->addr == addr && c->reg == reg &&
+            c->len == len && c->decoded == decoded)
+            return c;
     }
-    if (slot < 0) {
-        /* Evict oldest */
-        uint32_t oldest = UINT32_MAX;
+    return nullptr;
+}
+
+/* Entry for a key: existing, free, or the least recently used one */
+static I2cCache *i2cCacheSlot(uint8_t addr, uint8_t reg, uint8_t len, bool decoded) {
+    I2cCache *c = i2cCacheFind(addr, reg, len, decoded);
+    if (!c) {
         for (int i = 0; i < I2C_CACHE_MAX; i++) {
-            if (g_i2c_cache[i].last_read_ms < oldest) {
-                oldest = g_i2c_cache[i].last_read_ms;
-                slot = i;
-            }
+            if (!g_i2c_cache[i].valid) { c = &g_i2c_cache[i]; break; }
+        }
+    }
+    if (!c) {
+        c = &g_i2c_cache[0];
+        for (int i = 1; i < I2C_CACHE_MAX; i++) {
+            if (g_i2c_cache[i].lru < c->lru) c = &g_i2c_cache[i];
         }
     }
-    if (slot < 0) slot = 0;
-
-    g_i2c_cache[slot].addr = addr;
-    g_i2c_cache[slot].last_read_ms = millis();
-    g_i2c_cache[slot].num_values = num > 4 ? 4 : num;
-    g_i2c_cache[slot].valid = true;
-    for (int i = 0; i < g_i2c_cache[slot].num_values; i++) {
-        g_i2c_cache[slot].values[i] = values[i];
+    c->addr = addr;
+    c->reg = reg;
+    c->len = len;
+    c->decoded = decoded;
+    c->valid = true;
+    c->last_read_ms = millis();
+    c->lru = ++g_i2c_cache_tick;
+    return c;
+}
+
+static bool i2cCacheFresh(I2cCache *c) {
+    bool fresh = (millis() - c->last_read_ms) < i2cCacheTtl(c->addr);
+    if (fresh) {
+        g_i2c_cache_hits++;
+        c->lru = ++g_i2c_cache_tick;
+    } else {
+        g_i2c_cache_misses++;
+    }
+    return fresh;
+}
+
+/* Store decoded driver results under (addr, reg) */
+static void i2cCacheSet(uint8_t addr, uint8_t reg, const float *values, uint8_t num) {
+    if (num > 4) num = 4;
+    I2cCache *c = i2cCacheSlot(addr, reg, num, true);
+    for (int i = 0; i < num; i++) c->values[i] = values[i];
+}
+
+/* Decoded value for addr/reg/channel. Returns 0 if none, 1 if stale, 2 if fresh. */
+static int i2cCacheLookup(uint8_t addr, uint8_t reg, uint8_t num,
+                          uint8_t channel, float *out) {
+    I2cCache *c = i2cCacheFind(addr, reg, num, true);
+    if (!c || channel >= num) {
+        g_i2c_cache_misses++;
+        *out = NAN;
+        return 0;
+    }
+    *out = c->values[channel];
+    return i2cCacheFresh(c) ? 2 : 1;
+}
+
+bool i2cReadRegCached(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len) {
+    if (len > I2C_CACHE_RAW_MAX || i2cCacheTtl(addr) == 0)
+        return i2cReadReg(addr, reg, buf, len);
+
+    I2cCache *c = i2cCacheFind(addr, reg, len, false);
+    if (c && i2cCacheFresh(c)) {
+        memcpy(buf, c->raw, len);
+        return true;
     }
+    if (!c) g_i2c_cache_misses++;
+
+    if (!i2cReadReg(addr, reg, buf, len)) return false;
+    c = i2cCacheSlot(addr, reg, len, false);
+    memcpy(c->raw, buf, len);
+    return true;
 }
 
 void i2cCacheInvalidate(uint8_t addr) {
@@ -155,6 +338,17 @@ void i2cCacheInvalidate(uint8_t addr) {
             g_i2c_cache[i].valid = false;
         }
     }
+    i2cJobsClear(addr);
+}
+
+void i2cCacheStats(uint32_t *hits, uint32_t *misses, int *entries) {
+    int n = 0;
+    for (int i = 0; i < I2C_CACHE_MAX; i++) {
+        if (g_i2c_cache[i].valid) n++;
+    }
+    *hits = g_i2c_cache_hits;
+    *misses = g_i2c_cache_misses;
+    *entries = n;
 }
 
 /*============================================================================
@@ -162,12 +356,12 @@ void i2cCacheInvalidate(uint8_t addr) {
  *============================================================================*/
 
 float i2cGenericRead(uint8_t addr, uint8_t reg, uint8_t reg_len, float scale) {
-    if (!g_i2c_initialized) return NAN;
+    if (!i2cBusOf(addr)) return NAN;
     if (reg_len < 1) reg_len = 1;
     if (reg_len > 2) reg_len = 2;
 
     uint8_t buf[2] = {0};
-    if (!i2cReadReg(addr, reg, buf, reg_len)) return NAN;
+    if (!i2cReadRegCached(addr, reg, buf, reg_len)) return NAN;
 
     uint16_t raw = buf[0];
     if (reg_len == 2) raw = (raw << 8) | buf[1];
@@ -254,7 +448,8 @@ static bool bme280LoadCalib(uint8_t addr) {
     return true;
 }
 
-static bool bme280Init(uint8_t addr) {
+/* Check chip ID and soft-reset; bme280Configure() runs once the reset is done */
+static bool bme280Reset(uint8_t addr) {
     /* Check chip ID (should be 0x60 for BME280) */
     uint8_t id = 0;
     if (!i2cReadReg(addr, 0xD0, &id, 1) || id != 0x60) {
@@ -262,11 +457,11 @@ static bool bme280Init(uint8_t addr) {
         return false;
     }
 
-    /* Reset */
     uint8_t reset = 0xB6;
-    i2cWriteReg(addr, 0xE0, &reset, 1);
-    delay(10);
+    return i2cWriteReg(addr, 0xE0, &reset, 1);
+}
 
+static bool bme280Configure(uint8_t addr) {
     /* Load calibration */
     if (!bme280LoadCalib(addr)) return false;
 
@@ -274,25 +469,28 @@ static bool bme280Init(uint8_t addr) {
     uint8_t ctrl_hum = 0x01;  /* 1x oversampling */
     i2cWriteReg(addr, 0xF2, &ctrl_hum, 1);
 
-    /* Set temp + pressure oversampling + forced mode */
-    uint8_t ctrl_meas = 0x27; /* temp 1x, press 1x, normal mode */
-    i2cWriteReg(addr, 0xF4, &ctrl_meas, 1);
-
-    /* Config: standby 1000ms, filter off */
-    uint8_t config = 0xA0;    /* t_sb=1000ms, filter=off, spi3w_en=off */
+    /* Config: filter off; standby time is unused in forced mode */
+    uint8_t config = 0x00;
     i2cWriteReg(addr, 0xF5, &config, 1);
 
+    /* Temp 1x, press 1x, sleep mode - each read triggers a forced conversion */
+    uint8_t ctrl_meas = 0x24;
+    i2cWriteReg(addr, 0xF4, &ctrl_meas, 1);
+
     Serial.printf("BME280: initialized at 0x%02X\n", addr);
     return true;
 }
 
-static bool bme280DoRead(uint8_t addr, float *temp, float *humi, float *pres) {
+/* Start one forced-mode conversion (~9.3ms at 1x/1x/1x) */
+static bool bme280Trigger(uint8_t addr) {
+    uint8_t ctrl_meas = 0x25;   /* temp 1x, press 1x, forced mode */
+    return i2cWriteReg(addr, 0xF4, &ctrl_meas, 1);
+}
+
+static bool bme280Collect(uint8_t addr, float *temp, float *humi, float *pres) {
     Bme280Calib *c = bme280GetCalib(addr);
-    if (!c) {
-        if (!bme280Init(addr)) return false;
-        c = bme280GetCalib(addr);
-        if (!c) return false;
-    }
+    if (!c) return false;
+
 
     /* Read raw data: 0xF7..0xFE (8 bytes: press[3] + temp[3] + hum[2]) */
     uint8_t buf[8];
@@ -347,23 +545,6 @@ static bool bme280DoRead(uint8_t addr, float *temp, float *humi, float *pres) {
     return true;
 }
 
-float i2cBme280Read(uint8_t addr, uint8_t channel) {
-    if (!g_i2c_initialized || channel > 2) return NAN;
-
-    /* Check cache first */
-    float cached = i2cCacheGet(addr, channel);
-    if (!isnan(cached)) return cached;
-
-    /* Full read + cache all 3 channels */
-    float temp, humi, pres;
-    if (!bme280DoRead(addr, &temp, &humi, &pres)) return NAN;
-
-    float values[3] = { temp, humi, pres };
-    i2cCacheSet(addr, values, 3);
-
-    return values[channel];
-}
-
 /*============================================================================
  * BH1750 — Ambient Light Sensor
  *============================================================================*/
@@ -387,14 +568,12 @@ static bool bh1750Init(uint8_t addr) {
     if (g_bh1750_inited[slot]) return true;
 
     /* Power on */
-    Wire.beginTransmission(addr);
-    Wire.write(0x01);
-    if (Wire.endTransmission() != 0) return false;
+    static const uint8_t power_on = 0x01;
+    if (!i2cCommand(addr, &power_on, 1)) return false;
 
     /* Continuous high-resolution mode (1 lux resolution, 120ms) */
-    Wire.beginTransmission(addr);
-    Wire.write(0x10);
-    if (Wire.endTransmission() != 0) return false;
+    static const uint8_t cont_hres = 0x10;
+    if (!i2cCommand(addr, &cont_hres, 1)) return false;
 
     g_bh1750_inited[slot] = true;
     Serial.printf("BH1750: initialized at 0x%02X\n", addr);
@@ -402,12 +581,13 @@ static bool bh1750Init(uint8_t addr) {
 }
 
 float i2cBh1750Read(uint8_t addr) {
-    if (!g_i2c_initialized) return NAN;
+    if (!i2cBusOf(addr)) return NAN;
 
     if (!bh1750Init(addr)) return NAN;
 
-    if (Wire.requestFrom(addr, (uint8_t)2) != 2) return NAN;
-    uint16_t raw = (Wire.read() << 8) | Wire.read();
+    uint8_t buf[2];
+    if (!i2cRead(addr, buf, 2)) return NAN;
+    uint16_t raw = (buf[0] << 8) | buf[1];
 
     return (float)raw / 1.2f;
 }
@@ -416,20 +596,16 @@ float i2cBh1750Read(uint8_t addr) {
  * SHT31 — Temperature / Humidity
  *============================================================================*/
 
-static bool sht31DoRead(uint8_t addr, float *temp, float *humi) {
-    /* Send single-shot measurement command: high repeatability, clock stretching */
-    Wire.beginTransmission(addr);
-    Wire.write(0x2C);
-    Wire.write(0x06);
-    if (Wire.endTransmission() != 0) return false;
-
-    delay(16);  /* Wait for measurement (~15ms high repeatability) */
+/* Single-shot, high repeatability, no clock stretching (~15ms) */
+static bool sht31Trigger(uint8_t addr) {
+    static const uint8_t cmd[2] = { 0x24, 0x00 };
+    return i2cCommand(addr, cmd, 2);
+}
 
+static bool sht31Collect(uint8_t addr, float *temp, float *humi) {
     /* Read 6 bytes: temp_msb, temp_lsb, temp_crc, humi_msb, humi_lsb, humi_crc */
-    if (Wire.requestFrom(addr, (uint8_t)6) != 6) return false;
-
     uint8_t buf[6];
-    for (int i = 0; i < 6; i++) buf[i] = Wire.read();
+    if (!i2cRead(addr, buf, 6)) return false;
 
     uint16_t raw_t = (buf[0] << 8) | buf[1];
     uint16_t raw_h = (buf[3] << 8) | buf[4];
@@ -440,29 +616,11 @@ static bool sht31DoRead(uint8_t addr, float *temp, float *humi) {
     return true;
 }
 
-float i2cSht31Read(uint8_t addr, uint8_t channel) {
-    if (!g_i2c_initialized || channel > 1) return NAN;
-
-    /* Check cache */
-    float cached = i2cCacheGet(addr, channel);
-    if (!isnan(cached)) return cached;
-
-    float temp, humi;
-    if (!sht31DoRead(addr, &temp, &humi)) return NAN;
-
-    float values[2] = { temp, humi };
-    i2cCacheSet(addr, values, 2);
-
-    return values[channel];
-}
-
 /*============================================================================
  * ADS1115 — 16-bit ADC (4 single-ended channels)
  *============================================================================*/
 
-float i2cAds1115Read(uint8_t addr, uint8_t channel) {
-    if (!g_i2c_initialized || channel > 3) return NAN;
-
+static bool ads1115Trigger(uint8_t addr, uint8_t channel) {
     /*
      * Config register (0x01): 16 bits
      * Bit 15: OS = 1 (start single conversion)
@@ -481,11 +639,10 @@ float i2cAds1115Read(uint8_t addr, uint8_t channel) {
                       0x0080;        /* DR: 128 SPS */
 
     uint8_t cfg_bytes[2] = { (uint8_t)(config >> 8), (uint8_t)(config & 0xFF) };
-    if (!i2cWriteReg(addr, 0x01, cfg_bytes, 2)) return NAN;
-
-    /* Wait for conversion (128 SPS = ~8ms, add margin) */
-    delay(10);
+    return i2cWriteReg(addr, 0x01, cfg_bytes, 2);
+}
 
+static float ads1115Collect(uint8_t addr) {
     /* Read conversion register (0x00): 2 bytes, big-endian signed */
     uint8_t result[2];
     if (!i2cReadReg(addr, 0x00, result, 2)) return NAN;
@@ -495,3 +652,143 @@ float i2cAds1115Read(uint8_t addr, uint8_t channel) {
     /* Convert to millivolts: +/-4.096V range, 16-bit signed */
     return (float)raw * 0.125f;  /* 1 LSB = 0.125mV */
 }
+
+/*============================================================================
+ * Conversion Queue
+ *
+ * SHT31, ADS1115 and BME280 run through the trigger/collect queue
+ * (i2c_queue.h). Reads return the last result and request a new one when
+ * it is older than the address TTL; only the first read of a sensor waits
+ * for its conversion.
+ *============================================================================*/
+
+enum I2cJobType : uint8_t { I2C_JOB_SHT31, I2C_JOB_ADS1115, I2C_JOB_BME280 };
+
+static void (*g_i2c_result_hook)(uint8_t addr, uint8_t chan) = nullptr;
+
+void i2cSetResultHook(void (*fn)(uint8_t addr, uint8_t chan)) {
+    g_i2c_result_hook = fn;
+}
+
+static bool i2cJobReady(uint8_t addr) {
+    return i2cBusOf(addr) != nullptr;
+}
+
+static int i2cJobTrigger(uint8_t type, uint8_t addr, uint8_t chan, uint32_t *wait_ms) {
+    bool ok = false;
+    switch (type) {
+        case I2C_JOB_SHT31:
+            ok = sht31Trigger(addr);
+            *wait_ms = SHT31_CONV_MS;
+            break;
+
+        case I2C_JOB_ADS1115:
+            ok = ads1115Trigger(addr, chan);
+            *wait_ms = ADS1115_CONV_MS;
+            break;
+
+        case I2C_JOB_BME280:
+            if (!bme280GetCalib(addr)) {
+                /* First use: reset, then configure after BME280_RESET_MS */
+                *wait_ms = BME280_RESET_MS;
+                return bme280Reset(addr) ? I2C_TRIG_SETUP : I2C_TRIG_FAIL;
+            }
+            ok = bme280Trigger(addr);
+            *wait_ms = BME280_CONV_MS;
+            break;
+    }
+    return ok ? I2C_TRIG_CONVERT : I2C_TRIG_FAIL;
+}
+
+static bool i2cJobSetup(uint8_t type, uint8_t addr) {
+    return type == I2C_JOB_BME280 && bme280Configure(addr);
+}
+
+static bool i2cJobCollect(uint8_t type, uint8_t addr, uint8_t chan, float *values) {
+    switch (type) {
+        case I2C_JOB_SHT31:
+            return sht31Collect(addr, &values[0], &values[1]);
+        case I2C_JOB_ADS1115:
+            values[0] = ads1115Collect(addr);
+            return true;
+        case I2C_JOB_BME280:
+            return bme280Collect(addr, &values[0], &values[1], &values[2]);
+    }
+    return false;
+}
+
+/* Results go to the cache; a failed conversion publishes NaN rather than
+   keeping an old value */
+static void i2cJobResult(uint8_t type, uint8_t addr, uint8_t chan, const float *values) {
+    static const float nans[3] = { NAN, NAN, NAN };
+    uint8_t num = type == I2C_JOB_BME280 ? 3 : type == I2C_JOB_SHT31 ? 2 : 1;
+    uint8_t reg = type == I2C_JOB_ADS1115 ? chan : 0;
+    i2cCacheSet(addr, reg, values ? values : nans, num);
+    if (!values) {
+        if (g_debug) Serial.printf("I2C: conversion failed at 0x%02X\n", addr);
+        return;
+    }
+    if (g_i2c_result_hook)
+        g_i2c_result_hook(addr, type == I2C_JOB_ADS1115 ? chan : 0xFF);
+}
+
+static const I2cQueueDriver k_i2c_queue_driver = {
+    i2cJobReady, i2cJobTrigger, i2cJobSetup, i2cJobCollect, i2cJobResult
+};
+
+static I2cQueue g_i2c_queue = { &k_i2c_queue_driver, {} };
+
+/* First read of a sensor: nothing to return yet, run its queue to idle */
+static void i2cJobWait(I2cJob *j) {
+    uint32_t t0 = millis();
+    while (i2cQueueStep(&g_i2c_queue, j, millis()) && millis() - t0 < 100)
+        delay(1);
+}
+
+static void i2cJobsClear(uint8_t addr) {
+    i2cQueueClear(&g_i2c_queue, addr, 0xFF);
+}
+
+static void i2cJobsClearBus(uint8_t bus) {
+    i2cQueueClear(&g_i2c_queue, I2C_BUS_ADDR(bus, 0), 0x80);
+}
+
+void i2cPoll() {
+    uint32_t due;
+    if (i2cQueuePoll(&g_i2c_queue, millis(), &due)) loopAt(due);
+}
+
+/* Shared read path: decoded results live in the cache under (addr, reg, num) */
+static float i2cQueuedRead(uint8_t type, uint8_t addr, uint8_t reg, uint8_t num,
+                           uint8_t channel, uint8_t want) {
+    float v;
+    int state = i2cCacheLookup(addr, reg, num, channel, &v);
+    if (state == 2) return v;
+
+    I2cJob *j = i2cQueueGet(&g_i2c_queue, type, addr);
+    if (!j) return v;
+    j->want |= want;
+    if (state == 0) {
+        i2cJobWait(j);
+        i2cCacheLookup(addr, reg, num, channel, &v);
+    } else {
+        loopWake();     /* stale: i2cPoll() refreshes it on the next pass */
+    }
+    return v;
+}
+
+float i2cBme280Read(uint8_t addr, uint8_t channel) {
+    if (!i2cBusOf(addr) || channel > 2) return NAN;
+    return i2cQueuedRead(I2C_JOB_BME280, addr, 0, 3, channel, 1);
+}
+
+float i2cSht31Read(uint8_t addr, uint8_t channel) {
+    if (!i2cBusOf(addr) || channel > 1) return NAN;
+    return i2cQueuedRead(I2C_JOB_SHT31, addr, 0, 2, channel, 1);
+}
+
+/* Channels convert one at a time, so each is cached under reg = channel */
+float i2cAds1115Read(uint8_t addr, uint8_t channel) {
+    if (!i2cBusOf(addr) || channel > 3) return NAN;
+    return i2cQueuedRead(I2C_JOB_ADS1115, addr, channel, 1, 0, 1 << channel);
+}
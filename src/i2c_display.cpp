@@ -5,17 +5,42 @@
  * Raw Wire.h communication, no external libraries.
  * Supports 128x64 (8 lines) and 128x32 (4 lines), 21 chars per line.
  * Both SSD1306 and SH1106 use page addressing. SH1106 needs a 2-column offset.
- * Template engine replaces {device_name} tokens with live sensor readings.
+ * Templates are compiled into token ops and re-rendered when a shown value
+ * changes, not on a fixed refresh.
+ *
+ * Each display keeps a RAM shadow of what is on the panel. Text is
+ * rasterized into page buffers and only the column runs that differ from
+ * the shadow go out, as one bulk data transfer per run - an unchanged
+ * refresh costs no bus time at all.
  */
 
 #include "i2c_devices.h"
 #include "devices.h"
+#include "history.h"
+#include "loop_sched.h"
 #include <Wire.h>
 #include <WiFi.h>
+#include <math.h>
 
 extern bool g_debug;
 extern char cfg_device_name[32];
 
+#define OLED_MAX          4     /* displays with a framebuffer */
+#define OLED_WIDTH        128   /* visible columns */
+#define OLED_RUN_GAP      6     /* merge diff runs closer than this */
+#define SSD1306_MAX_COLS  21    /* 128 / 6 = 21 chars (5 pixel + 1 spacing) */
+#define TMPL_MAX_OPS      32    /* literal runs + tokens per template */
+#define DISP_TICK_MS      1000  /* {ip}/{heap}/{uptime} check interval */
+#define DISP_MIN_MS       100   /* min spacing of value-driven re-renders */
+#define DISP_HOLD_MS      2000  /* explicit writes stay up this long */
+
+/* Data bytes per I2C transfer: the Wire buffer minus the control byte */
+#ifdef I2C_BUFFER_LENGTH
+#define OLED_XFER_MAX     (I2C_BUFFER_LENGTH - 1)
+#else
+#define OLED_XFER_MAX     127
+#endif
+
 /*============================================================================
  * 5x7 ASCII Font (characters 32-127, 5 bytes each)
  *============================================================================*/
@@ -123,18 +148,131 @@ static const uint8_t FONT_5X7[] PROGMEM = {
  * SSD1306 Low-Level Commands
  *============================================================================*/
 
-static void ssd1306Cmd(uint8_t addr, uint8_t cmd) {
-    Wire.beginTransmission(addr);
-    Wire.write(0x00);  /* Co=0, D/C#=0 -> command */
-    Wire.write(cmd);
-    Wire.endTransmission();
+/* Start a transfer on the display's bus (addr may carry a bus index) */
+static TwoWire *oledBegin(uint8_t addr, uint8_t control) {
+    TwoWire *w = i2cBusWire(addr);
+    if (!w) return nullptr;
+    w->beginTransmission(I2C_ADDR_7BIT(addr));
+    w->write(control);
+    return w;
 }
 
-static void ssd1306CmdList(uint8_t addr, const uint8_t *cmds, uint8_t len) {
-    Wire.beginTransmission(addr);
-    Wire.write(0x00);
-    for (uint8_t i = 0; i < len; i++) Wire.write(cmds[i]);
-    Wire.endTransmission();
+static bool ssd1306CmdList(uint8_t addr, const uint8_t *cmds, uint8_t len) {
+    TwoWire *w = oledBegin(addr, 0x00);  /* Co=0, D/C#=0 -> command stream */
+    if (!w) return false;
+    for (uint8_t i = 0; i < len; i++) w->write(cmds[i]);
+    return w->endTransmission() == 0;
+}
+
+/* Write a run of GDDRAM bytes at page/column, split only where the Wire
+   buffer forces it. Returns false on a bus error. */
+static bool ssd1306WriteRun(uint8_t addr, uint8_t page, uint8_t col,
+                            const uint8_t *data, int len) {
+    const uint8_t pos[] = {
+        (uint8_t)(0xB0 | page),             /* page address */
+        (uint8_t)(0x00 | (col & 0x0F)),     /* lower column nibble */
+        (uint8_t)(0x10 | (col >> 4)),       /* upper column nibble */
+    };
+    if (!ssd1306CmdList(addr, pos, sizeof(pos))) return false;
+    while (len > 0) {
+        int n = len > OLED_XFER_MAX ? OLED_XFER_MAX : len;
+        TwoWire *w = oledBegin(addr, 0x40); /* data mode */
+        if (!w) return false;
+        w->write(data, n);
+        if (w->endTransmission() != 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/*============================================================================
+ * Framebuffer — shadow of the panel's GDDRAM, one per display
+ *============================================================================*/
+
+/* Compiled template op (see tmplCompile) */
+enum : uint8_t { TOP_LIT, TOP_SENSOR, TOP_ACTUATOR, TOP_IP, TOP_HEAP, TOP_UPTIME, TOP_NAME };
+
+struct TmplOp {
+    uint8_t  type;
+    uint8_t  arg;                           /* device slot, or offset into lit */
+    uint8_t  len;                           /* literal length */
+    float    val;                           /* last value of a device token */
+};
+
+struct OledFb {
+    uint8_t  addr;                          /* bus-qualified, 0 = free */
+    uint8_t  col_offset;
+    uint8_t  page_valid;                    /* bit per page: shadow matches panel */
+    uint8_t  shadow[8][OLED_WIDTH];
+    /* Template compiled for this display */
+    uint32_t gen;                           /* registry generation of the slots */
+    char     src[128];                      /* template the ops came from */
+    char     lit[128];                      /* literal runs, unescaped */
+    TmplOp   ops[TMPL_MAX_OPS];
+    uint8_t  n_ops;
+    bool     has_special;                   /* {ip}/{heap}/{uptime} used */
+    bool     dirty;                         /* a shown value changed */
+    uint32_t last_render_ms;
+    char     text[256];                     /* text last rendered to the panel */
+};
+
+static OledFb   g_oled[OLED_MAX];
+static uint32_t g_oled_sent = 0;            /* GDDRAM bytes written */
+static uint32_t g_oled_skipped = 0;         /* bytes unchanged, not sent */
+
+static OledFb *oledFind(uint8_t addr) {
+    for (int i = 0; i < OLED_MAX; i++) {
+        if (g_oled[i].addr == addr) return &g_oled[i];
+    }
+    return nullptr;
+}
+
+/* Bring one page of the panel to `page_buf`, sending only the column runs
+   that differ from the shadow. Runs closer than OLED_RUN_GAP are merged,
+   since re-addressing costs more than resending a few equal bytes. */
+static void oledSyncPage(OledFb *fb, uint8_t page, const uint8_t *page_buf) {
+    uint8_t *sh = fb->shadow[page];
+    bool full = !(fb->page_valid & (1 << page));
+    int sent = 0;
+    int col = 0;
+
+    while (col < OLED_WIDTH) {
+        if (!full && page_buf[col] == sh[col]) { col++; continue; }
+        int start = col, end = col + 1;
+        for (int j = end; j < OLED_WIDTH; j++) {
+            if (full || page_buf[j] != sh[j]) end = j + 1;
+            else if (j - end >= OLED_RUN_GAP) break;
+        }
+        if (!ssd1306WriteRun(fb->addr, page, (uint8_t)(fb->col_offset + start),
+                             page_buf + start, end - start)) {
+            fb->page_valid &= ~(1 << page);  /* panel state unknown: resend next time */
+            return;
+        }
+        memcpy(sh + start, page_buf + start, end - start);
+        sent += end - start;
+        col = end;
+    }
+    fb->page_valid |= (1 << page);
+    g_oled_sent += sent;
+    g_oled_skipped += OLED_WIDTH - sent;
+}
+
+/* Rasterize one text line (up to 21 chars, rest blank) into a page buffer */
+static void oledRenderLine(const char *text, uint8_t *page_buf) {
+    memset(page_buf, 0, OLED_WIDTH);
+    for (int i = 0; text[i] && i < SSD1306_MAX_COLS; i++) {
+        uint8_t c = (uint8_t)text[i];
+        if (c < 32 || c > 127) c = 32;
+        const uint8_t *glyph = &FONT_5X7[(c - 32) * 5];
+        for (int j = 0; j < 5; j++) page_buf[i * 6 + j] = pgm_read_byte(&glyph[j]);
+        /* 6th column stays blank: 1-pixel spacing */
+    }
+}
+
+void ssd1306Stats(uint32_t *sent, uint32_t *skipped) {
+    *sent = g_oled_sent;
+    *skipped = g_oled_skipped;
 }
 
 /*============================================================================
@@ -142,40 +280,54 @@ static void ssd1306CmdList(uint8_t addr, const uint8_t *cmds, uint8_t len) {
  *============================================================================*/
 
 bool ssd1306Init(uint8_t addr, uint8_t height, uint8_t col_offset) {
-    if (!i2cActive()) return false;
+    if (!i2cActive(I2C_ADDR_BUS(addr))) return false;
     if (!i2cDetect(addr)) {
         Serial.printf("OLED: not found at 0x%02X\n", addr);
         return false;
     }
+    OledFb *fb = oledFind(addr);
+    if (!fb) fb = oledFind(0);
+    if (!fb) {
+        Serial.printf("OLED: no framebuffer free for 0x%02X\n", addr);
+        return false;
+    }
+    fb->addr = addr;
+    fb->col_offset = col_offset;
+    fb->page_valid = 0;
+    fb->src[0] = '\0';                               /* template compiles on first render */
+    fb->n_ops = 0;
+    fb->text[0] = '\0';
 
     uint8_t mux_ratio = (height == 32) ? 0x1F : 0x3F;
     uint8_t com_pins  = (height == 32) ? 0x02 : 0x12;
 
-    /* Init sequence */
-    static const uint8_t init_cmds[] = {
-        0xAE,       /* display off */
-        0xD5, 0x80, /* clock divide ratio */
-        0xA8,       /* set multiplex (followed by mux_ratio below) */
+    /* Init sequence, one command stream per phase */
+    const uint8_t power_cmds[] = {
+        0xAE,             /* display off */
+        0xD5, 0x80,       /* clock divide ratio */
+        0xA8, mux_ratio,  /* multiplex ratio */
+        0xD3, 0x00,       /* display offset = 0 */
+        0x40,             /* start line = 0 */
+        0x8D, 0x14,       /* charge pump enable */
     };
-    ssd1306CmdList(addr, init_cmds, sizeof(init_cmds));
-    ssd1306Cmd(addr, mux_ratio);
-
-    ssd1306Cmd(addr, 0xD3); ssd1306Cmd(addr, 0x00); /* display offset = 0 */
-    ssd1306Cmd(addr, 0x40);                          /* start line = 0 */
-    ssd1306Cmd(addr, 0x8D); ssd1306Cmd(addr, 0x14); /* charge pump enable */
+    ssd1306CmdList(addr, power_cmds, sizeof(power_cmds));
     delay(100);                                      /* charge pump stabilization */
     /* Page addressing used for both SSD1306 and SH1106 compatibility */
-    ssd1306Cmd(addr, 0xA1);                          /* segment remap (flip X) */
-    ssd1306Cmd(addr, 0xC8);                          /* COM scan reverse (flip Y) */
-    ssd1306Cmd(addr, 0xDA); ssd1306Cmd(addr, com_pins); /* COM pins config */
-    ssd1306Cmd(addr, 0x81); ssd1306Cmd(addr, 0xCF); /* contrast */
-    ssd1306Cmd(addr, 0xD9); ssd1306Cmd(addr, 0xF1); /* pre-charge */
-    ssd1306Cmd(addr, 0xDB); ssd1306Cmd(addr, 0x40); /* VCOMH deselect */
-    ssd1306Cmd(addr, 0xA4);                          /* display from RAM */
-    ssd1306Cmd(addr, 0xA6);                          /* normal display */
+    const uint8_t panel_cmds[] = {
+        0xA1,             /* segment remap (flip X) */
+        0xC8,             /* COM scan reverse (flip Y) */
+        0xDA, com_pins,   /* COM pins config */
+        0x81, 0xCF,       /* contrast */
+        0xD9, 0xF1,       /* pre-charge */
+        0xDB, 0x40,       /* VCOMH deselect */
+        0xA4,             /* display from RAM */
+        0xA6,             /* normal display */
+    };
+    ssd1306CmdList(addr, panel_cmds, sizeof(panel_cmds));
 
     ssd1306Clear(addr, col_offset);                  /* clear GDDRAM before display on */
-    ssd1306Cmd(addr, 0xAF);                          /* display on — clean screen */
+    const uint8_t on_cmd = 0xAF;                     /* display on — clean screen */
+    ssd1306CmdList(addr, &on_cmd, 1);
 
     const char *type = (col_offset > 0) ? "SH1106" : "SSD1306";
     Serial.printf("%s: initialized at 0x%02X (%dx%d)\n", type, addr, 128, height);
@@ -183,35 +335,35 @@ bool ssd1306Init(uint8_t addr, uint8_t height, uint8_t col_offset) {
 }
 
 void ssd1306Deinit(uint8_t addr, uint8_t col_offset) {
-    if (!i2cActive()) return;
+    OledFb *fb = oledFind(addr);
+    if (fb) { fb->addr = 0; fb->n_ops = 0; }
+    if (!i2cActive(I2C_ADDR_BUS(addr))) return;
     ssd1306Clear(addr, col_offset);
-    ssd1306Cmd(addr, 0xAE); /* display off */
+    const uint8_t off_cmd = 0xAE;                    /* display off */
+    ssd1306CmdList(addr, &off_cmd, 1);
     const char *type = (col_offset > 0) ? "SH1106" : "SSD1306";
     Serial.printf("%s: deinitialized 0x%02X\n", type, addr);
 }
 
 void ssd1306Clear(uint8_t addr, uint8_t col_offset) {
-    if (!i2cActive()) return;
+    if (!i2cActive(I2C_ADDR_BUS(addr))) return;
 
     /* SH1106 has 132-column RAM; visible area starts at col_offset.
        Clear the full 132 columns to avoid ghost pixels. */
-    int total_cols = 128 + col_offset;
+    static const uint8_t zeros[OLED_WIDTH + 4] = {0};
+    int total_cols = OLED_WIDTH + col_offset;
 
+    OledFb *fb = oledFind(addr);
     for (uint8_t page = 0; page < 8; page++) {
-        /* Set page and column using page-addressing commands */
-        ssd1306Cmd(addr, 0xB0 | page);                    /* page address */
-        ssd1306Cmd(addr, 0x00 | (col_offset & 0x0F));     /* lower column nibble */
-        ssd1306Cmd(addr, 0x10 | (col_offset >> 4));        /* upper column nibble */
-
-        /* Write zero bytes in 32-byte chunks */
-        for (int chunk = 0; chunk < total_cols; chunk += 32) {
-            int n = total_cols - chunk;
-            if (n > 32) n = 32;
-            Wire.beginTransmission(addr);
-            Wire.write(0x40); /* data mode */
-            for (int i = 0; i < n; i++) Wire.write((uint8_t)0x00);
-            Wire.endTransmission();
-        }
+        bool ok = ssd1306WriteRun(addr, page, col_offset, zeros, total_cols);
+        if (!fb) continue;
+        memset(fb->shadow[page], 0, OLED_WIDTH);
+        if (ok) fb->page_valid |= (1 << page);
+        else    fb->page_valid &= ~(1 << page);
+    }
+    if (fb) {
+        fb->text[0] = '\0';
+        fb->dirty = true;   /* template comes back on the next poll */
     }
 }
 
@@ -219,160 +371,250 @@ void ssd1306Clear(uint8_t addr, uint8_t col_offset) {
  * SSD1306 Text Rendering
  *============================================================================*/
 
-#define SSD1306_MAX_COLS 21  /* 128 / 6 = 21 chars (5 pixel + 1 spacing) */
-
 void ssd1306WriteText(uint8_t addr, uint8_t line, const char *text, uint8_t col_offset) {
-    if (!i2cActive()) return;
-
-    /* Set cursor to start of line using page addressing (compatible with both SSD1306 and SH1106) */
-    ssd1306Cmd(addr, 0xB0 | line);                    /* page address */
-    ssd1306Cmd(addr, 0x00 | (col_offset & 0x0F));     /* lower column nibble */
-    ssd1306Cmd(addr, 0x10 | (col_offset >> 4));        /* upper column nibble */
+    (void)col_offset;   /* kept in the framebuffer since init */
+    if (!i2cActive(I2C_ADDR_BUS(addr)) || line > 7) return;
+    OledFb *fb = oledFind(addr);
+    if (!fb) return;
+
+    uint8_t page_buf[OLED_WIDTH];
+    oledRenderLine(text, page_buf);
+    oledSyncPage(fb, line, page_buf);
+}
 
-    /* Render up to 21 characters */
-    int col = 0;
-    for (int i = 0; text[i] && col < SSD1306_MAX_COLS; i++, col++) {
-        uint8_t c = (uint8_t)text[i];
-        if (c < 32 || c > 127) c = 32;
+void ssd1306WriteLines(uint8_t addr, const char *text, uint8_t height, uint8_t col_offset) {
+    (void)col_offset;
+    if (!i2cActive(I2C_ADDR_BUS(addr))) return;
+    OledFb *fb = oledFind(addr);
+    if (!fb) return;
+    fb->text[0] = '\0';    /* set by tmplRender when this is a template */
 
-        const uint8_t *glyph = &FONT_5X7[(c - 32) * 5];
-
-        Wire.beginTransmission(addr);
-        Wire.write(0x40);
-        for (int j = 0; j < 5; j++) Wire.write(pgm_read_byte(&glyph[j]));
-        Wire.write((uint8_t)0x00); /* 1-pixel spacing */
-        Wire.endTransmission();
-    }
+    int max_lines = (height == 32) ? 4 : 8;
+    uint8_t page_buf[OLED_WIDTH];
+    char line[SSD1306_MAX_COLS + 1];
+    const char *p = text;
+
+    for (int line_num = 0; line_num < max_lines; line_num++) {
+        /* Next line up to \n; past the end of the text, blank lines */
+        int n = 0;
+        while (p && *p && *p != '\n') {
+            if (n < SSD1306_MAX_COLS) line[n++] = *p;
+            p++;
+        }
+        line[n] = '\0';
+        if (p && *p == '\n') p++;
+        else p = nullptr;
 
-    /* Fill remaining columns with blanks */
-    int remaining = (SSD1306_MAX_COLS - col) * 6;
-    while (remaining > 0) {
-        int chunk = remaining > 16 ? 16 : remaining;
-        Wire.beginTransmission(addr);
-        Wire.write(0x40);
-        for (int i = 0; i < chunk; i++) Wire.write((uint8_t)0x00);
-        Wire.endTransmission();
-        remaining -= chunk;
+        oledRenderLine(line, page_buf);
+        oledSyncPage(fb, line_num, page_buf);
     }
 }
 
 /*============================================================================
- * Template Engine — {device_name} token replacement
+ * Template Engine — compiled once, re-rendered when a value changes
+ *
+ * A template is split into literal runs and tokens when it is first shown
+ * or changed; device tokens carry the resolved registry slot, so neither
+ * compiling nor rendering reads a sensor. A sensor token starts from the
+ * last value in the history raw tier and shows "--" until one is known.
+ * Values are pushed in through
+ * displayOnValue() by whoever samples the device, and a display is only
+ * re-rendered when one of its formatted values actually changes. {ip},
+ * {heap} and {uptime} are checked once a second.
  *============================================================================*/
 
-static void templateExpand(const char *tmpl, char *out, int out_len) {
-    int w = 0;
-    const char *p = tmpl;
+/* Format a token's value as shown on the display */
+static int tmplFormat(const TmplOp *op, float v, char *out, int out_len) {
+    if (op->type == TOP_SENSOR)
+        return isnan(v) ? snprintf(out, out_len, "--") : snprintf(out, out_len, "%.1f", v);
+    return snprintf(out, out_len, "%d", (int)v);
+}
+
+static void tmplCompile(OledFb *fb, const char *tmpl) {
+    strncpy(fb->src, tmpl, sizeof(fb->src) - 1);
+    fb->src[sizeof(fb->src) - 1] = '\0';
+    fb->gen = deviceRegistryGen();
+    fb->n_ops = 0;
+    fb->has_special = false;
+    fb->dirty = true;
 
-    while (*p && w < out_len - 1) {
-        if (*p == '{') {
-            /* Find closing brace */
+    int lw = 0;             /* write position in fb->lit */
+    int lit_start = 0;      /* start of the current literal run */
+    const char *p = fb->src;
+
+    while (*p) {
+        if (*p == '{' && fb->n_ops < TMPL_MAX_OPS - 2) {
             const char *end = strchr(p + 1, '}');
-            if (!end) { out[w++] = *p++; continue; }
-
-            /* Extract token name */
-            int tlen = end - p - 1;
-            if (tlen <= 0 || tlen >= 32) { out[w++] = *p++; continue; }
-            char token[32];
-            memcpy(token, p + 1, tlen);
-            token[tlen] = '\0';
-
-            /* Special tokens */
-            if (strcmp(token, "ip") == 0) {
-                w += snprintf(out + w, out_len - w, "%s",
-                              WiFi.localIP().toString().c_str());
-            } else if (strcmp(token, "heap") == 0) {
-                w += snprintf(out + w, out_len - w, "%u", ESP.getFreeHeap());
-            } else if (strcmp(token, "uptime") == 0) {
-                unsigned long secs = millis() / 1000;
-                unsigned long h = secs / 3600;
-                unsigned long m = (secs % 3600) / 60;
-                w += snprintf(out + w, out_len - w, "%luh%02lum", h, m);
-            } else if (strcmp(token, "name") == 0) {
-                w += snprintf(out + w, out_len - w, "%s", cfg_device_name);
-            } else {
-                /* Look up device by name */
-                Device *dev = deviceFind(token);
-                if (dev && deviceIsSensor(dev->kind)) {
-                    float val = deviceReadSensor(dev);
-                    w += snprintf(out + w, out_len - w, "%.1f", val);
+            int tlen = end ? (int)(end - p - 1) : 0;
+            if (tlen > 0 && tlen < 32) {
+                char token[32];
+                memcpy(token, p + 1, tlen);
+                token[tlen] = '\0';
+
+                TmplOp op = {};
+                Device *dev = nullptr;
+                if (strcmp(token, "ip") == 0)          op.type = TOP_IP;
+                else if (strcmp(token, "heap") == 0)   op.type = TOP_HEAP;
+                else if (strcmp(token, "uptime") == 0) op.type = TOP_UPTIME;
+                else if (strcmp(token, "name") == 0)   op.type = TOP_NAME;
+                else if ((dev = deviceFind(token)) && deviceIsSensor(dev->kind)) {
+                    op.type = TOP_SENSOR;
+                    if (!historyLast(dev - deviceGetAll(), &op.val))
+                        op.val = NAN;   /* until displayOnValue() */
                 } else if (dev && deviceIsActuator(dev->kind)) {
-                    w += snprintf(out + w, out_len - w, "%d", dev->last_value);
+                    op.type = TOP_ACTUATOR;
+                    op.val = (float)dev->last_value;
                 } else {
-                    /* Unknown token — pass through */
-                    w += snprintf(out + w, out_len - w, "?%s", token);
+                    /* Unknown token — pass through as literal "?token" */
+                    fb->lit[lw++] = '?';
+                    memcpy(fb->lit + lw, token, tlen);
+                    lw += tlen;
+                    p = end + 1;
+                    continue;
                 }
+                if (dev) op.arg = (uint8_t)(dev - deviceGetAll());
+                if (op.type == TOP_IP || op.type == TOP_HEAP || op.type == TOP_UPTIME)
+                    fb->has_special = true;
+
+                /* Close the pending literal run, then the token */
+                if (lw > lit_start) {
+                    TmplOp lit = {};
+                    lit.type = TOP_LIT;
+                    lit.arg = (uint8_t)lit_start;
+                    lit.len = (uint8_t)(lw - lit_start);
+                    fb->ops[fb->n_ops++] = lit;
+                }
+                fb->ops[fb->n_ops++] = op;
+                lit_start = lw;
+                p = end + 1;
+                continue;
             }
-
-            p = end + 1;
-        } else {
-            out[w++] = *p++;
         }
+        /* Literal text; \n escapes become line breaks */
+        if (p[0] == '\\' && p[1] == 'n') { fb->lit[lw++] = '\n'; p += 2; }
+        else fb->lit[lw++] = *p++;
     }
-    out[w] = '\0';
+    if (lw > lit_start) {
+        TmplOp lit = {};
+        lit.type = TOP_LIT;
+        lit.arg = (uint8_t)lit_start;
+        lit.len = (uint8_t)(lw - lit_start);
+        fb->ops[fb->n_ops++] = lit;
+    }
+    fb->lit[lw] = '\0';
 }
 
-/* In-place unescape: convert literal \n (two chars) to real newline (0x0A) */
-static void unescapeNewlines(char *s) {
-    char *r = s, *w = s;
-    while (*r) {
-        if (r[0] == '\\' && r[1] == 'n') {
-            *w++ = '\n';
-            r += 2;
-        } else {
-            *w++ = *r++;
+/* Recompile if the template text or the registry layout changed */
+static void tmplSync(OledFb *fb, const char *tmpl) {
+    if (fb->gen != deviceRegistryGen() || strcmp(fb->src, tmpl) != 0)
+        tmplCompile(fb, tmpl);
+}
+
+static void tmplExpand(const OledFb *fb, char *out, int out_len) {
+    int w = 0;
+    for (int i = 0; i < fb->n_ops && w < out_len - 1; i++) {
+        const TmplOp *op = &fb->ops[i];
+        int room = out_len - w;
+        int n = 0;
+        switch (op->type) {
+            case TOP_LIT:
+                n = op->len < room - 1 ? op->len : room - 1;
+                memcpy(out + w, fb->lit + op->arg, n);
+                break;
+            case TOP_SENSOR:
+            case TOP_ACTUATOR:
+                n = tmplFormat(op, op->val, out + w, room);
+                break;
+            case TOP_IP:
+                n = snprintf(out + w, room, "%s", WiFi.localIP().toString().c_str());
+                break;
+            case TOP_HEAP:
+                n = snprintf(out + w, room, "%u", ESP.getFreeHeap());
+                break;
+            case TOP_UPTIME: {
+                unsigned long secs = millis() / 1000;
+                n = snprintf(out + w, room, "%luh%02lum", secs / 3600, (secs % 3600) / 60);
+                break;
+            }
+            case TOP_NAME:
+                n = snprintf(out + w, room, "%s", cfg_device_name);
+                break;
         }
+        w += n < room ? n : room - 1;
     }
-    *w = '\0';
+    out[w] = '\0';
 }
 
-void ssd1306RenderTemplate(uint8_t addr, const char *tmpl, uint8_t height, uint8_t col_offset) {
-    if (!i2cActive() || !tmpl || !tmpl[0]) return;
-
-    /* Expand template tokens */
+/* Render and send if the text differs from what the panel shows */
+static void tmplRender(OledFb *fb, uint8_t height, bool force) {
     char expanded[256];
-    templateExpand(tmpl, expanded, sizeof(expanded));
-    unescapeNewlines(expanded);
-
-    int max_lines = (height == 32) ? 4 : 8;
-
-    /* Split by \n and render each line */
-    char *line_start = expanded;
-    int line_num = 0;
-
-    while (line_start && *line_start && line_num < max_lines) {
-        /* Find next newline */
-        char *nl = strchr(line_start, '\n');
-        if (nl) *nl = '\0';
+    tmplExpand(fb, expanded, sizeof(expanded));
+    fb->dirty = false;
+    fb->last_render_ms = millis();
+    if (!force && strcmp(expanded, fb->text) == 0) return;
+    ssd1306WriteLines(fb->addr, expanded, height, fb->col_offset);
+    strcpy(fb->text, expanded);
+}
 
-        ssd1306WriteText(addr, line_num, line_start, col_offset);
-        line_num++;
+void ssd1306RenderTemplate(uint8_t addr, const char *tmpl, uint8_t height, uint8_t col_offset) {
+    (void)col_offset;
+    if (!i2cActive(I2C_ADDR_BUS(addr)) || !tmpl || !tmpl[0]) return;
+    OledFb *fb = oledFind(addr);
+    if (!fb) return;
+    tmplSync(fb, tmpl);
+    tmplRender(fb, height, true);
+}
 
-        if (nl) line_start = nl + 1;
-        else break;
+void displayOnValue(int slot, float value) {
+    char a[16], b[16];
+    for (int i = 0; i < OLED_MAX; i++) {
+        OledFb *fb = &g_oled[i];
+        if (fb->addr == 0) continue;
+        for (int j = 0; j < fb->n_ops; j++) {
+            TmplOp *op = &fb->ops[j];
+            if ((op->type != TOP_SENSOR && op->type != TOP_ACTUATOR) || op->arg != slot)
+                continue;
+            tmplFormat(op, op->val, a, sizeof(a));
+            tmplFormat(op, value, b, sizeof(b));
+            op->val = value;
+            if (strcmp(a, b) != 0) fb->dirty = true;
+        }
     }
+}
 
-    /* Clear remaining lines */
-    while (line_num < max_lines) {
-        ssd1306WriteText(addr, line_num, "", col_offset);
-        line_num++;
+bool displayShows(int slot) {
+    for (int i = 0; i < OLED_MAX; i++) {
+        const OledFb *fb = &g_oled[i];
+        if (fb->addr == 0) continue;
+        for (int j = 0; j < fb->n_ops; j++) {
+            if (fb->ops[j].type == TOP_SENSOR && fb->ops[j].arg == slot) return true;
+        }
     }
+    return false;
 }
 
 /*============================================================================
- * Display Poll — refresh all OLED displays (SSD1306 + SH1106)
+ * Display Poll — re-render OLED displays whose content changed
  *============================================================================*/
 
-static uint32_t g_disp_last_poll = 0;
+static uint32_t g_disp_hold_until = 0;
+static uint32_t g_disp_last_tick = 0;
+static bool     g_disp_force = false;
 
 void displayPollReset() {
-    g_disp_last_poll = millis();
+    /* Keep an explicit write on screen for a moment, then re-apply templates */
+    g_disp_hold_until = millis() + DISP_HOLD_MS;
+    g_disp_force = true;
 }
 
 void displayPoll() {
     uint32_t now = millis();
-    if (now - g_disp_last_poll < 2000) return;
-    g_disp_last_poll = now;
+    if ((int32_t)(now - g_disp_hold_until) < 0) {
+        loopAt(g_disp_hold_until);
+        return;
+    }
+    bool tick = (now - g_disp_last_tick >= DISP_TICK_MS);
+    if (tick) g_disp_last_tick = now;
 
     Device *devs = deviceGetAll();
     for (int i = 0; i < MAX_DEVICES; i++) {
@@ -380,9 +622,19 @@ void displayPoll() {
         if (!d->used || !deviceIsDisplay(d->kind)) continue;
         if (d->i2c_addr == 0) continue;
         if (d->disp_template[0] == '\0') continue;
-
+        OledFb *fb = oledFind(deviceI2cAddr(d));
+        if (!fb) continue;
+
+        tmplSync(fb, d->disp_template);
+        bool due = g_disp_force || (tick && fb->has_special) ||
+                   (fb->dirty && now - fb->last_render_ms >= DISP_MIN_MS);
+        if (fb->has_special) loopAt(g_disp_last_tick + DISP_TICK_MS);
+        if (!due) {
+            if (fb->dirty) loopAt(fb->last_render_ms + DISP_MIN_MS);
+            continue;
+        }
         uint8_t height = (d->pin == 1) ? 32 : 64;
-        uint8_t col_offset = (d->kind == DEV_ACTUATOR_SH1106) ? 2 : 0;
-        ssd1306RenderTemplate(d->i2c_addr, d->disp_template, height, col_offset);
+        tmplRender(fb, height, false);
     }
+    g_disp_force = false;
 }
@@ -0,0 +1,87 @@
+/**
+ * @file i2c_queue.cpp
+ * @brief I2C conversion queue - trigger/collect scheduling
+ */
+
+#include "i2c_queue.h"
+#include <string.h>
+
+I2cJob *i2cQueueGet(I2cQueue *q, uint8_t type, uint8_t addr) {
+    I2cJob *free_job = nullptr;
+    for (int i = 0; i < I2C_JOB_MAX; i++) {
+        I2cJob *j = &q->jobs[i];
+        if (j->used && j->type == type && j->addr == addr) return j;
+        if (!j->used && !free_job) free_job = j;
+    }
+    if (!free_job) return nullptr;
+    memset(free_job, 0, sizeof(*free_job));
+    free_job->used = true;
+    free_job->type = type;
+    free_job->addr = addr;
+    return free_job;
+}
+
+/* Start the lowest requested channel. A failed trigger reports the
+   request as failed; the other channels stay pending. */
+static void queueTrigger(I2cQueue *q, I2cJob *j, uint32_t now) {
+    uint8_t chan = 0;
+    while (!(j->want & (1 << chan))) chan++;
+    j->chan = chan;
+
+    uint32_t wait = 0;
+    int rc = q->drv->trigger(j->type, j->addr, chan, &wait);
+    if (rc == I2C_TRIG_SETUP) {
+        j->stage  = I2C_STAGE_SETUP;
+        j->due_ms = now + wait;
+        return;
+    }
+    j->want &= ~(1 << chan);
+    if (rc != I2C_TRIG_CONVERT) {
+        q->drv->result(j->type, j->addr, chan, nullptr);
+        return;
+    }
+    j->stage  = I2C_STAGE_CONVERT;
+    j->due_ms = now + wait;
+}
+
+bool i2cQueueStep(I2cQueue *q, I2cJob *j, uint32_t now) {
+    if (j->stage != I2C_STAGE_IDLE) {
+        if ((int32_t)(now - j->due_ms) < 0) return true;
+        uint8_t stage = j->stage;
+        j->stage = I2C_STAGE_IDLE;
+        if (stage == I2C_STAGE_CONVERT) {
+            float values[I2C_JOB_VALUES];
+            bool ok = q->drv->collect(j->type, j->addr, j->chan, values);
+            q->drv->result(j->type, j->addr, j->chan, ok ? values : nullptr);
+        } else if (!q->drv->setup(j->type, j->addr)) {
+            /* Chip unusable: fail every pending request */
+            j->want = 0;
+            q->drv->result(j->type, j->addr, j->chan, nullptr);
+        }
+    }
+    if (j->want) queueTrigger(q, j, now);
+    return j->stage != I2C_STAGE_IDLE || j->want;
+}
+
+bool i2cQueuePoll(I2cQueue *q, uint32_t now, uint32_t *due_ms) {
+    bool pending = false;
+    uint32_t due = 0;
+    for (int i = 0; i < I2C_JOB_MAX; i++) {
+        I2cJob *j = &q->jobs[i];
+        if (!j->used || !q->drv->ready(j->addr)) continue;
+        i2cQueueStep(q, j, now);
+        /* Requests left after a failed trigger go on the next pass */
+        uint32_t t = j->stage != I2C_STAGE_IDLE ? j->due_ms : now;
+        if (j->stage == I2C_STAGE_IDLE && !j->want) continue;
+        if (!pending || (int32_t)(t - due) < 0) due = t;
+        pending = true;
+    }
+    if (pending) *due_ms = due;
+    return pending;
+}
+
+void i2cQueueClear(I2cQueue *q, uint8_t addr, uint8_t mask) {
+    for (int i = 0; i < I2C_JOB_MAX; i++) {
+        if (((q->jobs[i].addr ^ addr) & mask) == 0) q->jobs[i].used = false;
+    }
+}
@@ -0,0 +1,171 @@
+/**
+ * @file loop_sched.cpp
+ * @brief Tickless main loop - deadlines, wake notifications, socket watch
+ *
+ * The loop task blocks in ulTaskNotifyTake() with the time to the earliest
+ * deadline as timeout; every wake source gives it a notification. With the
+ * loop blocked, nothing runs between events but the idle task, which is
+ * what lets tickless idle drop the chip into automatic light sleep (build
+ * with IONODE_LIGHT_SLEEP and an sdkconfig with CONFIG_PM_ENABLE and
+ * CONFIG_FREERTOS_USE_TICKLESS_IDLE).
+ */
+
+#include "loop_sched.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/select.h>
+#if defined(IONODE_LIGHT_SLEEP) && CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+#include <esp_pm.h>
+#define LOOP_LIGHT_SLEEP 1
+#endif
+
+#define LOOP_WATCH_REFRESH_MS  1000    /* select() timeout, picks up fd changes */
+#define LOOP_WATCH_STACK       2560
+#define LOOP_WATCH_PRIO        2       /* above the loop task (1) */
+#define LOOP_STATS_WINDOW_MS   10000
+#define LOOP_POLL_MS           10      /* socket poll if the watcher is missing */
+
+static TaskHandle_t g_loop_task  = nullptr;
+static TaskHandle_t g_watch_task = nullptr;
+static volatile int g_watch_fd[LOOP_WATCH_MAX];
+static volatile bool g_watch_fired = false;    /* watcher waits for a pass */
+
+static bool     g_due_set = false;
+static uint32_t g_due_ms;
+
+static uint32_t g_win_start_ms;
+static uint32_t g_win_idle_us;
+static uint32_t g_win_passes;
+static uint32_t g_idle_pct;
+static uint32_t g_passes_s;
+
+/*============================================================================
+ * Socket Watch
+ *============================================================================*/
+
+static void loopWatchTask(void *) {
+    for (;;) {
+        fd_set rd;
+        FD_ZERO(&rd);
+        int maxfd = -1;
+        for (int i = 0; i < LOOP_WATCH_MAX; i++) {
+            int fd = g_watch_fd[i];
+            if (fd < 0) continue;
+            FD_SET(fd, &rd);
+            if (fd > maxfd) maxfd = fd;
+        }
+        if (maxfd < 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);    /* until loopWatch() */
+            continue;
+        }
+
+        struct timeval tv = { LOOP_WATCH_REFRESH_MS / 1000, 0 };
+        int n = select(maxfd + 1, &rd, nullptr, nullptr, &tv);
+        if (n > 0) {
+            /* Readable: wake the loop, then hold off until it has run a
+               pass and read what it could */
+            g_watch_fired = true;
+            loopWake();
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOOP_WATCH_REFRESH_MS));
+        } else if (n < 0) {
+            /* Socket closed under us: the loop drops it on its next pass */
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOOP_WATCH_REFRESH_MS));
+        }
+    }
+}
+
+void loopWatch(int slot, int fd) {
+    if (slot < 0 || slot >= LOOP_WATCH_MAX || g_watch_fd[slot] == fd) return;
+    g_watch_fd[slot] = fd;
+    if (g_watch_task) xTaskNotifyGive(g_watch_task);
+}
+
+/*============================================================================
+ * Deadlines and Wakeups
+ *============================================================================*/
+
+void loopSchedInit() {
+    for (int i = 0; i < LOOP_WATCH_MAX; i++) g_watch_fd[i] = -1;
+    g_loop_task = xTaskGetCurrentTaskHandle();
+    g_win_start_ms = millis();
+    if (xTaskCreate(loopWatchTask, "loop_watch", LOOP_WATCH_STACK, nullptr,
+                    LOOP_WATCH_PRIO, &g_watch_task) != pdPASS) {
+        g_watch_task = nullptr;
+        Serial.printf("Loop: socket watch task failed, polling every %dms\n",
+                      LOOP_POLL_MS);
+    }
+
+#if LOOP_LIGHT_SLEEP
+    esp_pm_config_t pm = {};
+    pm.max_freq_mhz = getCpuFrequencyMhz();
+    pm.min_freq_mhz = getXtalFrequencyMhz();
+    pm.light_sleep_enable = true;
+    if (esp_pm_configure(&pm) != ESP_OK)
+        Serial.printf("Loop: automatic light sleep not available\n");
+#endif
+}
+
+void loopAt(uint32_t due_ms) {
+    if (!g_due_set || (int32_t)(due_ms - g_due_ms) < 0) g_due_ms = due_ms;
+    g_due_set = true;
+}
+
+void loopIn(uint32_t ms) {
+    loopAt(millis() + ms);
+}
+
+void loopWake() {
+    if (g_loop_task) xTaskNotifyGive(g_loop_task);
+}
+
+void IRAM_ATTR loopWakeFromIsr() {
+    if (!g_loop_task) return;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(g_loop_task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+static void loopStatsUpdate(uint32_t idle_us) {
+    g_win_idle_us += idle_us;
+    g_win_passes++;
+    uint32_t elapsed = millis() - g_win_start_ms;
+    if (elapsed < LOOP_STATS_WINDOW_MS) return;
+    g_idle_pct = (uint32_t)((uint64_t)g_win_idle_us / 10 / elapsed);
+    g_passes_s = (uint32_t)((uint64_t)g_win_passes * 1000 / elapsed);
+    g_win_idle_us = 0;
+    g_win_passes = 0;
+    g_win_start_ms += elapsed;
+}
+
+void loopWait() {
+    uint32_t wait = LOOP_MAX_WAIT_MS;
+    if (g_due_set) {
+        int32_t left = (int32_t)(g_due_ms - millis());
+        if (left < 0) left = 0;
+        if ((uint32_t)left < wait) wait = (uint32_t)left;
+        g_due_set = false;
+    }
+
+    /* Let the watcher select again: this pass has read the socket */
+    if (g_watch_fired) {
+        g_watch_fired = false;
+        xTaskNotifyGive(g_watch_task);
+    }
+    if (!g_watch_task) {
+        for (int i = 0; i < LOOP_WATCH_MAX; i++)
+            if (g_watch_fd[i] >= 0 && wait > LOOP_POLL_MS) wait = LOOP_POLL_MS;
+    }
+
+    /* Rounded up, and at least one tick so lower priority tasks run even
+       when a deadline is already due; a pending wake returns at once */
+    TickType_t ticks = (wait + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    if (ticks == 0) ticks = 1;
+    uint32_t t0 = micros();
+    ulTaskNotifyTake(pdTRUE, ticks);
+    loopStatsUpdate(micros() - t0);
+}
+
+void loopSchedStats(uint32_t *idle_pct, uint32_t *passes_s) {
+    *idle_pct = g_idle_pct;
+    *passes_s = g_passes_s;
+}
@@ -17,11 +17,16 @@
 #include "driver/temperature_sensor.h"
 #endif
 #include "devices.h"
+#include "events.h"
 #include "nats_hal.h"
 #include "i2c_devices.h"
 #include "nats_config.h"
 #include "setup_portal.h"
 #include "web_config.h"
+#include "seglog.h"
+#include "boot_cache.h"
+#include "duty_sleep.h"
+#include "loop_sched.h"
 #include "version.h"
 #include <nats_atoms.h>
 
@@ -32,7 +37,15 @@
 #define LED_BRIGHTNESS          20
 #define SERIAL_BUF_SIZE         256
 #define HEARTBEAT_INTERVAL_MS   3000
+#define HEARTBEAT_BLINK_MS      50
 #define NATS_RECONNECT_DELAY_MS 30000
+#define BOOT_CONSOLE_WAIT_MS    5000    /* time to reattach a USB console */
+#define WIFI_CACHED_TIMEOUT_MS  3000    /* then forget the cached AP and scan */
+#define WIFI_TIMEOUT_MS         15000
+#define WIFI_RETRY_MS           5000    /* pause between reconnect attempts */
+#define DUTY_GRACE_MS           120000  /* awake after power-on before the first sleep */
+#define DUTY_WIFI_TIMEOUT_MS    8000    /* a duty wake gives up on WiFi sooner */
+#define DUTY_LISTEN_MS          500     /* time for queued requests after a report */
 
 /* Runtime config - loaded from LittleFS */
 char cfg_wifi_ssid[64];
@@ -43,6 +56,12 @@ int  cfg_nats_port = 4222;
 char cfg_timezone[64];
 char cfg_tag[32];
 int  cfg_heartbeat_interval = 60;
+int  cfg_i2c_hz = I2C_DEFAULT_HZ;      /* bus 0 clock */
+int  cfg_i2c1_sda = -1;                /* bus 1 pins (-1 = chip default) */
+int  cfg_i2c1_scl = -1;
+int  cfg_i2c1_hz = I2C_DEFAULT_HZ;     /* bus 1 clock */
+int  cfg_sleep_interval = 0;           /* duty cycle wake period (s), 0 = always on */
+int  cfg_sleep_report = 0;             /* duty cycle report period (s), 0 = every wake */
 
 static void configDefaults() {
     cfg_wifi_ssid[0] = '\0';
@@ -53,6 +72,12 @@ static void configDefaults() {
     strncpy(cfg_timezone, "UTC0", sizeof(cfg_timezone));
     cfg_tag[0] = '\0';
     cfg_heartbeat_interval = 60;
+    cfg_i2c_hz = I2C_DEFAULT_HZ;
+    cfg_i2c1_sda = -1;
+    cfg_i2c1_scl = -1;
+    cfg_i2c1_hz = I2C_DEFAULT_HZ;
+    cfg_sleep_interval = 0;
+    cfg_sleep_report = 0;
 }
 
 /*============================================================================
@@ -96,6 +121,29 @@ unsigned long g_config_dirty_ms = 0;
 /* Telemetry counters */
 uint32_t g_nats_reconnects = 0;
 uint32_t g_events_fired = 0;
+
+/* Loop latency: time spent in one loop() pass, excluding the idle delay */
+#define LOOP_STALL_US     100000    /* passes longer than this count as stalls */
+#define LOOP_WINDOW_MS    10000     /* peak is reported per window */
+uint32_t g_loop_last_us  = 0;
+uint32_t g_loop_avg_us   = 0;       /* moving average (1/16 weight) */
+uint32_t g_loop_peak_us  = 0;       /* max over the last complete window */
+uint32_t g_loop_max_us   = 0;       /* max since boot */
+uint32_t g_loop_stalls   = 0;
+
+/* Boot phases (ms since reset), reported once by the first heartbeat */
+struct BootTimes {
+    uint32_t wait;          /* console wait done */
+    uint32_t config;        /* config.json parsed */
+    uint32_t devices;       /* registry loaded */
+    uint32_t wifi;          /* WiFi connected */
+    uint32_t nats;          /* NATS connected */
+    uint32_t online;        /* first publish (online event) */
+    bool     wifi_cached;   /* joined the cached AP without a scan */
+    bool     nats_cached;   /* connected to the cached server address */
+};
+static BootTimes g_boot;
+static bool g_boot_reported = false;
 #if !defined(CONFIG_IDF_TARGET_ESP32)
 temperature_sensor_handle_t g_temp_sensor = NULL;
 #endif
@@ -164,7 +212,7 @@ static bool loadConfig() {
 
     Serial.printf("LittleFS: mounted OK\n");
 
-    static char json_buf[512];
+    static char json_buf[768];
     int len = readFile("/config.json", json_buf, sizeof(json_buf));
     if (len > 0) {
         Serial.printf("LittleFS: loaded config.json (%d bytes)\n", len);
@@ -182,6 +230,19 @@ static bool loadConfig() {
         if (jsonGetString(json_buf, "heartbeat_interval", hb_buf, sizeof(hb_buf))) {
             cfg_heartbeat_interval = atoi(hb_buf);
         }
+        char i2c_buf[12];
+        if (jsonGetString(json_buf, "i2c_hz", i2c_buf, sizeof(i2c_buf)) && atoi(i2c_buf) > 0)
+            cfg_i2c_hz = atoi(i2c_buf);
+        if (jsonGetString(json_buf, "i2c1_sda", i2c_buf, sizeof(i2c_buf)) && i2c_buf[0])
+            cfg_i2c1_sda = atoi(i2c_buf);
+        if (jsonGetString(json_buf, "i2c1_scl", i2c_buf, sizeof(i2c_buf)) && i2c_buf[0])
+            cfg_i2c1_scl = atoi(i2c_buf);
+        if (jsonGetString(json_buf, "i2c1_hz", i2c_buf, sizeof(i2c_buf)) && atoi(i2c_buf) > 0)
+            cfg_i2c1_hz = atoi(i2c_buf);
+        if (jsonGetString(json_buf, "sleep_interval", i2c_buf, sizeof(i2c_buf)))
+            cfg_sleep_interval = atoi(i2c_buf);
+        if (jsonGetString(json_buf, "sleep_report", i2c_buf, sizeof(i2c_buf)))
+            cfg_sleep_report = atoi(i2c_buf);
     } else {
         Serial.printf("LittleFS: no config.json, using defaults\n");
     }
@@ -218,7 +279,7 @@ void configSave() {
         return;
     }
 
-    static char buf[640];
+    static char buf[768];
     char esc[128];
     int w = 0;
 
@@ -244,7 +305,14 @@ void configSave() {
     jsonEscapeStr(esc, sizeof(esc), cfg_tag);
     w += snprintf(buf + w, sizeof(buf) - w, "  \"tag\": \"%s\",\n", esc);
 
-    w += snprintf(buf + w, sizeof(buf) - w, "  \"heartbeat_interval\": \"%d\"\n", cfg_heartbeat_interval);
+    w += snprintf(buf + w, sizeof(buf) - w, "  \"heartbeat_interval\": \"%d\",\n", cfg_heartbeat_interval);
+
+    w += snprintf(buf + w, sizeof(buf) - w, "  \"i2c_hz\": \"%d\",\n", cfg_i2c_hz);
+    w += snprintf(buf + w, sizeof(buf) - w, "  \"i2c1_sda\": \"%d\",\n", cfg_i2c1_sda);
+    w += snprintf(buf + w, sizeof(buf) - w, "  \"i2c1_scl\": \"%d\",\n", cfg_i2c1_scl);
+    w += snprintf(buf + w, sizeof(buf) - w, "  \"i2c1_hz\": \"%d\",\n", cfg_i2c1_hz);
+    w += snprintf(buf + w, sizeof(buf) - w, "  \"sleep_interval\": \"%d\",\n", cfg_sleep_interval);
+    w += snprintf(buf + w, sizeof(buf) - w, "  \"sleep_report\": \"%d\"\n", cfg_sleep_report);
 
     w += snprintf(buf + w, sizeof(buf) - w, "}\n");
 
@@ -257,31 +325,129 @@ void configSave() {
  * WiFi
  *============================================================================*/
 
-static bool connectWiFi() {
-    Serial.printf("WiFi: Connecting to %s", cfg_wifi_ssid);
-    ledOrange();
-
+/* Start joining. With use_cache, the AP from the last connection is
+   joined directly, skipping the scan. Returns true if it was. */
+static bool wifiBegin(bool use_cache) {
     WiFi.mode(WIFI_STA);
+    uint8_t bssid[6], channel = 0;
+    if (use_cache && bootCacheWifi(cfg_wifi_ssid, bssid, &channel)) {
+        Serial.printf(" (cached AP, ch %d)", channel);
+        WiFi.begin(cfg_wifi_ssid, cfg_wifi_pass, channel, bssid);
+        return true;
+    }
     WiFi.begin(cfg_wifi_ssid, cfg_wifi_pass);
+    return false;
+}
+
+/* Joined: remember the AP for the next boot */
+static void wifiJoined(bool cached) {
+    bootCacheSetWifi(cfg_wifi_ssid, WiFi.BSSID(), (uint8_t)WiFi.channel());
+    if (!g_boot.wifi) {
+        g_boot.wifi = millis();
+        g_boot.wifi_cached = cached;
+    }
+
+    Serial.printf(" OK!\n");
+    Serial.printf("WiFi: IP = %s\n", WiFi.localIP().toString().c_str());
+    ledGreen();
+}
+
+/* Blocking join, for setup() and duty wakes where nothing else runs yet */
+static bool connectWiFi(uint32_t timeout_ms = WIFI_TIMEOUT_MS) {
+    Serial.printf("WiFi: Connecting to %s", cfg_wifi_ssid);
+    ledOrange();
 
+    bool cached = wifiBegin(true);
+    uint32_t t0 = millis();
     int attempts = 0;
     while (WiFi.status() != WL_CONNECTED) {
-        delay(500);
-        Serial.print(".");
-        if (attempts % 2 == 0) ledOrange(); else ledOff();
-        if (++attempts > 30) {
+        delay(100);
+        if (attempts % 5 == 0) Serial.print(".");
+        if (attempts % 10 < 5) ledOrange(); else ledOff();
+        attempts++;
+        if (cached && attempts * 100 >= WIFI_CACHED_TIMEOUT_MS) {
+            /* AP moved or changed channel: forget it and scan */
+            Serial.printf(" cached AP gone, scanning");
+            bootCacheSetWifi(cfg_wifi_ssid, nullptr, 0);
+            WiFi.disconnect();
+            cached = wifiBegin(false);
+            attempts = 0;
+        } else if (!cached && millis() - t0 >= timeout_ms) {
             Serial.println(" FAILED!");
             ledRed();
             return false;
         }
     }
 
-    Serial.printf(" OK!\n");
-    Serial.printf("WiFi: IP = %s\n", WiFi.localIP().toString().c_str());
-    ledGreen();
+    wifiJoined(cached);
     return true;
 }
 
+/* Reconnect from loop() without blocking it: each pass checks the link
+ * and moves on; the next pass is due at the state's deadline, or earlier
+ * when the WiFi driver reports the link up or down. */
+enum WifiState { WIFI_UP, WIFI_JOIN_CACHED, WIFI_JOIN, WIFI_WAIT };
+
+static WifiState g_wifi_state = WIFI_UP;
+static uint32_t  g_wifi_due = 0;
+
+static void onWifiEvent(arduino_event_id_t event) {
+    (void)event;
+    loopWake();
+}
+
+/* Returns true while the link is up */
+static bool wifiPoll(uint32_t now) {
+    if (WiFi.status() == WL_CONNECTED) {
+        if (g_wifi_state != WIFI_UP) {
+            wifiJoined(g_wifi_state == WIFI_JOIN_CACHED);
+            webConfigLink(true);
+            Serial.printf("> ");
+            g_wifi_state = WIFI_UP;
+        }
+        return true;
+    }
+
+    switch (g_wifi_state) {
+    case WIFI_UP:
+        Serial.printf("\nWiFi disconnected! Reconnecting to %s", cfg_wifi_ssid);
+        ledOrange();
+        webConfigLink(false);
+        g_wifi_state = wifiBegin(true) ? WIFI_JOIN_CACHED : WIFI_JOIN;
+        g_wifi_due = now + (g_wifi_state == WIFI_JOIN_CACHED ? WIFI_CACHED_TIMEOUT_MS
+                                                              : WIFI_TIMEOUT_MS);
+        break;
+    case WIFI_JOIN_CACHED:
+        if ((int32_t)(now - g_wifi_due) < 0) break;
+        /* AP moved or changed channel: forget it and scan */
+        Serial.printf(" cached AP gone, scanning");
+        bootCacheSetWifi(cfg_wifi_ssid, nullptr, 0);
+        WiFi.disconnect();
+        wifiBegin(false);
+        g_wifi_state = WIFI_JOIN;
+        g_wifi_due = now + WIFI_TIMEOUT_MS;
+        break;
+    case WIFI_JOIN:
+        if ((int32_t)(now - g_wifi_due) < 0) break;
+        Serial.printf(" FAILED! Retrying in %ds\n", WIFI_RETRY_MS / 1000);
+        ledRed();
+        WiFi.disconnect();
+        g_wifi_state = WIFI_WAIT;
+        g_wifi_due = now + WIFI_RETRY_MS;
+        break;
+    case WIFI_WAIT:
+        if ((int32_t)(now - g_wifi_due) < 0) break;
+        Serial.printf("WiFi: Connecting to %s", cfg_wifi_ssid);
+        ledOrange();
+        wifiBegin(false);
+        g_wifi_state = WIFI_JOIN;
+        g_wifi_due = now + WIFI_TIMEOUT_MS;
+        break;
+    }
+    loopAt(g_wifi_due);
+    return false;
+}
+
 /*============================================================================
  * NATS
  *============================================================================*/
@@ -301,6 +467,29 @@ static const char natsSubjectDiscover[] = "_ion.discover";
 /* Capabilities response buffer */
 static char g_caps_json[2048];
 
+/* Capabilities fields, in response order. The static ones are cached as
+   "key":value, fragments; the rest are formatted per request. */
+enum {
+    CAPS_DEVICE, CAPS_FIRMWARE, CAPS_VERSION, CAPS_CHIP, CAPS_TAG, CAPS_HAL,
+    CAPS_STATIC,                                /* end of cached fields */
+    CAPS_FREE_HEAP = CAPS_STATIC, CAPS_RSSI, CAPS_IP, CAPS_DEVICES,
+    CAPS_FIELDS
+};
+static const char *CAPS_FIELD_NAMES[CAPS_FIELDS] = {
+    "device", "firmware", "version", "chip", "tag", "hal",
+    "free_heap", "rssi", "ip", "devices"
+};
+#define CAPS_DEV_ROOM  160      /* reserve per device entry when paging */
+
+static char     g_caps_static[512];
+static uint16_t g_caps_static_off[CAPS_STATIC + 1];
+static char     g_caps_devs[MAX_DEVICES * 80];  /* {"name":..,"kind":.. per slot */
+static uint16_t g_caps_dev_off[MAX_DEVICES + 1];
+static uint32_t g_caps_gen = 0;
+static bool     g_caps_valid = false;
+static char     g_caps_tag[sizeof(cfg_tag)];
+static char     g_caps_name[sizeof(cfg_device_name)];
+
 static void onNatsEvent(nats_client_t *client, nats_event_t event,
                         void *userdata) {
     (void)client; (void)userdata;
@@ -323,15 +512,11 @@ static void onNatsEvent(nats_client_t *client, nats_event_t event,
     }
 }
 
-/**
- * NATS capabilities handler - returns device state as JSON.
- * Used for discovery: what devices/hal capabilities are available.
- */
-static void onNatsCapabilities(nats_client_t *client, const nats_msg_t *msg,
-                               void *userdata) {
-    (void)userdata;
-
-    int w = 0;
+/* Rebuild the cached fragments if the registry, tag or name changed */
+static void capsCacheSync() {
+    if (g_caps_valid && g_caps_gen == deviceRegistryGen() &&
+        strcmp(g_caps_tag, cfg_tag) == 0 && strcmp(g_caps_name, cfg_device_name) == 0)
+        return;
 
     /* Chip identification */
     const char *chip_name =
@@ -345,44 +530,155 @@ static void onNatsCapabilities(nats_client_t *client, const nats_msg_t *msg,
         "ESP32";
 #endif
 
-    w += snprintf(g_caps_json + w, sizeof(g_caps_json) - w,
-        "{\"device\":\"%s\",\"firmware\":\"ionode\",\"version\":\"%s\","
-        "\"chip\":\"%s\",\"free_heap\":%u,\"rssi\":%d,\"ip\":\"%s\",",
-        cfg_device_name, IONODE_VERSION, chip_name, ESP.getFreeHeap(),
-        WiFi.RSSI(), WiFi.localIP().toString().c_str());
+    int w = 0;
+    const int n = sizeof(g_caps_static);
+    g_caps_static_off[CAPS_DEVICE] = w;
+    w += snprintf(g_caps_static + w, n - w, "\"device\":\"%s\",", cfg_device_name);
+    g_caps_static_off[CAPS_FIRMWARE] = w;
+    w += snprintf(g_caps_static + w, n - w, "\"firmware\":\"ionode\",");
+    g_caps_static_off[CAPS_VERSION] = w;
+    w += snprintf(g_caps_static + w, n - w, "\"version\":\"%s\",", IONODE_VERSION);
+    g_caps_static_off[CAPS_CHIP] = w;
+    w += snprintf(g_caps_static + w, n - w, "\"chip\":\"%s\",", chip_name);
+    /* Tag only if set */
+    g_caps_static_off[CAPS_TAG] = w;
+    if (cfg_tag[0])
+        w += snprintf(g_caps_static + w, n - w, "\"tag\":\"%s\",", cfg_tag);
+    g_caps_static_off[CAPS_HAL] = w;
+    w += snprintf(g_caps_static + w, n - w,
+        "\"hal\":{\"gpio\":true,\"adc\":true,\"pwm\":true,"
+        "\"dac\":false,\"uart\":true,\"i2c\":true,\"system_temp\":true},");
+    g_caps_static_off[CAPS_STATIC] = w;
 
-    /* Include tag if set */
-    if (cfg_tag[0]) {
-        w += snprintf(g_caps_json + w, sizeof(g_caps_json) - w,
-            "\"tag\":\"%s\",", cfg_tag);
+    /* Device entries up to the value; empty for unused slots */
+    const Device *devs = deviceGetAll();
+    w = 0;
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        g_caps_dev_off[i] = w;
+        const Device *d = &devs[i];
+        if (!d->used) continue;
+        if (deviceIsSensor(d->kind))
+            w += snprintf(g_caps_devs + w, sizeof(g_caps_devs) - w,
+                "{\"name\":\"%s\",\"kind\":\"%s\",\"unit\":\"%s\"",
+                d->name, deviceKindName(d->kind), d->unit);
+        else
+            w += snprintf(g_caps_devs + w, sizeof(g_caps_devs) - w,
+                "{\"name\":\"%s\",\"kind\":\"%s\",\"pin\":%d",
+                d->name, deviceKindName(d->kind), d->pin);
     }
+    g_caps_dev_off[MAX_DEVICES] = w;
 
-    /* HAL capabilities */
-    w += snprintf(g_caps_json + w, sizeof(g_caps_json) - w,
-        "\"hal\":{\"gpio\":true,\"adc\":true,\"pwm\":true,"
-        "\"dac\":false,\"uart\":true,\"i2c\":true,\"system_temp\":true},");
+    g_caps_gen = deviceRegistryGen();
+    strcpy(g_caps_tag, cfg_tag);
+    strcpy(g_caps_name, cfg_device_name);
+    g_caps_valid = true;
+}
 
-    /* Devices */
-    w += snprintf(g_caps_json + w, sizeof(g_caps_json) - w, "\"devices\":[");
-    Device *devs = deviceGetAll();
-    bool firstDev = true;
-    for (int i = 0; i < MAX_DEVICES && w < (int)sizeof(g_caps_json) - 200; i++) {
-        if (!devs[i].used) continue;
-        Device *d = &devs[i];
-        if (!firstDev) g_caps_json[w++] = ',';
-        firstDev = false;
-        if (deviceIsSensor(d->kind)) {
-            float val = deviceReadSensor(d);
-            w += snprintf(g_caps_json + w, sizeof(g_caps_json) - w,
-                "{\"name\":\"%s\",\"kind\":\"%s\",\"value\":%.1f,\"unit\":\"%s\"}",
-                d->name, deviceKindName(d->kind), val, d->unit);
-        } else {
-            w += snprintf(g_caps_json + w, sizeof(g_caps_json) - w,
-                "{\"name\":\"%s\",\"kind\":\"%s\",\"pin\":%d,\"value\":%d}",
-                d->name, deviceKindName(d->kind), d->pin, d->last_value);
+/* Request parameter, as query string (?fields=a,b&from=4) or JSON
+   ({"fields":"a,b","from":4}) */
+static bool capsParam(const char *payload, const char *key, char *out, size_t len) {
+    size_t klen = strlen(key);
+    for (const char *p = strstr(payload, key); p; p = strstr(p + 1, key)) {
+        if (p > payload && isalnum((unsigned char)p[-1])) continue;
+        const char *v = p + klen;
+        if (*v == '"') v++;
+        while (*v == ' ') v++;
+        if (*v != '=' && *v != ':') continue;
+        v++;
+        while (*v == ' ' || *v == '"') v++;
+        size_t n = 0;
+        while (v[n] && v[n] != '&' && v[n] != '"' && v[n] != '}' && n < len - 1) n++;
+        memcpy(out, v, n);
+        out[n] = '\0';
+        return true;
+    }
+    return false;
+}
+
+/* Bit per CAPS_* field named in a comma-separated list */
+static uint16_t capsFieldMask(const char *list) {
+    uint16_t mask = 1 << CAPS_DEVICE;          /* always say who answers */
+    while (*list) {
+        const char *end = strchr(list, ',');
+        size_t n = end ? (size_t)(end - list) : strlen(list);
+        for (int f = 0; f < CAPS_FIELDS; f++) {
+            if (strlen(CAPS_FIELD_NAMES[f]) == n && strncmp(list, CAPS_FIELD_NAMES[f], n) == 0)
+                mask |= 1 << f;
         }
+        if (!end) break;
+        list = end + 1;
     }
-    w += snprintf(g_caps_json + w, sizeof(g_caps_json) - w, "]}");
+    return mask;
+}
+
+/**
+ * NATS capabilities handler - returns device state as JSON.
+ * Used for discovery: what devices/hal capabilities are available.
+ * Values are the last samples; no sensor is read here. Device lists that
+ * do not fit end with "next", the slot to pass as "from" for the rest.
+ */
+static void onNatsCapabilities(nats_client_t *client, const nats_msg_t *msg,
+                               void *userdata) {
+    (void)userdata;
+
+    /* Parameters: payload is terminated right after the data */
+    char payload[96] = "";
+    size_t plen = msg->data_len < sizeof(payload) - 1 ? msg->data_len : sizeof(payload) - 1;
+    if (msg->data && plen > 0) memcpy(payload, msg->data, plen);
+    payload[plen] = '\0';
+
+    char param[80];
+    uint16_t want = 0xFFFF;
+    if (capsParam(payload, "fields", param, sizeof(param))) want = capsFieldMask(param);
+    int from = capsParam(payload, "from", param, sizeof(param)) ? atoi(param) : 0;
+    if (from < 0 || from > MAX_DEVICES) from = 0;
+
+    capsCacheSync();
+
+    const int n = sizeof(g_caps_json);
+    int w = 0;
+    g_caps_json[w++] = '{';
+    for (int f = 0; f < CAPS_STATIC; f++) {
+        if (!(want & (1 << f))) continue;
+        int len = g_caps_static_off[f + 1] - g_caps_static_off[f];
+        memcpy(g_caps_json + w, g_caps_static + g_caps_static_off[f], len);
+        w += len;
+    }
+    if (want & (1 << CAPS_FREE_HEAP))
+        w += snprintf(g_caps_json + w, n - w, "\"free_heap\":%u,", ESP.getFreeHeap());
+    if (want & (1 << CAPS_RSSI))
+        w += snprintf(g_caps_json + w, n - w, "\"rssi\":%d,", WiFi.RSSI());
+    if (want & (1 << CAPS_IP))
+        w += snprintf(g_caps_json + w, n - w, "\"ip\":\"%s\",", WiFi.localIP().toString().c_str());
+
+    int next = -1;
+    if (want & (1 << CAPS_DEVICES)) {
+        w += snprintf(g_caps_json + w, n - w, "\"devices\":[");
+        const Device *devs = deviceGetAll();
+        bool firstDev = true;
+        for (int i = from; i < MAX_DEVICES; i++) {
+            const Device *d = &devs[i];
+            if (!d->used) continue;
+            if (w > n - CAPS_DEV_ROOM) { next = i; break; }
+            if (!firstDev) g_caps_json[w++] = ',';
+            firstDev = false;
+            int len = g_caps_dev_off[i + 1] - g_caps_dev_off[i];
+            memcpy(g_caps_json + w, g_caps_devs + g_caps_dev_off[i], len);
+            w += len;
+            float val;
+            if (!deviceIsSensor(d->kind))
+                w += snprintf(g_caps_json + w, n - w, ",\"value\":%d}", d->last_value);
+            else if (deviceLastSample(d, &val))
+                w += snprintf(g_caps_json + w, n - w, ",\"value\":%.1f}", val);
+            else
+                w += snprintf(g_caps_json + w, n - w, ",\"value\":null}");
+        }
+        w += snprintf(g_caps_json + w, n - w, "],");
+        if (next >= 0)
+            w += snprintf(g_caps_json + w, n - w, "\"next\":%d,", next);
+    }
+    g_caps_json[w - 1] = '}';       /* replaces the trailing comma */
+    g_caps_json[w] = '\0';
 
     if (g_debug) Serial.printf("[NATS] capabilities: %d bytes\n", w);
 
@@ -495,9 +791,32 @@ static bool connectNats() {
 
     natsClient.onEvent(onNatsEvent, nullptr);
 
-    if (!natsClient.connect(cfg_nats_host, (uint16_t)cfg_nats_port, 2000)) {
-        Serial.printf("NATS: connection failed\n");
-        return false;
+    /* Connect to the address cached from the last connection, skipping
+       DNS; on failure forget it and resolve the host */
+    IPAddress ip;
+    uint32_t cached_ip = bootCacheNatsIp(cfg_nats_host);
+    bool cached = cached_ip != 0;
+    if (cached) {
+        if (!natsClient.connect(IPAddress(cached_ip).toString().c_str(),
+                                (uint16_t)cfg_nats_port, 2000)) {
+            Serial.printf("NATS: cached address failed, resolving %s\n", cfg_nats_host);
+            bootCacheSetNatsIp(cfg_nats_host, 0);
+            cached = false;
+        }
+    }
+    if (!cached) {
+        bool literal = ip.fromString(cfg_nats_host);
+        bool resolved = literal || WiFi.hostByName(cfg_nats_host, ip);
+        if (!natsClient.connect(resolved ? ip.toString().c_str() : cfg_nats_host,
+                                (uint16_t)cfg_nats_port, 2000)) {
+            Serial.printf("NATS: connection failed\n");
+            return false;
+        }
+        if (resolved && !literal) bootCacheSetNatsIp(cfg_nats_host, (uint32_t)ip);
+    }
+    if (!g_boot.nats) {
+        g_boot.nats = millis();
+        g_boot.nats_cached = cached;
     }
 
     nats_err_t err;
@@ -550,6 +869,7 @@ static bool connectNats() {
     static char eventsSubject[64];
     snprintf(eventsSubject, sizeof(eventsSubject), "%s.events", cfg_device_name);
     natsClient.publish(eventsSubject, onlineMsg);
+    if (!g_boot.online) g_boot.online = millis();
 
     Serial.printf("NATS: subscribed to %s, %s, %s, %s\n",
                   natsSubjectCapabilities, natsSubjectDiscover,
@@ -565,7 +885,7 @@ static bool connectNats() {
  * Heartbeat — periodic health publish to _ion.heartbeat
  *============================================================================*/
 
-static char g_hb_json[512];
+static char g_hb_json[640];
 static unsigned long lastHeartbeatPublish = 0;
 
 static void publishHeartbeat() {
@@ -591,10 +911,27 @@ static void publishHeartbeat() {
         "\"nats_reconnects\":%u,"
         "\"sensors\":%d,"
         "\"actuators\":%d,"
-        "\"events_fired\":%u}",
+        "\"events_fired\":%u,"
+        "\"loop_avg_us\":%u,"
+        "\"loop_peak_us\":%u",
         IONODE_VERSION, millis() / 1000,
         ESP.getFreeHeap(), WiFi.RSSI(),
-        g_nats_reconnects, sensors, actuators, g_events_fired);
+        g_nats_reconnects, sensors, actuators, g_events_fired,
+        g_loop_avg_us, g_loop_peak_us);
+
+    /* Boot phases, once: time to first publish is boot.online */
+    if (!g_boot_reported) {
+        w += snprintf(g_hb_json + w, sizeof(g_hb_json) - w,
+            ",\"boot\":{\"wait\":%u,\"config\":%u,\"devices\":%u,"
+            "\"wifi\":%u,\"nats\":%u,\"online\":%u,"
+            "\"wifi_cached\":%s,\"nats_cached\":%s}",
+            g_boot.wait, g_boot.config, g_boot.devices,
+            g_boot.wifi, g_boot.nats, g_boot.online,
+            g_boot.wifi_cached ? "true" : "false",
+            g_boot.nats_cached ? "true" : "false");
+        g_boot_reported = true;
+    }
+    w += snprintf(g_hb_json + w, sizeof(g_hb_json) - w, "}");
 
     natsClient.publish("_ion.heartbeat", g_hb_json);
 
@@ -602,6 +939,48 @@ static void publishHeartbeat() {
         Serial.printf("[Heartbeat] published (%d bytes)\n", w);
 }
 
+/*============================================================================
+ * Duty Cycle — battery nodes wake, sample, report when due and deep-sleep
+ *============================================================================*/
+
+/* One wake (setup() up to the registry has run). Does not return. */
+static void dutyWake() {
+    sleepBegin((uint32_t)cfg_sleep_interval, (uint32_t)cfg_sleep_report);
+    sleepSample();
+
+    if (sleepRadioNeeded() && cfg_wifi_ssid[0] && cfg_nats_host[0]) {
+        bool ok = false;
+        if (connectWiFi(DUTY_WIFI_TIMEOUT_MS)) {
+            configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+            setenv("TZ", cfg_timezone, 1);
+            tzset();
+            g_nats_enabled = true;
+            buildNatsSubjects();
+            if (connectNats()) {
+                publishHeartbeat();
+                ok = sleepPublish() >= 0 && natsClient.flush() == NATS_OK;
+                /* Core NATS does not queue: requests sent on seeing the
+                   heartbeat (config.sleep.set etc.) arrive in this window */
+                unsigned long t0 = millis();
+                while (millis() - t0 < DUTY_LISTEN_MS && natsClient.connected()) {
+                    natsClient.process();
+                    delay(10);
+                }
+                ok = ok && natsClient.connected();
+                natsClient.disconnect();
+            }
+        }
+        sleepRadioDone(ok);
+    }
+
+    /* Duty cycle switched off while listening: boot normally */
+    if (cfg_sleep_interval <= 0) {
+        if (g_config_dirty) configSave();
+        ESP.restart();
+    }
+    sleepEnter();
+}
+
 /*============================================================================
  * Serial Commands
  *============================================================================*/
@@ -668,6 +1047,7 @@ static void handleSerialCommand(const char *input) {
 
     if (strcmp(cmd, "reboot") == 0) {
         Serial.printf("Rebooting...\n");
+        seglogFlush();
         delay(200);
         ESP.restart();
         return;
@@ -691,9 +1071,48 @@ static void handleSerialCommand(const char *input) {
  * Setup
  *============================================================================*/
 
+/* A host on the USB CDC console, given a moment to show up after reset.
+   A UART console cannot be detected and is not waited for. */
+static bool consoleAttached() {
+#if ARDUINO_USB_CDC_ON_BOOT
+    for (int i = 0; i < 20 && !Serial; i++) delay(10);
+    return (bool)Serial;
+#else
+    return false;
+#endif
+}
+
+static bool g_console = false;
+
+/* Console input wakes the loop instead of waiting for its next pass */
+#if ARDUINO_USB_CDC_ON_BOOT
+static void consoleRxEvent(void *, esp_event_base_t, int32_t, void *) {
+    loopWake();
+}
+#else
+static void consoleRx() {
+    loopWake();
+}
+#endif
+
+static void consoleWakeSetup() {
+#if ARDUINO_USB_CDC_ON_BOOT && ARDUINO_USB_MODE
+    Serial.onEvent(ARDUINO_HW_CDC_RX_EVENT, consoleRxEvent);
+#elif ARDUINO_USB_CDC_ON_BOOT
+    Serial.onEvent(ARDUINO_USB_CDC_RX_EVENT, consoleRxEvent);
+#else
+    Serial.onReceive(consoleRx);
+#endif
+}
+
 void setup() {
     Serial.begin(115200);
-    delay(5000);
+    loopSchedInit();
+    consoleWakeSetup();
+    bool duty_wake = sleepWoke();
+    g_console = !duty_wake && consoleAttached();
+    if (g_console) delay(BOOT_CONSOLE_WAIT_MS);
+    g_boot.wait = millis();
 
     Serial.printf("\n\n");
     Serial.printf("========================================\n");
@@ -702,6 +1121,7 @@ void setup() {
 
     /* Load config from LittleFS */
     loadConfig();
+    g_boot.config = millis();
 
     Serial.printf("Device: %s\n", cfg_device_name);
 
@@ -715,8 +1135,19 @@ void setup() {
     }
 #endif
 
+    /* I2C bus pins/clock from config (buses start on first device) */
+    i2cBusConfig(0, -1, -1, (uint32_t)cfg_i2c_hz);
+    i2cBusConfig(1, cfg_i2c1_sda, cfg_i2c1_scl, (uint32_t)cfg_i2c1_hz);
+
     /* Initialize device registry */
     devicesInit();
+    g_boot.devices = millis();
+    if (duty_wake) sleepReleasePins();
+
+    if (duty_wake && cfg_sleep_interval > 0) dutyWake();
+
+    /* Sensor history log (replayed into history once NTP time is known) */
+    seglogInit();
 
     if (cfg_wifi_ssid[0] == '\0') {
         Serial.printf("\n[!] No WiFi config — starting setup portal\n");
@@ -729,6 +1160,10 @@ void setup() {
         runSetupPortal();
     }
 
+    /* Link changes wake the loop, which reconnects without blocking */
+    WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+
     /* NTP time sync */
     configTime(0, 0, "pool.ntp.org", "time.nist.gov");
     setenv("TZ", cfg_timezone, 1);
@@ -765,9 +1200,29 @@ void setup() {
  *============================================================================*/
 
 static unsigned long lastHeartbeat = 0;
+static bool ledBlinkOn = false;
+
+static void loopStatsUpdate(uint32_t us) {
+    static uint32_t win_max = 0;
+    static unsigned long win_start = 0;
+
+    g_loop_last_us = us;
+    g_loop_avg_us = g_loop_avg_us ? g_loop_avg_us - g_loop_avg_us / 16 + us / 16 : us;
+    if (us > g_loop_max_us) g_loop_max_us = us;
+    if (us > win_max) win_max = us;
+    if (us > LOOP_STALL_US) g_loop_stalls++;
+
+    unsigned long now = millis();
+    if (now - win_start >= LOOP_WINDOW_MS) {
+        g_loop_peak_us = win_max;
+        win_max = 0;
+        win_start = now;
+    }
+}
 
 void loop() {
     esp_task_wdt_reset();
+    uint32_t loop_t0 = micros();
 
     /* LED heartbeat - brief dim green blink when idle (suppressed when rgb_led is active) */
     unsigned long now = millis();
@@ -775,60 +1230,56 @@ void loop() {
         lastHeartbeat = now;
         if (!rgbLedOverride()) {
             led(0, 40, 0);
-            delay(50);
-            ledOff();
+            ledBlinkOn = true;
         }
+    } else if (ledBlinkOn && now - lastHeartbeat >= HEARTBEAT_BLINK_MS) {
+        ledBlinkOn = false;
+        if (!rgbLedOverride()) ledOff();
     }
+    loopAt(lastHeartbeat + (ledBlinkOn ? HEARTBEAT_BLINK_MS : HEARTBEAT_INTERVAL_MS + 1));
 
-    /* Check WiFi */
-    if (WiFi.status() != WL_CONNECTED) {
-        Serial.printf("\nWiFi disconnected! Reconnecting...\n");
-        ledRed();
-        if (!connectWiFi()) {
-            delay(5000);
-            return;
-        }
-        Serial.printf("> ");
-    }
+    /* Check WiFi; while it reconnects the local work below keeps running */
+    bool wifi_up = wifiPoll(now);
 
     /* Process web server */
-    webConfigLoop();
+    if (wifi_up) webConfigLoop();
 
     /* Process NATS */
-    if (g_nats_enabled) {
+    if (g_nats_enabled && wifi_up) {
         if (natsClient.connected()) {
             nats_err_t err = natsClient.process();
             if (err != NATS_OK && err != NATS_ERR_WOULD_BLOCK) {
                 if (g_debug) Serial.printf("NATS: process error: %s\n",
                                            nats_err_str(err));
             }
+            /* Read-ahead left in the client's buffer does not make the
+               socket readable: run the next pass at once to take it */
+            if (natsClient.pending() > 0) loopIn(0);
         } else {
             /* Reconnect with backoff */
             if (now - natsLastReconnect > NATS_RECONNECT_DELAY_MS) {
                 natsLastReconnect = now;
                 connectNats();
             }
+            loopAt(natsLastReconnect + NATS_RECONNECT_DELAY_MS + 1);
         }
     }
+    /* Incoming messages wake the loop */
+    loopWatch(LOOP_WATCH_NATS, natsClient.connected() ? natsClient.socketFd() : -1);
 
-    /* Poll serial_text UART for incoming data */
+    /* Deliver finished ADC captures */
+    halPoll();
+
+    /* Publish serial_text lines (the UART tasks wake the loop) */
     serialTextPoll();
 
-    /* Keep sensor EMA values warm (every 10s) + history (every 5min) */
+    /* Keep sensor EMA values warm, sample history + events (every 1s) */
     sensorsPoll();
 
-    /* Refresh SSD1306 display templates (every 2s) */
+    /* Re-render display templates whose values changed; an explicit write
+       holds the panel, {ip}/{heap}/{uptime} are checked once a second */
     displayPoll();
 
-    /* Check event thresholds every 1 second */
-    {
-        static unsigned long lastEventsCheck = 0;
-        if (now - lastEventsCheck >= 1000) {
-            lastEventsCheck = now;
-            eventsCheck();
-        }
-    }
-
     /* Debounced saves — flush dirty flags after delay */
     if (g_devices_dirty && (now - g_devices_dirty_ms >= 5000)) {
         devicesSave();
@@ -838,14 +1289,17 @@ void loop() {
         configSave();
         g_config_dirty = false;
     }
+    if (g_devices_dirty) loopAt(g_devices_dirty_ms + 5000);
+    if (g_config_dirty)  loopAt(g_config_dirty_ms + 2000);
 
     /* Heartbeat publish */
     if (g_nats_connected && cfg_heartbeat_interval > 0) {
         unsigned long hb_interval_ms = (unsigned long)cfg_heartbeat_interval * 1000;
-        if (now - lastHeartbeatPublish >= hb_interval_ms) {
+        if (!g_boot_reported || now - lastHeartbeatPublish >= hb_interval_ms) {
             lastHeartbeatPublish = now;
             publishHeartbeat();
         }
+        loopAt(lastHeartbeatPublish + hb_interval_ms);
     }
 
     /* Read serial input character by character */
@@ -895,12 +1349,26 @@ void loop() {
         }
     }
 
+    /* Duty cycle: first sleep once the power-on grace period is over. A
+       USB console attached at power-on keeps the node awake. */
+    if (cfg_sleep_interval > 0 && !g_console && !g_reboot_pending &&
+        millis() >= DUTY_GRACE_MS) {
+        if (g_nats_connected) natsClient.disconnect();
+        sleepBegin((uint32_t)cfg_sleep_interval, (uint32_t)cfg_sleep_report);
+        sleepEnter();
+    }
+
     /* Deferred reboot (allows HTTP response to flush) */
     if (g_reboot_pending && millis() >= g_reboot_at) {
         Serial.printf("Rebooting...\n");
+        seglogFlush();
         delay(200);
         ESP.restart();
     }
+    if (g_reboot_pending) loopAt(g_reboot_at);
 
-    delay(10);
+    /* Sleep until the earliest deadline above or a wake (NATS, console,
+       GPIO edge, ADC capture) */
+    loopStatsUpdate(micros() - loop_t0);
+    loopWait();
 }
@@ -3,13 +3,18 @@
  * @brief NATS remote configuration handler
  *
  * Subscribes to {device_name}.config.> and routes to sub-handlers for
- * remote device management, tag/group config, heartbeat, and events.
+ * remote device management, tag/group config, heartbeat, events and rules.
  */
 
 #include <Arduino.h>
 #include "nats_config.h"
 #include "devices.h"
+#include "subject_router.h"
+#include "subject_keys.h"
+#include "events.h"
+#include "i2c_devices.h"
 #include "nats_hal.h"
+#include "duty_cycle.h"
 
 /* Externs from main.cpp */
 extern char cfg_device_name[32];
@@ -19,6 +24,12 @@ extern int  cfg_nats_port;
 extern char cfg_timezone[64];
 extern char cfg_tag[32];
 extern int  cfg_heartbeat_interval;
+extern int  cfg_i2c_hz;
+extern int  cfg_i2c1_sda;
+extern int  cfg_i2c1_scl;
+extern int  cfg_i2c1_hz;
+extern int  cfg_sleep_interval;
+extern int  cfg_sleep_report;
 extern bool g_debug;
 extern bool g_config_dirty;
 extern unsigned long g_config_dirty_ms;
@@ -158,6 +169,7 @@ static void cfgDeviceAdd(nats_client_t *client, const nats_msg_t *msg,
     char nats_subj[32] = "";
     cfgJsonGetString(payload, "ns", nats_subj, sizeof(nats_subj));
     uint32_t baud = (uint32_t)cfgJsonGetInt(payload, "bd", 0);
+    int uart = cfgJsonGetInt(payload, "up", 1);
 
     /* Map kind string to enum (kindFromString is static in devices.cpp) */
     DeviceKind kind = DEV_SENSOR_DIGITAL;
@@ -186,6 +198,9 @@ static void cfgDeviceAdd(nats_client_t *client, const nats_msg_t *msg,
     else if (strcmp(kind_str, "dht11_humi") == 0)  kind = DEV_SENSOR_DHT11_HUMI;
     else if (strcmp(kind_str, "dht22_temp") == 0)  kind = DEV_SENSOR_DHT22_TEMP;
     else if (strcmp(kind_str, "dht22_humi") == 0)  kind = DEV_SENSOR_DHT22_HUMI;
+    else if (strcmp(kind_str, "pulse_count") == 0) kind = DEV_SENSOR_PULSE_COUNT;
+    else if (strcmp(kind_str, "pulse_rate") == 0)  kind = DEV_SENSOR_PULSE_RATE;
+    else if (strcmp(kind_str, "computed") == 0)    kind = DEV_SENSOR_COMPUTED;
     else {
         cfgError(client, msg, "unknown_kind", kind_str);
         return;
@@ -197,15 +212,52 @@ static void cfgDeviceAdd(nats_client_t *client, const nats_msg_t *msg,
     cfgJsonGetString(payload, "dt", disp_tmpl, sizeof(disp_tmpl));
     uint8_t i2c_reg_len = (uint8_t)cfgJsonGetInt(payload, "rl", 1);
     float i2c_scale = cfgJsonGetFloat(payload, "sc", 1.0f);
+    int i2c_ttl = cfgJsonGetInt(payload, "ct", DEV_I2C_TTL_DEFAULT);
+    int i2c_bus = cfgJsonGetInt(payload, "ib", 0);
+    if (i2c_bus < 0 || i2c_bus >= I2C_BUS_MAX) {
+        cfgError(client, msg, "invalid_bus", I2C_BUS_MAX > 1 ? "ib must be 0 or 1" : "ib must be 0 on this chip");
+        return;
+    }
+    if (i2c_ttl < 0 || i2c_ttl > 60000) {
+        cfgError(client, msg, "invalid_ttl", "ct must be 0-60000 ms");
+        return;
+    }
+
+    /* Digital inputs: debounce window and edge publishing */
+    int debounce = cfgJsonGetInt(payload, "db", DEV_DEBOUNCE_DEFAULT);
+    if (debounce < 0 || debounce > DEV_DEBOUNCE_MAX) {
+        cfgError(client, msg, "invalid_debounce", "db must be 0-1000 ms");
+        return;
+    }
+
+    /* Computed sensors: expression in "ex" (stored in the template field) */
+    if (kind == DEV_SENSOR_COMPUTED) {
+        cfgJsonGetString(payload, "ex", disp_tmpl, sizeof(disp_tmpl));
+        char err[64];
+        if (!deviceExprCheck(disp_tmpl, err, sizeof(err))) {
+            cfgError(client, msg, "invalid_expression", err);
+            return;
+        }
+        pin = PIN_NONE;
+    }
 
     bool ok = deviceRegister(name, kind, (uint8_t)pin, unit[0] ? unit : nullptr,
                         inverted, nats_subj[0] ? nats_subj : nullptr, baud,
                         i2c_addr, disp_tmpl[0] ? disp_tmpl : nullptr,
-                        i2c_reg_len, i2c_scale);
+                        i2c_reg_len, i2c_scale, (uint16_t)i2c_ttl, (uint8_t)i2c_bus,
+                        (uint8_t)uart);
     if (!ok) {
-        cfgError(client, msg, "register_failed", "duplicate name or registry full");
+        cfgError(client, msg, "register_failed",
+                 deviceIsPulse(kind) ? "duplicate name, registry full or no free pulse counter" :
+                 kind == DEV_SENSOR_SERIAL_TEXT ? "duplicate name, registry full or UART in use"
+                                                : "duplicate name or registry full");
         return;
     }
+    if (kind == DEV_SENSOR_DIGITAL) {
+        Device *d = deviceFind(name);
+        d->debounce_ms = (uint16_t)debounce;
+        d->edge_publish = cfgJsonGetBool(payload, "ep", false);
+    }
 
     devicesSave();
 
@@ -335,6 +387,102 @@ static void cfgHeartbeatSet(nats_client_t *client, const nats_msg_t *msg,
     Serial.printf("[Config] Heartbeat interval: %ds\n", cfg_heartbeat_interval);
 }
 
+/*============================================================================
+ * config.sleep.set / config.sleep.get — deep-sleep duty cycle
+ *============================================================================*/
+
+/* {"interval":300,"report":3600} or a bare interval. interval 0 = always on. */
+static void cfgSleepSet(nats_client_t *client, const nats_msg_t *msg,
+                        const char *payload) {
+    bool bare = isdigit((unsigned char)payload[0]);
+    int interval = bare ? atoi(payload) : cfgJsonGetInt(payload, "interval", cfg_sleep_interval);
+    int report = bare ? cfg_sleep_report : cfgJsonGetInt(payload, "report", cfg_sleep_report);
+    if (interval != 0 && (interval < 10 || interval > 86400)) {
+        cfgError(client, msg, "invalid_value", "interval 10-86400 seconds (0=off)");
+        return;
+    }
+    /* Reports carry the samples since the last one, at most DUTY_RING */
+    if (report != 0 && interval != 0 &&
+        (report < interval || report > interval * DUTY_RING)) {
+        char detail[64];
+        snprintf(detail, sizeof(detail), "report %d-%d seconds (0=every wake)",
+                 interval, interval * DUTY_RING);
+        cfgError(client, msg, "invalid_value", detail);
+        return;
+    }
+
+    cfg_sleep_interval = interval;
+    cfg_sleep_report = report;
+    g_config_dirty = true;
+    g_config_dirty_ms = millis();
+
+    cfgOk(client, msg);
+    Serial.printf("[Config] Sleep: interval %ds, report %ds\n",
+                  cfg_sleep_interval, cfg_sleep_report);
+}
+
+static void cfgSleepGet(nats_client_t *client, const nats_msg_t *msg) {
+    snprintf(g_cfg_reply, sizeof(g_cfg_reply), "{\"interval\":%d,\"report\":%d}",
+             cfg_sleep_interval, cfg_sleep_report);
+    if (msg->reply_len > 0)
+        nats_msg_respond_str(client, msg, g_cfg_reply);
+}
+
+/*============================================================================
+ * config.i2c.set / config.i2c.get — per-bus clock and pins
+ *============================================================================*/
+
+static void cfgI2cSet(nats_client_t *client, const nats_msg_t *msg,
+                      const char *payload) {
+    int bus = cfgJsonGetInt(payload, "b", 0);
+    if (bus < 0 || bus >= I2C_BUS_MAX) {
+        cfgError(client, msg, "invalid_bus", I2C_BUS_MAX > 1 ? "0-1" : "0");
+        return;
+    }
+    int hz = cfgJsonGetInt(payload, "hz", 0);
+    if (hz != 0 && (hz < 10000 || hz > 1000000)) {
+        cfgError(client, msg, "invalid_value", "hz 10000-1000000");
+        return;
+    }
+    int sda = cfgJsonGetInt(payload, "sda", -1);
+    int scl = cfgJsonGetInt(payload, "scl", -1);
+    if (bus == 0 && (sda >= 0 || scl >= 0)) {
+        cfgError(client, msg, "invalid_value", "bus 0 pins are fixed");
+        return;
+    }
+
+    i2cBusConfig((uint8_t)bus, sda, scl, (uint32_t)hz);
+    if (bus == 0) {
+        if (hz) cfg_i2c_hz = hz;
+    } else {
+        if (hz) cfg_i2c1_hz = hz;
+        if (sda >= 0) cfg_i2c1_sda = sda;
+        if (scl >= 0) cfg_i2c1_scl = scl;
+    }
+    g_config_dirty = true;
+    g_config_dirty_ms = millis();
+
+    cfgOk(client, msg);
+    Serial.printf("[Config] I2C bus %d: hz=%d sda=%d scl=%d\n", bus, hz, sda, scl);
+}
+
+static void cfgI2cGet(nats_client_t *client, const nats_msg_t *msg) {
+    int w = snprintf(g_cfg_json, sizeof(g_cfg_json), "{\"buses\":[");
+    for (int b = 0; b < I2C_BUS_MAX; b++) {
+        int sda, scl;
+        uint32_t hz;
+        bool active = i2cBusInfo((uint8_t)b, &sda, &scl, &hz);
+        w += snprintf(g_cfg_json + w, sizeof(g_cfg_json) - w,
+                      "%s{\"b\":%d,\"sda\":%d,\"scl\":%d,\"hz\":%lu,\"active\":%s}",
+                      b ? "," : "", b, sda, scl, (unsigned long)hz,
+                      active ? "true" : "false");
+    }
+    snprintf(g_cfg_json + w, sizeof(g_cfg_json) - w, "]}");
+
+    if (msg->reply_len > 0)
+        nats_msg_respond_str(client, msg, g_cfg_json);
+}
+
 /*============================================================================
  * config.event.set / config.event.clear / config.event.list (Phase 5)
  *============================================================================*/
@@ -370,16 +518,29 @@ static void cfgEventSet(nats_client_t *client, const nats_msg_t *msg,
         return;
     }
 
+    /* Optional: hysteresis band, measure mode, window length */
+    char mode_str[8] = "";
+    cfgJsonGetString(payload, "m", mode_str, sizeof(mode_str));
+    uint8_t mode = eventsModeFromString(mode_str);
+    if (mode == EV_MODE_BAD) {
+        cfgError(client, msg, "invalid_mode", "use value, rate, avg, min or max");
+        return;
+    }
+    float hyst = fabsf(cfgJsonGetFloat(payload, "h", 0.0f));
+    int window = cfgJsonGetInt(payload, "w", 10);
+
     dev->ev_threshold = threshold;
     dev->ev_direction = direction;
     dev->ev_cooldown = (uint16_t)constrain(cooldown, 1, 65535);
-    dev->ev_armed = true;
-    dev->ev_last_fire_ms = 0;
+    dev->ev_hysteresis = hyst;
+    dev->ev_mode = mode;
+    dev->ev_window = (uint8_t)constrain(window, 2, EV_WIN_MAX);
+    eventsDeviceChanged(dev);
 
     devicesMarkDirty();
     cfgOk(client, msg);
-    Serial.printf("[Config] Event set: %s %s %.1f (cd=%ds)\n",
-                  name, dir_str, threshold, cooldown);
+    Serial.printf("[Config] Event set: %s %s %s %.1f h=%.1f (cd=%ds)\n",
+                  name, eventsModeName(mode), dir_str, threshold, hyst, cooldown);
 }
 
 static void cfgEventClear(nats_client_t *client, const nats_msg_t *msg,
@@ -399,8 +560,9 @@ static void cfgEventClear(nats_client_t *client, const nats_msg_t *msg,
     dev->ev_direction = EV_DIR_NONE;
     dev->ev_threshold = 0.0f;
     dev->ev_cooldown = 0;
-    dev->ev_armed = false;
-    dev->ev_last_fire_ms = 0;
+    dev->ev_hysteresis = 0.0f;
+    dev->ev_mode = EV_MODE_VALUE;
+    eventsDeviceChanged(dev);
 
     devicesMarkDirty();
     cfgOk(client, msg);
@@ -424,8 +586,10 @@ static void cfgEventList(nats_client_t *client, const nats_msg_t *msg) {
         const char *dir = d->ev_direction == EV_DIR_ABOVE ? "above" : "below";
         w += snprintf(g_cfg_json + w, sizeof(g_cfg_json) - w,
             "{\"name\":\"%s\",\"threshold\":%.1f,\"direction\":\"%s\","
-            "\"cooldown\":%d,\"armed\":%s}",
+            "\"cooldown\":%d,\"hysteresis\":%.6g,\"mode\":\"%s\","
+            "\"window\":%d,\"armed\":%s}",
             d->name, d->ev_threshold, dir, d->ev_cooldown,
+            d->ev_hysteresis, eventsModeName(d->ev_mode), d->ev_window,
             d->ev_armed ? "true" : "false");
     }
 
@@ -435,6 +599,44 @@ static void cfgEventList(nats_client_t *client, const nats_msg_t *msg) {
         nats_msg_respond_str(client, msg, g_cfg_json);
 }
 
+/*============================================================================
+ * config.rule.set / config.rule.clear / config.rule.list
+ *============================================================================*/
+
+static void cfgRuleSet(nats_client_t *client, const nats_msg_t *msg,
+                        const char *payload) {
+    char err[64];
+    if (!eventsRuleSet(payload, err, sizeof(err))) {
+        cfgError(client, msg, "invalid_rule", err);
+        return;
+    }
+    devicesMarkDirty();     /* rules are saved together with devices */
+    cfgOk(client, msg);
+    if (g_debug) Serial.printf("[Config] Rule set (%d rules)\n", eventsRuleCount());
+}
+
+static void cfgRuleClear(nats_client_t *client, const nats_msg_t *msg,
+                          const char *payload) {
+    char name[EV_RULE_NAME_LEN];
+    if (!cfgJsonGetString(payload, "n", name, sizeof(name))) {
+        cfgError(client, msg, "missing_field", "n (rule name)");
+        return;
+    }
+    if (!eventsRuleClear(name)) {
+        cfgError(client, msg, "not_found", name);
+        return;
+    }
+    devicesMarkDirty();
+    cfgOk(client, msg);
+    Serial.printf("[Config] Rule cleared: %s\n", name);
+}
+
+static void cfgRuleList(nats_client_t *client, const nats_msg_t *msg) {
+    eventsRuleList(g_cfg_json, sizeof(g_cfg_json));
+    if (msg->reply_len > 0)
+        nats_msg_respond_str(client, msg, g_cfg_json);
+}
+
 /*============================================================================
  * config.name.set
  *============================================================================*/
@@ -490,9 +692,11 @@ static void cfgGet(nats_client_t *client, const nats_msg_t *msg) {
         "{\"device_name\":\"%s\",\"wifi_ssid\":\"%s\","
         "\"nats_host\":\"%s\",\"nats_port\":%d,"
         "\"timezone\":\"%s\",\"tag\":\"%s\","
-        "\"heartbeat_interval\":%d}",
+        "\"heartbeat_interval\":%d,"
+        "\"sleep_interval\":%d,\"sleep_report\":%d}",
         esc_name, esc_ssid, esc_host, cfg_nats_port,
-        esc_tz, esc_tag, cfg_heartbeat_interval);
+        esc_tz, esc_tag, cfg_heartbeat_interval,
+        cfg_sleep_interval, cfg_sleep_report);
 
     if (msg->reply_len > 0)
         nats_msg_respond_str(client, msg, g_cfg_json);
@@ -505,32 +709,34 @@ static void cfgGet(nats_client_t *client, const nats_msg_t *msg) {
 void onNatsConfig(nats_client_t *client, const nats_msg_t *msg, void *userdata) {
     (void)userdata;
 
-    /* Skip prefix: "{device_name}.config." */
-    if ((int)msg->subject_len <= cfgPrefixLen()) return;
-    const char *suffix = msg->subject + cfgPrefixLen();
-
-    /* Copy payload into null-terminated stack buffer */
-    char payload[256];
-    size_t plen = msg->data_len < sizeof(payload) - 1
-                  ? msg->data_len : sizeof(payload) - 1;
-    if (msg->data && plen > 0)
-        memcpy(payload, msg->data, plen);
-    payload[plen] = '\0';
+    /* Tokens after "{device_name}.config.", payload terminated in place */
+    Route r;
+    if (!routeParse(msg, cfgPrefixLen(), &r)) return;
+    const char *payload = r.payload;
 
     if (g_debug)
-        Serial.printf("[NATS] config: %s (payload='%s')\n", suffix, payload);
-
-    /* Route by suffix */
-    if (strcmp(suffix, "device.add") == 0)         cfgDeviceAdd(client, msg, payload);
-    else if (strcmp(suffix, "device.remove") == 0)  cfgDeviceRemove(client, msg, payload);
-    else if (strcmp(suffix, "device.list") == 0)    cfgDeviceList(client, msg);
-    else if (strcmp(suffix, "tag.set") == 0)        cfgTagSet(client, msg, payload);
-    else if (strcmp(suffix, "tag.get") == 0)        cfgTagGet(client, msg);
-    else if (strcmp(suffix, "heartbeat.set") == 0)  cfgHeartbeatSet(client, msg, payload);
-    else if (strcmp(suffix, "event.set") == 0)      cfgEventSet(client, msg, payload);
-    else if (strcmp(suffix, "event.clear") == 0)    cfgEventClear(client, msg, payload);
-    else if (strcmp(suffix, "event.list") == 0)     cfgEventList(client, msg);
-    else if (strcmp(suffix, "name.set") == 0)       cfgNameSet(client, msg, payload);
-    else if (strcmp(suffix, "get") == 0)            cfgGet(client, msg);
-    else cfgError(client, msg, "unknown_command", suffix);
+        Serial.printf("[NATS] config: %s (payload='%s')\n", r.suffix, payload);
+
+    switch (cfgCommand(&r)) {
+    case CCMD_DEVICE_ADD:     cfgDeviceAdd(client, msg, payload); break;
+    case CCMD_DEVICE_REMOVE:  cfgDeviceRemove(client, msg, payload); break;
+    case CCMD_DEVICE_LIST:    cfgDeviceList(client, msg); break;
+    case CCMD_TAG_SET:        cfgTagSet(client, msg, payload); break;
+    case CCMD_TAG_GET:        cfgTagGet(client, msg); break;
+    case CCMD_HEARTBEAT_SET:  cfgHeartbeatSet(client, msg, payload); break;
+    case CCMD_I2C_SET:        cfgI2cSet(client, msg, payload); break;
+    case CCMD_I2C_GET:        cfgI2cGet(client, msg); break;
+    case CCMD_EVENT_SET:      cfgEventSet(client, msg, payload); break;
+    case CCMD_EVENT_CLEAR:    cfgEventClear(client, msg, payload); break;
+    case CCMD_EVENT_LIST:     cfgEventList(client, msg); break;
+    case CCMD_RULE_SET:       cfgRuleSet(client, msg, payload); break;
+    case CCMD_RULE_CLEAR:     cfgRuleClear(client, msg, payload); break;
+    case CCMD_RULE_LIST:      cfgRuleList(client, msg); break;
+    case CCMD_NAME_SET:       cfgNameSet(client, msg, payload); break;
+    case CCMD_SLEEP_SET:      cfgSleepSet(client, msg, payload); break;
+    case CCMD_SLEEP_GET:      cfgSleepGet(client, msg); break;
+    case CCMD_GET:            cfgGet(client, msg); break;
+    default:                  cfgError(client, msg, "unknown_command", r.suffix); break;
+    }
+    routeRelease(&r);
 }
@@ -12,7 +12,19 @@
 #include "nats_hal.h"
 #include "devices.h"
 #include "i2c_devices.h"
+#include "adc_stream.h"
+#include "pulse_counter.h"
+#include "serial_text.h"
+#include "history.h"
+#include "subject_router.h"
+#include "subject_keys.h"
+#include "loop_sched.h"
 #include "soc/soc_caps.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/gpio_periph.h"
+#include "soc/io_mux_reg.h"
 #if !defined(CONFIG_IDF_TARGET_ESP32)
 #include "driver/temperature_sensor.h"
 extern temperature_sensor_handle_t g_temp_sensor;
@@ -22,6 +34,7 @@ extern temperature_sensor_handle_t g_temp_sensor;
 extern char cfg_device_name[32];
 extern bool g_debug;
 extern uint32_t g_nats_reconnects;
+extern uint32_t g_loop_last_us, g_loop_avg_us, g_loop_peak_us, g_loop_max_us, g_loop_stalls;
 
 /* Own JSON buffer for device list handler (replaces WireClaw's toolCallJsonBuf) */
 static char g_hal_json[2048];
@@ -34,7 +47,8 @@ static uint8_t s_pwm_state[SOC_GPIO_PIN_COUNT] = {0};
 
 /* Reserved HAL keywords — cannot be used as device names */
 static const char *HAL_RESERVED[] = {
-    "gpio", "adc", "pwm", "dac", "uart", "i2c", "system", "device", "config"
+    "gpio", "adc", "pwm", "dac", "uart", "i2c", "i2c1", "system", "device", "config",
+    "batch"
 };
 #define HAL_RESERVED_COUNT (sizeof(HAL_RESERVED) / sizeof(HAL_RESERVED[0]))
 
@@ -59,63 +73,139 @@ static void halError(nats_client_t *client, const nats_msg_t *msg,
         nats_msg_respond_str(client, msg, g_hal_reply);
 }
 
-static int parsePin(const char *s) {
-    if (!s || !*s) return -1;
-    char *end = nullptr;
-    long v = strtol(s, &end, 10);
-    if (end == s) return -1;
-    return (int)v;
+/* Integer field from a flat JSON payload */
+static int halJsonInt(const char *payload, const char *key, int def) {
+    char pattern[24];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char *p = strstr(payload, pattern);
+    if (!p) return def;
+    p += strlen(pattern);
+    while (*p == ' ' || *p == ':') p++;
+    if (strncmp(p, "true", 4) == 0) return 1;
+    if (strncmp(p, "false", 5) == 0) return 0;
+    return atoi(p);
 }
 
-/* Advance past first segment, return pointer to rest (after '.') or NULL */
-static const char *nextSegment(const char *s) {
-    const char *dot = strchr(s, '.');
-    if (!dot) return nullptr;
-    return dot + 1;
+/* String field from a flat JSON payload */
+static bool halJsonStr(const char *payload, const char *key, char *dst, int dst_len) {
+    char pattern[24];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char *p = strstr(payload, pattern);
+    if (!p) return false;
+    p += strlen(pattern);
+    while (*p == ' ' || *p == ':') p++;
+    if (*p != '"') return false;
+    p++;
+    int w = 0;
+    while (*p && *p != '"' && w < dst_len - 1) dst[w++] = *p++;
+    dst[w] = '\0';
+    return w > 0;
 }
 
 /*============================================================================
- * Handler: gpio.{pin}.get / gpio.{pin}.set
+ * GPIO registers - all pins in one access per 32-pin bank
  *============================================================================*/
 
+#define HAL_GPIO_VALID  ((1ULL << SOC_GPIO_PIN_COUNT) - 1)
+
+static portMUX_TYPE s_gpio_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/* Input levels, bit n = GPIO n */
+static uint64_t halGpioReadAll() {
+    uint64_t v = REG_READ(GPIO_IN_REG);
+#if SOC_GPIO_PIN_COUNT > 32
+    v |= (uint64_t)REG_READ(GPIO_IN1_REG) << 32;
+#endif
+    return v & HAL_GPIO_VALID;
+}
+
+/* Pins whose output driver is enabled */
+static uint64_t halGpioOutputs() {
+    uint64_t v = REG_READ(GPIO_ENABLE_REG);
+#if SOC_GPIO_PIN_COUNT > 32
+    v |= (uint64_t)REG_READ(GPIO_ENABLE1_REG) << 32;
+#endif
+    return v & HAL_GPIO_VALID;
+}
+
+/* True if the GPIO output register drives the pin: IO MUX set to the GPIO
+   function, the matrix output select on the plain GPIO signal (not LEDC,
+   UART, ... routed to it) and the output driver enabled. SIG_GPIO_OUT_IDX
+   is the highest select value, so (idx << 1) - 1 masks the select field. */
+static bool halGpioIsPlainOutput(int pin) {
+    if (!((halGpioOutputs() >> pin) & 1)) return false;
+    if (((REG_READ(GPIO_PIN_MUX_REG[pin]) & MCU_SEL_M) >> MCU_SEL_S) != PIN_FUNC_GPIO)
+        return false;
+    uint32_t sel = REG_READ(GPIO_FUNC0_OUT_SEL_CFG_REG + 4 * pin) & ((SIG_GPIO_OUT_IDX << 1) - 1);
+    return sel == SIG_GPIO_OUT_IDX;
+}
+
+/* Latch the output levels of all pins in mask with one write per bank.
+   Interrupts are off between the read and the write, so nothing on this
+   core can change another pin in between. */
+static void halGpioWriteAll(uint64_t mask, uint64_t levels) {
+    portENTER_CRITICAL(&s_gpio_mux);
+    uint32_t lo = (uint32_t)mask;
+    if (lo) REG_WRITE(GPIO_OUT_REG, (REG_READ(GPIO_OUT_REG) & ~lo) | ((uint32_t)levels & lo));
+#if SOC_GPIO_PIN_COUNT > 32
+    uint32_t hi = (uint32_t)(mask >> 32);
+    if (hi) REG_WRITE(GPIO_OUT1_REG, (REG_READ(GPIO_OUT1_REG) & ~hi) | ((uint32_t)(levels >> 32) & hi));
+#endif
+    portEXIT_CRITICAL(&s_gpio_mux);
+}
+
+/*============================================================================
+ * Handler: gpio.{pin}.get / gpio.{pin}.set / gpio.read_all
+ *============================================================================*/
+
+/* Pin token of gpio/adc/pwm subjects. Replies bad_pin and returns -1 if
+   it is not a valid GPIO number. */
+static int halPinToken(nats_client_t *client, const nats_msg_t *msg,
+                       const RouteToken &t) {
+    int pin;
+    if (!routeUint(t, 0xFFFF, &pin)) {
+        halError(client, msg, "bad_pin", "invalid pin number");
+        return -1;
+    }
+    if (pin >= SOC_GPIO_PIN_COUNT) {
+        halError(client, msg, "bad_pin", "pin out of range");
+        return -1;
+    }
+    return pin;
+}
+
 static void halGpio(nats_client_t *client, const nats_msg_t *msg,
-                    const char *rest, const char *payload) {
-    /* rest = "{pin}.get" or "{pin}.set" */
-    if (!rest || !*rest) {
+                    const Route *r, const char *payload) {
+    /* tok[1] = "{pin}" or "read_all", tok[2] = "get" or "set" */
+    const RouteToken &arg = routeTok(r, 1);
+    if (r->n < 2 || arg.len == 0) {
         halError(client, msg, "bad_request", "gpio.{pin}.get or gpio.{pin}.set");
         return;
     }
 
-    /* Extract pin number */
-    char pinStr[8];
-    const char *dot = strchr(rest, '.');
-    if (!dot) {
-        halError(client, msg, "bad_request", "missing .get or .set suffix");
-        return;
-    }
-    size_t plen = dot - rest;
-    if (plen >= sizeof(pinStr)) {
-        halError(client, msg, "bad_request", "pin too long");
+    /* All input levels as one bitmask */
+    if (r->n == 2 && ROUTE_MATCH(arg, "read_all")) {
+        snprintf(g_hal_reply, sizeof(g_hal_reply), "%llu",
+                 (unsigned long long)halGpioReadAll());
+        if (msg->reply_len > 0)
+            nats_msg_respond_str(client, msg, g_hal_reply);
         return;
     }
-    memcpy(pinStr, rest, plen);
-    pinStr[plen] = '\0';
 
-    int pin = parsePin(pinStr);
-    if (pin < 0 || pin >= SOC_GPIO_PIN_COUNT) {
-        halError(client, msg, "bad_pin",
-                 pin < 0 ? "invalid pin number" : "pin out of range");
+    if (r->n < 3) {
+        halError(client, msg, "bad_request", "missing .get or .set suffix");
         return;
     }
+    int pin = halPinToken(client, msg, arg);
+    if (pin < 0) return;
 
-    const char *action = dot + 1;
-
-    if (strcmp(action, "get") == 0) {
+    const RouteToken &action = r->tok[2];
+    if (r->n == 3 && ROUTE_MATCH(action, "get")) {
         int val = digitalRead(pin);
         snprintf(g_hal_reply, sizeof(g_hal_reply), "%d", val);
         if (msg->reply_len > 0)
             nats_msg_respond_str(client, msg, g_hal_reply);
-    } else if (strcmp(action, "set") == 0) {
+    } else if (r->n == 3 && ROUTE_MATCH(action, "set")) {
         int val = 0;
         if (payload[0]) val = atoi(payload);
         pinMode(pin, OUTPUT);
@@ -128,35 +218,110 @@ static void halGpio(nats_client_t *client, const nats_msg_t *msg,
 }
 
 /*============================================================================
- * Handler: adc.{pin}.read
+ * Handler: adc.{pin}.read / adc.{pin}.capture
  *============================================================================*/
 
-static void halAdc(nats_client_t *client, const nats_msg_t *msg,
-                   const char *rest, const char *payload) {
-    (void)payload;
-    if (!rest || !*rest) {
-        halError(client, msg, "bad_request", "adc.{pin}.read");
+/* Pending capture: the reply goes out from halPoll() once the buffer is
+ * full. Samples are published as little-endian int16 in chunks of
+ * HAL_CAPTURE_CHUNK bytes to the request's reply subject, then a JSON trailer
+ * with the status and the number of chunks sent. */
+#define HAL_CAPTURE_CHUNK  4096
+
+static nats_client_t *g_cap_client = nullptr;
+static char  g_cap_reply[NATS_MAX_SUBJECT_LEN];
+static bool  g_cap_mv = false;
+
+static void halAdcCapture(nats_client_t *client, const nats_msg_t *msg,
+                          int pin, const char *payload) {
+    if (msg->reply_len == 0 || msg->reply_len >= sizeof(g_cap_reply)) {
+        halError(client, msg, "bad_request", "capture needs a reply subject");
+        return;
+    }
+    if (g_cap_client) {
+        halError(client, msg, "busy", "capture in progress");
+        return;
+    }
+    int n  = halJsonInt(payload, "n", 1000);
+    int hz = halJsonInt(payload, "hz", 10000);
+    if (n < 1 || n > ADC_CAPTURE_MAX) {
+        snprintf(g_hal_reply, sizeof(g_hal_reply),
+                 "{\"error\":\"bad_count\",\"detail\":\"n 1-%d\"}", ADC_CAPTURE_MAX);
+        nats_msg_respond_str(client, msg, g_hal_reply);
+        return;
+    }
+    if (hz < ADC_CAPTURE_HZ_MIN || hz > ADC_CAPTURE_HZ_MAX) {
+        snprintf(g_hal_reply, sizeof(g_hal_reply),
+                 "{\"error\":\"bad_rate\",\"detail\":\"hz %d-%d\"}",
+                 ADC_CAPTURE_HZ_MIN, ADC_CAPTURE_HZ_MAX);
+        nats_msg_respond_str(client, msg, g_hal_reply);
         return;
     }
+    if (!adcCaptureStart((uint8_t)pin, (uint32_t)hz, n)) {
+        halError(client, msg, "capture_failed", "pin not on ADC1 or ADC busy");
+        return;
+    }
+    memcpy(g_cap_reply, msg->reply, msg->reply_len);
+    g_cap_reply[msg->reply_len] = '\0';
+    g_cap_mv = halJsonInt(payload, "mv", 0) != 0;
+    g_cap_client = client;
+}
+
+void halPoll() {
+    if (!g_cap_client) return;
+    int st = adcCapturePoll();
+    if (st == 0) return;
+
+    if (st < 0) {
+        nats_publish_str(g_cap_client, g_cap_reply,
+                         "{\"error\":\"capture_failed\",\"detail\":\"timeout\"}");
+    } else {
+        int n;
+        const int16_t *samples = adcCaptureData(&n, g_cap_mv);
+        /* The ESP32 is little-endian: the buffer is the wire format */
+        const uint8_t *p = (const uint8_t *)samples;
+        size_t left = (size_t)n * sizeof(int16_t);
+        int chunks = 0;
+        while (left > 0) {
+            size_t len = left < HAL_CAPTURE_CHUNK ? left : HAL_CAPTURE_CHUNK;
+            if (nats_publish(g_cap_client, g_cap_reply, p, len) != NATS_OK) break;
+            p += len;
+            left -= len;
+            chunks++;
+        }
 
-    char pinStr[8];
-    const char *dot = strchr(rest, '.');
-    size_t plen = dot ? (size_t)(dot - rest) : strlen(rest);
-    if (plen >= sizeof(pinStr)) {
-        halError(client, msg, "bad_request", "pin too long");
+        /* Trailer: a requester can tell a complete capture from a cut one */
+        char trailer[96];
+        if (left == 0)
+            snprintf(trailer, sizeof(trailer), "{\"ok\":true,\"n\":%d,\"chunks\":%d}",
+                     n, chunks);
+        else
+            snprintf(trailer, sizeof(trailer),
+                     "{\"error\":\"capture_failed\",\"detail\":\"publish\",\"n\":%d,\"chunks\":%d}",
+                     n, chunks);
+        nats_publish_str(g_cap_client, g_cap_reply, trailer);
+    }
+    adcCaptureEnd();
+    g_cap_client = nullptr;
+}
+
+static void halAdc(nats_client_t *client, const nats_msg_t *msg,
+                   const Route *r, const char *payload) {
+    /* tok[1] = "{pin}", tok[2] = "read" (default) or "capture" */
+    if (r->n < 2 || r->tok[1].len == 0) {
+        halError(client, msg, "bad_request", "adc.{pin}.read or adc.{pin}.capture");
         return;
     }
-    memcpy(pinStr, rest, plen);
-    pinStr[plen] = '\0';
+    int pin = halPinToken(client, msg, r->tok[1]);
+    if (pin < 0) return;
 
-    int pin = parsePin(pinStr);
-    if (pin < 0 || pin >= SOC_GPIO_PIN_COUNT) {
-        halError(client, msg, "bad_pin",
-                 pin < 0 ? "invalid pin number" : "pin out of range");
+    if (r->n == 3 && ROUTE_MATCH(r->tok[2], "capture")) {
+        halAdcCapture(client, msg, pin, payload);
         return;
     }
 
-    int val = analogRead(pin);
+    /* Streamed pins answer from the filter; others pause the stream */
+    float raw;
+    int val = adcStreamRaw(pin, &raw) ? (int)(raw + 0.5f) : adcOneshotRaw(pin);
     snprintf(g_hal_reply, sizeof(g_hal_reply), "%d", val);
     if (msg->reply_len > 0)
         nats_msg_respond_str(client, msg, g_hal_reply);
@@ -167,43 +332,28 @@ static void halAdc(nats_client_t *client, const nats_msg_t *msg,
  *============================================================================*/
 
 static void halPwm(nats_client_t *client, const nats_msg_t *msg,
-                   const char *rest, const char *payload) {
-    if (!rest || !*rest) {
+                   const Route *r, const char *payload) {
+    /* tok[1] = "{pin}", tok[2] = "set" or "get" */
+    if (r->n < 2 || r->tok[1].len == 0) {
         halError(client, msg, "bad_request", "pwm.{pin}.set or pwm.{pin}.get");
         return;
     }
-
-    char pinStr[8];
-    const char *dot = strchr(rest, '.');
-    if (!dot) {
+    if (r->n < 3) {
         halError(client, msg, "bad_request", "missing .set or .get suffix");
         return;
     }
-    size_t plen = dot - rest;
-    if (plen >= sizeof(pinStr)) {
-        halError(client, msg, "bad_request", "pin too long");
-        return;
-    }
-    memcpy(pinStr, rest, plen);
-    pinStr[plen] = '\0';
-
-    int pin = parsePin(pinStr);
-    if (pin < 0 || pin >= SOC_GPIO_PIN_COUNT) {
-        halError(client, msg, "bad_pin",
-                 pin < 0 ? "invalid pin number" : "pin out of range");
-        return;
-    }
+    int pin = halPinToken(client, msg, r->tok[1]);
+    if (pin < 0) return;
 
-    const char *action = dot + 1;
-
-    if (strcmp(action, "set") == 0) {
+    const RouteToken &action = r->tok[2];
+    if (r->n == 3 && ROUTE_MATCH(action, "set")) {
         int val = payload[0] ? atoi(payload) : 0;
         val = constrain(val, 0, 255);
         analogWrite(pin, val);
         s_pwm_state[pin] = (uint8_t)val;
         if (msg->reply_len > 0)
             nats_msg_respond_str(client, msg, "ok");
-    } else if (strcmp(action, "get") == 0) {
+    } else if (r->n == 3 && ROUTE_MATCH(action, "get")) {
         snprintf(g_hal_reply, sizeof(g_hal_reply), "%d", s_pwm_state[pin]);
         if (msg->reply_len > 0)
             nats_msg_respond_str(client, msg, g_hal_reply);
@@ -217,58 +367,74 @@ static void halPwm(nats_client_t *client, const nats_msg_t *msg,
  *============================================================================*/
 
 static void halDac(nats_client_t *client, const nats_msg_t *msg,
-                   const char *rest, const char *payload) {
-    (void)rest; (void)payload;
+                   const Route *r, const char *payload) {
+    (void)r; (void)payload;
     halError(client, msg, "no_dac", "DAC not available on this chip");
 }
 
 /*============================================================================
- * Handler: uart.read / uart.write
+ * Handler: uart.read / uart.write / uart.<n>.read / uart.<n>.write
  *============================================================================*/
 
 static void halUart(nats_client_t *client, const nats_msg_t *msg,
-                    const char *rest, const char *payload) {
-    if (!rest || !*rest) {
-        halError(client, msg, "bad_request", "uart.read or uart.write");
+                    const Route *r, const char *payload) {
+    /* tok[1] = "read"/"write", or "{n}" and tok[2] = "read"/"write" */
+    if (r->n < 2 || r->tok[1].len == 0) {
+        halError(client, msg, "bad_request", "uart.read or uart.<n>.read");
         return;
     }
 
-    if (strcmp(rest, "read") == 0) {
-        if (!serialTextActive()) {
-            halError(client, msg, "no_uart", "no serial_text device registered");
+    /* Optional UART number; without one the first serial_text device */
+    int uart = 0;
+    int ai = 1;
+    if (r->tok[1].p[0] >= '0' && r->tok[1].p[0] <= '9') {
+        if (!routeUint(r->tok[1], 255, &uart) || uart == 0 || r->n < 3) {
+            halError(client, msg, "bad_request", "uart.<n>.read or uart.<n>.write");
             return;
         }
-        const char *line = serialTextGetMsg();
-        snprintf(g_hal_reply, sizeof(g_hal_reply), "%s", line);
+        ai = 2;
+    }
+
+    const RouteToken &action = r->tok[ai];
+    bool rd = r->n == ai + 1 && ROUTE_MATCH(action, "read");
+    bool wr = r->n == ai + 1 && ROUTE_MATCH(action, "write");
+    if (!rd && !wr) {
+        halError(client, msg, "bad_action", "use uart.read or uart.write");
+        return;
+    }
+    Device *dev = deviceSerialText((uint8_t)uart);
+    if (!dev) {
+        halError(client, msg, "no_uart", "no serial_text device on this UART");
+        return;
+    }
+
+    if (rd) {
+        snprintf(g_hal_reply, sizeof(g_hal_reply), "%s", dev->nats_msg);
         if (msg->reply_len > 0)
             nats_msg_respond_str(client, msg, g_hal_reply);
-    } else if (strcmp(rest, "write") == 0) {
-        if (!serialTextActive()) {
-            halError(client, msg, "no_uart", "no serial_text device registered");
-            return;
-        }
-        serialTextSend(payload);
+    } else {
+        serialTextWrite(dev->uart, payload);
         if (msg->reply_len > 0)
             nats_msg_respond_str(client, msg, "ok");
-    } else {
-        halError(client, msg, "bad_action", "use uart.read or uart.write");
     }
 }
 
 /*============================================================================
- * Handler: system.temperature / system.heap / system.uptime
+ * Handler: system.temperature / system.heap / system.uptime / system.loop /
+ *          system.i2c_cache / system.adc / system.display
  *============================================================================*/
 
 static void halSystem(nats_client_t *client, const nats_msg_t *msg,
-                      const char *rest, const char *payload) {
+                      const Route *r, const char *payload) {
     (void)payload;
-    if (!rest || !*rest) {
+    if (r->n < 2 || r->tok[1].len == 0) {
         halError(client, msg, "bad_request",
                  "system.temperature, system.heap, or system.uptime");
         return;
     }
 
-    if (strcmp(rest, "temperature") == 0) {
+    switch (r->n == 2 ? halSysKey(r->tok[1]) : SYS_NONE) {
+    case SYS_TEMPERATURE: {
 #if !defined(CONFIG_IDF_TARGET_ESP32)
         float temp = 0.0f;
         if (g_temp_sensor)
@@ -277,13 +443,18 @@ static void halSystem(nats_client_t *client, const nats_msg_t *msg,
 #else
         snprintf(g_hal_reply, sizeof(g_hal_reply), "unsupported");
 #endif
-    } else if (strcmp(rest, "heap") == 0) {
+        break;
+    }
+    case SYS_HEAP:
         snprintf(g_hal_reply, sizeof(g_hal_reply), "%u", ESP.getFreeHeap());
-    } else if (strcmp(rest, "uptime") == 0) {
+        break;
+    case SYS_UPTIME:
         snprintf(g_hal_reply, sizeof(g_hal_reply), "%lu", millis() / 1000);
-    } else if (strcmp(rest, "rssi") == 0) {
+        break;
+    case SYS_RSSI:
         snprintf(g_hal_reply, sizeof(g_hal_reply), "%d", WiFi.RSSI());
-    } else if (strcmp(rest, "reset_reason") == 0) {
+        break;
+    case SYS_RESET_REASON: {
         const char *reason;
         switch (esp_reset_reason()) {
             case ESP_RST_POWERON:   reason = "power_on"; break;
@@ -297,11 +468,51 @@ static void halSystem(nats_client_t *client, const nats_msg_t *msg,
             default:                reason = "unknown"; break;
         }
         snprintf(g_hal_reply, sizeof(g_hal_reply), "%s", reason);
-    } else if (strcmp(rest, "nats_reconnects") == 0) {
+        break;
+    }
+    case SYS_NATS_RECONNECTS:
         snprintf(g_hal_reply, sizeof(g_hal_reply), "%u", g_nats_reconnects);
-    } else {
+        break;
+    case SYS_LOOP: {
+        uint32_t idle_pct, passes_s;
+        loopSchedStats(&idle_pct, &passes_s);
+        snprintf(g_hal_reply, sizeof(g_hal_reply),
+                 "{\"last_us\":%u,\"avg_us\":%u,\"peak_us\":%u,"
+                 "\"max_us\":%u,\"stalls\":%u,\"idle_pct\":%u,\"passes_s\":%u}",
+                 g_loop_last_us, g_loop_avg_us, g_loop_peak_us,
+                 g_loop_max_us, g_loop_stalls, idle_pct, passes_s);
+        break;
+    }
+    case SYS_I2C_CACHE: {
+        uint32_t hits, misses;
+        int entries;
+        i2cCacheStats(&hits, &misses, &entries);
+        snprintf(g_hal_reply, sizeof(g_hal_reply),
+                 "{\"hits\":%u,\"misses\":%u,\"entries\":%d,\"size\":%d}",
+                 hits, misses, entries, I2C_CACHE_MAX);
+        break;
+    }
+    case SYS_ADC: {
+        int channels;
+        uint32_t outputs, overruns;
+        bool running = adcStreamStats(&channels, &outputs, &overruns);
+        snprintf(g_hal_reply, sizeof(g_hal_reply),
+                 "{\"running\":%s,\"channels\":%d,\"sample_hz\":%d,"
+                 "\"decimation\":%d,\"outputs\":%u,\"overruns\":%u}",
+                 running ? "true" : "false", channels, ADC_STREAM_SAMPLE_HZ,
+                 ADC_STREAM_DECIM, outputs, overruns);
+        break;
+    }
+    case SYS_DISPLAY: {
+        uint32_t sent, skipped;
+        ssd1306Stats(&sent, &skipped);
+        snprintf(g_hal_reply, sizeof(g_hal_reply),
+                 "{\"bytes_sent\":%u,\"bytes_skipped\":%u}", sent, skipped);
+        break;
+    }
+    default:
         halError(client, msg, "bad_key",
-                 "use temperature, heap, uptime, rssi, reset_reason, or nats_reconnects");
+                 "use temperature, heap, uptime, rssi, reset_reason, nats_reconnects, loop, i2c_cache, adc, or display");
         return;
     }
 
@@ -311,24 +522,136 @@ static void halSystem(nats_client_t *client, const nats_msg_t *msg,
 
 /*============================================================================
  * Handler: i2c.scan / i2c.{addr}.detect / i2c.{addr}.read / i2c.{addr}.write
+ *          i2c.{addr}.xfer[.{n}]
+ * (i2c1.* addresses the second controller on ESP32/ESP32-S3)
  *============================================================================*/
 
+/* Burst transfers go up to the NATS payload limit: raw binary replies use
+ * all of it, hex replies half. */
+#define HAL_I2C_BURST_MAX  NATS_MAX_PAYLOAD_LEN
+
+static uint8_t g_i2c_burst[HAL_I2C_BURST_MAX + 2];
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static int hexNibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Decode the hex string of a JSON field into out. Returns the byte count,
+   or -1 if the field is missing, malformed or longer than max. */
+static int halJsonHex(const char *payload, const char *key, uint8_t *out, int max) {
+    char pattern[24];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char *p = strstr(payload, pattern);
+    if (!p) return -1;
+    p += strlen(pattern);
+    while (*p == ' ' || *p == ':') p++;
+    if (*p++ != '"') return -1;
+    int n = 0;
+    while (*p && *p != '"') {
+        if (*p == ' ') { p++; continue; }
+        int hi = hexNibble(p[0]), lo = hexNibble(p[1]);
+        if (hi < 0 || lo < 0 || n >= max) return -1;
+        out[n++] = (uint8_t)((hi << 4) | lo);
+        p += 2;
+    }
+    return n;
+}
+
+/* Register address bytes, big-endian, rw = 1 or 2 */
+static int i2cRegBytes(uint8_t *out, int reg, int rw) {
+    if (rw == 2) { out[0] = (uint8_t)(reg >> 8); out[1] = (uint8_t)reg; return 2; }
+    out[0] = (uint8_t)reg;
+    return 1;
+}
+
+/* Write reg (1 or 2 bytes), repeated start, read len bytes and reply them
+   as raw binary or as a hex string */
+static void halI2cBurstRead(nats_client_t *client, const nats_msg_t *msg,
+                            uint8_t addr, int reg, int rw, int len, bool hex) {
+    int max = (int)(hex ? HAL_I2C_BURST_MAX / 2 : HAL_I2C_BURST_MAX);
+    if (len < 1 || len > max) {
+        snprintf(g_hal_reply, sizeof(g_hal_reply),
+                 "{\"error\":\"bad_length\",\"detail\":\"len 1-%d\"}", max);
+        if (msg->reply_len > 0)
+            nats_msg_respond_str(client, msg, g_hal_reply);
+        return;
+    }
+    uint8_t regb[2];
+    int rn = i2cRegBytes(regb, reg, rw);
+    /* Hex: read into the upper half and expand downwards in place */
+    uint8_t *data = hex ? g_i2c_burst + len : g_i2c_burst;
+    if (!i2cTransfer(addr, regb, rn, data, len)) {
+        halError(client, msg, "read_failed", "I2C read error");
+        return;
+    }
+    if (msg->reply_len == 0) return;
+    if (hex) {
+        for (int i = 0; i < len; i++) {
+            uint8_t b = data[i];
+            g_i2c_burst[2 * i]     = HEX_DIGITS[b >> 4];
+            g_i2c_burst[2 * i + 1] = HEX_DIGITS[b & 0x0F];
+        }
+        nats_msg_respond(client, msg, g_i2c_burst, 2 * len);
+    } else {
+        nats_msg_respond(client, msg, g_i2c_burst, len);
+    }
+}
+
+/* xfer[.{n}]: the raw payload is written as is, then n bytes are read after
+   a repeated start and returned raw. No n: write only, reply "ok". */
+static void halI2cXfer(nats_client_t *client, const nats_msg_t *msg,
+                       uint8_t addr, const RouteToken *count) {
+    int n = 0;
+    if (count) {
+        if (!routeUint(*count, HAL_I2C_BURST_MAX, &n)) {
+            snprintf(g_hal_reply, sizeof(g_hal_reply),
+                     "{\"error\":\"bad_length\",\"detail\":\"n 0-%d\"}", (int)HAL_I2C_BURST_MAX);
+            if (msg->reply_len > 0)
+                nats_msg_respond_str(client, msg, g_hal_reply);
+            return;
+        }
+    }
+    if (n == 0 && msg->data_len == 0) {
+        halError(client, msg, "bad_request", "nothing to write or read");
+        return;
+    }
+    if (!i2cTransfer(addr, msg->data, msg->data_len, g_i2c_burst, n)) {
+        halError(client, msg, "xfer_failed", "I2C transfer error");
+        return;
+    }
+    if (msg->data_len > 0) i2cCacheInvalidate(addr);
+    if (msg->reply_len == 0) return;
+    if (n > 0) nats_msg_respond(client, msg, g_i2c_burst, n);
+    else       nats_msg_respond_str(client, msg, "ok");
+}
+
 static void halI2c(nats_client_t *client, const nats_msg_t *msg,
-                   const char *rest, const char *payload) {
-    if (!rest || !*rest) {
+                   const Route *r, const char *payload, uint8_t bus) {
+    if (bus >= I2C_BUS_MAX) {
+        halError(client, msg, "bad_bus", "this chip has one I2C bus");
+        return;
+    }
+    /* tok[1] = "scan", "recover" or "{addr}", tok[2] = action, tok[3] = n */
+    const RouteToken &arg = routeTok(r, 1);
+    if (r->n < 2 || arg.len == 0) {
         halError(client, msg, "bad_request",
                  "i2c.scan, i2c.{addr}.detect, i2c.{addr}.read, i2c.{addr}.write");
         return;
     }
 
     /* i2c.scan — no address needed */
-    if (strcmp(rest, "scan") == 0) {
+    if (r->n == 2 && ROUTE_MATCH(arg, "scan")) {
         /* Temporarily init I2C if not already active */
-        bool was_active = i2cActive();
-        if (!was_active) i2cInit();
+        bool was_active = i2cActive(bus);
+        if (!was_active) i2cInit(bus);
 
         uint8_t addrs[32];
-        int count = i2cScan(addrs, 32);
+        int count = i2cScan(addrs, 32, bus);
 
         int w = 0;
         w += snprintf(g_hal_reply, sizeof(g_hal_reply), "[");
@@ -338,7 +661,7 @@ static void halI2c(nats_client_t *client, const nats_msg_t *msg,
         }
         w += snprintf(g_hal_reply + w, sizeof(g_hal_reply) - w, "]");
 
-        if (!was_active) i2cDeinit();
+        if (!was_active) i2cDeinit(bus);
 
         if (msg->reply_len > 0)
             nats_msg_respond_str(client, msg, g_hal_reply);
@@ -346,44 +669,41 @@ static void halI2c(nats_client_t *client, const nats_msg_t *msg,
     }
 
     /* i2c.recover — bus recovery */
-    if (strcmp(rest, "recover") == 0) {
-        i2cRecover();
+    if (r->n == 2 && ROUTE_MATCH(arg, "recover")) {
+        i2cRecover(bus);
         if (msg->reply_len > 0)
             nats_msg_respond_str(client, msg, "ok");
         return;
     }
 
-    /* Parse address: i2c.{addr}.{action} */
-    char addrStr[8];
-    const char *dot = strchr(rest, '.');
-    if (!dot) {
+    /* i2c.{addr}.{action} */
+    if (r->n < 3) {
         halError(client, msg, "bad_request", "missing .detect, .read, or .write");
         return;
     }
-    size_t alen = dot - rest;
-    if (alen >= sizeof(addrStr)) {
-        halError(client, msg, "bad_request", "address too long");
+    int addr;
+    if (!routeUint(arg, 127, &addr) || addr < 1) {
+        halError(client, msg, "bad_address", "I2C address must be 1-127");
         return;
     }
-    memcpy(addrStr, rest, alen);
-    addrStr[alen] = '\0';
 
-    int addr = parsePin(addrStr);
-    if (addr < 1 || addr > 127) {
-        halError(client, msg, "bad_address", "I2C address must be 1-127");
+    /* Only xfer takes a token after the action */
+    const RouteToken &action = r->tok[2];
+    bool xfer = ROUTE_MATCH(action, "xfer");
+    if (r->n > (xfer ? 4 : 3)) {
+        halError(client, msg, "bad_action", "use detect, read, write, or xfer");
         return;
     }
+    bool was_active = i2cActive(bus);
+    if (!was_active) i2cInit(bus);
+    addr = I2C_BUS_ADDR(bus, addr);
 
-    const char *action = dot + 1;
-    bool was_active = i2cActive();
-    if (!was_active) i2cInit();
-
-    if (strcmp(action, "detect") == 0) {
+    if (ROUTE_MATCH(action, "detect")) {
         bool found = i2cDetect((uint8_t)addr);
         snprintf(g_hal_reply, sizeof(g_hal_reply), "%s", found ? "true" : "false");
         if (msg->reply_len > 0)
             nats_msg_respond_str(client, msg, g_hal_reply);
-    } else if (strcmp(action, "read") == 0) {
+    } else if (ROUTE_MATCH(action, "read")) {
         /* Payload: {"reg":0,"len":2} */
         int reg = 0, len = 1;
         if (payload[0] == '{') {
@@ -397,11 +717,32 @@ static void halI2c(nats_client_t *client, const nats_msg_t *msg,
             rp = strstr(payload, pattern);
             if (rp) { rp += 5; while (*rp == ' ' || *rp == ':') rp++; len = atoi(rp); }
         }
+        /* Burst: any length, 16-bit register addresses, binary or hex reply */
+        char fmt[8] = "";
+        bool has_fmt = strstr(payload, "\"fmt\"") != nullptr;
+        if (has_fmt && (!halJsonStr(payload, "fmt", fmt, sizeof(fmt)) ||
+                        (strcmp(fmt, "hex") != 0 && strcmp(fmt, "bin") != 0))) {
+            halError(client, msg, "bad_request", "fmt must be hex or bin");
+            if (!was_active) i2cDeinit(bus);
+            return;
+        }
+        int rw = halJsonInt(payload, "rw", 1);
+        if (rw != 1 && rw != 2) {
+            halError(client, msg, "bad_request", "rw must be 1 or 2");
+            if (!was_active) i2cDeinit(bus);
+            return;
+        }
+        if (has_fmt || rw == 2) {
+            halI2cBurstRead(client, msg, (uint8_t)addr, reg, rw, len, strcmp(fmt, "bin") != 0);
+            if (!was_active) i2cDeinit(bus);
+            return;
+        }
+
         if (len < 1) len = 1;
         if (len > 32) len = 32;
 
         uint8_t buf[32];
-        if (!i2cReadReg((uint8_t)addr, (uint8_t)reg, buf, (uint8_t)len)) {
+        if (!i2cReadRegCached((uint8_t)addr, (uint8_t)reg, buf, (uint8_t)len)) {
             halError(client, msg, "read_failed", "I2C read error");
         } else {
             int w = 0;
@@ -414,12 +755,32 @@ static void halI2c(nats_client_t *client, const nats_msg_t *msg,
             if (msg->reply_len > 0)
                 nats_msg_respond_str(client, msg, g_hal_reply);
         }
-    } else if (strcmp(action, "write") == 0) {
+    } else if (ROUTE_MATCH(action, "write")) {
         /* Payload: {"reg":0,"data":[1,2]} */
         int reg = 0;
         uint8_t data[32];
         int dlen = 0;
 
+        /* Burst: {"reg":0,"hex":"0102..."}, optionally "rw":2 */
+        if (strstr(payload, "\"hex\"")) {
+            int rw = halJsonInt(payload, "rw", 1);
+            int rn = i2cRegBytes(g_i2c_burst, halJsonInt(payload, "reg", 0), rw);
+            int n = halJsonHex(payload, "hex", g_i2c_burst + rn, HAL_I2C_BURST_MAX);
+            if (rw != 1 && rw != 2)
+                halError(client, msg, "bad_request", "rw must be 1 or 2");
+            else if (n <= 0)
+                halError(client, msg, "bad_request", "hex: even number of hex digits");
+            else if (!i2cTransfer((uint8_t)addr, g_i2c_burst, rn + n, nullptr, 0))
+                halError(client, msg, "write_failed", "I2C write error");
+            else {
+                i2cCacheInvalidate((uint8_t)addr);
+                if (msg->reply_len > 0)
+                    nats_msg_respond_str(client, msg, "ok");
+            }
+            if (!was_active) i2cDeinit(bus);
+            return;
+        }
+
         if (payload[0] == '{') {
             /* Parse "reg" */
             const char *rp = strstr(payload, "\"reg\"");
@@ -445,14 +806,18 @@ static void halI2c(nats_client_t *client, const nats_msg_t *msg,
         } else if (!i2cWriteReg((uint8_t)addr, (uint8_t)reg, data, (uint8_t)dlen)) {
             halError(client, msg, "write_failed", "I2C write error");
         } else {
+            /* Cached readings and queued conversions no longer reflect the chip */
+            i2cCacheInvalidate((uint8_t)addr);
             if (msg->reply_len > 0)
                 nats_msg_respond_str(client, msg, "ok");
         }
+    } else if (xfer) {
+        halI2cXfer(client, msg, (uint8_t)addr, r->n == 4 ? &r->tok[3] : nullptr);
     } else {
-        halError(client, msg, "bad_action", "use detect, read, or write");
+        halError(client, msg, "bad_action", "use detect, read, write, or xfer");
     }
 
-    if (!was_active) i2cDeinit();
+    if (!was_active) i2cDeinit(bus);
 }
 
 /*============================================================================
@@ -460,10 +825,10 @@ static void halI2c(nats_client_t *client, const nats_msg_t *msg,
  *============================================================================*/
 
 static void halDevice(nats_client_t *client, const nats_msg_t *msg,
-                      const char *rest, const char *payload) {
+                      const Route *r, const char *payload) {
     (void)payload;
     /* Only "list" sub-command for now */
-    if (rest && strcmp(rest, "list") != 0) {
+    if (r->n > 2 || (r->n == 2 && !ROUTE_MATCH(r->tok[1], "list"))) {
         halError(client, msg, "bad_action", "use device.list");
         return;
     }
@@ -503,34 +868,50 @@ static void halDevice(nats_client_t *client, const nats_msg_t *msg,
  * {sensor}.info  -> JSON with device details
  * {actuator}.set -> set actuator value (payload)
  * {actuator}.get -> read last actuator value
+ * {sensor}.history -> range query on the history store (payload: query)
  *============================================================================*/
 
 static void halDeviceLookup(nats_client_t *client, const nats_msg_t *msg,
-                            const char *name_and_suffix, const char *payload) {
-    /* Split "name" and optional ".info" / ".set" / ".get" suffix */
-    char devName[DEV_NAME_LEN];
-    const char *suffix = nullptr;
-    const char *dot = strchr(name_and_suffix, '.');
-    if (dot) {
-        size_t nlen = dot - name_and_suffix;
-        if (nlen >= sizeof(devName)) nlen = sizeof(devName) - 1;
-        memcpy(devName, name_and_suffix, nlen);
-        devName[nlen] = '\0';
-        suffix = dot + 1;
-    } else {
-        strncpy(devName, name_and_suffix, sizeof(devName) - 1);
-        devName[sizeof(devName) - 1] = '\0';
-    }
-
-    Device *dev = deviceFind(devName);
+                            const Route *r, const char *payload) {
+    /* First token is the name; the rest of the subject selects the action */
+    Device *dev = deviceFindN(r->tok[0].p, r->tok[0].len, r->tok[0].hash);
     if (!dev) {
+        char devName[DEV_NAME_LEN];
+        size_t nlen = r->tok[0].len < sizeof(devName) - 1 ? r->tok[0].len : sizeof(devName) - 1;
+        memcpy(devName, r->tok[0].p, nlen);
+        devName[nlen] = '\0';
         halError(client, msg, "not_found", devName);
         return;
     }
+    const char *devName = dev->name;
+
+    DevAction action = halDevAction(r);
 
-    if (suffix && strcmp(suffix, "info") == 0) {
+    if (action == DACT_INFO) {
         /* Build JSON info */
-        if (deviceIsSensor(dev->kind)) {
+        uint32_t rising, falling;
+        uint64_t last_us;
+        if (deviceEdgeStats(dev, &rising, &falling, &last_us)) {
+            /* Digital input: debounced level plus edge counters */
+            snprintf(g_hal_reply, sizeof(g_hal_reply),
+                "{\"name\":\"%s\",\"kind\":\"%s\",\"unit\":\"%s\","
+                "\"value\":%d,\"pin\":%d,\"debounce_ms\":%u,"
+                "\"rising\":%lu,\"falling\":%lu,\"last_edge_us\":%llu}",
+                dev->name, deviceKindName(dev->kind), dev->unit,
+                (int)deviceReadSensor(dev), dev->pin, dev->debounce_ms,
+                (unsigned long)rising, (unsigned long)falling,
+                (unsigned long long)last_us);
+        } else if (deviceIsPulse(dev->kind)) {
+            /* Pulse counter: scaled value plus raw count and rate */
+            uint64_t count = 0;
+            float hz = 0.0f;
+            pulseRead(dev->pin, &count, &hz);
+            snprintf(g_hal_reply, sizeof(g_hal_reply),
+                "{\"name\":\"%s\",\"kind\":\"%s\",\"unit\":\"%s\","
+                "\"value\":%.6g,\"pin\":%d,\"count\":%llu,\"rate_hz\":%.3f}",
+                dev->name, deviceKindName(dev->kind), dev->unit,
+                deviceReadSensor(dev), dev->pin, (unsigned long long)count, hz);
+        } else if (deviceIsSensor(dev->kind)) {
             float val = deviceReadSensor(dev);
             snprintf(g_hal_reply, sizeof(g_hal_reply),
                 "{\"name\":\"%s\",\"kind\":\"%s\",\"unit\":\"%s\","
@@ -547,7 +928,30 @@ static void halDeviceLookup(nats_client_t *client, const nats_msg_t *msg,
         return;
     }
 
-    if (suffix && strcmp(suffix, "set") == 0) {
+    if (action == DACT_RESET) {
+        if (!deviceIsPulse(dev->kind)) {
+            halError(client, msg, "not_pulse", devName);
+            return;
+        }
+        pulseReset(dev->pin);
+        if (msg->reply_len > 0)
+            nats_msg_respond_str(client, msg, "{\"ok\":true}");
+        return;
+    }
+
+    if (action == DACT_HISTORY) {
+        if (!deviceIsSensor(dev->kind)) {
+            halError(client, msg, "not_sensor", devName);
+            return;
+        }
+        historyQuery(dev - deviceGetAll(), dev->name, dev->unit, payload,
+                     g_hal_json, sizeof(g_hal_json));
+        if (msg->reply_len > 0)
+            nats_msg_respond_str(client, msg, g_hal_json);
+        return;
+    }
+
+    if (action == DACT_SET) {
         if (!deviceIsActuator(dev->kind)) {
             halError(client, msg, "not_actuator", devName);
             return;
@@ -567,26 +971,12 @@ static void halDeviceLookup(nats_client_t *client, const nats_msg_t *msg,
                 { char *r = buf, *w = buf;
                   while (*r) { if (r[0]=='\\' && r[1]=='n') { *w++='\n'; r+=2; } else { *w++=*r++; } }
                   *w = '\0'; }
-                int max_lines = (height == 32) ? 4 : 8;
-                char *line_start = buf;
-                int line_num = 0;
-                while (line_start && *line_start && line_num < max_lines) {
-                    char *nl = strchr(line_start, '\n');
-                    if (nl) *nl = '\0';
-                    ssd1306WriteText(dev->i2c_addr, line_num, line_start, col_offset);
-                    line_num++;
-                    if (nl) line_start = nl + 1;
-                    else break;
-                }
-                while (line_num < max_lines) {
-                    ssd1306WriteText(dev->i2c_addr, line_num, "", col_offset);
-                    line_num++;
-                }
+                ssd1306WriteLines(deviceI2cAddr(dev), buf, height, col_offset);
             } else {
                 /* Template mode: update template and render */
                 strncpy(dev->disp_template, payload, sizeof(dev->disp_template) - 1);
                 dev->disp_template[sizeof(dev->disp_template) - 1] = '\0';
-                ssd1306RenderTemplate(dev->i2c_addr, dev->disp_template, height, col_offset);
+                ssd1306RenderTemplate(deviceI2cAddr(dev), dev->disp_template, height, col_offset);
                 devicesMarkDirty();
             }
             displayPollReset();
@@ -602,7 +992,7 @@ static void halDeviceLookup(nats_client_t *client, const nats_msg_t *msg,
         return;
     }
 
-    if (suffix && strcmp(suffix, "get") == 0) {
+    if (action == DACT_GET) {
         if (deviceIsActuator(dev->kind)) {
             snprintf(g_hal_reply, sizeof(g_hal_reply), "%d", dev->last_value);
         } else {
@@ -625,6 +1015,246 @@ static void halDeviceLookup(nats_client_t *client, const nats_msg_t *msg,
         nats_msg_respond_str(client, msg, g_hal_reply);
 }
 
+/*============================================================================
+ * Handler: batch - several pin and device ops in one request
+ * Payload: [{"op":"gpio.read","pin":4},{"op":"pwm.set","pin":5,"v":128},...]
+ *      or: {"atomic":true,"ops":[...]}
+ * Reply:   one JSON array, an entry per op (value, "ok" or {"error":...})
+ *============================================================================*/
+
+#define HAL_BATCH_MAX  32
+
+enum BatchOpType { BOP_GPIO_READ, BOP_GPIO_SET, BOP_PWM_GET, BOP_PWM_SET,
+                   BOP_ADC_READ, BOP_DEV_GET, BOP_DEV_SET };
+
+struct BatchOp {
+    uint8_t     type;
+    int         pin;
+    int         v;
+    Device     *dev;
+    const char *err;            /* validation error, nullptr if the op is fine */
+};
+
+static BatchOp g_batch[HAL_BATCH_MAX];
+
+/* Digital and relay actuators can be latched with the GPIO register */
+static bool batchDevIsDigital(const Device *dev) {
+    return dev->pin != PIN_NONE &&
+           (dev->kind == DEV_ACTUATOR_DIGITAL || dev->kind == DEV_ACTUATOR_RELAY);
+}
+
+/* End of the JSON object starting at p ('{'): the matching '}', skipping
+   nested objects and braces inside strings. nullptr if unterminated. */
+static const char *batchObjectEnd(const char *p) {
+    int depth = 0;
+    bool str = false;
+    for (; *p; p++) {
+        if (str) {
+            if (*p == '\\' && p[1]) p++;
+            else if (*p == '"') str = false;
+        } else if (*p == '"') {
+            str = true;
+        } else if (*p == '{') {
+            depth++;
+        } else if (*p == '}' && --depth == 0) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+/* Ops an atomic batch can hold: input reads served from the snapshot and
+   outputs latched with the GPIO register. Anything else (PWM, ADC, device
+   reads) would run before or after the latch, not with it. */
+static bool batchOpIsAtomic(const BatchOp *op) {
+    return op->type == BOP_GPIO_READ || op->type == BOP_GPIO_SET ||
+           (op->type == BOP_DEV_SET && batchDevIsDigital(op->dev));
+}
+
+/* Output pin of an atomic op, -1 for reads */
+static int batchOpOutPin(const BatchOp *op) {
+    if (op->type == BOP_GPIO_SET) return op->pin;
+    if (op->type == BOP_DEV_SET) return op->dev->pin;
+    return -1;
+}
+
+/* Parse one op object into g_batch[i] */
+static void batchParseOp(const char *obj, BatchOp *op) {
+    char name[24];
+    op->err = nullptr;
+    op->dev = nullptr;
+    op->pin = halJsonInt(obj, "pin", -1);
+    op->v = halJsonInt(obj, "v", 0);
+    if (!halJsonStr(obj, "op", name, sizeof(name))) { op->err = "missing_op"; return; }
+
+    RouteToken t = routeToken(name);
+    bool known = true;
+    switch (t.hash) {
+    case routeKey("gpio.read"): known = routeIs(t, "gpio.read"); op->type = BOP_GPIO_READ; break;
+    case routeKey("gpio.set"):  known = routeIs(t, "gpio.set");  op->type = BOP_GPIO_SET;  break;
+    case routeKey("pwm.get"):   known = routeIs(t, "pwm.get");   op->type = BOP_PWM_GET;   break;
+    case routeKey("pwm.set"):   known = routeIs(t, "pwm.set");   op->type = BOP_PWM_SET;   break;
+    case routeKey("adc.read"):  known = routeIs(t, "adc.read");  op->type = BOP_ADC_READ;  break;
+    case routeKey("dev.get"):   known = routeIs(t, "dev.get");   op->type = BOP_DEV_GET;   break;
+    case routeKey("dev.set"):   known = routeIs(t, "dev.set");   op->type = BOP_DEV_SET;   break;
+    default:                    known = false; break;
+    }
+    if (!known) { op->err = "bad_op"; return; }
+
+    if (op->type == BOP_DEV_GET || op->type == BOP_DEV_SET) {
+        if (!halJsonStr(obj, "name", name, sizeof(name)) || !(op->dev = deviceFind(name)))
+            op->err = "not_found";
+        else if (op->type == BOP_DEV_SET && !deviceIsActuator(op->dev->kind))
+            op->err = "not_actuator";
+    } else if (op->pin < 0 || op->pin >= SOC_GPIO_PIN_COUNT) {
+        op->err = "bad_pin";
+    }
+}
+
+/* Run one op and append its result. snapshot: input levels for gpio.read
+   in atomic mode, nullptr to read the pin now. */
+static int batchRunOp(BatchOp *op, const uint64_t *snapshot, char *out, int len) {
+    if (op->err) return snprintf(out, len, "{\"error\":\"%s\"}", op->err);
+    switch (op->type) {
+    case BOP_GPIO_READ:
+        return snprintf(out, len, "%d", snapshot ? (int)((*snapshot >> op->pin) & 1)
+                                                 : digitalRead(op->pin));
+    case BOP_GPIO_SET:
+        if (!snapshot) {
+            pinMode(op->pin, OUTPUT);
+            digitalWrite(op->pin, op->v ? HIGH : LOW);
+        }
+        return snprintf(out, len, "\"ok\"");
+    case BOP_PWM_GET:
+        return snprintf(out, len, "%d", s_pwm_state[op->pin]);
+    case BOP_PWM_SET:
+        halPwmSet((uint8_t)op->pin, (uint8_t)constrain(op->v, 0, 255));
+        return snprintf(out, len, "\"ok\"");
+    case BOP_ADC_READ: {
+        float raw;
+        int val = adcStreamRaw(op->pin, &raw) ? (int)(raw + 0.5f) : adcOneshotRaw(op->pin);
+        return snprintf(out, len, "%d", val);
+    }
+    case BOP_DEV_GET:
+        if (deviceIsSensor(op->dev->kind))
+            return snprintf(out, len, "%.1f", deviceReadSensor(op->dev));
+        return snprintf(out, len, "%d", op->dev->last_value);
+    case BOP_DEV_SET:
+        /* Already latched in atomic mode; this writes the same level and
+           does the bookkeeping (state, persistence, display) */
+        deviceSetActuator(op->dev, op->v);
+        return snprintf(out, len, "\"ok\"");
+    }
+    return 0;
+}
+
+static void halBatch(nats_client_t *client, const nats_msg_t *msg,
+                     const Route *r, const char *payload) {
+    if (r->n > 1) {
+        halError(client, msg, "bad_request", "use batch");
+        return;
+    }
+    bool atomic = false;
+    const char *p = payload;
+    while (*p == ' ' || *p == '\n') p++;
+    if (*p == '{') {
+        atomic = halJsonInt(payload, "atomic", 0) != 0;
+        p = strstr(payload, "\"ops\"");
+        if (p) p = strchr(p, '[');
+    }
+    if (!p || *p != '[') {
+        halError(client, msg, "bad_request", "payload: [ops] or {\"atomic\":true,\"ops\":[...]}");
+        return;
+    }
+
+    /* Parse every op first so an atomic batch can be refused as a whole */
+    int n = 0;
+    char obj[128];
+    for (p++;; p++) {
+        while (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t' || *p == ',') p++;
+        if (*p == ']') break;
+        const char *end = *p == '{' ? batchObjectEnd(p) : nullptr;
+        if (!end) {
+            halError(client, msg, "bad_request", "ops: array of {...} objects");
+            return;
+        }
+        if (n >= HAL_BATCH_MAX) {
+            halError(client, msg, "too_many_ops", "max 32");
+            return;
+        }
+        BatchOp *op = &g_batch[n++];
+        size_t olen = end - p + 1;
+        if (olen >= sizeof(obj)) {
+            /* Refused rather than parsed from a cut-off copy */
+            memset(op, 0, sizeof(*op));
+            op->err = "op_too_long";
+        } else {
+            memcpy(obj, p, olen);
+            obj[olen] = '\0';
+            batchParseOp(obj, op);
+        }
+        p = end;
+    }
+
+    uint64_t snapshot = 0;
+    if (atomic) {
+        for (int i = 0; i < n; i++) {
+            if (!g_batch[i].err && !batchOpIsAtomic(&g_batch[i]))
+                g_batch[i].err = "not_atomic";
+            /* A write to the output register only reaches pins that
+               already are plain GPIO outputs */
+            int out = g_batch[i].err ? -1 : batchOpOutPin(&g_batch[i]);
+            if (out >= 0 && !halGpioIsPlainOutput(out))
+                g_batch[i].err = "not_gpio_output";
+            if (g_batch[i].err) {
+                snprintf(obj, sizeof(obj), "op %d: %s", i, g_batch[i].err);
+                halError(client, msg, "batch_rejected", obj);
+                return;
+            }
+        }
+        /* Read all inputs at once, then latch all digital outputs at once */
+        snapshot = halGpioReadAll();
+        uint64_t mask = 0, levels = 0;
+        for (int i = 0; i < n; i++) {
+            const BatchOp *op = &g_batch[i];
+            int pin = batchOpOutPin(op);
+            if (pin < 0) continue;
+            int level = op->v != 0;
+            if (op->type == BOP_DEV_SET)
+                level = level != (op->dev->kind == DEV_ACTUATOR_RELAY && op->dev->inverted);
+            mask |= 1ULL << pin;
+            if (level) levels |= 1ULL << pin;
+            else levels &= ~(1ULL << pin);
+        }
+        halGpioWriteAll(mask, levels);
+    }
+
+    /* Every op runs; if the results outgrow the reply buffer the reply
+       says so instead of cutting the array short */
+    char item[64];
+    int w = snprintf(g_hal_json, sizeof(g_hal_json), "[");
+    bool overflow = false;
+    for (int i = 0; i < n; i++) {
+        int len = batchRunOp(&g_batch[i], atomic ? &snapshot : nullptr, item, sizeof(item));
+        if (len >= (int)sizeof(item) || w + len + 2 >= (int)sizeof(g_hal_json)) {
+            overflow = true;
+            continue;
+        }
+        if (i > 0) g_hal_json[w++] = ',';
+        memcpy(g_hal_json + w, item, len);
+        w += len;
+    }
+    if (overflow) {
+        snprintf(obj, sizeof(obj), "all %d ops ran, results over %d bytes",
+                 n, (int)sizeof(g_hal_json));
+        halError(client, msg, "truncated", obj);
+        return;
+    }
+    snprintf(g_hal_json + w, sizeof(g_hal_json) - w, "]");
+    if (msg->reply_len > 0)
+        nats_msg_respond_str(client, msg, g_hal_json);
+}
+
 /*============================================================================
  * Public API
  *============================================================================*/
@@ -651,39 +1281,27 @@ void halPwmSet(uint8_t pin, uint8_t value) {
 void onNatsHal(nats_client_t *client, const nats_msg_t *msg, void *userdata) {
     (void)userdata;
 
-    /* Skip prefix: "{device_name}.hal." */
-    if ((int)msg->subject_len <= halPrefixLen()) return;
-    const char *suffix = msg->subject + halPrefixLen();
-
-    /* Copy payload into null-terminated stack buffer */
-    char payload[256];
-    size_t plen = msg->data_len < sizeof(payload) - 1
-                  ? msg->data_len : sizeof(payload) - 1;
-    if (msg->data && plen > 0)
-        memcpy(payload, msg->data, plen);
-    payload[plen] = '\0';
+    /* Tokens after "{device_name}.hal.", payload terminated in place */
+    Route r;
+    if (!routeParse(msg, halPrefixLen(), &r)) return;
+    const char *payload = r.payload;
 
     if (g_debug)
-        Serial.printf("[NATS] hal: %s (payload='%s')\n", suffix, payload);
-
-    /* Extract first segment */
-    char segment[24];
-    const char *dot = strchr(suffix, '.');
-    size_t slen = dot ? (size_t)(dot - suffix) : strlen(suffix);
-    if (slen >= sizeof(segment)) slen = sizeof(segment) - 1;
-    memcpy(segment, suffix, slen);
-    segment[slen] = '\0';
-
-    const char *rest = dot ? dot + 1 : nullptr;
-
-    /* Route to handler */
-    if (strcmp(segment, "gpio") == 0)        halGpio(client, msg, rest, payload);
-    else if (strcmp(segment, "adc") == 0)    halAdc(client, msg, rest, payload);
-    else if (strcmp(segment, "pwm") == 0)    halPwm(client, msg, rest, payload);
-    else if (strcmp(segment, "dac") == 0)    halDac(client, msg, rest, payload);
-    else if (strcmp(segment, "uart") == 0)   halUart(client, msg, rest, payload);
-    else if (strcmp(segment, "i2c") == 0)    halI2c(client, msg, rest, payload);
-    else if (strcmp(segment, "system") == 0) halSystem(client, msg, rest, payload);
-    else if (strcmp(segment, "device") == 0) halDevice(client, msg, rest, payload);
-    else                                     halDeviceLookup(client, msg, suffix, payload);
+        Serial.printf("[NATS] hal: %s (payload='%s')\n", r.suffix, payload);
+
+    /* Route on the first token; handlers switch on the following ones */
+    switch (halSegment(r.tok[0])) {
+    case HSEG_GPIO:   halGpio(client, msg, &r, payload); break;
+    case HSEG_ADC:    halAdc(client, msg, &r, payload); break;
+    case HSEG_PWM:    halPwm(client, msg, &r, payload); break;
+    case HSEG_DAC:    halDac(client, msg, &r, payload); break;
+    case HSEG_UART:   halUart(client, msg, &r, payload); break;
+    case HSEG_I2C:    halI2c(client, msg, &r, payload, 0); break;
+    case HSEG_I2C1:   halI2c(client, msg, &r, payload, 1); break;
+    case HSEG_SYSTEM: halSystem(client, msg, &r, payload); break;
+    case HSEG_DEVICE: halDevice(client, msg, &r, payload); break;
+    case HSEG_BATCH:  halBatch(client, msg, &r, payload); break;
+    default:          halDeviceLookup(client, msg, &r, payload); break;
+    }
+    routeRelease(&r);
 }
@@ -0,0 +1,213 @@
+/**
+ * @file pulse_counter.cpp
+ * @brief Hardware pulse counting for flow meters, anemometers, S0 meters
+ *
+ * PCNT unit per pin: one channel counting rising edges, glitch filter on,
+ * a watch point at PULSE_HIGH_LIMIT. The hardware clears the counter when
+ * it reaches the watch point and the on_reach ISR adds the limit to the
+ * overflow total. Reading combines both and retries if the ISR ran in
+ * between.
+ */
+
+#include "pulse_counter.h"
+#include "loop_sched.h"
+#include "soc/soc_caps.h"
+#if SOC_PCNT_SUPPORTED
+#include <driver/pulse_cnt.h>
+#endif
+
+struct PulseCounter {
+    uint8_t  pin;
+    uint8_t  refs;
+#if SOC_PCNT_SUPPORTED
+    pcnt_unit_handle_t    unit;
+    pcnt_channel_handle_t chan;
+#endif
+    volatile uint64_t overflow;     /* PCNT: wrapped counts; fallback: all */
+    uint64_t base;                  /* subtracted on reset */
+    uint64_t last_total;            /* never report a smaller total */
+    /* Sliding window of (time, total) samples */
+    uint32_t win_ms[PULSE_WINDOW];
+    uint64_t win_count[PULSE_WINDOW];
+    uint8_t  win_idx;
+    uint8_t  win_n;
+    uint32_t last_sample_ms;
+};
+
+static PulseCounter g_pulse[PULSE_MAX];
+
+static PulseCounter *pulseFind(uint8_t pin) {
+    for (int i = 0; i < PULSE_MAX; i++) {
+        if (g_pulse[i].refs > 0 && g_pulse[i].pin == pin) return &g_pulse[i];
+    }
+    return nullptr;
+}
+
+/*============================================================================
+ * Counting backends
+ *============================================================================*/
+
+#if SOC_PCNT_SUPPORTED
+
+static bool IRAM_ATTR pulseOnReach(pcnt_unit_handle_t unit,
+                                   const pcnt_watch_event_data_t *edata, void *arg) {
+    (void)unit;
+    PulseCounter *c = (PulseCounter *)arg;
+    c->overflow += edata->watch_point_value;
+    return false;
+}
+
+static bool pulseStart(PulseCounter *c) {
+    pcnt_unit_config_t ucfg = {};
+    ucfg.low_limit  = -1;
+    ucfg.high_limit = PULSE_HIGH_LIMIT;
+    if (pcnt_new_unit(&ucfg, &c->unit) != ESP_OK) return false;
+
+    pcnt_chan_config_t ccfg = {};
+    ccfg.edge_gpio_num  = c->pin;
+    ccfg.level_gpio_num = -1;
+    pcnt_glitch_filter_config_t fcfg = {};
+    fcfg.max_glitch_ns = PULSE_GLITCH_NS;
+    pcnt_event_callbacks_t cbs = {};
+    cbs.on_reach = pulseOnReach;
+
+    if (pcnt_new_channel(c->unit, &ccfg, &c->chan) != ESP_OK) {
+        pcnt_del_unit(c->unit);
+        return false;
+    }
+    if (pcnt_channel_set_edge_action(c->chan, PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+                                     PCNT_CHANNEL_EDGE_ACTION_HOLD) != ESP_OK ||
+        pcnt_unit_set_glitch_filter(c->unit, &fcfg) != ESP_OK ||
+        pcnt_unit_add_watch_point(c->unit, PULSE_HIGH_LIMIT) != ESP_OK ||
+        pcnt_unit_register_event_callbacks(c->unit, &cbs, c) != ESP_OK ||
+        pcnt_unit_enable(c->unit) != ESP_OK ||
+        pcnt_unit_clear_count(c->unit) != ESP_OK ||
+        pcnt_unit_start(c->unit) != ESP_OK) {
+        pcnt_del_channel(c->chan);
+        pcnt_del_unit(c->unit);
+        return false;
+    }
+    return true;
+}
+
+static void pulseStop(PulseCounter *c) {
+    pcnt_unit_stop(c->unit);
+    pcnt_unit_disable(c->unit);
+    pcnt_del_channel(c->chan);
+    pcnt_del_unit(c->unit);
+}
+
+static uint64_t pulseRawTotal(PulseCounter *c) {
+    uint64_t ov1, ov2;
+    int cnt = 0;
+    do {
+        ov1 = c->overflow;
+        pcnt_unit_get_count(c->unit, &cnt);
+        ov2 = c->overflow;
+    } while (ov1 != ov2);
+    return ov1 + (uint64_t)(cnt > 0 ? cnt : 0);
+}
+
+#else   /* no PCNT: count in a GPIO interrupt */
+
+static void IRAM_ATTR pulseIsr(void *arg) {
+    ((PulseCounter *)arg)->overflow++;
+}
+
+static bool pulseStart(PulseCounter *c) {
+    pinMode(c->pin, INPUT);
+    attachInterruptArg(digitalPinToInterrupt(c->pin), pulseIsr, c, RISING);
+    return true;
+}
+
+static void pulseStop(PulseCounter *c) {
+    detachInterrupt(digitalPinToInterrupt(c->pin));
+}
+
+static uint64_t pulseRawTotal(PulseCounter *c) {
+    uint64_t a, b;
+    do { a = c->overflow; b = c->overflow; } while (a != b);
+    return a;
+}
+
+#endif
+
+/* Total since reset. A wrap whose ISR has not run yet would read low for
+   a moment; hold the previous total until it has. */
+static uint64_t pulseTotal(PulseCounter *c) {
+    uint64_t t = pulseRawTotal(c) - c->base;
+    if (t < c->last_total) return c->last_total;
+    c->last_total = t;
+    return t;
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+
+bool pulseAttach(uint8_t pin) {
+    PulseCounter *c = pulseFind(pin);
+    if (c) { c->refs++; return true; }
+    for (int i = 0; i < PULSE_MAX; i++) {
+        if (g_pulse[i].refs > 0) continue;
+        c = &g_pulse[i];
+        memset(c, 0, sizeof(*c));
+        c->pin = pin;
+        if (!pulseStart(c)) {
+            Serial.printf("Pulse: counter setup failed on GPIO %d\n", pin);
+            return false;
+        }
+        c->refs = 1;
+        return true;
+    }
+    Serial.printf("Pulse: no free counter for GPIO %d\n", pin);
+    return false;
+}
+
+void pulseDetach(uint8_t pin) {
+    PulseCounter *c = pulseFind(pin);
+    if (!c || --c->refs > 0) return;
+    pulseStop(c);
+}
+
+void pulsePoll() {
+    uint32_t now = millis();
+    for (int i = 0; i < PULSE_MAX; i++) {
+        PulseCounter *c = &g_pulse[i];
+        if (c->refs == 0) continue;
+        if (c->win_n > 0 && now - c->last_sample_ms < PULSE_SAMPLE_MS) {
+            loopAt(c->last_sample_ms + PULSE_SAMPLE_MS);
+            continue;
+        }
+        c->last_sample_ms = now;
+        loopAt(now + PULSE_SAMPLE_MS);
+        c->win_ms[c->win_idx] = now;
+        c->win_count[c->win_idx] = pulseTotal(c);
+        c->win_idx = (c->win_idx + 1) % PULSE_WINDOW;
+        if (c->win_n < PULSE_WINDOW) c->win_n++;
+    }
+}
+
+bool pulseRead(uint8_t pin, uint64_t *count, float *rate_hz) {
+    PulseCounter *c = pulseFind(pin);
+    if (!c) return false;
+    *count = pulseTotal(c);
+    *rate_hz = 0.0f;
+    if (c->win_n >= 2) {
+        int newest = (c->win_idx + PULSE_WINDOW - 1) % PULSE_WINDOW;
+        int oldest = (c->win_idx + PULSE_WINDOW - c->win_n) % PULSE_WINDOW;
+        uint32_t dt = c->win_ms[newest] - c->win_ms[oldest];
+        if (dt > 0)
+            *rate_hz = (float)(c->win_count[newest] - c->win_count[oldest]) * 1000.0f / dt;
+    }
+    return true;
+}
+
+void pulseReset(uint8_t pin) {
+    PulseCounter *c = pulseFind(pin);
+    if (!c) return;
+    c->base = pulseRawTotal(c);
+    c->last_total = 0;
+    c->win_n = 0;
+    c->win_idx = 0;
+}
@@ -0,0 +1,422 @@
+/**
+ * @file seglog.cpp
+ * @brief Append-only segmented sample log - LittleFS on target, stdio on host
+ */
+
+#include "seglog.h"
+#include <string.h>
+#include <stdio.h>
+
+/*============================================================================
+ * File backend
+ *============================================================================*/
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <esp_system.h>
+
+typedef File SegFile;
+
+static bool segOpen(SegFile &f, const char *path, const char *mode) {
+    f = LittleFS.open(path, mode);
+    return (bool)f;
+}
+static void   segClose(SegFile &f)                         { f.close(); }
+static size_t segSize(SegFile &f)                          { return f.size(); }
+static bool   segSeek(SegFile &f, uint32_t off)            { return f.seek(off); }
+static size_t segRead(SegFile &f, void *buf, size_t len)   { return f.read((uint8_t *)buf, len); }
+static size_t segWrite(SegFile &f, const void *buf, size_t len) {
+    return f.write((const uint8_t *)buf, len);
+}
+static bool   segExists(const char *path)                  { return LittleFS.exists(path); }
+static void   segMkdir(const char *path)                   { if (!LittleFS.exists(path)) LittleFS.mkdir(path); }
+
+#else /* host: file-backed stand-in */
+#include <sys/stat.h>
+#include <time.h>
+
+struct SegFile { FILE *fp = nullptr; };
+
+static bool segOpen(SegFile &f, const char *path, const char *mode) {
+    char m[4];
+    snprintf(m, sizeof(m), "%sb", mode);
+    f.fp = fopen(path, m);
+    return f.fp != nullptr;
+}
+static void   segClose(SegFile &f)                         { if (f.fp) fclose(f.fp); f.fp = nullptr; }
+static size_t segSize(SegFile &f) {
+    long cur = ftell(f.fp);
+    fseek(f.fp, 0, SEEK_END);
+    long n = ftell(f.fp);
+    fseek(f.fp, cur, SEEK_SET);
+    return n > 0 ? (size_t)n : 0;
+}
+static bool   segSeek(SegFile &f, uint32_t off)            { return fseek(f.fp, off, SEEK_SET) == 0; }
+static size_t segRead(SegFile &f, void *buf, size_t len)   { return fread(buf, 1, len, f.fp); }
+static size_t segWrite(SegFile &f, const void *buf, size_t len) { return fwrite(buf, 1, len, f.fp); }
+static bool   segExists(const char *path)                  { struct stat st; return stat(path, &st) == 0; }
+static void   segMkdir(const char *path)                   { mkdir(path, 0755); }
+
+static uint32_t millis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+#endif
+
+/*============================================================================
+ * Block format
+ *============================================================================*/
+
+#define SEGLOG_MAGIC  0x31474C53u   /* "SLG1" */
+
+struct SegBlockHdr {
+    uint32_t magic;
+    uint32_t seq;       /* global block sequence number */
+    uint32_t t_first;   /* oldest record timestamp */
+    uint32_t t_last;    /* newest record timestamp */
+    uint16_t count;     /* records in block */
+    uint16_t rsv;
+    uint32_t crc;       /* CRC32 over seq..rsv and the records */
+};
+
+#define SEGLOG_RECS_PER_BLOCK \
+    ((SEGLOG_BLOCK_SIZE - sizeof(SegBlockHdr)) / sizeof(SeglogRecord))
+
+struct SegBlock {
+    SegBlockHdr  h;
+    SeglogRecord rec[SEGLOG_RECS_PER_BLOCK];
+    uint8_t      pad[SEGLOG_BLOCK_SIZE - sizeof(SegBlockHdr)
+                     - SEGLOG_RECS_PER_BLOCK * sizeof(SeglogRecord)];
+};
+
+static_assert(sizeof(SeglogRecord) == 20, "record layout is part of the file format");
+static_assert(sizeof(SegBlock) == SEGLOG_BLOCK_SIZE, "block must be exactly one block size");
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *p, size_t len) {
+    static const uint32_t T[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    while (len--) {
+        crc = T[(crc ^ *p) & 0x0F] ^ (crc >> 4);
+        crc = T[(crc ^ (*p >> 4)) & 0x0F] ^ (crc >> 4);
+        p++;
+    }
+    return ~crc;
+}
+
+static uint32_t blockCrc(const SegBlock *b) {
+    uint16_t n = b->h.count <= SEGLOG_RECS_PER_BLOCK ? b->h.count : 0;
+    uint32_t crc = crc32Update(0, (const uint8_t *)&b->h.seq,
+                               offsetof(SegBlockHdr, crc) - offsetof(SegBlockHdr, seq));
+    return crc32Update(crc, (const uint8_t *)b->rec, n * sizeof(SeglogRecord));
+}
+
+static bool blockValid(const SegBlock *b) {
+    return b->h.magic == SEGLOG_MAGIC &&
+           b->h.count <= SEGLOG_RECS_PER_BLOCK &&
+           b->h.crc == blockCrc(b);
+}
+
+/*============================================================================
+ * State
+ *============================================================================*/
+
+static char     s_dir[24];
+static bool     s_ready = false;
+
+/* Writer: block being filled and where it goes */
+static SegBlock s_wr;
+static uint8_t  s_wr_seg = 0;
+static uint16_t s_wr_blk = 0;
+static bool     s_wr_dirty = false;
+static uint32_t s_wr_dirty_ms = 0;
+
+/* Reader: one block buffer + the open segment */
+static SegBlock s_rd;
+static SegFile  s_rd_file;
+static bool     s_rd_open = false;
+static uint16_t s_rd_nblk = 0;
+
+static uint32_t s_blocks_written = 0;
+static uint32_t s_bad_blocks = 0;
+
+static void segPath(char *buf, size_t len, uint8_t slot) {
+    snprintf(buf, len, "%s/seg%u.bin", s_dir, (unsigned)slot);
+}
+
+static void blockReset(uint32_t seq) {
+    memset(&s_wr, 0, sizeof(s_wr));
+    s_wr.h.magic = SEGLOG_MAGIC;
+    s_wr.h.seq = seq;
+}
+
+/* Read block blk of an open segment. Returns false on short read. */
+static bool blockRead(SegFile &f, uint16_t blk, SegBlock *out) {
+    if (!segSeek(f, (uint32_t)blk * SEGLOG_BLOCK_SIZE)) return false;
+    return segRead(f, out, SEGLOG_BLOCK_SIZE) == SEGLOG_BLOCK_SIZE;
+}
+
+static void blockWrite() {
+    char path[40];
+    segPath(path, sizeof(path), s_wr_seg);
+    s_wr.h.crc = blockCrc(&s_wr);
+
+    SegFile f;
+    if (!segOpen(f, path, segExists(path) ? "r+" : "w+")) return;
+    if (segSeek(f, (uint32_t)s_wr_blk * SEGLOG_BLOCK_SIZE))
+        segWrite(f, &s_wr, SEGLOG_BLOCK_SIZE);
+    segClose(f);
+
+    s_wr_dirty = false;
+    s_blocks_written++;
+}
+
+/* Move the writer to the next block, rotating to the oldest segment */
+static void writerAdvance() {
+    uint32_t seq = s_wr.h.seq + 1;
+    s_wr_blk++;
+    if (s_wr_blk >= SEGLOG_SEG_BLOCKS) {
+        s_wr_seg = (uint8_t)((s_wr_seg + 1) % SEGLOG_MAX_SEGS);
+        s_wr_blk = 0;
+        if (s_rd_open) { segClose(s_rd_file); s_rd_open = false; }
+        char path[40];
+        segPath(path, sizeof(path), s_wr_seg);
+        SegFile f;
+        if (segOpen(f, path, "w")) segClose(f);    /* truncate */
+    }
+    blockReset(seq);
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+
+uint32_t seglogKey(const char *name) {
+    uint32_t h = 2166136261u;
+    while (name && *name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
+bool seglogInit(const char *dir) {
+#if defined(ARDUINO)
+    /* Every esp_restart() path (reboot commands, setup portal, config
+       apply) writes the buffered block first */
+    static bool shutdown_hooked = false;
+    if (!shutdown_hooked)
+        shutdown_hooked = esp_register_shutdown_handler(seglogFlush) == ESP_OK;
+#endif
+    strncpy(s_dir, dir, sizeof(s_dir) - 1);
+    s_dir[sizeof(s_dir) - 1] = '\0';
+    segMkdir(s_dir);
+
+    /* Find the segment holding the newest valid block */
+    int      best_seg = -1;
+    uint16_t best_blk = 0;
+    uint32_t best_seq = 0;
+    for (uint8_t slot = 0; slot < SEGLOG_MAX_SEGS; slot++) {
+        char path[40];
+        segPath(path, sizeof(path), slot);
+        SegFile f;
+        if (!segExists(path) || !segOpen(f, path, "r")) continue;
+        int nblk = (int)(segSize(f) / SEGLOG_BLOCK_SIZE);
+        /* Walk back over a torn tail */
+        for (int b = nblk - 1; b >= 0; b--) {
+            if (!blockRead(f, (uint16_t)b, &s_rd)) continue;
+            if (!blockValid(&s_rd)) { s_bad_blocks++; continue; }
+            if (best_seg < 0 || s_rd.h.seq > best_seq) {
+                best_seg = slot;
+                best_blk = (uint16_t)b;
+                best_seq = s_rd.h.seq;
+            }
+            break;
+        }
+        segClose(f);
+    }
+
+    s_ready = true;
+
+    if (best_seg < 0) {
+        /* Empty log */
+        s_wr_seg = 0;
+        s_wr_blk = 0;
+        blockReset(1);
+        char path[40];
+        segPath(path, sizeof(path), 0);
+        SegFile f;
+        if (segOpen(f, path, "w")) segClose(f);
+        return true;
+    }
+
+    /* Resume: continue a partially filled block, else start the next one */
+    s_wr_seg = (uint8_t)best_seg;
+    s_wr_blk = best_blk;
+    char path[40];
+    segPath(path, sizeof(path), s_wr_seg);
+    SegFile f;
+    bool resumed = false;
+    if (segOpen(f, path, "r")) {
+        if (blockRead(f, best_blk, &s_wr) && blockValid(&s_wr) &&
+            s_wr.h.count < SEGLOG_RECS_PER_BLOCK)
+            resumed = true;
+        segClose(f);
+    }
+    if (!resumed) {
+        blockReset(best_seq);
+        writerAdvance();
+    }
+    return true;
+}
+
+bool seglogAppend(const SeglogRecord &rec) {
+    if (!s_ready) return false;
+
+    SegBlockHdr &h = s_wr.h;
+    if (h.count == 0 || rec.t < h.t_first) h.t_first = rec.t;
+    if (rec.t > h.t_last) h.t_last = rec.t;
+    s_wr.rec[h.count++] = rec;
+
+    uint32_t now = millis();
+    if (!s_wr_dirty) {
+        s_wr_dirty = true;
+        s_wr_dirty_ms = now;
+    }
+
+    if (h.count >= SEGLOG_RECS_PER_BLOCK) {
+        blockWrite();
+        writerAdvance();
+    } else if (now - s_wr_dirty_ms >= SEGLOG_FLUSH_MS) {
+        blockWrite();   /* partial block, rewritten in place as it fills */
+    }
+    return true;
+}
+
+void seglogFlush() {
+    if (s_ready && s_wr_dirty) blockWrite();
+}
+
+uint32_t seglogBlocksWritten() { return s_blocks_written; }
+uint32_t seglogBadBlocks()     { return s_bad_blocks; }
+
+/*============================================================================
+ * Streaming reader
+ *============================================================================*/
+
+static void readerCloseFile() {
+    if (s_rd_open) segClose(s_rd_file);
+    s_rd_open = false;
+}
+
+void seglogReaderOpen(SeglogReader *r, uint32_t key, uint32_t from, uint32_t to) {
+    memset(r, 0, sizeof(*r));
+    r->key  = key;
+    r->from = from;
+    r->to   = to;
+    readerCloseFile();
+    if (!s_ready) { r->done = true; return; }
+
+    /* Order segments by first block sequence; drop ones outside the range */
+    uint32_t first_seq[SEGLOG_MAX_SEGS];
+    for (uint8_t slot = 0; slot < SEGLOG_MAX_SEGS; slot++) {
+        bool live = (slot == s_wr_seg);
+        char path[40];
+        segPath(path, sizeof(path), slot);
+        SegFile f;
+        uint32_t seq = live ? s_wr.h.seq - s_wr_blk : 0;
+        if (!live) {
+            if (!segExists(path) || !segOpen(f, path, "r")) continue;
+            int nblk = (int)(segSize(f) / SEGLOG_BLOCK_SIZE);
+            bool keep = false;
+            if (nblk > 0 && blockRead(f, 0, &s_rd) && s_rd.h.magic == SEGLOG_MAGIC) {
+                seq = s_rd.h.seq;
+                keep = s_rd.h.t_first <= to;
+                if (keep && blockRead(f, (uint16_t)(nblk - 1), &s_rd) &&
+                    s_rd.h.magic == SEGLOG_MAGIC && s_rd.h.t_last < from)
+                    keep = false;
+            }
+            segClose(f);
+            if (!keep) continue;
+        }
+        int j = r->nseg++;
+        while (j > 0 && first_seq[j - 1] > seq) {
+            first_seq[j] = first_seq[j - 1];
+            r->order[j] = r->order[j - 1];
+            j--;
+        }
+        first_seq[j] = seq;
+        r->order[j] = slot;
+    }
+    if (r->nseg == 0) r->done = true;
+}
+
+/* Load the next candidate block into s_rd. Returns false when exhausted. */
+static bool readerLoad(SeglogReader *r) {
+    while (r->seg < r->nseg) {
+        uint8_t slot = r->order[r->seg];
+        bool live = (slot == s_wr_seg);
+
+        if (!s_rd_open) {
+            char path[40];
+            segPath(path, sizeof(path), slot);
+            s_rd_nblk = 0;
+            if (segExists(path) && segOpen(s_rd_file, path, "r")) {
+                s_rd_open = true;
+                s_rd_nblk = (uint16_t)(segSize(s_rd_file) / SEGLOG_BLOCK_SIZE);
+            }
+            /* The live segment ends at the RAM block */
+            if (live) s_rd_nblk = s_wr_blk + 1;
+        }
+
+        if (r->blk >= s_rd_nblk) {
+            readerCloseFile();
+            r->seg++;
+            r->blk = 0;
+            continue;
+        }
+
+        uint16_t blk = r->blk++;
+        if (live && blk == s_wr_blk) {
+            memcpy(&s_rd, &s_wr, sizeof(s_rd));
+        } else {
+            if (!s_rd_open || !blockRead(s_rd_file, blk, &s_rd)) continue;
+            if (!blockValid(&s_rd)) { s_bad_blocks++; continue; }
+        }
+        if (s_rd.h.count == 0) continue;
+        if (s_rd.h.t_last < r->from || s_rd.h.t_first > r->to) continue;
+        r->rec = 0;
+        return true;
+    }
+    readerCloseFile();
+    return false;
+}
+
+bool seglogReaderNext(SeglogReader *r, SeglogRecord *out) {
+    while (!r->done) {
+        if (!r->loaded) {
+            if (!readerLoad(r)) { r->done = true; break; }
+            r->loaded = true;
+        }
+        while (r->rec < s_rd.h.count) {
+            const SeglogRecord &rec = s_rd.rec[r->rec++];
+            if (r->key && rec.key != r->key) continue;
+            if (rec.t < r->from || rec.t > r->to) continue;
+            *out = rec;
+            return true;
+        }
+        r->loaded = false;
+    }
+    return false;
+}
+
+void seglogReaderClose(SeglogReader *r) {
+    r->done = true;
+    readerCloseFile();
+}
@@ -0,0 +1,184 @@
+/**
+ * @file serial_text.cpp
+ * @brief Line-framed UART input for serial_text devices
+ *
+ * Line ends are found by the UART pattern detector, which queues their
+ * positions in the RX ring. A read pops one position and copies exactly
+ * that many bytes plus the '\n'.
+ *
+ * A small task per port blocks on the driver event queue. It counts the
+ * line ends, flags overflows and wakes the main loop, so a line is handled
+ * on the next pass and an idle port costs no wakeups. A position is only
+ * popped once its event has been counted: the ISR queues the position
+ * before it posts the event, so a position without an event is left for
+ * the next read. When the FIFO or the ring overflowed, or an event finds
+ * no position (more lines than the pattern queue holds), framing is lost
+ * and the input is flushed.
+ */
+
+#include "serial_text.h"
+#include "loop_sched.h"
+#include <driver/uart.h>
+#include <atomic>
+
+#define SERIAL_TEXT_TASK_STACK  2048
+#define SERIAL_TEXT_TASK_PRIO   2       /* above the loop task (1) */
+
+struct SerialTextPort {
+    bool              open;
+    QueueHandle_t     events;
+    TaskHandle_t      task;
+    std::atomic<int>  pending;      /* line ends signalled but not popped */
+    std::atomic<bool> overflow;     /* FIFO or ring overflowed */
+    uint32_t          lines;
+    uint32_t          overflows;
+};
+
+static SerialTextPort g_st[SERIAL_TEXT_UARTS + 1];     /* indexed by UART number */
+
+static const int8_t g_st_pins[][2] = {
+    { -1, -1 },                             /* UART0: console */
+    { SERIAL_TEXT_RX, SERIAL_TEXT_TX },
+    { SERIAL_TEXT2_RX, SERIAL_TEXT2_TX },
+};
+
+static SerialTextPort *serialTextPort(uint8_t uart) {
+    if (uart < 1 || uart > SERIAL_TEXT_UARTS || !g_st[uart].open) return nullptr;
+    return &g_st[uart];
+}
+
+/* Framing lost: drop everything buffered and start over */
+static void serialTextFlush(uint8_t uart, SerialTextPort *p) {
+    uart_flush_input(uart);
+    uart_pattern_queue_reset(uart, SERIAL_TEXT_PATTERNS);
+    p->pending = 0;
+    p->overflow = false;
+    p->overflows++;
+}
+
+/* Per-port event task: count line ends, flag overflows, wake the loop */
+static void serialTextTask(void *arg) {
+    SerialTextPort *p = (SerialTextPort *)arg;
+    uart_event_t ev;
+    for (;;) {
+        if (xQueueReceive(p->events, &ev, portMAX_DELAY) != pdTRUE) continue;
+        if (ev.type == UART_FIFO_OVF || ev.type == UART_BUFFER_FULL)
+            p->overflow = true;
+        else if (ev.type == UART_PATTERN_DET)
+            p->pending++;
+        else
+            continue;
+        loopWake();
+    }
+}
+
+bool serialTextOpen(uint8_t uart, uint32_t baud) {
+    if (uart < 1 || uart > SERIAL_TEXT_UARTS || g_st[uart].open) return false;
+    if (baud == 0) baud = 9600;
+    SerialTextPort *p = &g_st[uart];
+
+    uart_config_t cfg = {};
+    cfg.baud_rate  = (int)baud;
+    cfg.data_bits  = UART_DATA_8_BITS;
+    cfg.parity     = UART_PARITY_DISABLE;
+    cfg.stop_bits  = UART_STOP_BITS_1;
+    cfg.flow_ctrl  = UART_HW_FLOWCTRL_DISABLE;
+    cfg.source_clk = UART_SCLK_DEFAULT;
+
+    if (uart_driver_install(uart, SERIAL_TEXT_RX_BUF, 0, SERIAL_TEXT_EVENTS,
+                            &p->events, 0) != ESP_OK)
+        return false;
+    if (uart_param_config(uart, &cfg) != ESP_OK ||
+        uart_set_pin(uart, g_st_pins[uart][1], g_st_pins[uart][0],
+                     UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK ||
+        uart_enable_pattern_det_baud_intr(uart, '\n', 1, 9, 0, 0) != ESP_OK ||
+        uart_pattern_queue_reset(uart, SERIAL_TEXT_PATTERNS) != ESP_OK) {
+        uart_driver_delete(uart);
+        return false;
+    }
+
+    p->pending = 0;
+    p->overflow = false;
+    p->lines = 0;
+    p->overflows = 0;
+    char name[12];
+    snprintf(name, sizeof(name), "uart%d_rx", uart);
+    if (xTaskCreate(serialTextTask, name, SERIAL_TEXT_TASK_STACK, p,
+                    SERIAL_TEXT_TASK_PRIO, &p->task) != pdPASS) {
+        uart_driver_delete(uart);
+        return false;
+    }
+
+    p->open = true;
+    Serial.printf("SerialText: UART%d at %u baud (RX=%d TX=%d)\n",
+                  uart, baud, g_st_pins[uart][0], g_st_pins[uart][1]);
+    return true;
+}
+
+void serialTextClose(uint8_t uart) {
+    if (!serialTextPort(uart)) return;
+    vTaskDelete(g_st[uart].task);       /* before its event queue goes away */
+    g_st[uart].task = nullptr;
+    uart_driver_delete(uart);
+    g_st[uart].open = false;
+    Serial.printf("SerialText: UART%d stopped\n", uart);
+}
+
+bool serialTextIsOpen(uint8_t uart) {
+    return serialTextPort(uart) != nullptr;
+}
+
+bool serialTextReadLine(uint8_t uart, char *out, size_t out_len) {
+    SerialTextPort *p = serialTextPort(uart);
+    if (!p || out_len == 0) return false;
+
+    if (p->overflow) {
+        serialTextFlush(uart, p);
+        return false;
+    }
+
+    /* Only positions whose event was counted; a newer one waits its turn */
+    while (p->pending > 0) {
+        int pos = uart_pattern_pop_pos(uart);
+        if (pos < 0) {
+            /* Signalled line end without a position: the pattern queue overflowed */
+            serialTextFlush(uart, p);
+            return false;
+        }
+        p->pending--;
+
+        /* Line body, truncated to the buffer; the rest is discarded */
+        int keep = pos < (int)out_len - 1 ? pos : (int)out_len - 1;
+        int n = uart_read_bytes(uart, out, keep, 0);
+        if (n < 0) n = 0;
+        char discard[32];
+        for (int rest = pos - keep; rest > 0; ) {
+            int r = uart_read_bytes(uart, discard, rest > 32 ? 32 : rest, 0);
+            if (r <= 0) break;
+            rest -= r;
+        }
+        uart_read_bytes(uart, discard, 1, 0);   /* the '\n' */
+
+        while (n > 0 && out[n - 1] == '\r') n--;
+        out[n] = '\0';
+        if (n == 0) continue;
+        p->lines++;
+        return true;
+    }
+    return false;
+}
+
+bool serialTextWrite(uint8_t uart, const char *text) {
+    if (!serialTextPort(uart) || !text) return false;
+    size_t len = strlen(text);
+    if (len > 0) uart_write_bytes(uart, text, len);
+    /* Append newline if not already present */
+    if (len == 0 || text[len - 1] != '\n') uart_write_bytes(uart, "\n", 1);
+    return true;
+}
+
+void serialTextStats(uint8_t uart, uint32_t *lines, uint32_t *overflows) {
+    SerialTextPort *p = (uart >= 1 && uart <= SERIAL_TEXT_UARTS) ? &g_st[uart] : nullptr;
+    *lines = p ? p->lines : 0;
+    *overflows = p ? p->overflows : 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file subject_keys.cpp
+ * @brief Keys of the hal.* and config.* subjects
+ */
+
+#include "subject_keys.h"
+
+HalSegment halSegment(const RouteToken &t) {
+    switch (t.hash) {
+    case routeKey("gpio"):   return routeIs(t, "gpio")   ? HSEG_GPIO   : HSEG_NONE;
+    case routeKey("adc"):    return routeIs(t, "adc")    ? HSEG_ADC    : HSEG_NONE;
+    case routeKey("pwm"):    return routeIs(t, "pwm")    ? HSEG_PWM    : HSEG_NONE;
+    case routeKey("dac"):    return routeIs(t, "dac")    ? HSEG_DAC    : HSEG_NONE;
+    case routeKey("uart"):   return routeIs(t, "uart")   ? HSEG_UART   : HSEG_NONE;
+    case routeKey("i2c"):    return routeIs(t, "i2c")    ? HSEG_I2C    : HSEG_NONE;
+    case routeKey("i2c1"):   return routeIs(t, "i2c1")   ? HSEG_I2C1   : HSEG_NONE;
+    case routeKey("system"): return routeIs(t, "system") ? HSEG_SYSTEM : HSEG_NONE;
+    case routeKey("device"): return routeIs(t, "device") ? HSEG_DEVICE : HSEG_NONE;
+    case routeKey("batch"):  return routeIs(t, "batch")  ? HSEG_BATCH  : HSEG_NONE;
+    default:                 return HSEG_NONE;
+    }
+}
+
+SysKey halSysKey(const RouteToken &t) {
+#define SYS_KEY(key, k) case routeKey(key): return routeIs(t, key) ? k : SYS_NONE
+    switch (t.hash) {
+    SYS_KEY("temperature",     SYS_TEMPERATURE);
+    SYS_KEY("heap",            SYS_HEAP);
+    SYS_KEY("uptime",          SYS_UPTIME);
+    SYS_KEY("rssi",            SYS_RSSI);
+    SYS_KEY("reset_reason",    SYS_RESET_REASON);
+    SYS_KEY("nats_reconnects", SYS_NATS_RECONNECTS);
+    SYS_KEY("loop",            SYS_LOOP);
+    SYS_KEY("i2c_cache",       SYS_I2C_CACHE);
+    SYS_KEY("adc",             SYS_ADC);
+    SYS_KEY("display",         SYS_DISPLAY);
+    default: return SYS_NONE;
+    }
+#undef SYS_KEY
+}
+
+DevAction halDevAction(const Route *r) {
+    if (r->n != 2) return DACT_READ;
+    const RouteToken &a = r->tok[1];
+    switch (a.hash) {
+    case routeKey("info"):    return routeIs(a, "info")    ? DACT_INFO    : DACT_READ;
+    case routeKey("reset"):   return routeIs(a, "reset")   ? DACT_RESET   : DACT_READ;
+    case routeKey("history"): return routeIs(a, "history") ? DACT_HISTORY : DACT_READ;
+    case routeKey("set"):     return routeIs(a, "set")     ? DACT_SET     : DACT_READ;
+    case routeKey("get"):     return routeIs(a, "get")     ? DACT_GET     : DACT_READ;
+    default:                  return DACT_READ;
+    }
+}
+
+enum CfgGroup { CGRP_NONE, CGRP_DEVICE, CGRP_TAG, CGRP_HEARTBEAT, CGRP_I2C,
+                CGRP_EVENT, CGRP_RULE, CGRP_NAME, CGRP_SLEEP, CGRP_GET };
+
+enum CfgVerb { CVERB_NONE, CVERB_ADD, CVERB_REMOVE, CVERB_LIST, CVERB_SET,
+               CVERB_GET, CVERB_CLEAR };
+
+#define CFG_KEY(t, key, val, none) case routeKey(key): return routeIs(t, key) ? val : none
+
+static CfgGroup cfgGroup(const RouteToken &t) {
+    switch (t.hash) {
+    CFG_KEY(t, "device",    CGRP_DEVICE,    CGRP_NONE);
+    CFG_KEY(t, "tag",       CGRP_TAG,       CGRP_NONE);
+    CFG_KEY(t, "heartbeat", CGRP_HEARTBEAT, CGRP_NONE);
+    CFG_KEY(t, "i2c",       CGRP_I2C,       CGRP_NONE);
+    CFG_KEY(t, "event",     CGRP_EVENT,     CGRP_NONE);
+    CFG_KEY(t, "rule",      CGRP_RULE,      CGRP_NONE);
+    CFG_KEY(t, "name",      CGRP_NAME,      CGRP_NONE);
+    CFG_KEY(t, "sleep",     CGRP_SLEEP,     CGRP_NONE);
+    CFG_KEY(t, "get",       CGRP_GET,       CGRP_NONE);
+    default: return CGRP_NONE;
+    }
+}
+
+static CfgVerb cfgVerb(const RouteToken &t) {
+    switch (t.hash) {
+    CFG_KEY(t, "add",    CVERB_ADD,    CVERB_NONE);
+    CFG_KEY(t, "remove", CVERB_REMOVE, CVERB_NONE);
+    CFG_KEY(t, "list",   CVERB_LIST,   CVERB_NONE);
+    CFG_KEY(t, "set",    CVERB_SET,    CVERB_NONE);
+    CFG_KEY(t, "get",    CVERB_GET,    CVERB_NONE);
+    CFG_KEY(t, "clear",  CVERB_CLEAR,  CVERB_NONE);
+    default: return CVERB_NONE;
+    }
+}
+
+#undef CFG_KEY
+
+CfgCommand cfgCommand(const Route *r) {
+    CfgGroup g = cfgGroup(r->tok[0]);
+    if (g == CGRP_GET) return r->n == 1 ? CCMD_GET : CCMD_NONE;
+    if (g == CGRP_NONE || r->n != 2) return CCMD_NONE;
+
+    CfgVerb v = cfgVerb(r->tok[1]);
+    switch (g) {
+    case CGRP_DEVICE:
+        return v == CVERB_ADD    ? CCMD_DEVICE_ADD :
+               v == CVERB_REMOVE ? CCMD_DEVICE_REMOVE :
+               v == CVERB_LIST   ? CCMD_DEVICE_LIST : CCMD_NONE;
+    case CGRP_TAG:
+        return v == CVERB_SET ? CCMD_TAG_SET :
+               v == CVERB_GET ? CCMD_TAG_GET : CCMD_NONE;
+    case CGRP_HEARTBEAT:
+        return v == CVERB_SET ? CCMD_HEARTBEAT_SET : CCMD_NONE;
+    case CGRP_I2C:
+        return v == CVERB_SET ? CCMD_I2C_SET :
+               v == CVERB_GET ? CCMD_I2C_GET : CCMD_NONE;
+    case CGRP_EVENT:
+        return v == CVERB_SET   ? CCMD_EVENT_SET :
+               v == CVERB_CLEAR ? CCMD_EVENT_CLEAR :
+               v == CVERB_LIST  ? CCMD_EVENT_LIST : CCMD_NONE;
+    case CGRP_RULE:
+        return v == CVERB_SET   ? CCMD_RULE_SET :
+               v == CVERB_CLEAR ? CCMD_RULE_CLEAR :
+               v == CVERB_LIST  ? CCMD_RULE_LIST : CCMD_NONE;
+    case CGRP_NAME:
+        return v == CVERB_SET ? CCMD_NAME_SET : CCMD_NONE;
+    case CGRP_SLEEP:
+        return v == CVERB_SET ? CCMD_SLEEP_SET :
+               v == CVERB_GET ? CCMD_SLEEP_GET : CCMD_NONE;
+    default:
+        return CCMD_NONE;
+    }
+}
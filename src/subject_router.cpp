@@ -0,0 +1,66 @@
+/**
+ * @file subject_router.cpp
+ * @brief Subject tokens and compile-time hashed dispatch
+ *
+ * The client delivers a MSG payload straight from its receive buffer, where
+ * it is followed by the protocol's CRLF (checked before delivery and
+ * consumed after the callback). Writing the terminator over the CR gives
+ * handlers a C string without copying; routeRelease() puts the CR back.
+ */
+
+#include "subject_router.h"
+
+bool routeUint(const RouteToken &t, uint32_t max, int *out) {
+    if (t.len == 0 || t.len > 10) return false;
+    uint64_t v = 0;
+    for (size_t i = 0; i < t.len; i++) {
+        char c = t.p[i];
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + (uint64_t)(c - '0');
+    }
+    if (v > max) return false;
+    *out = (int)v;
+    return true;
+}
+
+bool routeParse(const nats_msg_t *msg, size_t prefix_len, Route *r) {
+    r->term = nullptr;
+    r->payload = "";
+    r->payload_len = 0;
+    if (msg->subject_len <= prefix_len) return false;
+
+    r->suffix = msg->subject + prefix_len;
+    r->suffix_len = msg->subject_len - prefix_len;
+
+    /* Split on '.' and hash each token in the same pass; the last token
+       keeps any remainder */
+    const char *p = r->suffix;
+    const char *end = r->suffix + r->suffix_len;
+    const char *start = p;
+    uint32_t h = ROUTE_HASH_INIT;
+    r->n = 0;
+    for (; p < end; p++) {
+        if (*p == '.' && r->n < ROUTE_MAX_TOKENS - 1) {
+            r->tok[r->n++] = { start, (size_t)(p - start), h };
+            start = p + 1;
+            h = ROUTE_HASH_INIT;
+        } else {
+            h = routeHashStep(h, *p);
+        }
+    }
+    r->tok[r->n++] = { start, (size_t)(end - start), h };
+
+    if (msg->data) {
+        r->term = (char *)msg->data + msg->data_len;
+        r->saved = *r->term;
+        *r->term = '\0';
+        r->payload = (const char *)msg->data;
+        r->payload_len = msg->data_len;
+    }
+    return true;
+}
+
+void routeRelease(Route *r) {
+    if (r->term) *r->term = r->saved;
+    r->term = nullptr;
+}
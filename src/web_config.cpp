@@ -13,8 +13,12 @@
 #include <LittleFS.h>
 #include "version.h"
 #include "devices.h"
+#include "events.h"
 #include "nats_hal.h"
 #include "i2c_devices.h"
+#include "adc_stream.h"
+#include "loop_sched.h"
+#include <lwip/sockets.h>
 
 /* Externs from main.cpp */
 extern char cfg_wifi_ssid[64];
@@ -32,7 +36,8 @@ extern uint32_t g_events_fired;
 extern bool g_reboot_pending;
 extern unsigned long g_reboot_at;
 
-static WebServer server(80);
+static WebServer server(WEB_PORT);
+static int g_web_listen_fd = -1;        /* -1: not found, poll instead */
 
 /*============================================================================
  * Helpers
@@ -182,7 +187,7 @@ static void handlePostConfig() {
     const String &body = server.arg("plain");
 
     /* Read existing config to preserve masked fields */
-    static char existing[512];
+    static char existing[768];
     int elen = wcReadFile("/config.json", existing, sizeof(existing));
     if (elen <= 0) existing[0] = '\0';
 
@@ -190,12 +195,14 @@ static void handlePostConfig() {
         const char *key;
         char val[128];
     };
-    static const int NUM_FIELDS = 8;
+    static const int NUM_FIELDS = 14;
     static Field fields[NUM_FIELDS];
     const char *keys[] = {
         "wifi_ssid", "wifi_pass", "device_name",
         "nats_host", "nats_port", "timezone",
-        "tag", "heartbeat_interval"
+        "tag", "heartbeat_interval",
+        "i2c_hz", "i2c1_sda", "i2c1_scl", "i2c1_hz",
+        "sleep_interval", "sleep_report"
     };
 
     for (int i = 0; i < NUM_FIELDS; i++) {
@@ -328,17 +335,20 @@ static void handleGetDevices() {
         if (d->kind == DEV_SENSOR_NATS_VALUE && d->nats_subject[0])
             snprintf(extra, sizeof(extra), "%s", d->nats_subject);
         else if (d->kind == DEV_SENSOR_SERIAL_TEXT && d->baud > 0)
-            snprintf(extra, sizeof(extra), "%u baud", (unsigned)d->baud);
+            snprintf(extra, sizeof(extra), "UART%d %u baud", d->uart, (unsigned)d->baud);
         else if (deviceIsI2c(d->kind) && d->i2c_addr > 0)
-            snprintf(extra, sizeof(extra), "0x%02X ch%d", d->i2c_addr, d->pin);
+            snprintf(extra, sizeof(extra), d->i2c_bus ? "bus1 0x%02X ch%d" : "0x%02X ch%d",
+                     d->i2c_addr, d->pin);
+        else if (d->kind == DEV_SENSOR_COMPUTED)
+            snprintf(extra, sizeof(extra), "%s", d->disp_template);
 
         /* Last message for NATS and serial_text sensors */
         char msg[80];
         msg[0] = '\0';
         if (d->kind == DEV_SENSOR_NATS_VALUE && d->nats_msg[0])
             snprintf(msg, sizeof(msg), "%s", d->nats_msg);
-        else if (d->kind == DEV_SENSOR_SERIAL_TEXT && serialTextGetMsg()[0])
-            snprintf(msg, sizeof(msg), "%s", serialTextGetMsg());
+        else if (d->kind == DEV_SENSOR_SERIAL_TEXT && deviceGetNatsMsg(d)[0])
+            snprintf(msg, sizeof(msg), "%s", deviceGetNatsMsg(d));
 
         /* JSON-escape name, extra, msg */
         char e_name[48], e_extra[64], e_msg[96];
@@ -361,8 +371,10 @@ static void handleGetDevices() {
             const char *dir = d->ev_direction == EV_DIR_ABOVE ? "above" : "below";
             w += snprintf(buf + w, sizeof(buf) - w,
                 ",\"ev_threshold\":%.1f,\"ev_direction\":\"%s\","
-                "\"ev_cooldown\":%d,\"ev_armed\":%s",
-                d->ev_threshold, dir, d->ev_cooldown,
+                "\"ev_cooldown\":%d,\"ev_hysteresis\":%.6g,\"ev_mode\":\"%s\","
+                "\"ev_window\":%d,\"ev_armed\":%s",
+                d->ev_threshold, dir, d->ev_cooldown, d->ev_hysteresis,
+                eventsModeName(d->ev_mode), d->ev_window,
                 d->ev_armed ? "true" : "false");
         }
 
@@ -428,6 +440,7 @@ static void handleAddDevice() {
     int pin = wcJsonGetInt(body, "pin", PIN_NONE);
     bool inverted = wcJsonGetBool(body, "inverted", false);
     uint32_t baud = (uint32_t)wcJsonGetInt(body, "baud", 0);
+    uint8_t uart = (uint8_t)wcJsonGetInt(body, "uart", 1);
 
     /* Determine DeviceKind */
     DeviceKind kind;
@@ -450,6 +463,9 @@ static void handleAddDevice() {
     else if (strcmp(kind_str, "dht11_humi") == 0)  kind = DEV_SENSOR_DHT11_HUMI;
     else if (strcmp(kind_str, "dht22_temp") == 0)  kind = DEV_SENSOR_DHT22_TEMP;
     else if (strcmp(kind_str, "dht22_humi") == 0)  kind = DEV_SENSOR_DHT22_HUMI;
+    else if (strcmp(kind_str, "pulse_count") == 0) kind = DEV_SENSOR_PULSE_COUNT;
+    else if (strcmp(kind_str, "pulse_rate") == 0)  kind = DEV_SENSOR_PULSE_RATE;
+    else if (strcmp(kind_str, "computed") == 0)    kind = DEV_SENSOR_COMPUTED;
     else {
         server.send(400, "application/json", "{\"ok\":false,\"error\":\"unknown kind\"}");
         return;
@@ -464,6 +480,22 @@ static void handleAddDevice() {
     wcJsonGetString(body, "template", disp_tmpl, sizeof(disp_tmpl));
     uint8_t i2c_reg_len = (uint8_t)wcJsonGetInt(body, "reg_len", 1);
     float i2c_scale = wcJsonGetFloat(body, "scale", 1.0f);
+    int i2c_ttl = wcJsonGetInt(body, "cache_ttl", DEV_I2C_TTL_DEFAULT);
+    uint8_t i2c_bus = (uint8_t)wcJsonGetInt(body, "i2c_bus", 0);
+    if (i2c_ttl < 0 || i2c_ttl > 60000) i2c_ttl = DEV_I2C_TTL_DEFAULT;
+
+    /* Computed sensors: expression over other sensors, no pin */
+    if (kind == DEV_SENSOR_COMPUTED) {
+        wcJsonGetString(body, "expr", disp_tmpl, sizeof(disp_tmpl));
+        char err[64];
+        if (!deviceExprCheck(disp_tmpl, err, sizeof(err))) {
+            static char eresp[128];
+            snprintf(eresp, sizeof(eresp), "{\"ok\":false,\"error\":\"%s\"}", err);
+            server.send(400, "application/json", eresp);
+            return;
+        }
+        pin = PIN_NONE;
+    }
 
     /* Default unit */
     char unit_buf[DEV_UNIT_LEN] = "";
@@ -475,6 +507,7 @@ static void handleAddDevice() {
         else if (kind == DEV_SENSOR_I2C_BH1750) unit = "lux";
         else if (kind == DEV_SENSOR_DHT11_TEMP || kind == DEV_SENSOR_DHT22_TEMP) unit = "C";
         else if (kind == DEV_SENSOR_DHT11_HUMI || kind == DEV_SENSOR_DHT22_HUMI) unit = "%";
+        else if (kind == DEV_SENSOR_PULSE_RATE) unit = "Hz";
     }
 
     /* OLED display defaults (SSD1306/SH1106) */
@@ -482,7 +515,13 @@ static void handleAddDevice() {
 
     bool ok = deviceRegister(name, kind, (uint8_t)pin, unit, inverted, nullptr, baud,
                              i2c_addr, disp_tmpl[0] ? disp_tmpl : nullptr,
-                             i2c_reg_len, i2c_scale);
+                             i2c_reg_len, i2c_scale, (uint16_t)i2c_ttl, i2c_bus, uart);
+    if (ok && kind == DEV_SENSOR_DIGITAL) {
+        Device *d = deviceFind(name);
+        d->debounce_ms = (uint16_t)constrain(
+            wcJsonGetInt(body, "debounce", DEV_DEBOUNCE_DEFAULT), 0, DEV_DEBOUNCE_MAX);
+        d->edge_publish = wcJsonGetBool(body, "publish_edges", false);
+    }
     if (ok) devicesSave();
 
     static char resp[128];
@@ -560,11 +599,21 @@ static void handleSetEvent() {
 
     int cooldown = wcJsonGetInt(body, "cooldown", 10);
 
+    char mode_str[8] = "";
+    wcJsonGetString(body, "mode", mode_str, sizeof(mode_str));
+    uint8_t mode = eventsModeFromString(mode_str);
+    if (mode == EV_MODE_BAD) {
+        server.send(400, "application/json", "{\"ok\":false,\"error\":\"mode must be value, rate, avg, min or max\"}");
+        return;
+    }
+
     dev->ev_threshold = threshold;
     dev->ev_direction = direction;
     dev->ev_cooldown = (uint16_t)constrain(cooldown, 1, 65535);
-    dev->ev_armed = true;
-    dev->ev_last_fire_ms = 0;
+    dev->ev_hysteresis = fabsf(wcJsonGetFloat(body, "hysteresis", 0.0f));
+    dev->ev_mode = mode;
+    dev->ev_window = (uint8_t)constrain(wcJsonGetInt(body, "window", 10), 2, EV_WIN_MAX);
+    eventsDeviceChanged(dev);
 
     devicesMarkDirty();
     server.send(200, "application/json", "{\"ok\":true}");
@@ -590,21 +639,21 @@ static void handleClearEvent() {
     dev->ev_direction = EV_DIR_NONE;
     dev->ev_threshold = 0.0f;
     dev->ev_cooldown = 0;
-    dev->ev_armed = false;
-    dev->ev_last_fire_ms = 0;
+    dev->ev_hysteresis = 0.0f;
+    dev->ev_mode = EV_MODE_VALUE;
+    eventsDeviceChanged(dev);
 
     devicesMarkDirty();
     server.send(200, "application/json", "{\"ok\":true}");
 }
 
 static void handleGetDevicesJson() {
-    static char buf[2048];
-    int len = wcReadFile("/devices.json", buf, sizeof(buf));
-    if (len <= 0) {
-        server.send(200, "text/plain", "[]");
+    const char *json = devicesExportJson();
+    if (!json) {
+        server.send(500, "application/json", "{\"ok\":false,\"error\":\"registry too large to export\"}");
         return;
     }
-    server.send(200, "text/plain", buf);
+    server.send(200, "text/plain", json);
 }
 
 static void handlePostDevicesJson() {
@@ -612,20 +661,18 @@ static void handlePostDevicesJson() {
         server.send(400, "application/json", "{\"ok\":false,\"error\":\"no body\"}");
         return;
     }
-    const String &body = server.arg("plain");
-
-    File f = LittleFS.open("/devices.json", "w");
-    if (!f) {
-        server.send(500, "application/json", "{\"ok\":false,\"error\":\"write failed\"}");
-        return;
-    }
-    f.print(body);
-    f.close();
-
-    devicesReload();
-
-    Serial.printf("[WebConfig] devices.json overwritten + reloaded\n");
-    server.send(200, "application/json", "{\"ok\":true,\"message\":\"Devices reloaded.\"}");
+    int skipped = 0;
+    int count = devicesImportJson(server.arg("plain").c_str(), &skipped);
+
+    Serial.printf("[WebConfig] devices imported from JSON (%d, %d skipped)\n", count, skipped);
+    char resp[96];
+    if (skipped)
+        snprintf(resp, sizeof(resp),
+                 "{\"ok\":false,\"message\":\"%d devices imported, %d skipped.\"}",
+                 count, skipped);
+    else
+        snprintf(resp, sizeof(resp), "{\"ok\":true,\"message\":\"%d devices imported.\"}", count);
+    server.send(200, "application/json", resp);
 }
 
 /*============================================================================
@@ -633,11 +680,16 @@ static void handlePostDevicesJson() {
  *============================================================================*/
 
 static void handleI2cScan() {
-    bool was_active = i2cActive();
-    if (!was_active) i2cInit();
+    uint8_t bus = server.hasArg("bus") ? (uint8_t)server.arg("bus").toInt() : 0;
+    if (bus >= I2C_BUS_MAX) {
+        server.send(400, "application/json", "{\"error\":\"no such bus\"}");
+        return;
+    }
+    bool was_active = i2cActive(bus);
+    if (!was_active) i2cInit(bus);
 
     uint8_t addrs[32];
-    int count = i2cScan(addrs, 32);
+    int count = i2cScan(addrs, 32, bus);
 
     static char buf[256];
     int w = 0;
@@ -648,7 +700,7 @@ static void handleI2cScan() {
     }
     w += snprintf(buf + w, sizeof(buf) - w, "]");
 
-    if (!was_active) i2cDeinit();
+    if (!was_active) i2cDeinit(bus);
     server.send(200, "application/json", buf);
 }
 
@@ -688,27 +740,13 @@ static void handleSetDisplayText() {
           while (*r) { if (r[0]=='\\' && r[1]=='n') { *w++='\n'; r+=2; } else { *w++=*r++; } }
           *w = '\0'; }
         uint8_t height = (dev->pin == 1) ? 32 : 64;
-        int max_lines = (height == 32) ? 4 : 8;
-        char *line_start = text + 1;
-        int line_num = 0;
-        while (line_start && *line_start && line_num < max_lines) {
-            char *nl = strchr(line_start, '\n');
-            if (nl) *nl = '\0';
-            ssd1306WriteText(dev->i2c_addr, line_num, line_start, col_offset);
-            line_num++;
-            if (nl) line_start = nl + 1;
-            else break;
-        }
-        while (line_num < max_lines) {
-            ssd1306WriteText(dev->i2c_addr, line_num, "", col_offset);
-            line_num++;
-        }
+        ssd1306WriteLines(deviceI2cAddr(dev), text + 1, height, col_offset);
     } else if (text[0]) {
         /* Update template and render */
         strncpy(dev->disp_template, text, sizeof(dev->disp_template) - 1);
         dev->disp_template[sizeof(dev->disp_template) - 1] = '\0';
         uint8_t height = (dev->pin == 1) ? 32 : 64;
-        ssd1306RenderTemplate(dev->i2c_addr, dev->disp_template, height, col_offset);
+        ssd1306RenderTemplate(deviceI2cAddr(dev), dev->disp_template, height, col_offset);
         devicesMarkDirty();
     }
 
@@ -758,7 +796,8 @@ static void handlePins() {
             snprintf(resp, sizeof(resp), "{\"ok\":true}");
         }
     } else if (strcmp(type, "ADC") == 0) {
-        int val = analogRead(pin);
+        float raw;
+        int val = adcStreamRaw(pin, &raw) ? (int)(raw + 0.5f) : adcOneshotRaw(pin);
         snprintf(resp, sizeof(resp), "{\"value\":%d}", val);
     } else if (strcmp(type, "PWM") == 0) {
         if (strcmp(action, "read") == 0) {
@@ -966,6 +1005,9 @@ nav button{padding:0.4rem 0.6rem;font-size:0.8rem}
 <option value="dht11_humi">dht11_humi</option>
 <option value="dht22_temp">dht22_temp</option>
 <option value="dht22_humi">dht22_humi</option>
+<option value="pulse_count">pulse_count</option>
+<option value="pulse_rate">pulse_rate</option>
+<option value="computed">computed</option>
 </select>
 </div>
 </div>
@@ -979,6 +1021,8 @@ nav button{padding:0.4rem 0.6rem;font-size:0.8rem}
 <div id="ad_baud_wrap" class="hidden">
 <label>Baud Rate</label>
 <input type="number" id="ad_baud" value="9600">
+<label>UART</label>
+<input type="number" id="ad_uart" value="1" min="1" max="2">
 </div>
 <div id="ad_i2c_wrap" class="hidden">
 <label>I2C Address (decimal)</label>
@@ -999,6 +1043,11 @@ nav button{padding:0.4rem 0.6rem;font-size:0.8rem}
 <input type="text" id="ad_tmpl" placeholder="e.g. T:{temp}C H:{humi}%">
 <p class="hint">{device_name} tokens are replaced with live values. Use \n for new lines.</p>
 </div>
+<div id="ad_expr_wrap" class="hidden">
+<label>Expression</label>
+<input type="text" id="ad_expr" placeholder="e.g. dew(bme_temp, bme_humi)">
+<p class="hint">Sensor names, + - * / ^, min/max/avg(...), abs, sqrt, log, exp, round, pow, dew(t,rh)</p>
+</div>
 <div id="ad_generic_wrap" class="hidden">
 <label>Register Address</label>
 <input type="number" id="ad_reg" value="0" min="0" max="255">
@@ -1124,13 +1173,14 @@ var isI2c=k.startsWith('i2c_')||k==='ssd1306'||k==='sh1106';
 var isDht=k.startsWith('dht');
 var isDisp=k==='ssd1306'||k==='sh1106';
 var isMultiChan=k==='i2c_bme280'||k==='i2c_sht31'||k==='i2c_ads1115';
-document.getElementById('ad_pin_wrap').classList.toggle('hidden',k==='serial_text'||isI2c);
+document.getElementById('ad_pin_wrap').classList.toggle('hidden',k==='serial_text'||k==='computed'||isI2c);
 document.getElementById('ad_inv_wrap').classList.toggle('hidden',k!=='relay'&&k!=='ntc_10k'&&k!=='ldr');
 document.getElementById('ad_inv_label').textContent=(k==='ntc_10k'||k==='ldr')?'at 3.3V side':'Inverted';
 document.getElementById('ad_baud_wrap').classList.toggle('hidden',k!=='serial_text');
 document.getElementById('ad_i2c_wrap').classList.toggle('hidden',!isI2c);
 document.getElementById('ad_chan_wrap').classList.toggle('hidden',!isMultiChan);
-document.getElementById('ad_unit_wrap').classList.toggle('hidden',!isI2c);
+document.getElementById('ad_unit_wrap').classList.toggle('hidden',!isI2c&&k!=='computed'&&!k.startsWith('pulse_'));
+document.getElementById('ad_expr_wrap').classList.toggle('hidden',k!=='computed');
 document.getElementById('ad_tmpl_wrap').classList.toggle('hidden',!isDisp);
 document.getElementById('ad_generic_wrap').classList.toggle('hidden',k!=='i2c_generic');
 document.getElementById('ad_scan_btn').classList.toggle('hidden',!isI2c);
@@ -1146,6 +1196,12 @@ var d={name:name,kind:kind};
 var isI2c=kind.startsWith('i2c_')||kind==='ssd1306'||kind==='sh1106';
 if(kind==='serial_text'){
 d.baud=parseInt(document.getElementById('ad_baud').value)||9600;
+d.uart=parseInt(document.getElementById('ad_uart').value)||1;
+}else if(kind==='computed'){
+d.expr=document.getElementById('ad_expr').value.trim();
+if(!d.expr){toast('Expression required',false);return}
+var cu=document.getElementById('ad_unit').value.trim();
+if(cu)d.unit=cu;
 }else if(isI2c){
 var addr=parseInt(document.getElementById('ad_i2c_addr').value);
 if(isNaN(addr)||addr<1||addr>127){toast('I2C address 1-127 required',false);return}
@@ -1170,6 +1226,7 @@ var pin=parseInt(document.getElementById('ad_pin').value);
 if(isNaN(pin)){toast('Pin required',false);return}
 d.pin=pin;
 if(kind==='relay'||kind==='ntc_10k'||kind==='ldr')d.inverted=document.getElementById('ad_inv').checked;
+if(kind.startsWith('pulse_')){var pu=document.getElementById('ad_unit').value.trim();if(pu)d.unit=pu}
 }
 fetch('/api/devices/add',{method:'POST',headers:{'Content-Type':'application/json'},
 body:JSON.stringify(d)}).then(function(r){return r.json()}).then(function(j){
@@ -1351,10 +1408,29 @@ document.getElementById('hdr-ver').textContent='v'+d.version;
  * Setup & Loop
  *============================================================================*/
 
+/* WebServer keeps its listening socket private: find it among the lwIP
+   sockets by local port and listen state */
+static int webListenFd() {
+    for (int fd = LWIP_SOCKET_OFFSET; fd < LWIP_SOCKET_OFFSET + CONFIG_LWIP_MAX_SOCKETS; fd++) {
+        struct sockaddr_storage sa;
+        socklen_t len = sizeof(sa);
+        if (getsockname(fd, (struct sockaddr *)&sa, &len) != 0) continue;
+        uint16_t port = 0;
+        if (sa.ss_family == AF_INET)  port = ((struct sockaddr_in *)&sa)->sin_port;
+        if (sa.ss_family == AF_INET6) port = ((struct sockaddr_in6 *)&sa)->sin6_port;
+        if (ntohs(port) != WEB_PORT) continue;
+        int listening = 0;
+        socklen_t olen = sizeof(listening);
+        if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &olen) == 0 && listening)
+            return fd;
+    }
+    return -1;
+}
+
 void webConfigSetup() {
     /* mDNS */
     if (MDNS.begin(cfg_device_name)) {
-        MDNS.addService("http", "tcp", 80);
+        MDNS.addService("http", "tcp", WEB_PORT);
         Serial.printf("mDNS: http://%s.local/\n", cfg_device_name);
     } else {
         Serial.printf("mDNS: failed to start\n");
@@ -1382,9 +1458,36 @@ void webConfigSetup() {
     server.on("/api/reboot", HTTP_POST, handleReboot);
 
     server.begin();
+    server.enableDelay(false);          /* the loop sleeps in loopWait() instead */
     Serial.printf("WebConfig: http://%s/\n", WiFi.localIP().toString().c_str());
+
+    g_web_listen_fd = webListenFd();
+    if (g_web_listen_fd < 0)
+        Serial.printf("WebConfig: listener not found, polling every %dms\n", WEB_POLL_MS);
 }
 
 void webConfigLoop() {
     server.handleClient();
+    if (g_web_listen_fd < 0) {
+        loopIn(WEB_POLL_MS);
+        return;
+    }
+
+    /* The server takes one connection at a time and accepts the next only
+       after it, so while one is served only that one is watched; a pending
+       connection on the listener would otherwise wake every pass. Request
+       data and the peer's close wake the loop; the server's idle timeouts
+       run on the LOOP_MAX_WAIT_MS bound of loopWait(). */
+    WiFiClient &conn = server.client();
+    bool serving = conn.connected();
+    loopWatch(LOOP_WATCH_WEB, serving ? -1 : g_web_listen_fd);
+    loopWatch(LOOP_WATCH_WEB_CONN, serving ? conn.fd() : -1);
+}
+
+void webConfigLink(bool up) {
+    loopWatch(LOOP_WATCH_WEB, -1);
+    loopWatch(LOOP_WATCH_WEB_CONN, -1);
+    g_web_listen_fd = up ? webListenFd() : -1;
+    if (up && g_web_listen_fd < 0)
+        Serial.printf("WebConfig: listener not found, polling every %dms\n", WEB_POLL_MS);
 }
@@ -0,0 +1,114 @@
+/**
+ * @file dht_decode_test.cpp
+ * @brief Host test: DHT decoder on reference traces in the driver's capture format
+ *
+ * Valid DHT11/DHT22 frames, below zero, jitter, micros() wrap, lost ACK
+ * edges, bad checksum, short and stretched frames.
+ *
+ *   g++ -O2 -Iinclude src/dht_decode.cpp test/host/dht_decode_test.cpp -o dht_test
+ *   ./dht_test
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include "dht_decode.h"
+
+/* Pulse widths in us from the sensor's ACK LOW on: ACK LOW, ACK HIGH,
+   40 x (bit LOW, bit HIGH), trailing LOW. 83 widths = 84 edges. */
+#define TRACE_WIDTHS  83
+
+/* DHT22 65.2 %RH, 23.1 C: 02 8C 00 E7 75 */
+static const uint8_t k_dht22_23c1[TRACE_WIDTHS] = {
+     80,  79,  53,  24,  50,  28,  50,  26,  54,  24,  54,  25,  50,  24,  53,  71,
+     50,  25,  50,  72,  53,  24,  54,  24,  51,  28,  50,  72,  54,  71,  50,  25,
+     50,  28,  51,  26,  53,  25,  54,  24,  54,  26,  54,  25,  50,  28,  54,  25,
+     52,  24,  54,  68,  54,  68,  54,  69,  53,  28,  53,  26,  53,  72,  53,  70,
+     52,  69,  51,  25,  50,  72,  52,  72,  53,  70,  53,  26,  54,  68,  50,  28,
+     53,  69,  52,
+};
+
+/* DHT22 40.0 %RH, -10.1 C: 01 90 80 65 76 */
+static const uint8_t k_dht22_neg[TRACE_WIDTHS] = {
+     79,  81,  53,  24,  50,  28,  54,  26,  52,  26,  54,  27,  54,  27,  50,  24,
+     52,  71,  50,  68,  52,  28,  53,  26,  53,  70,  50,  27,  52,  25,  54,  24,
+     53,  24,  51,  70,  51,  25,  53,  27,  53,  24,  51,  27,  53,  28,  52,  25,
+     53,  28,  52,  27,  52,  71,  51,  69,  50,  25,  51,  25,  51,  68,  53,  28,
+     51,  70,  52,  24,  51,  71,  54,  70,  54,  72,  52,  25,  54,  72,  50,  71,
+     54,  27,  53,
+};
+
+/* DHT11 45 %RH, 22 C: 2D 00 16 00 43 */
+static const uint8_t k_dht11_22c[TRACE_WIDTHS] = {
+     81,  81,  50,  27,  53,  24,  51,  68,  51,  27,  51,  68,  52,  72,  50,  24,
+     50,  72,  51,  28,  50,  26,  54,  24,  50,  25,  54,  27,  51,  26,  52,  28,
+     52,  27,  50,  24,  53,  27,  53,  27,  52,  68,  51,  24,  52,  70,  53,  69,
+     54,  24,  51,  28,  52,  25,  54,  24,  54,  26,  50,  26,  54,  26,  51,  26,
+     51,  28,  54,  28,  52,  69,  54,  25,  51,  27,  51,  25,  54,  27,  52,  68,
+     50,  70,  53,
+};
+
+/* Same frame as k_dht22_23c1 with +-10 us jitter on every pulse, as seen
+   when WiFi interrupts delay the edge ISR */
+static const uint8_t k_dht22_jitter[TRACE_WIDTHS] = {
+     80,  79,  62,  28,  51,  26,  63,  24,  51,  20,  47,  20,  47,  26,  46,  68,
+     46,  26,  59,  77,  59,  32,  40,  26,  60,  24,  60,  64,  61,  64,  52,  31,
+     62,  31,  46,  26,  45,  25,  60,  24,  42,  31,  63,  25,  54,  25,  63,  20,
+     63,  21,  45,  65,  40,  65,  58,  77,  54,  31,  60,  21,  59,  76,  59,  70,
+     61,  77,  51,  21,  57,  71,  44,  63,  40,  75,  63,  29,  43,  71,  63,  33,
+     44,  69,  51,
+};
+
+/* Edge timestamps from widths, first edge at t0 */
+static int traceEdges(const uint8_t *w, int nw, uint32_t t0, uint32_t *edges) {
+    edges[0] = t0;
+    for (int i = 0; i < nw; i++) edges[i + 1] = edges[i] + w[i];
+    return nw + 1;
+}
+
+static int g_fail = 0;
+
+static void check(const char *name, const uint8_t *w, int nw, uint32_t t0,
+                  int skip, int want_rc, bool is_dht22, float want_t, float want_h) {
+    uint32_t edges[TRACE_WIDTHS + 1];
+    int n = traceEdges(w, nw, t0, edges) - skip;
+    uint8_t data[5];
+    int rc = dhtDecodeEdges(edges + skip, n, data);
+    bool ok = rc == want_rc;
+    float t = NAN, h = NAN;
+    if (ok && rc == DHT_DECODE_OK) {
+        dhtDecodeValues(data, is_dht22, &t, &h);
+        ok = fabsf(t - want_t) < 0.05f && fabsf(h - want_h) < 0.05f;
+    }
+    printf("%-22s %-4s %s", name, ok ? "ok" : "FAIL", dhtDecodeError(rc));
+    if (rc == DHT_DECODE_OK) printf("  temp=%.1f humi=%.1f", t, h);
+    printf("\n");
+    if (!ok) g_fail++;
+}
+
+int main() {
+    uint8_t w[TRACE_WIDTHS];
+
+    check("dht22 valid",          k_dht22_23c1,  TRACE_WIDTHS, 1000, 0, DHT_DECODE_OK, true,  23.1f, 65.2f);
+    check("dht22 below zero",     k_dht22_neg,   TRACE_WIDTHS, 1000, 0, DHT_DECODE_OK, true, -10.1f, 40.0f);
+    check("dht11 valid",          k_dht11_22c,   TRACE_WIDTHS, 1000, 0, DHT_DECODE_OK, false, 22.0f, 45.0f);
+    check("dht22 jittered",       k_dht22_jitter, TRACE_WIDTHS, 1000, 0, DHT_DECODE_OK, true, 23.1f, 65.2f);
+    check("dht22 micros() wrap",  k_dht22_23c1,  TRACE_WIDTHS, 0xFFFFFF00u, 0, DHT_DECODE_OK, true, 23.1f, 65.2f);
+    check("dht22 ACK edges lost", k_dht22_23c1,  TRACE_WIDTHS, 1000, 2, DHT_DECODE_OK, true, 23.1f, 65.2f);
+
+    /* Last checksum bit read as 0 instead of 1 */
+    memcpy(w, k_dht22_23c1, sizeof(w));
+    w[2 + 2 * 39 + 1] = 26;
+    check("bad checksum",         w, TRACE_WIDTHS, 1000, 0, DHT_DECODE_CHECKSUM, true, 0, 0);
+
+    /* Capture stopped early: only 70 edges */
+    check("short frame",          k_dht22_23c1, 69, 1000, 0, DHT_DECODE_SHORT, false, 0, 0);
+
+    /* One HIGH stretched past DHT_PULSE_MAX_US by a long ISR delay */
+    memcpy(w, k_dht22_jitter, sizeof(w));
+    w[2 + 2 * 20 + 1] = 130;
+    check("stretched pulse",      w, TRACE_WIDTHS, 1000, 0, DHT_DECODE_TIMING, true, 0, 0);
+
+    printf("%s\n", g_fail ? "FAILED" : "all passed");
+    return g_fail ? 1 : 0;
+}
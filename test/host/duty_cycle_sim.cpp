@@ -0,0 +1,119 @@
+/**
+ * @file duty_cycle_sim.cpp
+ * @brief Host simulation: duty-cycle schedule and battery estimate
+ *
+ * Runs the schedule on a simulated RTC clock for N days with two sensors,
+ * a threshold event and occasional failed joins, then prints wakes, radio
+ * use, samples, events and the average current.
+ *
+ *   g++ -O2 -Iinclude src/duty_cycle.cpp test/host/duty_cycle_sim.cpp -o duty_sim
+ *   ./duty_sim [wake_s] [report_s] [days]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "duty_cycle.h"
+
+/* Rough ESP32-C6 module figures; measure your board and adjust */
+#define SIM_SLEEP_UA     20.0     /* deep sleep incl. regulator */
+#define SIM_WAKE_MA      25.0     /* CPU on, radio off */
+#define SIM_RADIO_MA     100.0    /* WiFi join, NATS connect, publish */
+#define SIM_ON_MA        45.0     /* always-on firmware, WiFi modem sleep */
+#define SIM_WAKE_MS      80       /* boot, registry load, sampling */
+#define SIM_RADIO_MS     1200     /* cached-AP join + connect + listen window */
+#define SIM_BATTERY_MAH  2000.0
+
+static const char *simName(int slot, void *ctx) {
+    (void)ctx;
+    static const char *names[] = { "temp", "humi" };
+    return slot < 2 ? names[slot] : nullptr;
+}
+
+int main(int argc, char **argv) {
+    DutyConfig c;
+    c.wake_s   = argc > 1 ? (uint32_t)atoi(argv[1]) : 300;
+    c.report_s = argc > 2 ? (uint32_t)atoi(argv[2]) : 3600;
+    int days   = argc > 3 ? atoi(argv[3]) : 90;
+    if (c.wake_s == 0) { fprintf(stderr, "wake_s must be > 0\n"); return 1; }
+
+    static DutyState s;
+    uint32_t now = 1000;                  /* simulated RTC clock, seconds */
+    const uint32_t unix0 = 1760000000u;
+    dutyReset(&s, &c, now);
+
+    uint32_t keys[DUTY_SLOTS] = { 1, 2 };
+    dutyBindSlots(&s, keys);
+
+    static char json[4096];
+    double mas = 0.0;                     /* charge used, mA*s */
+    uint32_t samples = 0, reported = 0, events = 0, published = 0;
+    uint32_t max_json = 0, late = 0;
+    bool above = false;
+    srand(1);
+
+    uint32_t end = now + (uint32_t)days * 86400u;
+    while (now < end) {
+        /* Wake on the grid (the timer may fire a second early or late) */
+        uint32_t off = (now - s.anchor) % c.wake_s;
+        if (off > 1 && off < c.wake_s - 1) late++;
+
+        float v[DUTY_SLOTS] = { 0 };
+        float day = (float)((now % 86400u) / 86400.0);
+        v[0] = 22.0f + 8.0f * sinf(day * 6.2832f) + (rand() % 100) / 100.0f;
+        v[1] = 50.0f + 10.0f * cosf(day * 6.2832f);
+        dutyLogRow(&s, now, v, 0x3);
+        samples++;
+
+        /* Threshold event with hysteresis, as the event engine would */
+        bool is_above = above ? v[0] > 29.0f : v[0] > 29.5f;
+        if (is_above && !above) {
+            snprintf(json, sizeof(json),
+                     "{\"event\":\"threshold\",\"sensor\":\"temp\",\"value\":%.1f}", v[0]);
+            dutyOutboxPush(&s, "sim.events.temp", json, unix0 + now);
+            events++;
+        }
+        above = is_above;
+
+        uint32_t awake_ms = SIM_WAKE_MS;
+        double ma_s = SIM_WAKE_MA * SIM_WAKE_MS / 1000.0;
+        if (dutyNeedRadio(&s, now)) {
+            bool ok = (rand() % 50) != 0;         /* 2% of joins fail */
+            if (ok) {
+                int rows = s.ring_unsent;
+                int n = dutyTelemetryJson(&s, json, sizeof(json), "sim",
+                                          unix0 + now, now, simName, nullptr);
+                if (n < 0) { fprintf(stderr, "telemetry does not fit\n"); return 1; }
+                if ((uint32_t)n > max_json) max_json = n;
+                reported += rows;
+                const char *subj, *ev;
+                for (int off = 0; (off = dutyOutboxNext(&s, off, &subj, &ev)) >= 0; )
+                    published++;
+            }
+            dutyRadioDone(&s, ok, now);
+            awake_ms += SIM_RADIO_MS;
+            ma_s += SIM_RADIO_MA * SIM_RADIO_MS / 1000.0;
+        }
+        mas += ma_s;
+
+        uint32_t sleep_s = dutySleepFor(&s, now + awake_ms / 1000, awake_ms % 1000);
+        mas += SIM_SLEEP_UA / 1000.0 * sleep_s;
+        now += awake_ms / 1000 + sleep_s + (uint32_t)(rand() % 3) - 1;
+    }
+
+    double secs = (double)days * 86400.0;
+    double avg_ma = mas / secs;
+    printf("wake %us, report %us, %d days\n", c.wake_s, c.report_s, days);
+    printf("wakes:        %u (radio %u, failed %u, off-grid %u)\n",
+           s.wakes, s.radio_wakes, s.radio_fails, late);
+    printf("samples:      %u taken, %u reported, %u lost\n",
+           samples, reported, samples - reported - s.ring_unsent);
+    printf("events:       %u queued, %u published, %u dropped\n",
+           events, published, s.outbox_dropped);
+    printf("telemetry:    largest message %u bytes\n", max_json);
+    printf("awake:        %.1f s/day\n", s.awake_ms / 1000.0 / days);
+    printf("avg current:  %.1f uA -> %.0f days on %.0f mAh (always on: %.1f days)\n",
+           avg_ma * 1000.0, SIM_BATTERY_MAH / avg_ma / 24.0, SIM_BATTERY_MAH,
+           SIM_BATTERY_MAH / SIM_ON_MA / 24.0);
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file ev_window_test.cpp
+ * @brief Host test: event windows with failed reads (NaN) between samples
+ *
+ * Pushes NaN between finite samples in avg, min, max and rate mode and
+ * checks that the reported measure ignores it.
+ *
+ *   g++ -O2 -Iinclude src/ev_window.cpp test/host/ev_window_test.cpp -o ev_window_test
+ *   ./ev_window_test
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "ev_window.h"
+
+static int g_fail = 0;
+static int g_checks = 0;
+
+#define CHECK(cond) do { \
+    g_checks++; \
+    if (!(cond)) { g_fail++; printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); } \
+} while (0)
+
+static bool near(float a, float b) {
+    return fabsf(a - b) < 1e-4f;
+}
+
+/* Push xs at 1 s spacing; returns the measure after the last push */
+static float feed(EvWindow *w, uint8_t mode, const float *xs, int n, uint32_t *t) {
+    float m = NAN;
+    for (int i = 0; i < n; i++, *t += 1000) m = evWinPush(w, mode, xs[i], *t);
+    return m;
+}
+
+static void testAvg() {
+    printf("avg\n");
+    EvWindow w;
+    uint32_t t = 0;
+    evWinReset(&w, 4);
+    const float a[] = { 10, 20 };
+    CHECK(near(feed(&w, EV_MODE_AVG, a, 2, &t), 15));
+    CHECK(isnan(evWinPush(&w, EV_MODE_AVG, NAN, t)));
+    CHECK(w.count == 2 && near(w.sum, 30));
+    const float b[] = { 30, 40, 50 };
+    CHECK(near(feed(&w, EV_MODE_AVG, b, 3, &t), 35));  /* 20 30 40 50 */
+    CHECK(isnan(evWinPush(&w, EV_MODE_AVG, INFINITY, t)));
+    CHECK(near(evWinPush(&w, EV_MODE_AVG, 60, t), 45));
+}
+
+static void testMinMax() {
+    printf("min / max\n");
+    EvWindow w;
+    uint32_t t = 0;
+
+    /* 10, NaN, 1 must report 1, not the stale 10 */
+    evWinReset(&w, 4);
+    const float a[] = { 10, NAN, 1 };
+    CHECK(near(feed(&w, EV_MODE_MIN, a, 3, &t), 1));
+    const float b[] = { 5, NAN, 7, 8 };
+    CHECK(near(feed(&w, EV_MODE_MIN, b, 4, &t), 1));    /* 1 5 7 8 */
+    CHECK(near(evWinPush(&w, EV_MODE_MIN, 9, t), 5));   /* 5 7 8 9 */
+
+    evWinReset(&w, 4);
+    const float c[] = { 1, NAN, 10 };
+    CHECK(near(feed(&w, EV_MODE_MAX, c, 3, &t), 10));
+    const float d[] = { NAN, 3, 2, 4 };
+    CHECK(near(feed(&w, EV_MODE_MAX, d, 4, &t), 10));   /* 10 3 2 4 */
+    CHECK(isnan(evWinPush(&w, EV_MODE_MAX, NAN, t)));
+    CHECK(near(evWinPush(&w, EV_MODE_MAX, 0, t), 4));   /* 3 2 4 0 */
+}
+
+static void testRate() {
+    printf("rate\n");
+    EvWindow w;
+    uint32_t t = 0;
+    evWinReset(&w, 3);
+    CHECK(isnan(evWinPush(&w, EV_MODE_RATE, NAN, t)));
+    t += 1000;
+    CHECK(isnan(evWinPush(&w, EV_MODE_RATE, 10, t)));   /* one sample */
+    t += 1000;
+    CHECK(near(evWinPush(&w, EV_MODE_RATE, 12, t), 2));
+    t += 1000;
+    CHECK(isnan(evWinPush(&w, EV_MODE_RATE, NAN, t)));
+    t += 1000;
+    CHECK(near(evWinPush(&w, EV_MODE_RATE, 16, t), 2)); /* 10 @1s .. 16 @4s */
+    t += 1000;
+    CHECK(near(evWinPush(&w, EV_MODE_RATE, 18, t), 2)); /* 12 @2s .. 18 @5s */
+}
+
+int main() {
+    testAvg();
+    testMinMax();
+    testRate();
+    printf("%d checks, %s\n", g_checks, g_fail ? "FAILED" : "all passed");
+    return g_fail ? 1 : 0;
+}
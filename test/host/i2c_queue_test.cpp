@@ -0,0 +1,337 @@
+/**
+ * @file i2c_queue_test.cpp
+ * @brief Host test: I2C conversion queue on a mock bus
+ *
+ * A mock bus stands in for Wire and the sensor chips; checks ordering,
+ * deadlines and contention.
+ *
+ *   g++ -O2 -Iinclude src/i2c_queue.cpp test/host/i2c_queue_test.cpp -o i2c_queue_test
+ *   ./i2c_queue_test
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "i2c_queue.h"
+
+enum { T_SHT31, T_ADS1115, T_BME280 };
+
+/* Datasheet conversion times, rounded up to the ms */
+#define MOCK_SHT31_MS    15
+#define MOCK_ADS1115_MS  8
+#define MOCK_BME280_MS   10
+#define MOCK_BME_BOOT_MS 2
+
+struct MockChip {
+    uint8_t  addr;
+    uint8_t  type;
+    bool     fail;          /* NACKs every transfer */
+    bool     converting;
+    uint8_t  conv_chan;
+    uint32_t conv_t;
+    bool     configured;    /* BME280: after reset + setup */
+    uint32_t reset_t;
+};
+
+struct MockOp {
+    uint32_t t;
+    uint8_t  addr;
+    char     op;            /* R reset, S setup, T trigger, C collect */
+    uint8_t  chan;
+};
+
+struct MockResult {
+    uint32_t t;
+    uint8_t  addr;
+    uint8_t  chan;
+    bool     ok;
+};
+
+static MockChip   g_chips[12];
+static int        g_nchips;
+static MockOp     g_ops[128];
+static int        g_nops;
+static MockResult g_res[64];
+static int        g_nres;
+static bool       g_bus_up[2];
+static uint32_t   g_now;
+static int        g_early;      /* collect before the conversion finished */
+static int        g_overlap;    /* trigger while the chip was converting */
+
+static MockChip *mockChip(uint8_t addr) {
+    for (int i = 0; i < g_nchips; i++)
+        if (g_chips[i].addr == addr) return &g_chips[i];
+    return nullptr;
+}
+
+static void mockLog(uint8_t addr, char op, uint8_t chan) {
+    if (g_nops < (int)(sizeof(g_ops) / sizeof(g_ops[0])))
+        g_ops[g_nops++] = { g_now, addr, op, chan };
+}
+
+static bool mockReady(uint8_t addr) {
+    return g_bus_up[addr >> 7];
+}
+
+static int mockTrigger(uint8_t type, uint8_t addr, uint8_t chan, uint32_t *wait_ms) {
+    MockChip *c = mockChip(addr);
+    if (!c || c->fail) return I2C_TRIG_FAIL;
+    if (type == T_BME280 && !c->configured) {
+        c->reset_t = g_now;
+        mockLog(addr, 'R', chan);
+        *wait_ms = BME280_RESET_MS;
+        return I2C_TRIG_SETUP;
+    }
+    if (c->converting) g_overlap++;
+    c->converting = true;
+    c->conv_chan  = chan;
+    c->conv_t     = g_now;
+    mockLog(addr, 'T', chan);
+    *wait_ms = type == T_SHT31 ? SHT31_CONV_MS :
+               type == T_ADS1115 ? ADS1115_CONV_MS : BME280_CONV_MS;
+    return I2C_TRIG_CONVERT;
+}
+
+static bool mockSetup(uint8_t type, uint8_t addr) {
+    MockChip *c = mockChip(addr);
+    if (!c || c->fail || type != T_BME280) return false;
+    if (g_now - c->reset_t < MOCK_BME_BOOT_MS) return false;
+    c->configured = true;
+    mockLog(addr, 'S', 0);
+    return true;
+}
+
+static bool mockCollect(uint8_t type, uint8_t addr, uint8_t chan, float *values) {
+    MockChip *c = mockChip(addr);
+    if (!c || c->fail) return false;
+    uint32_t need = type == T_SHT31 ? MOCK_SHT31_MS :
+                    type == T_ADS1115 ? MOCK_ADS1115_MS : MOCK_BME280_MS;
+    if (!c->converting || c->conv_chan != chan || g_now - c->conv_t < need) {
+        g_early++;
+        return false;   /* SHT31 NACKs, ADS1115 returns the old result */
+    }
+    c->converting = false;
+    mockLog(addr, 'C', chan);
+    values[0] = (float)(addr * 10 + chan);
+    return true;
+}
+
+static void mockResult(uint8_t type, uint8_t addr, uint8_t chan, const float *values) {
+    (void)type;
+    if (values && values[0] != (float)(addr * 10 + chan)) g_early++;
+    if (g_nres < (int)(sizeof(g_res) / sizeof(g_res[0])))
+        g_res[g_nres++] = { g_now, addr, chan, values != nullptr };
+}
+
+static const I2cQueueDriver k_mock_driver = {
+    mockReady, mockTrigger, mockSetup, mockCollect, mockResult
+};
+
+static I2cQueue g_q;
+
+static void mockReset(uint32_t now) {
+    memset(&g_q, 0, sizeof(g_q));
+    g_q.drv = &k_mock_driver;
+    memset(g_chips, 0, sizeof(g_chips));
+    g_nchips = g_nops = g_nres = g_early = g_overlap = 0;
+    g_bus_up[0] = true;
+    g_bus_up[1] = true;
+    g_now = now;
+}
+
+static MockChip *mockAdd(uint8_t addr, uint8_t type) {
+    MockChip *c = &g_chips[g_nchips++];
+    c->addr = addr;
+    c->type = type;
+    return c;
+}
+
+static void request(uint8_t type, uint8_t addr, uint8_t want) {
+    I2cJob *j = i2cQueueGet(&g_q, type, addr);
+    if (j) j->want |= want;
+}
+
+/* Tickless loop: sleep until the deadline the queue asks for */
+static void runToIdle(int max_passes) {
+    uint32_t due;
+    while (max_passes-- > 0 && i2cQueuePoll(&g_q, g_now, &due)) g_now = due;
+}
+
+static int opIndex(uint8_t addr, char op, int from) {
+    for (int i = from; i < g_nops; i++)
+        if (g_ops[i].addr == addr && g_ops[i].op == op) return i;
+    return -1;
+}
+
+static int g_fail = 0;
+static int g_checks = 0;
+
+#define CHECK(cond) do { \
+    g_checks++; \
+    if (!(cond)) { g_fail++; printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); } \
+} while (0)
+
+/* SHT31, ADS1115 (3 channels) and a first-use BME280 on one bus */
+static void testOrdering() {
+    printf("trigger -> collect ordering\n");
+    mockReset(1000);
+    mockAdd(0x44, T_SHT31);
+    mockAdd(0x48, T_ADS1115);
+    mockAdd(0x76, T_BME280);
+    request(T_SHT31, 0x44, 1);
+    request(T_ADS1115, 0x48, 0x0B);     /* channels 0, 1, 3 */
+    request(T_BME280, 0x76, 1);
+    runToIdle(50);
+
+    CHECK(g_early == 0);
+    CHECK(g_overlap == 0);
+    CHECK(g_nres == 5);
+    for (int i = 0; i < g_nres; i++) CHECK(g_res[i].ok);
+
+    /* Every collect follows the trigger of the same channel */
+    for (int i = 0; i < g_nops; i++) {
+        if (g_ops[i].op != 'C') continue;
+        int t = -1;
+        for (int k = i - 1; k >= 0; k--)
+            if (g_ops[k].addr == g_ops[i].addr) { t = k; break; }
+        CHECK(t >= 0 && g_ops[t].op == 'T' && g_ops[t].chan == g_ops[i].chan);
+    }
+
+    /* All three chips are started in the first pass */
+    CHECK(g_ops[0].t == 1000 && g_ops[1].t == 1000 && g_ops[2].t == 1000);
+
+    /* ADS1115 channels in order */
+    int k = 0;
+    uint8_t chans[3];
+    for (int i = 0; i < g_nres; i++)
+        if (g_res[i].addr == 0x48 && k < 3) chans[k++] = g_res[i].chan;
+    CHECK(k == 3 && chans[0] == 0 && chans[1] == 1 && chans[2] == 3);
+
+    /* BME280 first use: reset, setup, trigger, collect */
+    int r = opIndex(0x76, 'R', 0), s = opIndex(0x76, 'S', 0);
+    int t = opIndex(0x76, 'T', 0), c = opIndex(0x76, 'C', 0);
+    CHECK(r >= 0 && r < s && s < t && t < c);
+
+    /* The cycle costs the longest chain (3 ADS1115 conversions), not the sum */
+    printf("  cycle %u ms (sum of conversions %u ms)\n", (unsigned)(g_now - 1000),
+           (unsigned)(SHT31_CONV_MS + 3 * ADS1115_CONV_MS + BME280_RESET_MS + BME280_CONV_MS));
+    CHECK(g_now - 1000 == 3 * ADS1115_CONV_MS);
+}
+
+/* Deadlines are honoured exactly, also across the millis() wrap */
+static void testDeadlines() {
+    printf("conversion deadlines\n");
+    mockReset(0xFFFFFFF8u);
+    mockAdd(0x44, T_SHT31);
+    uint32_t due = 0;
+    CHECK(!i2cQueuePoll(&g_q, g_now, &due));    /* idle queue: no wakeup */
+
+    request(T_SHT31, 0x44, 1);
+    CHECK(i2cQueuePoll(&g_q, g_now, &due));
+    CHECK(due == 0xFFFFFFF8u + SHT31_CONV_MS);
+    CHECK(g_nops == 1 && g_ops[0].op == 'T');
+
+    /* Woken early (other work): nothing is read, the deadline stands */
+    g_now = due - 1;
+    uint32_t due2 = 0;
+    CHECK(i2cQueuePoll(&g_q, g_now, &due2));
+    CHECK(due2 == due);
+    CHECK(g_nops == 1 && g_nres == 0);
+
+    g_now = due;
+    CHECK(!i2cQueuePoll(&g_q, g_now, &due2));
+    CHECK(g_nres == 1 && g_res[0].ok && g_res[0].t == due);
+    CHECK(g_early == 0);
+
+    /* Earliest deadline wins across jobs */
+    mockReset(500);
+    mockAdd(0x44, T_SHT31);
+    mockAdd(0x48, T_ADS1115);
+    request(T_SHT31, 0x44, 1);
+    request(T_ADS1115, 0x48, 1);
+    CHECK(i2cQueuePoll(&g_q, g_now, &due));
+    CHECK(due == 500 + ADS1115_CONV_MS);
+}
+
+/* Requests competing for one converter, a failing chip, a bus going away */
+static void testContention() {
+    printf("bus contention\n");
+    uint32_t due;
+
+    /* New ADS1115 requests while a conversion runs wait for it */
+    mockReset(2000);
+    mockAdd(0x48, T_ADS1115);
+    request(T_ADS1115, 0x48, 1 << 0);
+    i2cQueuePoll(&g_q, g_now, &due);
+    g_now += 3;
+    request(T_ADS1115, 0x48, (1 << 2) | (1 << 0));
+    i2cQueuePoll(&g_q, g_now, &due);
+    CHECK(opIndex(0x48, 'T', 1) < 0);           /* nothing started mid-conversion */
+    runToIdle(20);
+    CHECK(g_overlap == 0 && g_early == 0);
+    CHECK(g_nres == 3 && g_res[0].chan == 0 && g_res[1].chan == 0 && g_res[2].chan == 2);
+
+    /* A chip that NACKs fails its request without holding up the others */
+    mockReset(3000);
+    mockAdd(0x44, T_SHT31);
+    mockAdd(0x45, T_SHT31)->fail = true;
+    mockAdd(0x48, T_ADS1115);
+    request(T_SHT31, 0x45, 1);
+    request(T_SHT31, 0x44, 1);
+    request(T_ADS1115, 0x48, 0x03);
+    runToIdle(20);
+    CHECK(g_nres == 4);
+    CHECK(g_res[0].addr == 0x45 && !g_res[0].ok && g_res[0].t == 3000);
+    int ok = 0;
+    for (int i = 1; i < g_nres; i++) ok += g_res[i].ok;
+    CHECK(ok == 3);
+    CHECK(g_now - 3000 == 2 * ADS1115_CONV_MS);
+
+    /* BME280 that fails setup drops its request */
+    mockReset(4000);
+    mockAdd(0x77, T_BME280);
+    request(T_BME280, 0x77, 1);
+    i2cQueuePoll(&g_q, g_now, &due);
+    g_chips[0].fail = true;
+    runToIdle(5);
+    CHECK(g_nres == 1 && !g_res[0].ok);
+    CHECK(!i2cQueuePoll(&g_q, g_now, &due));
+
+    /* Second bus down: its job waits and touches nothing */
+    mockReset(5000);
+    uint8_t b1 = 0x80 | 0x44;
+    mockAdd(0x44, T_SHT31);
+    mockAdd(b1, T_SHT31);
+    g_bus_up[1] = false;
+    request(T_SHT31, 0x44, 1);
+    request(T_SHT31, b1, 1);
+    runToIdle(20);
+    CHECK(g_nres == 1 && g_res[0].addr == 0x44);
+    CHECK(opIndex(b1, 'T', 0) < 0);
+    g_bus_up[1] = true;
+    runToIdle(20);
+    CHECK(g_nres == 2 && g_res[1].addr == b1 && g_res[1].ok);
+
+    /* Bus removed mid-conversion: jobs dropped, nothing collected */
+    mockReset(6000);
+    mockAdd(b1, T_SHT31);
+    request(T_SHT31, b1, 1);
+    i2cQueuePoll(&g_q, g_now, &due);
+    i2cQueueClear(&g_q, 0x80, 0x80);
+    CHECK(!i2cQueuePoll(&g_q, g_now + 100, &due));
+    CHECK(g_nres == 0);
+
+    /* One job per chip; the table is bounded */
+    mockReset(7000);
+    for (int i = 0; i < I2C_JOB_MAX; i++)
+        CHECK(i2cQueueGet(&g_q, T_SHT31, (uint8_t)(0x10 + i)) != nullptr);
+    CHECK(i2cQueueGet(&g_q, T_SHT31, 0x10) == &g_q.jobs[0]);
+    CHECK(i2cQueueGet(&g_q, T_SHT31, 0x30) == nullptr);
+}
+
+int main() {
+    testOrdering();
+    testDeadlines();
+    testContention();
+    printf("%d checks, %s\n", g_checks, g_fail ? "FAILED" : "all passed");
+    return g_fail ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+/**
+ * @file subject_router_bench.cpp
+ * @brief Host benchmark: recorded hal.* / config.* traffic, old dispatch vs router
+ *
+ * The router side runs the shipped code: routeParse() from
+ * subject_router.cpp and the key switches of subject_keys.cpp, in the
+ * order onNatsHal() / onNatsConfig() call them. Handler bodies are stubbed:
+ * a message ends at the leaf it would be handed to (HAL segment, system
+ * key, device slot and action, config command). Device names are looked up
+ * the way deviceFindN() does, against a fixed registry.
+ *
+ * The baseline is the strcmp dispatch the router replaced, down to the
+ * same leaves: payload copied to the stack, first segment copied out and
+ * compared in turn, system keys and config suffixes compared in turn,
+ * device name copied and compared against every slot.
+ *
+ *   g++ -O2 -Iinclude -Ilib/nats/proto src/subject_router.cpp src/subject_keys.cpp \
+ *       test/host/subject_router_bench.cpp -o router_bench
+ *   ./router_bench [reps]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "subject_router.h"
+#include "subject_keys.h"
+
+/* A 40-message slice of a dashboard session against a node named "node1":
+ * the dashboard reads its sensors and outputs, a flow toggles outputs,
+ * an operator pokes the I2C bus and adjusts config now and then. */
+struct BenchMsg { const char *subject; const char *payload; };
+
+static const BenchMsg k_trace[] = {
+    { "node1.hal.temp", "" },              { "node1.hal.humi", "" },
+    { "node1.hal.pressure", "" },          { "node1.hal.co2", "" },
+    { "node1.hal.door", "" },              { "node1.hal.motion", "" },
+    { "node1.hal.soil", "" },              { "node1.hal.light", "" },
+    { "node1.hal.led.get", "" },           { "node1.hal.relay.get", "" },
+    { "node1.hal.pump.set", "1" },         { "node1.hal.fan.set", "0" },
+    { "node1.hal.temp.info", "" },         { "node1.hal.temp.history", "{\"from\":-3600,\"step\":60}" },
+    { "node1.hal.gpio.4.get", "" },        { "node1.hal.gpio.5.set", "1" },
+    { "node1.hal.gpio.18.get", "" },       { "node1.hal.gpio.read_all", "" },
+    { "node1.hal.adc.2", "" },             { "node1.hal.adc.3.read", "" },
+    { "node1.hal.pwm.6.set", "128" },      { "node1.hal.pwm.6.get", "" },
+    { "node1.hal.system.heap", "" },       { "node1.hal.system.uptime", "" },
+    { "node1.hal.system.loop", "" },       { "node1.hal.system.rssi", "" },
+    { "node1.hal.device.list", "" },       { "node1.hal.i2c.scan", "" },
+    { "node1.hal.i2c.118.read", "{\"reg\":250,\"len\":3}" },
+    { "node1.hal.i2c.60.write", "{\"reg\":0,\"data\":[174]}" },
+    { "node1.hal.i2c.72.xfer.2", "\x01" }, { "node1.hal.i2c.35.detect", "" },
+    { "node1.hal.nosuch", "" },            { "node1.hal.system.bogus", "" },
+    { "node1.config.get", "" },            { "node1.config.device.list", "" },
+    { "node1.config.event.list", "" },     { "node1.config.rule.list", "" },
+    { "node1.config.tag.get", "" },
+    { "node1.config.event.set", "{\"name\":\"temp\",\"above\":30,\"cooldown\":60}" },
+};
+#define BENCH_MSGS  (int)(sizeof(k_trace) / sizeof(k_trace[0]))
+#define BENCH_HAL_PREFIX  10            /* "node1.hal." */
+#define BENCH_CFG_PREFIX  13            /* "node1.config." */
+
+/* Registry: 12 of MAX_DEVICES (16) slots in use */
+static const char *k_bench_devs[] = {
+    "temp", "humi", "door", "led", "relay", "light",
+    "pressure", "soil", "pump", "fan", "motion", "co2",
+};
+#define BENCH_DEVS  (int)(sizeof(k_bench_devs) / sizeof(k_bench_devs[0]))
+#define BENCH_SLOTS 16
+#define BENCH_NAME_LEN 24               /* DEV_NAME_LEN */
+static char     g_bench_dev[BENCH_SLOTS][BENCH_NAME_LEN];
+static uint32_t g_bench_hash[BENCH_SLOTS];
+
+/* Leaf a message reaches and its argument */
+enum BenchLeaf { BL_NONE, BL_SEG, BL_SYS, BL_SYS_BAD, BL_DEV, BL_NOT_FOUND,
+                 BL_CFG, BL_CFG_BAD };
+#define LEAF(l, arg)  (((uint32_t)(l) << 24) | (uint32_t)(arg))
+
+/* Keeps the payload copy from being optimized away */
+static volatile char g_bench_sink;
+
+/*--- Baseline: payload copied to the stack, strcmp per level ---*/
+
+/* In SysKey and CfgCommand order, so both sides name leaves alike */
+static const char *k_sys_keys[] = { "temperature", "heap", "uptime", "rssi",
+    "reset_reason", "nats_reconnects", "loop", "i2c_cache", "adc", "display" };
+static const char *k_cfg_cmds[] = { "device.add", "device.remove", "device.list",
+    "tag.set", "tag.get", "heartbeat.set", "i2c.set", "i2c.get", "event.set",
+    "event.clear", "event.list", "rule.set", "rule.clear", "rule.list",
+    "name.set", "sleep.set", "sleep.get", "get" };
+
+static uint32_t oldHal(const char *suffix) {
+    char segment[24];
+    const char *dot = strchr(suffix, '.');
+    size_t slen = dot ? (size_t)(dot - suffix) : strlen(suffix);
+    if (slen >= sizeof(segment)) slen = sizeof(segment) - 1;
+    memcpy(segment, suffix, slen);
+    segment[slen] = '\0';
+    const char *rest = dot ? dot + 1 : nullptr;
+
+    if (strcmp(segment, "gpio") == 0)        return LEAF(BL_SEG, HSEG_GPIO);
+    else if (strcmp(segment, "adc") == 0)    return LEAF(BL_SEG, HSEG_ADC);
+    else if (strcmp(segment, "pwm") == 0)    return LEAF(BL_SEG, HSEG_PWM);
+    else if (strcmp(segment, "dac") == 0)    return LEAF(BL_SEG, HSEG_DAC);
+    else if (strcmp(segment, "uart") == 0)   return LEAF(BL_SEG, HSEG_UART);
+    else if (strcmp(segment, "i2c") == 0)    return LEAF(BL_SEG, HSEG_I2C);
+    else if (strcmp(segment, "i2c1") == 0)   return LEAF(BL_SEG, HSEG_I2C1);
+    else if (strcmp(segment, "system") == 0) {
+        if (!rest) return LEAF(BL_SYS_BAD, 0);
+        for (int i = 0; i < (int)(sizeof(k_sys_keys) / sizeof(k_sys_keys[0])); i++)
+            if (strcmp(rest, k_sys_keys[i]) == 0) return LEAF(BL_SYS, SYS_TEMPERATURE + i);
+        return LEAF(BL_SYS_BAD, 0);
+    }
+    else if (strcmp(segment, "device") == 0) return LEAF(BL_SEG, HSEG_DEVICE);
+    else if (strcmp(segment, "batch") == 0)  return LEAF(BL_SEG, HSEG_BATCH);
+
+    /* Device lookup: copy the name, strcmp against every slot */
+    char devName[BENCH_NAME_LEN];
+    const char *sub = nullptr;
+    if (dot) {
+        size_t nlen = dot - suffix;
+        if (nlen >= sizeof(devName)) nlen = sizeof(devName) - 1;
+        memcpy(devName, suffix, nlen);
+        devName[nlen] = '\0';
+        sub = dot + 1;
+    } else {
+        strncpy(devName, suffix, sizeof(devName) - 1);
+        devName[sizeof(devName) - 1] = '\0';
+    }
+    int dev = -1;
+    for (int i = 0; i < BENCH_SLOTS; i++)
+        if (g_bench_dev[i][0] && strcmp(g_bench_dev[i], devName) == 0) { dev = i; break; }
+    if (dev < 0) return LEAF(BL_NOT_FOUND, 0);
+    int action = DACT_READ;
+    if (sub && strcmp(sub, "info") == 0)         action = DACT_INFO;
+    else if (sub && strcmp(sub, "reset") == 0)   action = DACT_RESET;
+    else if (sub && strcmp(sub, "history") == 0) action = DACT_HISTORY;
+    else if (sub && strcmp(sub, "set") == 0)     action = DACT_SET;
+    else if (sub && strcmp(sub, "get") == 0)     action = DACT_GET;
+    return LEAF(BL_DEV, dev << 8 | action);
+}
+
+static uint32_t oldDispatch(const nats_msg_t *msg, bool hal) {
+    size_t prefix = hal ? BENCH_HAL_PREFIX : BENCH_CFG_PREFIX;
+    if (msg->subject_len <= prefix) return LEAF(BL_NONE, 0);
+    const char *suffix = msg->subject + prefix;
+
+    char payload[512];
+    size_t cap = hal ? 256 : 512;
+    size_t plen = msg->data_len < cap - 1 ? msg->data_len : cap - 1;
+    if (msg->data && plen > 0) memcpy(payload, msg->data, plen);
+    payload[plen] = '\0';
+    g_bench_sink = payload[0];
+
+    if (hal) return oldHal(suffix);
+    for (int i = 0; i < (int)(sizeof(k_cfg_cmds) / sizeof(k_cfg_cmds[0])); i++)
+        if (strcmp(suffix, k_cfg_cmds[i]) == 0) return LEAF(BL_CFG, CCMD_DEVICE_ADD + i);
+    return LEAF(BL_CFG_BAD, 0);
+}
+
+/*--- Router: routeParse() and the subject_keys switches ---*/
+
+/* As deviceFindN(), with the name hash cache already built */
+static int benchFindN(const char *name, size_t len, uint32_t hash) {
+    if (len >= BENCH_NAME_LEN) return -1;
+    for (int i = 0; i < BENCH_SLOTS; i++) {
+        if (g_bench_hash[i] == hash && g_bench_dev[i][0] &&
+            memcmp(g_bench_dev[i], name, len) == 0 && g_bench_dev[i][len] == '\0')
+            return i;
+    }
+    return -1;
+}
+
+static uint32_t newHal(const Route *r) {
+    HalSegment seg = halSegment(r->tok[0]);
+    switch (seg) {
+    case HSEG_SYSTEM: {
+        SysKey key = r->n == 2 ? halSysKey(r->tok[1]) : SYS_NONE;
+        return key == SYS_NONE ? LEAF(BL_SYS_BAD, 0) : LEAF(BL_SYS, key);
+    }
+    case HSEG_NONE: {
+        int dev = benchFindN(r->tok[0].p, r->tok[0].len, r->tok[0].hash);
+        if (dev < 0) return LEAF(BL_NOT_FOUND, 0);
+        return LEAF(BL_DEV, dev << 8 | halDevAction(r));
+    }
+    default:
+        return LEAF(BL_SEG, seg);
+    }
+}
+
+static uint32_t newDispatch(const nats_msg_t *msg, bool hal) {
+    Route r;
+    if (!routeParse(msg, hal ? BENCH_HAL_PREFIX : BENCH_CFG_PREFIX, &r))
+        return LEAF(BL_NONE, 0);
+    g_bench_sink = r.payload[0];
+    uint32_t leaf;
+    if (hal) {
+        leaf = newHal(&r);
+    } else {
+        CfgCommand cmd = cfgCommand(&r);
+        leaf = cmd == CCMD_NONE ? LEAF(BL_CFG_BAD, 0) : LEAF(BL_CFG, cmd);
+    }
+    routeRelease(&r);
+    return leaf;
+}
+
+/*--- Driver ---*/
+
+static double benchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef uint32_t (*BenchDispatch)(const nats_msg_t *, bool);
+
+/* Best of several rounds, ns per message */
+static double benchRun(BenchDispatch fn, const nats_msg_t *msgs, const bool *hal,
+                       int rounds, int reps, uint32_t *sum) {
+    double best = 1e9;
+    for (int k = 0; k < rounds; k++) {
+        uint32_t acc = 0;
+        double a = benchNow();
+        for (int rep = 0; rep < reps; rep++)
+            for (int i = 0; i < BENCH_MSGS; i++)
+                acc += fn(&msgs[i], hal[i]);
+        double ns = (benchNow() - a) * 1e9 / ((double)reps * BENCH_MSGS);
+        if (ns < best) best = ns;
+        *sum = acc;
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    int reps = argc > 1 ? atoi(argv[1]) : 200000;
+
+    for (int i = 0; i < BENCH_DEVS; i++) {
+        snprintf(g_bench_dev[i], sizeof(g_bench_dev[i]), "%s", k_bench_devs[i]);
+        g_bench_hash[i] = routeKey(g_bench_dev[i]);
+    }
+
+    /* Payloads sit in a receive buffer followed by CRLF, as the client
+       delivers them; the router terminates them in place */
+    static char rx[BENCH_MSGS][128];
+    nats_msg_t msgs[BENCH_MSGS];
+    bool hal[BENCH_MSGS];
+    for (int i = 0; i < BENCH_MSGS; i++) {
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        snprintf(rx[i], sizeof(rx[i]), "%s\r\n", k_trace[i].payload);
+        msgs[i].subject = k_trace[i].subject;
+        msgs[i].subject_len = strlen(k_trace[i].subject);
+        msgs[i].data = (const uint8_t *)rx[i];
+        msgs[i].data_len = strlen(k_trace[i].payload);
+        hal[i] = strncmp(k_trace[i].subject, "node1.hal.", 10) == 0;
+    }
+
+    /* Both dispatchers must reach the same leaf with the same argument */
+    int bad = 0;
+    for (int i = 0; i < BENCH_MSGS; i++) {
+        uint32_t o = oldDispatch(&msgs[i], hal[i]);
+        uint32_t n = newDispatch(&msgs[i], hal[i]);
+        if (o != n) {
+            printf("MISMATCH %s: old %u/%u, router %u/%u\n", k_trace[i].subject,
+                   o >> 24, o & 0xFFFFFF, n >> 24, n & 0xFFFFFF);
+            bad++;
+        }
+    }
+    if (bad) return 1;
+
+    uint32_t so, sn;
+    double old_ns = benchRun(oldDispatch, msgs, hal, 5, reps, &so);
+    double new_ns = benchRun(newDispatch, msgs, hal, 5, reps, &sn);
+    printf("%d messages x %d, same leaf for all\n", BENCH_MSGS, reps);
+    printf("strcmp dispatch: %6.1f ns/msg\n", old_ns);
+    printf("token router:    %6.1f ns/msg (%.2fx)\n", new_ns, old_ns / new_ns);
+    return so == sn ? 0 : 1;
+}